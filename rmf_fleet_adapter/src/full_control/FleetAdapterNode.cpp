@@ -295,6 +295,12 @@ const rmf_traffic::agv::Planner& FleetAdapterNode::get_planner() const
   return _field->planner;
 }
 
+//==============================================================================
+rmf_traffic::agv::PlanningExecutor& FleetAdapterNode::get_planning_executor()
+{
+  return _field->planning_executor;
+}
+
 //==============================================================================
 const rmf_traffic::agv::Graph& FleetAdapterNode::get_graph() const
 {
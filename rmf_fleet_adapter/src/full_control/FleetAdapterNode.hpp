@@ -42,6 +42,7 @@
 #include <rmf_traffic/agv/Graph.hpp>
 #include <rmf_traffic/agv/VehicleTraits.hpp>
 #include <rmf_traffic/agv/Planner.hpp>
+#include <rmf_traffic/agv/PlanningExecutor.hpp>
 
 #include <std_msgs/msg/bool.hpp>
 
@@ -129,6 +130,8 @@ public:
 
   const rmf_traffic::agv::Planner& get_planner() const;
 
+  rmf_traffic::agv::PlanningExecutor& get_planning_executor();
+
   const rmf_traffic::agv::Graph& get_graph() const;
 
   std::vector<rmf_traffic::agv::Plan::Start> compute_plan_starts(
@@ -149,6 +152,10 @@ public:
     rmf_traffic::agv::VehicleTraits traits;
     rmf_traffic::agv::Planner planner;
 
+    // This is declared last so that it gets destroyed first, because its
+    // planning jobs refer to the schedule viewer of the mirror.
+    rmf_traffic::agv::PlanningExecutor planning_executor;
+
     Fields(
         GraphInfo graph_info_,
         rmf_traffic::agv::VehicleTraits traits_,
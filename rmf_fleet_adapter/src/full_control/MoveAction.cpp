@@ -28,45 +28,6 @@ namespace rmf_fleet_adapter {
 namespace full_control {
 
 namespace {
-//==============================================================================
-rmf_utils::optional<std::size_t> get_fastest_plan_index(
-    const std::vector<rmf_utils::optional<rmf_traffic::agv::Plan>>& plans)
-{
-  auto nearest = std::chrono::steady_clock::time_point::max();
-  std::size_t i_nearest = std::numeric_limits<std::size_t>::max();
-  for (std::size_t i=0; i < plans.size(); ++i)
-  {
-    const auto& plan = plans[i];
-    if (plan)
-    {
-      const auto finish_time = plan->get_trajectories().back().finish_time();
-      if (!finish_time)
-      {
-        // If this is an empty trajectory, then the robot is already sitting on
-        // its destination, making this undoubtedly the fastest plan.
-        assert(!plan->get_waypoints().empty());
-        assert(plan->get_waypoints().front().graph_index());
-        assert(plan->get_waypoints().size() == 1);
-        assert(*plan->get_waypoints().front().graph_index()
-               == *plan->get_waypoints().back().graph_index());
-        return i;
-      }
-
-      if (*finish_time < nearest)
-      {
-        nearest = *finish_time;
-        i_nearest = i;
-      }
-    }
-  }
-
-  if (i_nearest == std::numeric_limits<std::size_t>::max())
-  {
-    return rmf_utils::nullopt;
-  }
-  return i_nearest;
-}
-
 //==============================================================================
 class MoveAction : public Action
 {
@@ -110,84 +71,38 @@ public:
     const auto plan_starts =
         _node->compute_plan_starts(_context->location, start_delay);
 
-    bool interrupt_flag = false;
     auto options = planner.get_default_options();
-    options.interrupt_flag(&interrupt_flag);
     options.ignore_schedule_ids(schedule_ids());
 
-    bool main_plan_solved = false;
-    bool main_plan_failed = false;
-    bool fallback_plan_solved = false;
-    std::condition_variable plan_solved_cv;
-    rmf_utils::optional<rmf_traffic::agv::Plan> main_plan;
-    std::thread main_plan_thread = std::thread(
-          [&]()
-    {
-      main_plan = planner.plan(
-            plan_starts, rmf_traffic::agv::Plan::Goal(_goal_wp_index), options);
-      if (main_plan)
-      {
-        main_plan_solved = true;
-        plan_solved_cv.notify_all();
-      }
-      else
-      {
-        main_plan_failed = true;
-      }
-    });
-
-    std::vector<std::thread> fallback_plan_threads;
-    std::vector<rmf_utils::optional<rmf_traffic::agv::Plan>> fallback_plans;
-    std::mutex fallback_plan_mutex;
-    for (const std::size_t goal_wp : _fallback_wps)
-    {
-      fallback_plan_threads.emplace_back(std::thread([&, goal_wp]()
-      {
-        auto fallback_plan = planner.plan(
-              plan_starts, rmf_traffic::agv::Plan::Goal(goal_wp), options);
-
-        std::unique_lock<std::mutex> lock(fallback_plan_mutex);
-        if (fallback_plan)
-        {
-          fallback_plan_solved = true;
-          plan_solved_cv.notify_all();
-        }
-        fallback_plans.emplace_back(std::move(fallback_plan));
-      }));
-    }
-
-    const auto giveup_time =
-        std::chrono::steady_clock::now() + _node->get_plan_time();
+    using PlanningExecutor = rmf_traffic::agv::PlanningExecutor;
+    auto& executor = _node->get_planning_executor();
 
-    const auto done_searching = [&]() -> bool
-    {
-      return main_plan_solved || (main_plan_failed && fallback_plan_solved);
-    };
+    // Both searches will give up on their own once they have spent the
+    // planning time searching
+    const PlanningExecutor::CancellationToken token{
+      rmf_utils::nullopt, _node->get_plan_time()};
 
-    // Waiting for the main planning thread is a bit complicated, because we
-    // want to avoid the possibility that the plan finishes and triggers the
-    // condition variable before we check it.
-    while (std::chrono::steady_clock::now() < giveup_time && !done_searching())
-    {
-      std::mutex placeholder;
-      std::unique_lock<std::mutex> lock(placeholder);
-      plan_solved_cv.wait_for(
-            lock, std::chrono::milliseconds(100),
-            [&](){ return done_searching(); });
-    }
+    auto main_plan_future = executor.plan(
+          planner, plan_starts, rmf_traffic::agv::Plan::Goal(_goal_wp_index),
+          options, token);
 
-    interrupt_flag = true;
-    main_plan_thread.join();
-    for (auto& fallback_thread : fallback_plan_threads)
-      fallback_thread.join();
+    // A single search finds the nearest reachable parking spot, instead of
+    // running a separate search for each parking spot.
+    auto fallback_plan_future = executor.plan_to_nearest(
+          planner, plan_starts, fallback_goals(), options, token);
 
+    auto main_plan = main_plan_future.get();
     if (main_plan)
     {
+      // We do not need the fallback plan anymore, but we still wait for it to
+      // stop so that it does not outlive this search.
+      token.cancel();
+      fallback_plan_future.wait();
       plans.emplace_back(std::move(*std::move(main_plan)));
       return plans;
     }
 
-    return use_fallback(std::move(fallback_plans));
+    return use_fallback(fallback_plan_future.get());
   }
 
   void find_and_execute_plan(const std::chrono::nanoseconds start_delay)
@@ -211,12 +126,11 @@ public:
   }
 
   std::vector<rmf_traffic::agv::Plan> use_fallback(
-      std::vector<rmf_utils::optional<rmf_traffic::agv::Plan>> fallback_plans)
+      rmf_utils::optional<rmf_traffic::agv::Plan> fallback_plan)
   {
     std::vector<rmf_traffic::agv::Plan> plans;
 
-    const auto i_nearest_opt = get_fastest_plan_index(fallback_plans);
-    if (!i_nearest_opt)
+    if (!fallback_plan)
     {
       RCLCPP_WARN(
             _node->get_logger(),
@@ -225,67 +139,58 @@ public:
 
       return plans;
     }
-    const auto i_nearest = *i_nearest_opt;
 
-    const auto& fallback_plan = *fallback_plans[i_nearest];
     const std::size_t fallback_waypoint =
-        *fallback_plan.get_waypoints().back().graph_index();
+        *fallback_plan->get_waypoints().back().graph_index();
     const double fallback_orientation =
-        fallback_plan.get_waypoints().back().position()[2];
+        fallback_plan->get_waypoints().back().position()[2];
     const auto fallback_end_time =
-        fallback_plan.get_waypoints().back().time();
+        fallback_plan->get_waypoints().back().time();
 
     const auto& planner = _node->get_planner();
 
-    bool interrupt_flag = false;
     auto options = planner.get_default_options();
-    options.interrupt_flag(&interrupt_flag);
     options.ignore_schedule_ids(schedule_ids());
 
-    const auto t_spread = std::chrono::seconds(15);
-    bool have_resume_plan = false;
-    std::vector<std::thread> resume_plan_threads;
-    std::vector<rmf_utils::optional<rmf_traffic::agv::Plan>> resume_plans;
-    std::mutex resume_plan_mutex;
-    std::condition_variable resume_plan_cv;
+    using PlanningExecutor = rmf_traffic::agv::PlanningExecutor;
+    auto& executor = _node->get_planning_executor();
+    const PlanningExecutor::CancellationToken token{
+      rmf_utils::nullopt, _node->get_plan_time()};
 
+    // All of the resume times are searched at once, but the results are
+    // checked from earliest to latest, so the plan that we use is the one that
+    // lets the robot leave the parking spot soonest.
+    const auto t_spread = std::chrono::seconds(15);
+    std::vector<PlanningExecutor::PlanFuture> resume_plan_futures;
     for (std::size_t i=1; i < 9; ++i)
     {
-      resume_plan_threads.emplace_back(std::thread([&, i]()
-      {
-        const auto resume_time = fallback_end_time + i*t_spread;
-        auto resume_plan = planner.plan(
-              rmf_traffic::agv::Plan::Start(
-                resume_time, fallback_waypoint, fallback_orientation),
-              rmf_traffic::agv::Plan::Goal(
-                _goal_wp_index),
-              options);
-
-        std::unique_lock<std::mutex> lock(resume_plan_mutex);
-        if (resume_plan)
-          have_resume_plan = true;
-        resume_plans.emplace_back(std::move(resume_plan));
-        resume_plan_cv.notify_all();
-      }));
+      const auto resume_time = fallback_end_time + i*t_spread;
+      resume_plan_futures.emplace_back(
+            executor.plan(
+              planner,
+              {rmf_traffic::agv::Plan::Start(
+                 resume_time, fallback_waypoint, fallback_orientation)},
+              rmf_traffic::agv::Plan::Goal(_goal_wp_index),
+              options, token));
     }
 
-    const auto giveup_time =
-        std::chrono::steady_clock::now() + _node->get_plan_time();
-
-    while (std::chrono::steady_clock::now() < giveup_time && !have_resume_plan)
+    rmf_utils::optional<rmf_traffic::agv::Plan> resume_plan;
+    for (auto& future : resume_plan_futures)
     {
-      std::mutex placeholder;
-      std::unique_lock<std::mutex> lock(placeholder);
-      resume_plan_cv.wait_for(lock, std::chrono::milliseconds(100),
-                              [&](){ return have_resume_plan; });
-    }
+      if (resume_plan)
+      {
+        // The later searches are no longer needed, but we wait for them to
+        // stop before we return.
+        future.wait();
+        continue;
+      }
 
-    interrupt_flag = true;
-    for (auto& resume_plan_thread : resume_plan_threads)
-      resume_plan_thread.join();
+      resume_plan = future.get();
+      if (resume_plan)
+        token.cancel();
+    }
 
-    const auto quickest_finish_opt = get_fastest_plan_index(resume_plans);
-    if (!quickest_finish_opt)
+    if (!resume_plan)
     {
       RCLCPP_WARN(
             _node->get_logger(),
@@ -296,13 +201,23 @@ public:
     }
     else
     {
-      plans.emplace_back(fallback_plan);
-      plans.emplace_back(*resume_plans[*quickest_finish_opt]);
+      plans.emplace_back(*std::move(fallback_plan));
+      plans.emplace_back(*std::move(resume_plan));
     }
 
     return plans;
   }
 
+  rmf_traffic::agv::Planner::GoalSet fallback_goals() const
+  {
+    rmf_traffic::agv::Planner::GoalSet goals;
+    goals.reserve(_fallback_wps.size());
+    for (const std::size_t goal_wp : _fallback_wps)
+      goals.emplace_back(goal_wp);
+
+    return goals;
+  }
+
   std::vector<rmf_traffic::Trajectory> collect_trajectories(
       std::vector<rmf_traffic::agv::Plan> plans,
       std::chrono::nanoseconds delay = std::chrono::seconds(0)) const
@@ -1087,48 +1002,20 @@ public:
     const auto plan_starts = _node->compute_plan_starts(
           _context->location, std::chrono::seconds(0));
 
-    bool interrupt_flag = false;
     auto options = planner.get_default_options();
-    options.interrupt_flag(&interrupt_flag);
     options.ignore_schedule_ids(schedule_ids());
 
-    std::vector<std::thread> plan_threads;
-    std::vector<rmf_utils::optional<rmf_traffic::agv::Plan>> candidate_plans;
-    std::mutex plans_mutex;
-    std::condition_variable plans_cv;
-    bool have_plan = false;
-    for (const std::size_t goal_wp : _fallback_wps)
-    {
-      plan_threads.emplace_back(std::thread([&, goal_wp]()
-      {
-        auto emergency_plan = planner.plan(
-              plan_starts, rmf_traffic::agv::Plan::Goal(goal_wp), options);
-
-        std::unique_lock<std::mutex> lock(plans_mutex);
-        if (emergency_plan)
-          have_plan = true;
-
-        candidate_plans.emplace_back(std::move(emergency_plan));
-        plans_cv.notify_all();
-      }));
-    }
-
-    const auto giveup_time =
-        std::chrono::steady_clock::now() + 5*_node->get_plan_time();
-
-    while (std::chrono::steady_clock::now() < giveup_time && !have_plan)
-    {
-      std::unique_lock<std::mutex> lock(plans_mutex);
-      plans_cv.wait_for(lock, std::chrono::milliseconds(100),
-                        [&](){ return have_plan; });
-    }
+    using PlanningExecutor = rmf_traffic::agv::PlanningExecutor;
+    const PlanningExecutor::CancellationToken token{
+      rmf_utils::nullopt, 5*_node->get_plan_time()};
 
-    interrupt_flag =  true;
-    for (auto& plan_thread : plan_threads)
-      plan_thread.join();
+    // A single search finds the parking spot that the robot can reach soonest.
+    // Emergency plans jump ahead of any routine plans that are waiting.
+    const auto emergency_plan = _node->get_planning_executor().plan_to_nearest(
+          planner, plan_starts, fallback_goals(), options, token,
+          PlanningExecutor::Priority::Emergency).get();
 
-    const auto quickest_finish_opt = get_fastest_plan_index(candidate_plans);
-    if (!quickest_finish_opt)
+    if (!emergency_plan)
     {
       RCLCPP_WARN(
             _node->get_logger(),
@@ -1139,7 +1026,7 @@ public:
     }
 
     const std::size_t emergency_wp_index =
-        *candidate_plans[*quickest_finish_opt]->get_waypoints().back().graph_index();
+        *emergency_plan->get_waypoints().back().graph_index();
     const auto it =_node->get_waypoint_names().find(emergency_wp_index);
     const auto emergency_wp_name =
         (it == _node->get_waypoint_names().end()) ? "" : (":" + it->second);
@@ -1149,7 +1036,7 @@ public:
           "Choosing emergency waypoint [" + std::to_string(emergency_wp_index)
           + emergency_wp_name + "] for [" + _context->robot_name() + "]");
 
-    return {*candidate_plans[*quickest_finish_opt]};
+    return {*emergency_plan};
   }
 
   void find_and_execute_emergency_plan()
@@ -20,6 +20,8 @@
 
 #include <rmf_traffic/Trajectory.hpp>
 #include <exception>
+#include <utility>
+#include <vector>
 
 namespace rmf_traffic {
 
@@ -106,6 +108,74 @@ public:
       const bool quit_after_one = false);
   // TODO(MXG): Replace quit_after_one with a DetectConflict::Options class
 
+  /// A pair of indices that refer to two trajectories which are in conflict.
+  using IndexPair = std::pair<std::size_t, std::size_t>;
+
+  /// Find every pair of trajectories within a set that are in conflict with
+  /// each other.
+  ///
+  /// The trajectories are first sorted by their start times and swept to find
+  /// the pairs that share a map, overlap in time, and have overlapping
+  /// bounding boxes. Only those pairs are given to narrow_phase(), and that
+  /// work is divided between the calling thread and a pool of worker threads
+  /// that is shared by every call.
+  ///
+  /// \param[in] trajectories
+  ///   The set of trajectories to check. None of the pointers may be null, and
+  ///   each trajectory must have at least two segments.
+  ///
+  /// \param[in] max_threads
+  ///   The maximum number of threads to use for the narrow phase, including the
+  ///   calling thread. If this is 0, every worker in the pool may be used.
+  ///
+  /// \return the pairs of indices into the trajectories vector that are in
+  /// conflict. The first index of each pair is less than the second, and the
+  /// pairs are sorted.
+  static std::vector<IndexPair> all_pairs(
+      const std::vector<const Trajectory*>& trajectories,
+      std::size_t max_threads = 0);
+
+  /// Find every pair of trajectories where one trajectory comes from the set
+  /// trajectories_a and the other comes from trajectories_b that are in
+  /// conflict. Pairs within the same set are never tested, so the cost does
+  /// not grow with the number of pairs inside either set.
+  ///
+  /// \return the pairs of conflicting indices, where the first index of each
+  /// pair refers to trajectories_a and the second index refers to
+  /// trajectories_b. The pairs are sorted.
+  static std::vector<IndexPair> all_pairs(
+      const std::vector<const Trajectory*>& trajectories_a,
+      const std::vector<const Trajectory*>& trajectories_b,
+      std::size_t max_threads = 0);
+
+  /// Check whether a candidate trajectory is in conflict with any trajectory
+  /// in a set.
+  ///
+  /// This gives the same answer as calling between() on the candidate and
+  /// each trajectory in the set, but the splines and bounding boxes of the
+  /// candidate are only computed once, the collision objects are reused, and
+  /// the search stops at the first conflict.
+  ///
+  /// \param[in] candidate
+  ///   The trajectory to check. It must have at least two segments.
+  ///
+  /// \param[in] trajectories
+  ///   The trajectories to check the candidate against. None of the pointers
+  ///   may be null, and each trajectory must have at least two segments.
+  static bool any_between(
+      const Trajectory& candidate,
+      const std::vector<const Trajectory*>& trajectories);
+
+  /// Find every trajectory in a set that is in conflict with a candidate
+  /// trajectory. The precomputation for the candidate is shared in the same
+  /// way as any_between().
+  ///
+  /// \return the indices into the trajectories vector of the trajectories that
+  /// are in conflict with the candidate, in increasing order.
+  static std::vector<std::size_t> all_between(
+      const Trajectory& candidate,
+      const std::vector<const Trajectory*>& trajectories);
+
   class Implementation;
 };
 
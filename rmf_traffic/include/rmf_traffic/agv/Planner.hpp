@@ -28,6 +28,9 @@
 
 #include <rmf_utils/optional.hpp>
 
+#include <atomic>
+#include <memory>
+
 namespace rmf_traffic {
 namespace agv {
 
@@ -166,6 +169,35 @@ public:
     /// long.
     const bool* interrupt_flag() const;
 
+    /// Set a cancellation flag to stop this planner. Unlike the interrupt
+    /// flag, this flag may safely be raised from another thread while the
+    /// planner is running. Pass in a nullptr to remove the cancellation flag.
+    Options& cancel_flag(std::shared_ptr<const std::atomic_bool> flag);
+
+    /// Get the cancellation flag that will stop this planner.
+    const std::shared_ptr<const std::atomic_bool>& cancel_flag() const;
+
+    /// Set a deadline for this planner. If the planner is still searching when
+    /// the deadline arrives, it will give up. Pass in a nullopt to let the
+    /// planner run without a deadline.
+    Options& deadline(rmf_utils::optional<Time> deadline);
+
+    /// Get the deadline for this planner, if it has one.
+    const rmf_utils::optional<Time>& deadline() const;
+
+    /// Turn Safe Interval Path Planning (SIPP) on or off. It is off by default.
+    ///
+    /// With SIPP, the planner reads the schedule once to find the spans of
+    /// time when each waypoint and lane is free of other trajectories. Instead
+    /// of waiting at holding points in increments of the minimum holding time,
+    /// the robot will wait exactly until a waypoint or lane that it wants to
+    /// move into becomes free. This expands far fewer nodes and runs far fewer
+    /// conflict checks when the schedule is busy.
+    Options& safe_interval_planning(bool enable);
+
+    /// Get whether Safe Interval Path Planning is turned on.
+    bool safe_interval_planning() const;
+
     /// Specify a set of schedule IDs to ignore when collision checking. This is
     /// useful for planning a schedule replacement.
     Options& ignore_schedule_ids(std::unordered_set<schedule::Version> ids);
@@ -401,6 +433,83 @@ public:
       Goal goal,
       Options options) const;
 
+  using GoalSet = std::vector<Goal>;
+
+  /// Produces a plan from the given set of starting conditions to each goal in
+  /// the given set of goals. The default Options of this Planner instance will
+  /// be used.
+  ///
+  /// All of the plans are found with a single search, which is much cheaper
+  /// than planning to each goal separately.
+  ///
+  /// \param[in] starts
+  ///   The set of available starting conditions
+  ///
+  /// \param[in] goals
+  ///   The set of goals to find plans for
+  ///
+  /// \return one entry for each goal, in the same order as the goals. An entry
+  /// will be a nullopt if no plan could be found to its goal, or if the planner
+  /// was interrupted before its goal was reached.
+  std::vector<rmf_utils::optional<Plan>> plan(
+      const StartSet& starts,
+      GoalSet goals) const;
+
+  /// Produces a plan from the given set of starting conditions to each goal in
+  /// the given set of goals. Override the default options.
+  ///
+  /// \param[in] starts
+  ///   The set of available starting conditions
+  ///
+  /// \param[in] goals
+  ///   The set of goals to find plans for
+  ///
+  /// \param[in] options
+  ///   The options to use for this plan. This overrides the default Options of
+  ///   the Planner instance.
+  ///
+  /// \return one entry for each goal, in the same order as the goals.
+  std::vector<rmf_utils::optional<Plan>> plan(
+      const StartSet& starts,
+      GoalSet goals,
+      Options options) const;
+
+  /// Produces a plan from the given set of starting conditions to whichever
+  /// goal in the set can be reached with the shortest plan. The default
+  /// Options of this Planner instance will be used.
+  ///
+  /// The search stops as soon as any goal is reached, so this is cheaper than
+  /// finding a plan to every goal.
+  ///
+  /// \param[in] starts
+  ///   The set of available starting conditions
+  ///
+  /// \param[in] goals
+  ///   The set of acceptable goals. Use Plan::get_goal() to find out which one
+  ///   was chosen.
+  rmf_utils::optional<Plan> plan_to_nearest(
+      const StartSet& starts,
+      GoalSet goals) const;
+
+  /// Produces a plan from the given set of starting conditions to whichever
+  /// goal in the set can be reached with the shortest plan. Override the
+  /// default options.
+  ///
+  /// \param[in] starts
+  ///   The set of available starting conditions
+  ///
+  /// \param[in] goals
+  ///   The set of acceptable goals. Use Plan::get_goal() to find out which one
+  ///   was chosen.
+  ///
+  /// \param[in] options
+  ///   The options to use for this plan. This overrides the default Options of
+  ///   the Planner instance.
+  rmf_utils::optional<Plan> plan_to_nearest(
+      const StartSet& starts,
+      GoalSet goals,
+      Options options) const;
+
   class Implementation;
 private:
   rmf_utils::impl_ptr<Implementation> _pimpl;
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RMF_TRAFFIC__AGV__PLANNINGEXECUTOR_HPP
+#define RMF_TRAFFIC__AGV__PLANNINGEXECUTOR_HPP
+
+#include <rmf_traffic/agv/Planner.hpp>
+
+#include <future>
+
+namespace rmf_traffic {
+namespace agv {
+
+//==============================================================================
+/// The PlanningExecutor runs planning jobs on a fixed pool of worker threads.
+///
+/// Each job returns a future for its result, so many plans can be requested at
+/// once without creating a thread for each of them. Jobs with a higher
+/// Priority are always started before jobs with a lower Priority. Jobs with
+/// the same Priority are started in the order that they were submitted.
+///
+/// When the executor is destroyed, it waits for the jobs that are currently
+/// running to finish. Jobs that have not started yet will not be run, and
+/// their futures will receive a nullopt.
+class PlanningExecutor
+{
+public:
+
+  enum class Priority : uint8_t
+  {
+    /// Routine plans, like replanning to resolve a conflict
+    Routine = 0,
+
+    /// Urgent plans, like finding an emergency parking spot. These will be
+    /// started before any Routine plans that are waiting.
+    Emergency
+  };
+
+  /// A CancellationToken can stop any number of planning jobs. A job will
+  /// stop if cancel() is called on its token, if the deadline of its token
+  /// arrives, or if the job has been running for longer than the time limit of
+  /// its token. If a job is cancelled before it has started, it will not run at
+  /// all.
+  ///
+  /// Copies of a CancellationToken share the same cancellation state.
+  class CancellationToken
+  {
+  public:
+
+    /// Constructor
+    ///
+    /// \param[in] deadline
+    ///   The time after which jobs with this token should stop searching. Pass
+    ///   in a nullopt if there should not be a deadline.
+    ///
+    /// \param[in] time_limit
+    ///   How long each job with this token may search for. The time limit of a
+    ///   job begins when a worker starts running it, so time spent waiting in
+    ///   the queue does not count against it. Pass in a nullopt if there should
+    ///   not be a time limit.
+    CancellationToken(
+        rmf_utils::optional<Time> deadline = rmf_utils::nullopt,
+        rmf_utils::optional<Duration> time_limit = rmf_utils::nullopt);
+
+    /// Cancel every job that is using this token. This may be called from any
+    /// thread.
+    void cancel() const;
+
+    /// Returns true if cancel() has been called or if the deadline has passed.
+    /// The time limit is counted separately for each job, so it is not
+    /// considered here.
+    bool cancelled() const;
+
+    /// Get the deadline of this token, if it has one.
+    const rmf_utils::optional<Time>& deadline() const;
+
+    /// Get the time limit of this token, if it has one.
+    const rmf_utils::optional<Duration>& time_limit() const;
+
+    /// Apply this token to a set of planner options, so that the planner will
+    /// stop when this token is cancelled.
+    Planner::Options& apply(Planner::Options& options) const;
+
+    class Implementation;
+  private:
+    rmf_utils::impl_ptr<Implementation> _pimpl;
+  };
+
+  /// The result of a planning job. If the planner threw an exception while
+  /// running the job, get() will rethrow that exception.
+  using PlanFuture = std::future<rmf_utils::optional<Plan>>;
+
+  /// Constructor
+  ///
+  /// \param[in] num_workers
+  ///   The number of worker threads that will run planning jobs. If this is
+  ///   zero, then the number of hardware threads will be used.
+  PlanningExecutor(std::size_t num_workers = 0);
+
+  /// Get the number of worker threads in this executor.
+  std::size_t num_workers() const;
+
+  /// Get the number of jobs that are waiting for a worker.
+  std::size_t num_pending() const;
+
+  /// Produce a plan to a goal on one of the worker threads.
+  ///
+  /// \param[in] planner
+  ///   The planner to use. A copy of the planner is kept by the job, so the
+  ///   original may be destroyed before the job is finished.
+  ///
+  /// \param[in] starts
+  ///   The set of available starting conditions
+  ///
+  /// \param[in] goal
+  ///   The goal conditions
+  ///
+  /// \param[in] options
+  ///   The options to use for this plan. The schedule viewer of these options
+  ///   must remain alive until the job is finished.
+  ///
+  /// \param[in] token
+  ///   The token that can be used to cancel this job
+  ///
+  /// \param[in] priority
+  ///   The priority of this job
+  ///
+  /// \return a future for the plan. The plan will be a nullopt if no plan
+  /// could be found, if the job was cancelled, or if this executor was
+  /// destroyed before the job could start. If the planner throws an exception,
+  /// the future will rethrow it when get() is called.
+  PlanFuture plan(
+      const Planner& planner,
+      Planner::StartSet starts,
+      Planner::Goal goal,
+      Planner::Options options,
+      CancellationToken token = CancellationToken(),
+      Priority priority = Priority::Routine);
+
+  /// Produce a plan to whichever goal in a set can be reached with the
+  /// shortest plan on one of the worker threads.
+  ///
+  /// \sa Planner::plan_to_nearest()
+  PlanFuture plan_to_nearest(
+      const Planner& planner,
+      Planner::StartSet starts,
+      Planner::GoalSet goals,
+      Planner::Options options,
+      CancellationToken token = CancellationToken(),
+      Priority priority = Priority::Routine);
+
+  class Implementation;
+private:
+  rmf_utils::unique_impl_ptr<Implementation> _pimpl;
+};
+
+} // namespace agv
+} // namespace rmf_traffic
+
+#endif // RMF_TRAFFIC__AGV__PLANNINGEXECUTOR_HPP
@@ -79,6 +79,11 @@ public:
   /// Look at the source of this FinalShape to inspect its parameters.
   const Shape& source() const;
 
+  /// Get the characteristic length of this FinalShape. This is the radius of
+  /// the smallest circle, centered on the shape's origin, that contains the
+  /// shape for every possible orientation.
+  double get_characteristic_length() const;
+
   virtual ~FinalShape() = default;
 
   class Implementation;
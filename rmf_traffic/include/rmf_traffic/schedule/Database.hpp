@@ -25,6 +25,8 @@
 namespace rmf_traffic {
 namespace schedule {
 
+class Storage;
+
 //==============================================================================
 /// A class that maintains a database of scheduled Trajectories. This class is
 /// intended to be used only for the canonical RMF traffic schedule database.
@@ -455,6 +457,10 @@ public:
   /// this version number will remain the same.
   Version cull(Time time);
 
+private:
+  // The Storage class needs to read and restore the internal records of a
+  // Database, including the parts that are not visible through the Viewer API.
+  friend class Storage;
 };
 
 } // namespace schedule
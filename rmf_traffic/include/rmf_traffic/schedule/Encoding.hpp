@@ -0,0 +1,317 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RMF_TRAFFIC__SCHEDULE__ENCODING_HPP
+#define RMF_TRAFFIC__SCHEDULE__ENCODING_HPP
+
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <iterator>
+#include <vector>
+
+namespace rmf_traffic {
+namespace schedule {
+
+//==============================================================================
+/// Encode a Trajectory into a compact binary format.
+///
+/// Each distinct profile and shape of the Trajectory is only written once, and
+/// the finish times of the segments are written as differences from the
+/// segment before them. The result can be read with a TrajectoryView.
+///
+/// \warning The encoding uses the byte order of the machine that creates it,
+/// so it should only be decoded on a machine with the same byte order.
+std::vector<uint8_t> encode(const Trajectory& trajectory);
+
+//==============================================================================
+/// Encode a Database::Patch into a compact binary format.
+///
+/// The map names, profiles, and shapes of every Trajectory in the Patch are
+/// gathered into tables that are shared by the whole Patch, so each distinct
+/// profile is only written (and later decoded) once. The result can be read
+/// with a PatchView.
+///
+/// \warning The encoding uses the byte order of the machine that creates it,
+/// so it should only be decoded on a machine with the same byte order.
+///
+/// \throws std::runtime_error if a Change in the Patch is missing its
+/// Trajectory.
+std::vector<uint8_t> encode(const Database::Patch& patch);
+
+//==============================================================================
+/// A read-only view of an encoded Trajectory. The segments of the Trajectory
+/// can be inspected directly from the encoded data without constructing a
+/// Trajectory object.
+///
+/// The view does not copy the encoded data, so the data must outlive the view
+/// and any iterators that come from it.
+class TrajectoryView
+{
+public:
+
+  /// A Segment of the encoded Trajectory
+  class Segment
+  {
+  public:
+
+    /// Get the finishing time of this Segment.
+    Time get_finish_time() const;
+
+    /// Get the finishing position of this Segment.
+    Eigen::Vector3d get_finish_position() const;
+
+    /// Get the finishing velocity of this Segment.
+    Eigen::Vector3d get_finish_velocity() const;
+
+    /// Get the index of this Segment's profile within the profile table of the
+    /// encoding.
+    std::size_t get_profile_index() const;
+
+  private:
+    friend class TrajectoryView;
+    Time _finish_time;
+    std::size_t _profile_index;
+    const uint8_t* _vectors;
+  };
+
+  /// An iterator over the Segments of the encoded Trajectory. Iterating does
+  /// not allocate any memory.
+  class const_iterator
+  {
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Segment;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Segment*;
+    using reference = const Segment&;
+
+    /// Dereference operator
+    const Segment& operator*() const;
+
+    /// Drill-down operator
+    const Segment* operator->() const;
+
+    /// Pre-increment operator: ++it
+    const_iterator& operator++();
+
+    /// Post-increment operator: it++
+    const_iterator operator++(int);
+
+    /// Equality comparison operator
+    bool operator==(const const_iterator& other) const;
+
+    /// Inequality comparison operator
+    bool operator!=(const const_iterator& other) const;
+
+    /// Create an uninitialized iterator
+    const_iterator();
+
+  private:
+    friend class TrajectoryView;
+    void _load();
+    const uint8_t* _next;
+    const uint8_t* _end;
+    std::size_t _index;
+    std::size_t _size;
+    std::size_t _num_profiles;
+    Segment _segment;
+  };
+
+  /// Create a view of data that was produced by encode(const Trajectory&).
+  ///
+  /// \throws std::runtime_error if the data is not an encoded Trajectory.
+  TrajectoryView(const uint8_t* data, std::size_t size);
+
+  /// Create a view of data that was produced by encode(const Trajectory&).
+  ///
+  /// \throws std::runtime_error if the data is not an encoded Trajectory.
+  explicit TrajectoryView(const std::vector<uint8_t>& data);
+
+  // A view cannot be created from a temporary, because the view would outlive
+  // the data that it refers to.
+  TrajectoryView(std::vector<uint8_t>&&) = delete;
+
+  /// Get the name of the map that the Trajectory is on.
+  std::string get_map_name() const;
+
+  /// Get the number of Segments in the Trajectory.
+  std::size_t size() const;
+
+  /// Returns true if the Trajectory has no Segments.
+  bool empty() const;
+
+  /// Get the finish time of the first Segment, or a nullptr if the Trajectory
+  /// is empty.
+  const Time* start_time() const;
+
+  /// Get the finish time of the last Segment, or a nullptr if the Trajectory
+  /// is empty.
+  const Time* finish_time() const;
+
+  /// Get the duration of the Trajectory, or zero if the Trajectory is empty.
+  Duration duration() const;
+
+  /// Get the number of profiles that the Segments can refer to.
+  std::size_t num_profiles() const;
+
+  /// Returns an iterator to the first Segment.
+  const_iterator begin() const;
+
+  /// Returns an iterator that follows the last Segment.
+  const_iterator end() const;
+
+  /// Construct a Trajectory from the encoded data.
+  Trajectory decode() const;
+
+  class Implementation;
+private:
+  TrajectoryView();
+  friend class PatchView;
+  rmf_utils::impl_ptr<Implementation> _pimpl;
+};
+
+//==============================================================================
+/// A read-only view of an encoded Database::Patch. The Changes of the Patch can
+/// be inspected directly from the encoded data without constructing any
+/// Trajectory objects.
+///
+/// The view does not copy the encoded data, so the data must outlive the view
+/// and anything that comes from it.
+class PatchView
+{
+public:
+
+  /// A Change within the encoded Patch
+  class Change
+  {
+  public:
+
+    /// Get the type of Change
+    Database::Change::Mode get_mode() const;
+
+    /// Get the version ID that this change refers to
+    Version id() const;
+
+    /// Get the ID of the Trajectory that this Change modifies. This is only
+    /// meaningful for Interrupt, Delay, Replace, and Erase changes.
+    Version original_id() const;
+
+    /// Get the Trajectory of an Insert or Replace change, or the interruption
+    /// of an Interrupt change. For other types of changes, this returns a
+    /// nullptr.
+    const TrajectoryView* trajectory() const;
+
+    /// Get the time that a Delay began, or the cut-off time of a Cull.
+    Time time() const;
+
+    /// Get the duration of a Delay, or the delay that follows an Interrupt.
+    Duration duration() const;
+
+  private:
+    friend class PatchView;
+    Database::Change::Mode _mode;
+    Version _id;
+    Version _original_id;
+    Time _time;
+    Duration _duration;
+    rmf_utils::optional<TrajectoryView> _trajectory;
+  };
+
+  /// An iterator over the Changes of the encoded Patch.
+  class const_iterator
+  {
+  public:
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Change;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const Change*;
+    using reference = const Change&;
+
+    /// Dereference operator
+    const Change& operator*() const;
+
+    /// Drill-down operator
+    const Change* operator->() const;
+
+    /// Pre-increment operator: ++it
+    const_iterator& operator++();
+
+    /// Post-increment operator: it++
+    const_iterator operator++(int);
+
+    /// Equality comparison operator
+    bool operator==(const const_iterator& other) const;
+
+    /// Inequality comparison operator
+    bool operator!=(const const_iterator& other) const;
+
+    /// Create an uninitialized iterator
+    const_iterator();
+
+  private:
+    friend class PatchView;
+    void _load();
+    const PatchView* _view;
+    const uint8_t* _next;
+    std::size_t _index;
+    Change _change;
+  };
+
+  /// Create a view of data that was produced by encode(const Database::Patch&)
+  ///
+  /// \throws std::runtime_error if the data is not an encoded Patch.
+  PatchView(const uint8_t* data, std::size_t size);
+
+  /// Create a view of data that was produced by encode(const Database::Patch&)
+  ///
+  /// \throws std::runtime_error if the data is not an encoded Patch.
+  explicit PatchView(const std::vector<uint8_t>& data);
+
+  // A view cannot be created from a temporary, because the view would outlive
+  // the data that it refers to.
+  PatchView(std::vector<uint8_t>&&) = delete;
+
+  /// Get the latest version of the Database that informed this Patch.
+  Version latest_version() const;
+
+  /// Get the number of Changes in this Patch.
+  std::size_t size() const;
+
+  /// Returns an iterator to the first Change.
+  const_iterator begin() const;
+
+  /// Returns an iterator that follows the last Change.
+  const_iterator end() const;
+
+  /// Construct a Database::Patch from the encoded data. Each profile in the
+  /// tables of the Patch is only constructed once and then shared by all of
+  /// the Trajectories that use it.
+  Database::Patch decode() const;
+
+  class Implementation;
+private:
+  rmf_utils::impl_ptr<Implementation> _pimpl;
+};
+
+} // namespace schedule
+} // namespace rmf_traffic
+
+#endif // RMF_TRAFFIC__SCHEDULE__ENCODING_HPP
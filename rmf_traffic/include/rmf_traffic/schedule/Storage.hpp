@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef RMF_TRAFFIC__SCHEDULE__STORAGE_HPP
+#define RMF_TRAFFIC__SCHEDULE__STORAGE_HPP
+
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include <string>
+
+namespace rmf_traffic {
+namespace schedule {
+
+//==============================================================================
+/// A class that keeps a copy of a Database on disk so that the Database can be
+/// recovered after its process restarts. The recovered Database will have the
+/// same entries and version numbers as the original, so any mirrors of it can
+/// keep asking for the changes that come after their latest version.
+///
+/// The copy consists of two files inside of a directory:
+///  * `snapshot` - A complete copy of the Database at some version
+///  * `log` - The changes that were made to the Database after that version
+///
+/// Each call to save() appends the new changes to the log. When the Database
+/// has been culled, the log is instead compacted into a new snapshot, since
+/// culling is what lets the Database forget its old entries.
+///
+/// Saving happens in two steps: prepare() serializes the changes while the
+/// Database is being read, and write() puts them on disk. Users that guard
+/// their Database with a mutex can call write() after releasing the mutex, so
+/// that nothing needs to wait for the disk while the Database is locked.
+///
+/// \warning The files are written in the byte order of the machine that writes
+/// them, so they should only be loaded on a machine with the same byte order.
+class Storage
+{
+public:
+
+  /// Constructor
+  ///
+  /// \param[in] directory
+  ///   The directory that the files should be kept in. It will be created if
+  ///   it does not exist yet.
+  Storage(std::string directory);
+
+  /// Get the directory that the files are kept in.
+  const std::string& directory() const;
+
+  /// Load the Database that was saved in this storage. If nothing has been
+  /// saved yet, this will return an empty Database.
+  ///
+  /// If the end of the log was only partially written (e.g. because the
+  /// process was killed while writing it), the changes that were fully written
+  /// will still be recovered.
+  Database load();
+
+  /// Changes of a Database that have been serialized by prepare() but have not
+  /// been written yet.
+  class Pending
+  {
+  public:
+
+    class Implementation;
+  private:
+    Pending();
+    rmf_utils::unique_impl_ptr<Implementation> _pimpl;
+  };
+
+  /// Serialize the changes that need to be written to bring the files up to
+  /// date with the given Database. If the Database was not loaded from this
+  /// storage, or if it has been culled, this will be a new snapshot.
+  ///
+  /// Calls to prepare() must not overlap each other, and the results must be
+  /// passed to write() in the same order that they were prepared. prepare()
+  /// and write() may be called at the same time from different threads.
+  Pending prepare(const Database& database);
+
+  /// Write changes that were serialized by prepare().
+  void write(Pending pending);
+
+  /// Bring the files up to date with the given Database. This should be called
+  /// after each time the Database is changed. This is the same as calling
+  /// write(prepare(database)).
+  void save(const Database& database);
+
+  /// Write a new snapshot of the given Database and clear the log.
+  void compact(const Database& database);
+
+  class Implementation;
+private:
+  rmf_utils::unique_impl_ptr<Implementation> _pimpl;
+};
+
+} // namespace schedule
+} // namespace rmf_traffic
+
+#endif // RMF_TRAFFIC__SCHEDULE__STORAGE_HPP
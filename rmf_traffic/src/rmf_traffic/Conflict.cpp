@@ -19,12 +19,18 @@
 #include "DetectConflictInternal.hpp"
 #include "Spline.hpp"
 #include "StaticMotion.hpp"
+#include "WorkerPool.hpp"
 
 #include <rmf_traffic/Conflict.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
 
 #include <fcl/continuous_collision.h>
 #include <fcl/ccd/motion.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <unordered_map>
 
 namespace rmf_traffic {
@@ -187,59 +193,252 @@ std::shared_ptr<fcl::SplineMotion> make_uninitialized_fcl_spline_motion()
 }
 
 //==============================================================================
-std::tuple<Trajectory::const_iterator, Trajectory::const_iterator>
-get_initial_iterators(
-    const Trajectory& trajectory_a,
-    const Trajectory& trajectory_b)
+fcl::ContinuousCollisionRequest make_fcl_request()
 {
-  std::size_t min_size = std::min(trajectory_a.size(), trajectory_b.size());
-  if(min_size < 2)
-  {
-    throw invalid_trajectory_error::Implementation
-        ::make_segment_num_error(min_size);
-  }
+  fcl::ContinuousCollisionRequest request;
+  request.ccd_solver_type = fcl::CCDC_CONSERVATIVE_ADVANCEMENT;
+  request.gjk_solver_type = fcl::GST_LIBCCD;
+
+  return request;
+}
+
+//==============================================================================
+/// Get the radius of the shape of this profile if it is a circle.
+rmf_utils::optional<double> get_circle_radius(
+    const Trajectory::ConstProfilePtr& profile)
+{
+  const auto* circle =
+      dynamic_cast<const geometry::Circle*>(&profile->get_shape()->source());
+  if(!circle)
+    return rmf_utils::nullopt;
 
-  const Time& t_a0 = *trajectory_a.start_time();
-  const Time& t_b0 = *trajectory_b.start_time();
+  return circle->get_radius();
+}
+
+//==============================================================================
+// The squared distance between two cubic polynomials is a polynomial of this
+// degree
+const std::size_t ContactDegree = 6;
+using BernsteinCoefficients = std::array<double, ContactDegree+1>;
 
-  Trajectory::const_iterator a_it;
-  Trajectory::const_iterator b_it;
+// Scaled time resolution for the earliest contact between two circles
+const double ContactTolerance = 1e-7;
 
-  if(t_a0 < t_b0)
+//==============================================================================
+/// Find the earliest point in [lower, upper] where the polynomial with these
+/// Bernstein coefficients is not positive.
+rmf_utils::optional<double> find_first_nonpositive(
+    const BernsteinCoefficients& b,
+    const double lower,
+    const double upper)
+{
+  // The first coefficient is the value of the polynomial at the lower bound
+  if(b[0] <= 0.0)
+    return lower;
+
+  // The polynomial is contained in the convex hull of its coefficients, so if
+  // they are all positive then the polynomial is positive too.
+  if(*std::min_element(b.begin(), b.end()) > 0.0)
+    return rmf_utils::nullopt;
+
+  if(upper - lower < ContactTolerance)
   {
-    // Trajectory `a` starts first, so we begin evaluating at the time
-    // that `b` begins
-    a_it = trajectory_a.find(t_b0);
-    b_it = ++trajectory_b.begin();
+    // We cannot rule out contact inside of this tiny interval, so we will err
+    // on the side of caution and report it.
+    return lower;
   }
-  else if(t_b0 < t_a0)
+
+  // Split the polynomial in half with de Casteljau's algorithm
+  BernsteinCoefficients left;
+  BernsteinCoefficients right;
+  BernsteinCoefficients work = b;
+  left[0] = work[0];
+  right[ContactDegree] = work[ContactDegree];
+  for(std::size_t r=1; r <= ContactDegree; ++r)
   {
-    // Trajectory `b` starts first, so we begin evaluating at the time
-    // that `a` begins
-    a_it = ++trajectory_a.begin();
-    b_it = trajectory_b.find(t_a0);
+    for(std::size_t i=0; i <= ContactDegree - r; ++i)
+      work[i] = 0.5*(work[i] + work[i+1]);
+
+    left[r] = work[0];
+    right[ContactDegree - r] = work[ContactDegree - r];
+  }
+
+  const double middle = 0.5*(lower + upper);
+  if(const auto contact = find_first_nonpositive(left, lower, middle))
+    return contact;
+
+  return find_first_nonpositive(right, middle, upper);
+}
+
+//==============================================================================
+/// Find the earliest moment that the shapes of two segments come into contact
+/// while the splines that lead up to them overlap in time. The FCL motions are
+/// passed in so that they can be reused from one call to the next.
+rmf_utils::optional<Time> detect_contact(
+    const Spline& spline_a,
+    const Trajectory::ConstProfilePtr& profile_a,
+    const Spline& spline_b,
+    const Trajectory::ConstProfilePtr& profile_b,
+    const std::shared_ptr<fcl::SplineMotion>& motion_a,
+    const std::shared_ptr<fcl::SplineMotion>& motion_b,
+    const fcl::ContinuousCollisionRequest& request)
+{
+  const Time start_time =
+      std::max(spline_a.start_time(), spline_b.start_time());
+  const Time finish_time =
+      std::min(spline_a.finish_time(), spline_b.finish_time());
+
+  if(finish_time < start_time)
+    return rmf_utils::nullopt;
+
+  assert(profile_a->get_shape());
+  assert(profile_b->get_shape());
+
+  // The shapes cannot touch if the boxes that they sweep through while the
+  // splines overlap in time do not intersect, so we can skip the expensive
+  // collision check. The bounds of the whole splines are cached by the
+  // trajectories, so we test those before narrowing down the time window.
+  const double length_a = profile_a->get_shape()->get_characteristic_length();
+  const double length_b = profile_b->get_shape()->get_characteristic_length();
+  if(!internal::overlap(
+       internal::get_bounding_box(spline_a.compute_bounds(), length_a),
+       internal::get_bounding_box(spline_b.compute_bounds(), length_b)))
+    return rmf_utils::nullopt;
+
+  if(!internal::overlap(
+       internal::get_bounding_box(
+         spline_a.compute_bounds(start_time, finish_time), length_a),
+       internal::get_bounding_box(
+         spline_b.compute_bounds(start_time, finish_time), length_b)))
+    return rmf_utils::nullopt;
+
+  rmf_utils::optional<double> contact;
+  const auto radius_a = get_circle_radius(profile_a);
+  const auto radius_b = get_circle_radius(profile_b);
+  if(radius_a && radius_b)
+  {
+    // Two circles are in contact whenever the distance between their centers
+    // is less than the sum of their radii, so we can solve for the contact
+    // directly instead of using FCL.
+    contact = internal::detect_circle_contact(
+          spline_a.compute_coefficients(start_time, finish_time),
+          spline_b.compute_coefficients(start_time, finish_time),
+          *radius_a + *radius_b);
   }
   else
   {
-    // The Trajectories begin at the exact same time, so both will begin
-    // from their start
-    a_it = ++trajectory_a.begin();
-    b_it = ++trajectory_b.begin();
+    *motion_a = spline_a.to_fcl(start_time, finish_time);
+    *motion_b = spline_b.to_fcl(start_time, finish_time);
+
+    const auto obj_a = fcl::ContinuousCollisionObject(
+          geometry::FinalConvexShape::Implementation::get_collision(
+            *profile_a->get_shape()), motion_a);
+    const auto obj_b = fcl::ContinuousCollisionObject(
+          geometry::FinalConvexShape::Implementation::get_collision(
+            *profile_b->get_shape()), motion_b);
+
+    fcl::ContinuousCollisionResult result;
+    fcl::collide(&obj_a, &obj_b, request, result);
+    if(result.is_collide)
+      contact = result.time_of_contact;
   }
 
-  return {a_it, b_it};
+  if(!contact)
+    return rmf_utils::nullopt;
+
+  const double scaled_time = *contact;
+  const Duration delta_t{
+    Duration::rep(scaled_time * (finish_time - start_time).count())};
+  return start_time + delta_t;
 }
 
 //==============================================================================
-fcl::ContinuousCollisionRequest make_fcl_request()
+/// A spline of one trajectory along with everything that is needed to search
+/// another trajectory for contacts with it.
+struct PreparedSpline
 {
-  fcl::ContinuousCollisionRequest request;
-  request.ccd_solver_type = fcl::CCDC_CONSERVATIVE_ADVANCEMENT;
-  request.gjk_solver_type = fcl::GST_LIBCCD;
+  Trajectory::const_iterator it;
+  Spline spline;
+  Trajectory::ConstProfilePtr profile;
+  internal::BoundingBox box;
+};
 
-  return request;
+using PreparedSplines =
+    std::vector<PreparedSpline, Eigen::aligned_allocator<PreparedSpline>>;
+
+//==============================================================================
+PreparedSpline prepare_spline(const Trajectory::const_iterator& it)
+{
+  Spline spline(it);
+  Trajectory::ConstProfilePtr profile = it->get_profile();
+  assert(profile->get_shape());
+
+  const internal::BoundingBox box = internal::get_bounding_box(
+        spline.compute_bounds(),
+        profile->get_shape()->get_characteristic_length());
+
+  return PreparedSpline{it, std::move(spline), std::move(profile), box};
 }
 
+//==============================================================================
+/// Searches trajectories for the splines that come into contact with a given
+/// spline. The FCL objects are reused for every pair of splines that gets
+/// checked.
+class ContactSearch
+{
+public:
+
+  ContactSearch()
+    : _motion_a(make_uninitialized_fcl_spline_motion()),
+      _motion_b(make_uninitialized_fcl_spline_motion()),
+      _request(make_fcl_request())
+  {
+    // Do nothing
+  }
+
+  /// Pass each spline of the searched trajectory that comes into contact with
+  /// the prepared spline to on_contact, along with the time of the contact.
+  /// Only the splines that the bounding volume hierarchy of the searched
+  /// trajectory finds nearby get checked. on_contact returns false to stop the
+  /// search.
+  ///
+  /// \return false if on_contact stopped the search, otherwise true.
+  template<typename OnContact>
+  bool search(
+      const PreparedSpline& prepared,
+      const Trajectory& searched,
+      OnContact&& on_contact)
+  {
+    const internal::SplineTree& tree =
+        detail::TrajectoryIteratorImplementation::spline_tree(searched);
+
+    return tree.visit(
+          prepared.spline.start_time(), prepared.spline.finish_time(),
+          prepared.box.min, prepared.box.max,
+          [&](const std::size_t index)
+    {
+      const Trajectory::const_iterator searched_it =
+          detail::TrajectoryIteratorImplementation::iterator_at(
+            searched, index);
+
+      const rmf_utils::optional<Time> time = detect_contact(
+            prepared.spline, prepared.profile,
+            Spline(searched_it), searched_it->get_profile(),
+            _motion_a, _motion_b, _request);
+
+      if(!time)
+        return true;
+
+      return on_contact(searched_it, *time);
+    });
+  }
+
+private:
+  std::shared_ptr<fcl::SplineMotion> _motion_a;
+  std::shared_ptr<fcl::SplineMotion> _motion_b;
+  fcl::ContinuousCollisionRequest _request;
+};
+
 } // anonymous namespace
 
 class DetectConflict::Implementation
@@ -261,103 +460,489 @@ std::vector<ConflictData> DetectConflict::narrow_phase(
     const Trajectory& trajectory_b,
     const bool quit_after_one)
 {
-  Trajectory::const_iterator a_it;
-  Trajectory::const_iterator b_it;
-  std::tie(a_it, b_it) = get_initial_iterators(trajectory_a, trajectory_b);
-
-  // Verify that neither trajectory has run into a bug. These conditions should
-  // be guaranteed by
-  // 1. The assumption that the trajectories overlap (this is an assumption that
-  //    is made explicit to the user)
-  // 2. The min_size check up above
-  assert(a_it != trajectory_a.end());
-  assert(b_it != trajectory_b.end());
-
-  // Initialize the objects that will be used inside the loop
-  Spline spline_a(a_it);
-  Spline spline_b(b_it);
-  std::shared_ptr<fcl::SplineMotion> motion_a =
-      make_uninitialized_fcl_spline_motion();
-  std::shared_ptr<fcl::SplineMotion> motion_b =
-      make_uninitialized_fcl_spline_motion();
+  std::size_t min_size = std::min(trajectory_a.size(), trajectory_b.size());
+  if(min_size < 2)
+  {
+    throw invalid_trajectory_error::Implementation
+        ::make_segment_num_error(min_size);
+  }
 
-  const fcl::ContinuousCollisionRequest request = make_fcl_request();
-  fcl::ContinuousCollisionResult result;
+  // We walk along the splines of the trajectory that has fewer segments, and
+  // search the bounding volume hierarchy of the other trajectory for the
+  // splines that overlap each of them in time and space. That way the cost of
+  // checking a short trajectory against a long one depends on the length of
+  // the short one.
+  const bool a_is_walked = trajectory_a.size() <= trajectory_b.size();
+  const Trajectory& walked = a_is_walked? trajectory_a : trajectory_b;
+  const Trajectory& searched = a_is_walked? trajectory_b : trajectory_a;
+
+  const Time searched_start_time = *searched.start_time();
+  const Time searched_finish_time = *searched.finish_time();
+
+  // Skip ahead to the first spline that reaches the start of the searched
+  // trajectory
+  Trajectory::const_iterator walked_it =
+      *walked.start_time() < searched_start_time?
+        walked.find(searched_start_time) : ++walked.begin();
+
+  ContactSearch contact_search;
   std::vector<ConflictData> conflicts;
 
-  while(a_it != trajectory_a.end() && b_it != trajectory_b.end())
+  for(; walked_it != walked.end(); ++walked_it)
   {
-    // Increment a_it until spline_a will overlap with spline_b
-    if(a_it->get_finish_time() < spline_b.start_time())
+    const PreparedSpline prepared = prepare_spline(walked_it);
+    if(searched_finish_time < prepared.spline.start_time())
+      break;
+
+    const bool searched_everything = contact_search.search(
+          prepared, searched,
+          [&](const Trajectory::const_iterator& searched_it, const Time time)
     {
-      ++a_it;
-      continue;
-    }
+      conflicts.emplace_back(
+            Implementation::make_conflict(
+              time, a_is_walked?
+                ConflictData::Segments{walked_it, searched_it}
+              : ConflictData::Segments{searched_it, walked_it}));
+
+      return !quit_after_one;
+    });
+
+    if(!searched_everything)
+      break;
+  }
+
+  return conflicts;
+}
+
+namespace {
 
-    // Increment b_it until spline_b will overlap with spline_a
-    if(b_it->get_finish_time() < spline_a.start_time())
+//==============================================================================
+struct SweepInfo
+{
+  std::size_t index;
+  Time start;
+  Time finish;
+  internal::BoundingBox box;
+};
+
+//==============================================================================
+internal::BoundingBox get_swept_bounding_box(const Trajectory& trajectory)
+{
+  // The root of the trajectory's bounding volume hierarchy already covers all
+  // of its splines
+  const internal::SplineTree& tree =
+      detail::TrajectoryIteratorImplementation::spline_tree(trajectory);
+  assert(!tree.empty());
+  return {tree.root().min, tree.root().max};
+}
+
+//==============================================================================
+/// Find the pairs of trajectories that share a map and whose time spans and
+/// bounding boxes overlap.
+///
+/// The trajectories before split belong to one set and the rest belong to
+/// another. When split is the size of the whole vector, every pair within the
+/// one set is considered. Otherwise only pairs that have one trajectory from
+/// each set are considered, and trajectories from the same set are never
+/// tested against each other.
+std::vector<DetectConflict::IndexPair> sweep_and_prune(
+    const std::vector<const Trajectory*>& trajectories,
+    const std::size_t split)
+{
+  std::unordered_map<std::string, std::vector<SweepInfo>> maps;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    const Trajectory& trajectory = *trajectories[i];
+    if(trajectory.size() < 2)
     {
-      ++b_it;
-      continue;
+      throw invalid_trajectory_error::Implementation
+          ::make_segment_num_error(trajectory.size());
     }
 
-    const Trajectory::ConstProfilePtr profile_a = a_it->get_profile();
-    const Trajectory::ConstProfilePtr profile_b = b_it->get_profile();
+    maps[trajectory.get_map_name()].push_back(
+          SweepInfo{
+            i,
+            *trajectory.start_time(),
+            *trajectory.finish_time(),
+            get_swept_bounding_box(trajectory)
+          });
+  }
 
-    // TODO(MXG): Consider using optional<Spline> so that we can easily keep
-    // track of which needs to be updated. There's some wasted computational
-    // cycles here whenever we are using the same spline as a previous iteration
-    spline_a = Spline(a_it);
-    spline_b = Spline(b_it);
+  const bool single_set = split >= trajectories.size();
 
-    const Time start_time =
-        std::max(spline_a.start_time(), spline_b.start_time());
-    const Time finish_time =
-        std::min(spline_a.finish_time(), spline_b.finish_time());
+  std::vector<DetectConflict::IndexPair> candidates;
+  for(auto& map : maps)
+  {
+    std::vector<SweepInfo>& infos = map.second;
+    std::sort(infos.begin(), infos.end(),
+              [](const SweepInfo& a, const SweepInfo& b)
+    {
+      return a.start < b.start;
+    });
 
-    *motion_a = spline_a.to_fcl(start_time, finish_time);
-    *motion_b = spline_b.to_fcl(start_time, finish_time);
+    // The trajectories of each set that are still running at the current
+    // point of the sweep
+    std::array<std::vector<const SweepInfo*>, 2> active;
+    for(const SweepInfo& info : infos)
+    {
+      const std::size_t set = info.index < split? 0 : 1;
+      std::vector<const SweepInfo*>& others =
+          single_set? active[set] : active[1-set];
 
-    assert(profile_a->get_shape());
-    assert(profile_b->get_shape());
-    const auto obj_a = fcl::ContinuousCollisionObject(
-          geometry::FinalConvexShape::Implementation::get_collision(
-            *profile_a->get_shape()), motion_a);
-    const auto obj_b = fcl::ContinuousCollisionObject(
-          geometry::FinalConvexShape::Implementation::get_collision(
-            *profile_b->get_shape()), motion_b);
+      // Stop considering any trajectories that finished before this one began
+      others.erase(std::remove_if(others.begin(), others.end(),
+                                  [&](const SweepInfo* other)
+      {
+        return other->finish < info.start;
+      }), others.end());
 
-    fcl::collide(&obj_a, &obj_b, request, result);
-    if(result.is_collide)
-    {
-      const double scaled_time = result.time_of_contact;
-      const Duration delta_t{
-        Duration::rep(scaled_time * (finish_time - start_time).count())};
-      const Time time = start_time + delta_t;
-      conflicts.emplace_back(Implementation::make_conflict(time, {a_it, b_it}));
-      if (quit_after_one)
-        return conflicts;
+      for(const SweepInfo* other : others)
+      {
+        if(!internal::overlap(other->box, info.box))
+          continue;
+
+        candidates.emplace_back(
+              std::min(other->index, info.index),
+              std::max(other->index, info.index));
+      }
+
+      active[set].push_back(&info);
     }
+  }
+
+  return candidates;
+}
 
-    if(spline_a.finish_time() < spline_b.finish_time())
+//==============================================================================
+/// Run the narrow phase on each candidate pair, divided between the calling
+/// thread and the shared worker pool, and return the pairs that are in
+/// conflict.
+std::vector<DetectConflict::IndexPair> narrow_phase_in_parallel(
+    const std::vector<const Trajectory*>& trajectories,
+    const std::vector<DetectConflict::IndexPair>& candidates,
+    std::size_t max_threads)
+{
+  std::vector<char> in_conflict(candidates.size(), false);
+
+  // The workers may get to their jobs after this function has returned, so
+  // everything that they touch before checking whether the work is finished
+  // needs to be shared with them.
+  struct Progress
+  {
+    std::atomic_size_t next_candidate{0};
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool finished = false;
+    std::size_t num_working = 0;
+    std::exception_ptr error;
+  };
+
+  const auto progress = std::make_shared<Progress>();
+
+  const auto work = [&trajectories, &candidates, &in_conflict](
+      Progress& progress)
+  {
+    try
     {
-      ++a_it;
+      for(std::size_t k = progress.next_candidate++; k < candidates.size();
+          k = progress.next_candidate++)
+      {
+        const auto& candidate = candidates[k];
+        in_conflict[k] = !DetectConflict::narrow_phase(
+              *trajectories[candidate.first],
+              *trajectories[candidate.second], true).empty();
+      }
     }
-    else if(spline_b.finish_time() < spline_a.finish_time())
+    catch(...)
     {
-      ++b_it;
+      std::unique_lock<std::mutex> lock(progress.mutex);
+      if(!progress.error)
+        progress.error = std::current_exception();
+
+      // Make the other threads stop early
+      progress.next_candidate = candidates.size();
     }
-    else
+  };
+
+  internal::WorkerPool& pool = internal::WorkerPool::shared();
+  if(max_threads == 0)
+    max_threads = pool.num_workers() + 1;
+
+  const std::size_t num_threads = std::min(max_threads, candidates.size());
+  for(std::size_t t=1; t < num_threads; ++t)
+  {
+    pool.post([progress, work]()
+    {
+      {
+        std::unique_lock<std::mutex> lock(progress->mutex);
+        if(progress->finished)
+          return;
+
+        ++progress->num_working;
+      }
+
+      work(*progress);
+
+      {
+        std::unique_lock<std::mutex> lock(progress->mutex);
+        --progress->num_working;
+      }
+      progress->cv.notify_all();
+    });
+  }
+
+  // The calling thread helps with the work, so all of the candidates will get
+  // checked even if every worker in the pool is busy with something else.
+  work(*progress);
+
+  {
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->finished = true;
+    progress->cv.wait(lock, [&]() { return progress->num_working == 0; });
+  }
+
+  if(progress->error)
+    std::rethrow_exception(progress->error);
+
+  std::vector<DetectConflict::IndexPair> conflicts;
+  for(std::size_t k=0; k < candidates.size(); ++k)
+  {
+    if(in_conflict[k])
+      conflicts.push_back(candidates[k]);
+  }
+
+  std::sort(conflicts.begin(), conflicts.end());
+  return conflicts;
+}
+
+//==============================================================================
+/// Check a candidate trajectory against each trajectory in a set. The splines
+/// of the candidate are prepared once and shared by every check. on_conflict
+/// is given the index of each trajectory that is in conflict with the
+/// candidate, and returns false to stop checking the rest.
+template<typename OnConflict>
+void search_between(
+    const Trajectory& candidate,
+    const std::vector<const Trajectory*>& trajectories,
+    OnConflict&& on_conflict)
+{
+  if(candidate.size() < 2)
+  {
+    throw invalid_trajectory_error::Implementation
+        ::make_segment_num_error(candidate.size());
+  }
+
+  PreparedSplines splines;
+  splines.reserve(candidate.size() - 1);
+  for(auto it = ++candidate.begin(); it != candidate.end(); ++it)
+    splines.push_back(prepare_spline(it));
+
+  const internal::SplineTree::Node& candidate_bounds =
+      detail::TrajectoryIteratorImplementation::spline_tree(candidate).root();
+  const internal::BoundingBox candidate_box{
+    candidate_bounds.min, candidate_bounds.max};
+
+  ContactSearch contact_search;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    const Trajectory& other = *trajectories[i];
+    if(other.size() < 2)
     {
-      ++a_it;
-      ++b_it;
+      throw invalid_trajectory_error::Implementation
+          ::make_segment_num_error(other.size());
     }
+
+    if(other.get_map_name() != candidate.get_map_name())
+      continue;
+
+    const internal::SplineTree::Node& other_bounds =
+        detail::TrajectoryIteratorImplementation::spline_tree(other).root();
+
+    if(other_bounds.finish < candidate_bounds.start
+       || candidate_bounds.finish < other_bounds.start)
+      continue;
+
+    const internal::BoundingBox other_box{other_bounds.min, other_bounds.max};
+    if(!internal::overlap(candidate_box, other_box))
+      continue;
+
+    // Skip ahead to the first spline of the candidate that reaches the start
+    // of the other trajectory
+    auto spline_it = std::lower_bound(
+          splines.begin(), splines.end(), other_bounds.start,
+          [](const PreparedSpline& prepared, const Time t)
+    {
+      return prepared.spline.finish_time() < t;
+    });
+
+    bool in_conflict = false;
+    for(; spline_it != splines.end(); ++spline_it)
+    {
+      if(other_bounds.finish < spline_it->spline.start_time())
+        break;
+
+      in_conflict = !contact_search.search(
+            *spline_it, other,
+            [](const Trajectory::const_iterator&, const Time)
+      {
+        return false;
+      });
+
+      if(in_conflict)
+        break;
+    }
+
+    if(in_conflict && !on_conflict(i))
+      return;
   }
+}
+
+} // anonymous namespace
+
+//==============================================================================
+auto DetectConflict::all_pairs(
+    const std::vector<const Trajectory*>& trajectories,
+    const std::size_t max_threads) -> std::vector<IndexPair>
+{
+  const auto candidates = sweep_and_prune(trajectories, trajectories.size());
+
+  return narrow_phase_in_parallel(trajectories, candidates, max_threads);
+}
+
+//==============================================================================
+auto DetectConflict::all_pairs(
+    const std::vector<const Trajectory*>& trajectories_a,
+    const std::vector<const Trajectory*>& trajectories_b,
+    const std::size_t max_threads) -> std::vector<IndexPair>
+{
+  const std::size_t num_a = trajectories_a.size();
+
+  std::vector<const Trajectory*> trajectories;
+  trajectories.reserve(num_a + trajectories_b.size());
+  trajectories.insert(
+        trajectories.end(), trajectories_a.begin(), trajectories_a.end());
+  trajectories.insert(
+        trajectories.end(), trajectories_b.begin(), trajectories_b.end());
+
+  // The first index of each candidate pair is always the one from set a
+  const auto candidates = sweep_and_prune(trajectories, num_a);
+
+  std::vector<IndexPair> conflicts =
+      narrow_phase_in_parallel(trajectories, candidates, max_threads);
+
+  for(auto& conflict : conflicts)
+    conflict.second -= num_a;
+
+  return conflicts;
+}
+
+//==============================================================================
+bool DetectConflict::any_between(
+    const Trajectory& candidate,
+    const std::vector<const Trajectory*>& trajectories)
+{
+  bool conflict = false;
+  search_between(candidate, trajectories, [&](std::size_t)
+  {
+    conflict = true;
+    return false;
+  });
+
+  return conflict;
+}
+
+//==============================================================================
+std::vector<std::size_t> DetectConflict::all_between(
+    const Trajectory& candidate,
+    const std::vector<const Trajectory*>& trajectories)
+{
+  std::vector<std::size_t> conflicts;
+  search_between(candidate, trajectories, [&](const std::size_t i)
+  {
+    conflicts.push_back(i);
+    return true;
+  });
 
   return conflicts;
 }
 
 namespace internal {
+//==============================================================================
+BoundingBox get_bounding_box(
+    const std::array<Eigen::Vector2d, 2>& position_bounds,
+    const double characteristic_length)
+{
+  const Eigen::Vector2d inflation =
+      Eigen::Vector2d::Constant(characteristic_length);
+
+  return {position_bounds[0] - inflation, position_bounds[1] + inflation};
+}
+
+//==============================================================================
+BoundingBox get_bounding_box(const Trajectory::const_iterator& segment)
+{
+  const Trajectory::ConstProfilePtr profile = segment->get_profile();
+  assert(profile->get_shape());
+
+  return get_bounding_box(
+        Spline(segment).compute_bounds(),
+        profile->get_shape()->get_characteristic_length());
+}
+
+//==============================================================================
+BoundingBox get_bounding_box(
+    const Eigen::Isometry2d& pose,
+    const geometry::FinalShape& shape)
+{
+  const Eigen::Vector2d p = pose.translation();
+  return get_bounding_box({p, p}, shape.get_characteristic_length());
+}
+
+//==============================================================================
+rmf_utils::optional<double> detect_circle_contact(
+    const std::array<Eigen::Vector4d, 3>& coeffs_a,
+    const std::array<Eigen::Vector4d, 3>& coeffs_b,
+    const double contact_distance)
+{
+  // The circles are rotationally symmetric, so only the x and y components
+  // matter. The difference between their centers is a cubic polynomial:
+  const Eigen::Vector4d dx = coeffs_a[0] - coeffs_b[0];
+  const Eigen::Vector4d dy = coeffs_a[1] - coeffs_b[1];
+
+  // The circles are in contact wherever this polynomial is not positive:
+  // f(s) = dx(s)^2 + dy(s)^2 - contact_distance^2
+  std::array<double, ContactDegree+1> power = {};
+  for(int i=0; i < 4; ++i)
+  {
+    for(int j=0; j < 4; ++j)
+      power[static_cast<std::size_t>(i+j)] += dx[i]*dx[j] + dy[i]*dy[j];
+  }
+  power[0] -= contact_distance*contact_distance;
+
+  // Convert the polynomial to the Bernstein basis over [0, 1]:
+  // b_k = sum_{j=0}^{k} [C(k,j)/C(n,j)] * a_j
+  std::array<double, ContactDegree+1> binomial;
+  binomial[0] = 1.0;
+  for(std::size_t j=1; j <= ContactDegree; ++j)
+    binomial[j] = binomial[j-1]*static_cast<double>(ContactDegree - j + 1)/j;
+
+  BernsteinCoefficients bernstein;
+  for(std::size_t k=0; k <= ContactDegree; ++k)
+  {
+    double b = 0.0;
+    double k_choose_j = 1.0;
+    for(std::size_t j=0; j <= k; ++j)
+    {
+      b += k_choose_j/binomial[j] * power[j];
+      k_choose_j = k_choose_j*static_cast<double>(k - j)/(j + 1);
+    }
+
+    bernstein[k] = b;
+  }
+
+  return find_first_nonpositive(bernstein, 0.0, 1.0);
+}
+
 //==============================================================================
 bool detect_conflicts(
     const Trajectory& trajectory,
@@ -398,14 +983,6 @@ bool detect_conflicts(
     return false;
   }
 
-  const Trajectory::const_iterator begin_it =
-      trajectory_start_time < start_time?
-        trajectory.find(start_time) : ++trajectory.begin();
-
-  const Trajectory::const_iterator end_it =
-      finish_time < trajectory_finish_time?
-        ++trajectory.find(finish_time) : trajectory.end();
-
   std::shared_ptr<fcl::SplineMotion> motion_trajectory =
       make_uninitialized_fcl_spline_motion();
   std::shared_ptr<internal::StaticMotion> motion_region =
@@ -413,10 +990,25 @@ bool detect_conflicts(
 
   const fcl::ContinuousCollisionRequest request = make_fcl_request();
 
+  assert(region.shape);
+  const BoundingBox region_box = get_bounding_box(region.pose, *region.shape);
+  const auto& region_shapes = geometry::FinalShape::Implementation
+      ::get_collisions(*region.shape);
+
   bool collision_detected = false;
 
-  for(auto it = begin_it; it != end_it; ++it)
+  // Only the splines whose boxes overlap the region during its time range need
+  // to be checked, and the bounding volume hierarchy of the trajectory finds
+  // them without visiting the rest.
+  const internal::SplineTree& tree =
+      detail::TrajectoryIteratorImplementation::spline_tree(trajectory);
+
+  tree.visit(start_time, finish_time, region_box.min, region_box.max,
+             [&](const std::size_t index)
   {
+    const Trajectory::const_iterator it =
+        detail::TrajectoryIteratorImplementation::iterator_at(
+          trajectory, index);
     const Trajectory::ConstProfilePtr profile = it->get_profile();
 
     Spline spline_trajectory{it};
@@ -426,17 +1018,22 @@ bool detect_conflicts(
     const Time spline_finish_time =
         std::min(spline_trajectory.finish_time(), finish_time);
 
+    assert(profile->get_shape());
+    const BoundingBox trajectory_box = get_bounding_box(
+          spline_trajectory.compute_bounds(
+            spline_start_time, spline_finish_time),
+          profile->get_shape()->get_characteristic_length());
+
+    if(!overlap(trajectory_box, region_box))
+      return true;
+
     *motion_trajectory = spline_trajectory.to_fcl(
           spline_start_time, spline_finish_time);
 
-    assert(profile->get_shape());
     const auto obj_trajectory = fcl::ContinuousCollisionObject(
           geometry::FinalConvexShape::Implementation::get_collision(
             *profile->get_shape()), motion_trajectory);
 
-    assert(region.shape);
-    const auto& region_shapes = geometry::FinalShape::Implementation
-        ::get_collisions(*region.shape);
     for(const auto& region_shape : region_shapes)
     {
       const auto obj_region = fcl::ContinuousCollisionObject(
@@ -446,21 +1043,70 @@ bool detect_conflicts(
       fcl::collide(&obj_trajectory, &obj_region, request, result);
       if(result.is_collide)
       {
-        if(output_iterators)
-        {
-          output_iterators->push_back(it);
-          collision_detected = true;
-        }
-        else
-        {
-          return true;
-        }
+        collision_detected = true;
+        if(!output_iterators)
+          return false;
+
+        output_iterators->push_back(it);
       }
     }
-  }
+
+    return true;
+  });
 
   return collision_detected;
 }
+
+//==============================================================================
+bool detect_conflicts(
+    const Trajectory& trajectory,
+    const std::vector<Trajectory::const_iterator>& splines)
+{
+  if(trajectory.size() < 2)
+  {
+    throw invalid_trajectory_error::Implementation
+        ::make_segment_num_error(trajectory.size());
+  }
+
+  PreparedSplines prepared;
+  prepared.reserve(trajectory.size() - 1);
+  for(auto it = ++trajectory.begin(); it != trajectory.end(); ++it)
+    prepared.push_back(prepare_spline(it));
+
+  const std::shared_ptr<fcl::SplineMotion> motion_a =
+      make_uninitialized_fcl_spline_motion();
+  const std::shared_ptr<fcl::SplineMotion> motion_b =
+      make_uninitialized_fcl_spline_motion();
+  const fcl::ContinuousCollisionRequest request = make_fcl_request();
+
+  for(const Trajectory::const_iterator& it : splines)
+  {
+    const Spline other(it);
+    const Trajectory::ConstProfilePtr other_profile = it->get_profile();
+
+    // Skip ahead to the first spline of the trajectory that reaches the start
+    // of the other spline
+    auto spline_it = std::lower_bound(
+          prepared.begin(), prepared.end(), other.start_time(),
+          [](const PreparedSpline& p, const Time t)
+    {
+      return p.spline.finish_time() < t;
+    });
+
+    for(; spline_it != prepared.end(); ++spline_it)
+    {
+      if(other.finish_time() < spline_it->spline.start_time())
+        break;
+
+      if(detect_contact(
+           spline_it->spline, spline_it->profile, other, other_profile,
+           motion_a, motion_b, request))
+        return true;
+    }
+  }
+
+  return false;
+}
 } // namespace internal
 
 } // namespace rmf_traffic
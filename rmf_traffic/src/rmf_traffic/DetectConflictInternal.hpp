@@ -22,6 +22,9 @@
 
 #include <rmf_traffic/Trajectory.hpp>
 
+#include <rmf_utils/optional.hpp>
+
+#include <array>
 #include <unordered_map>
 
 namespace rmf_traffic {
@@ -37,12 +40,87 @@ struct Spacetime
   geometry::ConstFinalShapePtr shape;
 };
 
+//==============================================================================
+/// An axis-aligned box in the x-y plane
+struct BoundingBox
+{
+  Eigen::Vector2d min;
+  Eigen::Vector2d max;
+};
+
+//==============================================================================
+/// Get a box that contains everything that a shape with the given
+/// characteristic length can touch while its origin sits anywhere inside of
+/// the position bounds.
+BoundingBox get_bounding_box(
+    const std::array<Eigen::Vector2d, 2>& position_bounds,
+    double characteristic_length);
+
+//==============================================================================
+/// Get a box that contains every point that the trajectory's shape can touch
+/// while it travels along the spline that ends with this segment. The segment
+/// must not be the first segment of its trajectory.
+BoundingBox get_bounding_box(const Trajectory::const_iterator& segment);
+
+//==============================================================================
+/// Get a box that contains the space of a region.
+BoundingBox get_bounding_box(
+    const Eigen::Isometry2d& pose,
+    const geometry::FinalShape& shape);
+
+//==============================================================================
+inline bool overlap(const BoundingBox& box_a, const BoundingBox& box_b)
+{
+  for(int i=0; i < 2; ++i)
+  {
+    if(box_a.max[i] < box_b.min[i])
+      return false;
+
+    if(box_b.max[i] < box_a.min[i])
+      return false;
+  }
+
+  return true;
+}
+
+//==============================================================================
+/// Find the earliest moment when two circles come into contact while their
+/// centers follow cubic polynomials over the same time range. The coefficients
+/// should come from Spline::compute_coefficients(), so the time range is
+/// scaled to [0, 1].
+///
+/// \param[in] coeffs_a
+///   The polynomial coefficients for the center of the first circle
+///
+/// \param[in] coeffs_b
+///   The polynomial coefficients for the center of the second circle
+///
+/// \param[in] contact_distance
+///   The distance between the centers at which the circles touch, i.e. the sum
+///   of their radii
+///
+/// \return the scaled time of the first contact, or nullopt if they never
+/// come into contact.
+rmf_utils::optional<double> detect_circle_contact(
+    const std::array<Eigen::Vector4d, 3>& coeffs_a,
+    const std::array<Eigen::Vector4d, 3>& coeffs_b,
+    double contact_distance);
+
 //==============================================================================
 bool detect_conflicts(
     const Trajectory& trajectory,
     const Spacetime& region,
     std::vector<Trajectory::const_iterator>* output_iterators);
 
+//==============================================================================
+/// Check whether a trajectory comes into contact with any of the given splines
+/// of other trajectories. Each iterator refers to the segment at the end of a
+/// spline. No broad phase is run on the splines, so the caller should only
+/// pass in the ones that are near the trajectory.
+bool detect_conflicts(
+    const Trajectory& trajectory,
+    const std::vector<Trajectory::const_iterator>& splines);
+
 
 } // namespace internal
 } // namespace rmf_traffic
@@ -17,6 +17,10 @@
 
 #include "Spline.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 namespace rmf_traffic {
 
 namespace {
@@ -62,48 +66,16 @@ std::array<Eigen::Vector4d, 3> compute_coefficients(
 
 //==============================================================================
 Spline::Parameters compute_parameters(
-    const Trajectory::const_iterator& finish_it)
+    const internal::SegmentData& start,
+    const internal::SegmentData& finish)
 {
-  const Trajectory::const_iterator start_it =
-      --Trajectory::const_iterator(finish_it);
-
-  const Trajectory::Segment& start = *start_it;
-  const Trajectory::Segment& finish = *finish_it;
-
-  const Time start_time = start.get_finish_time();
-  const Time finish_time = finish.get_finish_time();
-
-  const double delta_t = compute_delta_t(finish_time, start_time);
-
-  const Eigen::Vector3d x0 = start.get_finish_position();
-  const Eigen::Vector3d x1 = finish.get_finish_position();
-  const Eigen::Vector3d v0 = delta_t * start.get_finish_velocity();
-  const Eigen::Vector3d v1 = delta_t * finish.get_finish_velocity();
-
-  return {
-    compute_coefficients(x0, x1, v0, v1),
-    delta_t,
-    {start_time, finish_time}
-  };
-}
-
-//==============================================================================
-Spline::Parameters compute_parameters(
-    const internal::SegmentList::const_iterator& finish_it)
-{
-  const internal::SegmentList::const_iterator start_it =
-      --internal::SegmentList::const_iterator(finish_it);
-
-  const internal::SegmentElement::Data& start = start_it->data;
-  const internal::SegmentElement::Data& finish = finish_it->data;
-
   const Time start_time = start.finish_time;
   const Time finish_time = finish.finish_time;
 
   const double delta_t = compute_delta_t(finish_time, start_time);
 
-  const Eigen::Vector3d x0 = start.position;
-  const Eigen::Vector3d x1 = finish.position;
+  const Eigen::Vector3d& x0 = start.position;
+  const Eigen::Vector3d& x1 = finish.position;
   const Eigen::Vector3d v0 = delta_t * start.velocity;
   const Eigen::Vector3d v1 = delta_t * finish.velocity;
 
@@ -178,6 +150,72 @@ Eigen::Vector3d compute_acceleration(
   return result;
 }
 
+//==============================================================================
+/// Expand [lower, upper] to contain the values that the cubic polynomial with
+/// these coefficients takes on over the scaled time range [0, 1].
+void expand_cubic_bounds(
+    const Eigen::Vector4d& coeffs,
+    double& lower,
+    double& upper)
+{
+  const auto evaluate = [&](const double s)
+  {
+    const double value =
+        coeffs[0] + s*(coeffs[1] + s*(coeffs[2] + s*coeffs[3]));
+    lower = std::min(lower, value);
+    upper = std::max(upper, value);
+  };
+
+  evaluate(0.0);
+  evaluate(1.0);
+
+  // The extrema of the cubic can only be at the endpoints of the range or at
+  // the roots of its derivative: 3a*s^2 + 2b*s + c = 0
+  const double qa = 3.0*coeffs[3];
+  const double qb = 2.0*coeffs[2];
+  const double qc = coeffs[1];
+
+  const auto evaluate_if_inside = [&](const double s)
+  {
+    if(0.0 < s && s < 1.0)
+      evaluate(s);
+  };
+
+  if(std::abs(qa) < 1e-12)
+  {
+    if(std::abs(qb) > 1e-12)
+      evaluate_if_inside(-qc/qb);
+
+    return;
+  }
+
+  const double discriminant = qb*qb - 4.0*qa*qc;
+  if(discriminant < 0.0)
+    return;
+
+  const double sqrt_discriminant = std::sqrt(discriminant);
+  evaluate_if_inside((-qb + sqrt_discriminant)/(2.0*qa));
+  evaluate_if_inside((-qb - sqrt_discriminant)/(2.0*qa));
+}
+
+//==============================================================================
+std::array<Eigen::Vector2d, 2> compute_bounds(
+    const std::array<Eigen::Vector4d, 3>& coeffs)
+{
+  std::array<Eigen::Vector2d, 2> bounds;
+  for(int i=0; i < 2; ++i)
+  {
+    const std::size_t si = static_cast<std::size_t>(i);
+    double lower = std::numeric_limits<double>::infinity();
+    double upper = -std::numeric_limits<double>::infinity();
+    expand_cubic_bounds(coeffs[si], lower, upper);
+    bounds[0][i] = lower;
+    bounds[1][i] = upper;
+  }
+
+  return bounds;
+}
+
 } // anonymous namespace
 
 //==============================================================================
@@ -185,14 +223,25 @@ const Eigen::Matrix4d M_inv = make_M_inv();
 
 //==============================================================================
 Spline::Spline(const Trajectory::const_iterator& it)
-  : params(compute_parameters(it))
 {
-  // Do nothing
+  using TrajectoryIteratorImplementation =
+      detail::TrajectoryIteratorImplementation;
+
+  const internal::SplineCoefficients& spline =
+      TrajectoryIteratorImplementation::spline(it);
+
+  params.coeffs = spline.coeffs;
+  params.delta_t = spline.delta_t;
+  params.time_range = TrajectoryIteratorImplementation::spline_time_range(it);
+  bounds = spline.bounds;
 }
 
 //==============================================================================
-Spline::Spline(const internal::SegmentList::const_iterator& it)
-  : params(compute_parameters(it))
+Spline::Spline(
+    const internal::SegmentData& start,
+    const internal::SegmentData& finish)
+  : params(compute_parameters(start, finish)),
+    bounds(rmf_traffic::compute_bounds(params.coeffs))
 {
   // Do nothing
 }
@@ -200,6 +249,24 @@ Spline::Spline(const internal::SegmentList::const_iterator& it)
 //==============================================================================
 std::array<Eigen::Vector3d, 4> Spline::compute_knots(
     const Time start_time, const Time finish_time) const
+{
+  const std::array<Eigen::Vector4d, 3> subspline_coeffs =
+      compute_coefficients(start_time, finish_time);
+
+  std::array<Eigen::Vector3d, 4> result;
+  for(std::size_t i=0; i < 3; ++i)
+  {
+    const Eigen::Vector4d p = M_inv * subspline_coeffs[i];
+    for(int j=0; j < 4; ++j)
+      result[j][i] = p[j];
+  }
+
+  return result;
+}
+
+//==============================================================================
+std::array<Eigen::Vector4d, 3> Spline::compute_coefficients(
+    const Time start_time, const Time finish_time) const
 {
   assert(params.time_range[0] <= start_time);
   assert(finish_time <= params.time_range[1]);
@@ -219,18 +286,7 @@ std::array<Eigen::Vector3d, 4> Spline::compute_knots(
   const Eigen::Vector3d v1 =
     scaled_delta_t * rmf_traffic::compute_velocity(params, scaled_finish_time);
 
-  const std::array<Eigen::Vector4d, 3> subspline_coeffs =
-      compute_coefficients(x0, x1, v0, v1);
-
-  std::array<Eigen::Vector3d, 4> result;
-  for(std::size_t i=0; i < 3; ++i)
-  {
-    const Eigen::Vector4d p = M_inv * subspline_coeffs[i];
-    for(int j=0; j < 4; ++j)
-      result[j][i] = p[j];
-  }
-
-  return result;
+  return rmf_traffic::compute_coefficients(x0, x1, v0, v1);
 }
 
 //==============================================================================
@@ -289,4 +345,36 @@ Eigen::Vector3d Spline::compute_acceleration(const Time at_time) const
         params, compute_scaled_time(at_time, params));
 }
 
+//==============================================================================
+std::array<Eigen::Vector2d, 2> Spline::compute_bounds() const
+{
+  return bounds;
+}
+
+//==============================================================================
+std::array<Eigen::Vector2d, 2> Spline::compute_bounds(
+    const Time start_time, const Time finish_time) const
+{
+  return rmf_traffic::compute_bounds(
+        compute_coefficients(start_time, finish_time));
+}
+
+//==============================================================================
+namespace internal {
+
+//==============================================================================
+SplineCoefficients compute_spline_coefficients(
+    const SegmentData& start,
+    const SegmentData& finish)
+{
+  const Spline::Parameters params = compute_parameters(start, finish);
+  return {
+    params.coeffs,
+    params.delta_t,
+    rmf_traffic::compute_bounds(params.coeffs)
+  };
+}
+
+} // namespace internal
+
 } // namespace rmf_traffic
@@ -38,18 +38,27 @@ class Spline
 public:
 
   /// Create a spline that goes from the end of the preceding to the Segment of
-  /// `it`.
+  /// `it`. The coefficients are taken from the Trajectory's cache, so this is
+  /// cheap to call repeatedly for the same Segment.
   Spline(const Trajectory::const_iterator& it);
 
-  /// Create a spline that goes from the end of the preceding to the Segment of
-  /// `it`.
-  Spline(const internal::SegmentList::const_iterator& it);
+  /// Create a spline that goes from the end of one segment to the end of the
+  /// next segment.
+  Spline(
+      const internal::SegmentData& start,
+      const internal::SegmentData& finish);
 
   /// Compute the knots for the motion of this spline from start_time to
   /// finish_time, scaled to a "time" range of [0, 1].
   std::array<Eigen::Vector3d, 4> compute_knots(
       const Time start_time, const Time finish_time) const;
 
+  /// Compute the coefficients of the cubic polynomial that this spline follows
+  /// from start_time to finish_time, scaled to a "time" range of [0, 1]. The
+  /// coefficients for each dimension are in increasing order of degree.
+  std::array<Eigen::Vector4d, 3> compute_coefficients(
+      const Time start_time, const Time finish_time) const;
+
   fcl::SplineMotion to_fcl(const Time start_time, const Time finish_time) const;
 
   Time start_time() const;
@@ -71,9 +80,20 @@ public:
   /// Compute the velocity of the spline at this moment in time
   Eigen::Vector3d compute_acceleration(const Time at_time) const;
 
+  /// Get the tightest axis-aligned bounds on the x-y positions that this
+  /// spline passes through during its time range. The first element of the
+  /// result is the lower corner, and the second element is the upper corner.
+  std::array<Eigen::Vector2d, 2> compute_bounds() const;
+
+  /// Compute the tightest axis-aligned bounds on the x-y positions that this
+  /// spline passes through from start_time to finish_time.
+  std::array<Eigen::Vector2d, 2> compute_bounds(
+      const Time start_time, const Time finish_time) const;
+
 private:
 
   Parameters params;
+  std::array<Eigen::Vector2d, 2> bounds;
 
 };
 
@@ -21,55 +21,48 @@
 #include "MotionInternal.hpp"
 #include "TrajectoryInternal.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include <string>
 
 namespace rmf_traffic {
 
+namespace internal {
 //==============================================================================
-namespace detail {
-class TrajectoryIteratorImplementation
+/// A value that is shared between copies of a Trajectory until one of them
+/// needs to modify it. A null pointer stands in for a default-constructed
+/// value, so that empty trajectories do not need to allocate anything.
+template<typename T>
+class CopyOnWrite
 {
 public:
 
-  internal::SegmentList::iterator raw_iterator;
-  const Trajectory::Implementation* parent;
-
-  template<typename SegT>
-  Trajectory::base_iterator<SegT> make_iterator(
-      internal::SegmentList::iterator it) const
+  const T& get() const
   {
-    Trajectory::base_iterator<SegT> result;
-    result._pimpl->raw_iterator = it;
-    result._pimpl->parent = parent;
+    if (_value)
+      return *_value;
 
-    return result;
+    static const T empty;
+    return empty;
   }
 
-  template<typename SegT>
-  Trajectory::base_iterator<SegT> post_increment()
+  T& edit()
   {
-    const Trajectory::base_iterator<SegT> old_it =
-        make_iterator<SegT>(raw_iterator);
-
-    ++raw_iterator;
+    if (!_value)
+      _value = std::make_shared<T>();
+    else if (_value.use_count() > 1)
+      _value = std::make_shared<T>(*_value);
 
-    return old_it;
-  }
-
-  template<typename SegT>
-  Trajectory::base_iterator<SegT> post_decrement()
-  {
-    const Trajectory::base_iterator<SegT> old_it =
-        make_iterator<SegT>(raw_iterator);
-
-    --raw_iterator;
-
-    return old_it;
+    return *_value;
   }
 
+private:
+  std::shared_ptr<T> _value;
 };
-} // namespace detail
+} // namespace internal
 
 //==============================================================================
 class Trajectory::Segment::Implementation
@@ -77,24 +70,11 @@ class Trajectory::Segment::Implementation
 public:
 
   // Note: these fields will be filled in by the
-  // Trajectory::Implementation::insert() function.
-  internal::SegmentList::iterator myself;
+  // Trajectory::Implementation::get_segment() function.
   Trajectory::Implementation* parent;
+  std::size_t id;
 
-  internal::SegmentElement::Data& data()
-  {
-    return myself->data;
-  }
-
-  const internal::SegmentElement::Data& data() const
-  {
-    return myself->data;
-  }
-
-  Time time() const
-  {
-    return data().finish_time;
-  }
+  std::size_t index() const;
 
 };
 
@@ -103,28 +83,510 @@ class Trajectory::Implementation
 {
 public:
 
+  static constexpr std::size_t npos =
+      detail::TrajectoryIteratorImplementation::npos;
+
   std::string map_name;
-  internal::OrderMap ordering;
-  internal::SegmentList segments;
+
+  template<typename T>
+  using Column = internal::CopyOnWrite<std::vector<T>>;
+
+  // The data of the segments is stored in contiguous arrays that are sorted by
+  // finish time. The element at index i of each array belongs to the same
+  // segment.
+  //
+  // Each array is shared between copies of the Trajectory until one of the
+  // copies modifies it, so a copy that only has its times changed (like a
+  // delayed trajectory in the schedule) shares everything else with the
+  // original.
+  Column<Time> times;
+  Column<Eigen::Vector3d> positions;
+  Column<Eigen::Vector3d> velocities;
+  Column<std::size_t> profile_indices;
+
+  // Each distinct profile is only stored once. Trajectories usually only have
+  // one or two profiles that are shared by all of their segments.
+  Column<ConstProfilePtr> profiles;
+
+  // ids[i] is the ID of the segment at index i, and indices[id] is the index
+  // of the segment with that ID, or npos if the ID is not in use. Iterators
+  // and Segment references hold onto IDs so that they stay valid while other
+  // segments are inserted or erased.
+  struct IdTable
+  {
+    std::vector<std::size_t> ids;
+    std::vector<std::size_t> indices;
+    std::vector<std::size_t> free_ids;
+  };
+  internal::CopyOnWrite<IdTable> id_table;
+
+  // Delays that have not been applied to the times column yet. Each shift
+  // moves the segments from index `first` to the end of the Trajectory by
+  // `delta`. They are sorted by `first` with at most one shift per index, so
+  // repeatedly delaying a Trajectory from the same segment only costs O(1)
+  // instead of rewriting every time that follows it.
+  struct Shift
+  {
+    std::size_t first;
+    Duration delta;
+  };
+  std::vector<Shift> shifts;
+
+  // Reading a time costs O(shifts.size()), so we apply the shifts to the times
+  // column once too many of them have piled up.
+  static constexpr std::size_t MaxShifts = 8;
+
+  // The effective start and finish times of the Trajectory. These are updated
+  // whenever the Trajectory is modified so that start_time() and finish_time()
+  // can return pointers without needing to apply the shifts.
+  Time cached_start_time;
+  Time cached_finish_time;
+
+  // The spline that leads up to each segment is computed the first time that
+  // any spline is needed, and then kept until the segment or the one before it
+  // is modified. Conflict detection keeps asking for the same splines of a
+  // schedule entry, so this saves a lot of repeated work. The entry at index 0
+  // is never used because the first segment has no spline leading up to it.
+  //
+  // The bounding volume hierarchy over the splines is built the first time that
+  // it is needed, and rebuilt after any modification.
+  //
+  // Copies of a Trajectory share the cache and the hierarchy, just like they
+  // share the segment data, so copying a Trajectory never copies them. Every
+  // Trajectory that shares them has the same segments, so they all fill them
+  // in the same way. A Trajectory may not be modified while other threads are
+  // reading it, so only the lazy filling needs to be guarded by a mutex, and
+  // the mutex is shared along with the data that it guards.
+  struct CachedSpline
+  {
+    internal::SplineCoefficients value;
+    bool valid = false;
+  };
+  using SplineCache =
+      std::vector<CachedSpline, Eigen::aligned_allocator<CachedSpline>>;
+
+  struct Splines
+  {
+    SplineCache cache;
+    std::atomic_bool cache_ready{true};
+    internal::SplineTree tree;
+    std::atomic_bool tree_ready{true};
+    std::mutex mutex;
+  };
+  std::shared_ptr<Splines> splines;
+
+  /// Get the splines so that they can be modified, first making our own copy
+  /// of them if they are shared with another Trajectory. Every modification
+  /// invalidates the hierarchy, so the copy does not include it.
+  Splines& edit_splines()
+  {
+    if (!splines)
+    {
+      splines = std::make_shared<Splines>();
+    }
+    else if (splines.use_count() > 1)
+    {
+      // The other Trajectories might be filling in the cache from another
+      // thread
+      const auto edited = std::make_shared<Splines>();
+      std::lock_guard<std::mutex> lock(splines->mutex);
+      edited->cache = splines->cache;
+      edited->cache_ready.store(
+            splines->cache_ready.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+      edited->tree_ready.store(false, std::memory_order_relaxed);
+      splines = edited;
+    }
+
+    return *splines;
+  }
+
+  // Segment objects are only created when a user asks for a reference to one,
+  // and are kept alive until the Trajectory is destroyed. They are organized
+  // by ID. Several threads may be reading the same const Trajectory at once,
+  // so the table is filled in with compare-and-swap instead of a mutex. Chunk
+  // k of the table holds the Segments whose IDs are in [2^k - 1, 2^(k+1) - 1),
+  // so a chunk never needs to be moved once it has been created.
+  class SegmentTable
+  {
+  public:
+
+    Segment& get(Implementation* parent, const std::size_t id)
+    {
+      const std::size_t n = id + 1;
+      std::size_t k = 0;
+      while (n >> (k+1))
+        ++k;
+
+      Slot* const chunk = load_or_create(
+            _chunks[k],
+            [k]() { return new Slot[std::size_t(1) << k](); },
+            [](Slot* chunk) { delete[] chunk; });
+
+      Segment* const segment = load_or_create(
+            chunk[n - (std::size_t(1) << k)],
+            [parent, id]()
+      {
+        Segment* const created = new Segment;
+        created->_pimpl->parent = parent;
+        created->_pimpl->id = id;
+        return created;
+      },
+            [](Segment* segment) { delete segment; });
+
+      return *segment;
+    }
+
+    ~SegmentTable()
+    {
+      for (std::size_t k=0; k < _chunks.size(); ++k)
+      {
+        Slot* const chunk = _chunks[k].load(std::memory_order_relaxed);
+        if (!chunk)
+          continue;
+
+        for (std::size_t i=0; i < (std::size_t(1) << k); ++i)
+          delete chunk[i].load(std::memory_order_relaxed);
+
+        delete[] chunk;
+      }
+    }
+
+  private:
+
+    using Slot = std::atomic<Segment*>;
+
+    /// Get the object that a slot points to, creating it first if the slot is
+    /// empty. If another thread fills the slot at the same time, its object is
+    /// used and ours is destroyed.
+    template<typename T, typename Create, typename Destroy>
+    static T* load_or_create(
+        std::atomic<T*>& slot, const Create& create, const Destroy& destroy)
+    {
+      T* current = slot.load(std::memory_order_acquire);
+      if (current)
+        return current;
+
+      T* const created = create();
+      if (slot.compare_exchange_strong(
+            current, created,
+            std::memory_order_acq_rel, std::memory_order_acquire))
+        return created;
+
+      destroy(created);
+      return current;
+    }
+
+    std::array<std::atomic<Slot*>, 8*sizeof(std::size_t)> _chunks = {};
+  };
+
+  // This is only allocated once a Segment is asked for, so that trajectories
+  // that are never dereferenced stay small.
+  mutable std::atomic<SegmentTable*> segment_table{nullptr};
 
   template<typename SegT>
-  base_iterator<SegT> make_iterator(
-      internal::SegmentList::iterator iterator) const
+  base_iterator<SegT> make_iterator(const std::size_t id) const
   {
     base_iterator<SegT> it;
-    it._pimpl->raw_iterator = std::move(iterator);
+    it._pimpl->id = id;
     it._pimpl->parent = this;
 
     return it;
   }
 
-  std::unique_ptr<Segment> make_segment(internal::SegmentList::iterator iterator)
+  std::size_t id_at(const std::size_t index) const
+  {
+    const std::vector<std::size_t>& ids = id_table.get().ids;
+    return index < ids.size()? ids[index] : npos;
+  }
+
+  template<typename SegT>
+  base_iterator<SegT> make_iterator_at(const std::size_t index) const
+  {
+    return make_iterator<SegT>(id_at(index));
+  }
+
+  Segment& get_segment(const std::size_t id) const
+  {
+    SegmentTable* table = segment_table.load(std::memory_order_acquire);
+    if (!table)
+    {
+      SegmentTable* const created = new SegmentTable;
+      if (segment_table.compare_exchange_strong(
+            table, created,
+            std::memory_order_acq_rel, std::memory_order_acquire))
+        table = created;
+      else
+        delete created;
+    }
+
+    return table->get(const_cast<Implementation*>(this), id);
+  }
+
+  /// Get the finish time of the segment at this index with any pending shifts
+  /// applied to it.
+  Time time(const std::size_t index) const
+  {
+    Time result = times.get()[index];
+    for (const Shift& shift : shifts)
+    {
+      if (index < shift.first)
+        break;
+
+      result += shift.delta;
+    }
+
+    return result;
+  }
+
+  /// Get the index of the first segment that does not finish before the given
+  /// time.
+  std::size_t lower_bound(const Time t) const
+  {
+    std::size_t low = 0;
+    std::size_t high = times.get().size();
+    while (low < high)
+    {
+      const std::size_t mid = low + (high - low)/2;
+      if (time(mid) < t)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+    return low;
+  }
+
+  /// Write any pending shifts into the times column. This needs to be done
+  /// before the order of the segments is changed.
+  void apply_shifts()
+  {
+    if (shifts.empty())
+      return;
+
+    std::vector<Time>& edit_times = times.edit();
+    auto shift_it = shifts.begin();
+    Duration offset(0);
+    for (std::size_t i=0; i < edit_times.size(); ++i)
+    {
+      while (shift_it != shifts.end() && shift_it->first <= i)
+        offset += (shift_it++)->delta;
+
+      edit_times[i] += offset;
+    }
+
+    shifts.clear();
+  }
+
+  /// Shift the segments from index `first` to the end of the Trajectory
+  void add_shift(const std::size_t first, const Duration delta)
+  {
+    // Only the spline that leads into the first shifted segment changes its
+    // duration. Every other spline keeps its shape.
+    invalidate_spline(first);
+
+    const auto it = std::lower_bound(
+          shifts.begin(), shifts.end(), first,
+          [](const Shift& shift, const std::size_t index)
+    {
+      return shift.first < index;
+    });
+
+    if (it != shifts.end() && it->first == first)
+    {
+      it->delta += delta;
+      if (it->delta.count() == 0)
+        shifts.erase(it);
+    }
+    else
+    {
+      shifts.insert(it, Shift{first, delta});
+    }
+
+    if (shifts.size() > MaxShifts)
+      apply_shifts();
+
+    update_bounds();
+  }
+
+  /// Mark the spline that leads up to the segment at this index as outdated.
+  void invalidate_spline(const std::size_t index)
   {
-    std::unique_ptr<Segment> seg(new Segment);
-    seg->_pimpl->myself = std::move(iterator);
-    seg->_pimpl->parent = this;
+    Splines& edited = edit_splines();
+    if (index < edited.cache.size())
+      edited.cache[index].valid = false;
 
-    return seg;
+    edited.cache_ready.store(false, std::memory_order_relaxed);
+    edited.tree_ready.store(false, std::memory_order_relaxed);
+  }
+
+  /// Mark the splines on both sides of the segment at this index as outdated.
+  void invalidate_splines_around(const std::size_t index)
+  {
+    invalidate_spline(index);
+    invalidate_spline(index+1);
+  }
+
+  /// Get the spline that leads up to the segment at this index, computing any
+  /// outdated splines first.
+  const internal::SplineCoefficients& spline(const std::size_t index) const
+  {
+    assert(splines && 0 < index && index < splines->cache.size());
+    if (!splines->cache_ready.load(std::memory_order_acquire))
+    {
+      std::lock_guard<std::mutex> lock(splines->mutex);
+      fill_spline_cache();
+    }
+
+    return splines->cache[index].value;
+  }
+
+  /// Compute any outdated splines. The mutex of the splines must be locked.
+  void fill_spline_cache() const
+  {
+    if (splines->cache_ready.load(std::memory_order_relaxed))
+      return;
+
+    SplineCache& cache = splines->cache;
+    for (std::size_t i=1; i < cache.size(); ++i)
+    {
+      CachedSpline& entry = cache[i];
+      if (entry.valid)
+        continue;
+
+      entry.value = internal::compute_spline_coefficients(data(i-1), data(i));
+      entry.valid = true;
+    }
+
+    splines->cache_ready.store(true, std::memory_order_release);
+  }
+
+  /// Get the bounding volume hierarchy over the splines, rebuilding it first
+  /// if the Trajectory has changed.
+  const internal::SplineTree& get_spline_tree() const
+  {
+    if (!splines)
+    {
+      // Nothing has ever been inserted into this Trajectory
+      static const internal::SplineTree empty_tree;
+      return empty_tree;
+    }
+
+    internal::SplineTree& tree = splines->tree;
+    if (splines->tree_ready.load(std::memory_order_acquire))
+      return tree;
+
+    std::lock_guard<std::mutex> lock(splines->mutex);
+    if (splines->tree_ready.load(std::memory_order_relaxed))
+      return tree;
+
+    fill_spline_cache();
+    const SplineCache& cache = splines->cache;
+
+    const std::vector<ConstProfilePtr>& current_profiles = profiles.get();
+    const std::vector<std::size_t>& current_indices = profile_indices.get();
+
+    std::vector<internal::SplineTree::Node,
+        Eigen::aligned_allocator<internal::SplineTree::Node>> leaves;
+    leaves.reserve(cache.size());
+    for (std::size_t i=1; i < cache.size(); ++i)
+    {
+      const auto& shape = current_profiles[current_indices[i]]->get_shape();
+      const Eigen::Vector2d inflation = Eigen::Vector2d::Constant(
+            shape? shape->get_characteristic_length() : 0.0);
+
+      const std::array<Eigen::Vector2d, 2>& bounds = cache[i].value.bounds;
+
+      leaves.push_back(
+            internal::SplineTree::Node{
+              time(i-1),
+              time(i),
+              bounds[0] - inflation,
+              bounds[1] + inflation
+            });
+    }
+
+    tree.build(leaves);
+    splines->tree_ready.store(true, std::memory_order_release);
+    return tree;
+  }
+
+  void update_bounds()
+  {
+    const std::size_t N = times.get().size();
+    if (N == 0)
+      return;
+
+    cached_start_time = time(0);
+    cached_finish_time = time(N-1);
+  }
+
+  internal::SegmentData data(const std::size_t index) const
+  {
+    return internal::SegmentData{
+      time(index),
+      positions.get()[index],
+      velocities.get()[index]
+    };
+  }
+
+  std::size_t get_profile_index(const ConstProfilePtr& profile)
+  {
+    const std::vector<ConstProfilePtr>& current = profiles.get();
+    const auto it = std::find(current.begin(), current.end(), profile);
+    if (it != current.end())
+      return static_cast<std::size_t>(it - current.begin());
+
+    std::vector<ConstProfilePtr>& edited = profiles.edit();
+    edited.push_back(profile);
+    return edited.size() - 1;
+  }
+
+  static std::size_t make_id(IdTable& table)
+  {
+    if (!table.free_ids.empty())
+    {
+      const std::size_t id = table.free_ids.back();
+      table.free_ids.pop_back();
+      return id;
+    }
+
+    table.indices.push_back(npos);
+    return table.indices.size() - 1;
+  }
+
+  /// Update the indices of the segments in the range [first, last)
+  static void reindex(
+      IdTable& table, const std::size_t first, const std::size_t last)
+  {
+    for (std::size_t i = first; i < last; ++i)
+      table.indices[table.ids[i]] = i;
+  }
+
+  /// Move the segment at index `from` so that it is at index `to`, shifting
+  /// the segments in between.
+  void move_segment(const std::size_t from, const std::size_t to)
+  {
+    const auto shift = [&](auto& v)
+    {
+      if (from < to)
+        std::rotate(v.begin() + from, v.begin() + from + 1, v.begin() + to + 1);
+      else
+        std::rotate(v.begin() + to, v.begin() + from, v.begin() + from + 1);
+    };
+
+    shift(times.edit());
+    shift(positions.edit());
+    shift(velocities.edit());
+    shift(profile_indices.edit());
+    shift(edit_splines().cache);
+
+    IdTable& table = id_table.edit();
+    shift(table.ids);
+    reindex(table, std::min(from, to), std::max(from, to) + 1);
+
+    for (std::size_t i = std::min(from, to); i <= std::max(from, to) + 1; ++i)
+      invalidate_spline(i);
   }
 
   Implementation(std::string map_name)
@@ -138,97 +600,310 @@ public:
     *this = other;
   }
 
+  ~Implementation()
+  {
+    delete segment_table.load(std::memory_order_relaxed);
+  }
+
   Implementation& operator=(const Implementation& other)
   {
-    // Start by making a normal copy
+    // The segment data is shared with the other Trajectory until one of us
+    // modifies it. We also share its IDs, so any Segment objects that we
+    // already have will refer to the new segment that has the same ID.
     map_name = other.map_name;
-    ordering = other.ordering;
-    segments = other.segments;
-
-    // Now correct all the iterators to point to the freshly copied container
-    internal::SegmentList::iterator sit = segments.begin();
-    internal::OrderMap::iterator oit = ordering.begin();
-    for( ; sit != segments.end(); ++sit, ++oit)
-    {
-      sit->myself = make_segment(sit);
-      oit->second = sit;
-    }
+    times = other.times;
+    positions = other.positions;
+    velocities = other.velocities;
+    profile_indices = other.profile_indices;
+    profiles = other.profiles;
+    id_table = other.id_table;
+    shifts = other.shifts;
+    cached_start_time = other.cached_start_time;
+    cached_finish_time = other.cached_finish_time;
+    splines = other.splines;
 
     return *this;
   }
 
-  InsertionResult insert(internal::SegmentElement::Data data)
+  InsertionResult insert(
+      const Time finish_time,
+      const ConstProfilePtr& profile,
+      Eigen::Vector3d position,
+      Eigen::Vector3d velocity)
   {
-    const internal::OrderMap::iterator hint = ordering.lower_bound(data.finish_time);
-    if(hint != ordering.end() && hint->first == data.finish_time)
+    apply_shifts();
+
+    const std::vector<Time>& current_times = times.get();
+    const auto time_it = std::lower_bound(
+          current_times.begin(), current_times.end(), finish_time);
+    const std::size_t index =
+        static_cast<std::size_t>(time_it - current_times.begin());
+
+    if (time_it != current_times.end() && *time_it == finish_time)
     {
       // We already have a Segment in the Trajectory that ends at this same
       // exact moment in time, so we will return the existing iterator along
       // with inserted==false.
-      assert(segments.size() > 0);
-      return InsertionResult{make_iterator<Segment>(hint->second), false};
+      return InsertionResult{make_iterator<Segment>(id_at(index)), false};
     }
 
-    const internal::SegmentList::const_iterator list_destination =
-        (hint == ordering.end()) ? segments.end() : hint->second;
+    const std::size_t profile_index = get_profile_index(profile);
+
+    std::vector<Time>& edit_times = times.edit();
+    edit_times.insert(edit_times.begin() + index, finish_time);
+
+    std::vector<Eigen::Vector3d>& edit_positions = positions.edit();
+    edit_positions.insert(edit_positions.begin() + index, std::move(position));
 
-    const internal::SegmentList::iterator result =
-        segments.emplace(list_destination, std::move(data));
-    result->myself = make_segment(result);
-    assert(segments.size() > 0);
+    std::vector<Eigen::Vector3d>& edit_velocities = velocities.edit();
+    edit_velocities.insert(
+          edit_velocities.begin() + index, std::move(velocity));
 
-    ordering.emplace_hint(hint, data.finish_time, result);
-    assert(ordering.size() > 0);
+    std::vector<std::size_t>& edit_profiles = profile_indices.edit();
+    edit_profiles.insert(edit_profiles.begin() + index, profile_index);
 
-    return InsertionResult{make_iterator<Segment>(result), true};
+    IdTable& table = id_table.edit();
+    const std::size_t id = make_id(table);
+    table.ids.insert(table.ids.begin() + index, id);
+    reindex(table, index, table.ids.size());
+    update_bounds();
+
+    SplineCache& cache = edit_splines().cache;
+    cache.insert(cache.begin() + index, CachedSpline());
+    invalidate_splines_around(index);
+
+    return InsertionResult{make_iterator<Segment>(id), true};
   }
 
-  iterator find(Time time)
+  iterator find(Time t) const
   {
-    const auto it = ordering.lower_bound(time);
-    if(it == ordering.end())
-      return make_iterator<Segment>(segments.end());
+    const std::size_t index = lower_bound(t);
+    if (index == times.get().size())
+      return make_iterator<Segment>(npos);
 
     // If the time comes before the start of the Trajectory, then we return
     // the end() iterator
-    if(time < segments.begin()->data.finish_time)
-      return make_iterator<Segment>(segments.end());
+    if (t < cached_start_time)
+      return make_iterator<Segment>(npos);
 
-    return make_iterator<Segment>(it->second);
+    return make_iterator_at<Segment>(index);
   }
 
-  iterator erase(iterator segment)
+  iterator erase(const std::size_t first, const std::size_t last)
   {
-    ordering.erase(segment->_pimpl->myself->data.finish_time);
-    return make_iterator<Segment>(segments.erase(segment->_pimpl->myself));
+    if (first == last)
+      return make_iterator_at<Segment>(first);
+
+    apply_shifts();
+
+    IdTable& table = id_table.edit();
+    for (std::size_t i = first; i < last; ++i)
+    {
+      table.indices[table.ids[i]] = npos;
+      table.free_ids.push_back(table.ids[i]);
+    }
+
+    const auto erase_range = [&](auto& v)
+    {
+      v.erase(v.begin() + first, v.begin() + last);
+    };
+
+    erase_range(times.edit());
+    erase_range(positions.edit());
+    erase_range(velocities.edit());
+    erase_range(profile_indices.edit());
+    erase_range(table.ids);
+    reindex(table, first, table.ids.size());
+    update_bounds();
+
+    erase_range(edit_splines().cache);
+    invalidate_spline(first);
+
+    return make_iterator_at<Segment>(first);
   }
 
-  iterator erase(iterator first, iterator last)
+  iterator erase(const iterator& segment)
   {
-    const auto seg_begin = first->_pimpl->myself;
-    const auto seg_end = last._pimpl->raw_iterator == segments.end()?
-          segments.end() : last->_pimpl->myself;
-
-    const auto order_start = ordering.find(seg_begin->data.finish_time);
-    const auto order_end = seg_end == segments.end()?
-          ordering.end() : ordering.find(seg_end->data.finish_time);
+    const std::size_t index = segment._pimpl->index();
+    return erase(index, index+1);
+  }
 
-    ordering.erase(order_start, order_end);
-    return make_iterator<Segment>(segments.erase(seg_begin, seg_end));
+  iterator erase(const iterator& first, const iterator& last)
+  {
+    return erase(first._pimpl->index(), last._pimpl->index());
   }
 
-  iterator begin()
+  iterator begin() const
   {
-    return make_iterator<Segment>(segments.begin());
+    return make_iterator_at<Segment>(0);
   }
 
-  iterator end()
+  iterator end() const
   {
-    return make_iterator<Segment>(segments.end());
+    return make_iterator<Segment>(npos);
   }
 
 };
 
+constexpr std::size_t Trajectory::Implementation::npos;
+constexpr std::size_t Trajectory::Implementation::MaxShifts;
+
+//==============================================================================
+std::size_t Trajectory::Segment::Implementation::index() const
+{
+  return parent->id_table.get().indices[id];
+}
+
+//==============================================================================
+namespace detail {
+
+constexpr std::size_t TrajectoryIteratorImplementation::npos;
+
+//==============================================================================
+template<typename SegT>
+Trajectory::base_iterator<SegT> TrajectoryIteratorImplementation::make_iterator(
+    const std::size_t other_id) const
+{
+  return parent->make_iterator<SegT>(other_id);
+}
+
+//==============================================================================
+template<typename SegT>
+Trajectory::base_iterator<SegT>
+TrajectoryIteratorImplementation::post_increment()
+{
+  const Trajectory::base_iterator<SegT> old_it = make_iterator<SegT>(id);
+  increment();
+  return old_it;
+}
+
+//==============================================================================
+template<typename SegT>
+Trajectory::base_iterator<SegT>
+TrajectoryIteratorImplementation::post_decrement()
+{
+  const Trajectory::base_iterator<SegT> old_it = make_iterator<SegT>(id);
+  decrement();
+  return old_it;
+}
+
+//==============================================================================
+std::size_t TrajectoryIteratorImplementation::index() const
+{
+  return id == npos?
+        parent->times.get().size() : parent->id_table.get().indices[id];
+}
+
+//==============================================================================
+void TrajectoryIteratorImplementation::increment()
+{
+  id = parent->id_at(index() + 1);
+}
+
+//==============================================================================
+void TrajectoryIteratorImplementation::decrement()
+{
+  // Decrementing the begin() iterator is undefined, just like it is for the
+  // standard containers.
+  id = parent->id_at(index() - 1);
+}
+
+//==============================================================================
+internal::SegmentData TrajectoryIteratorImplementation::data(
+    const Trajectory::const_iterator& it)
+{
+  return it._pimpl->parent->data(it._pimpl->index());
+}
+
+//==============================================================================
+internal::SegmentData TrajectoryIteratorImplementation::preceding_data(
+    const Trajectory::const_iterator& it)
+{
+  const std::size_t index = it._pimpl->index();
+  assert(index > 0);
+  return it._pimpl->parent->data(index - 1);
+}
+
+//==============================================================================
+const internal::SplineCoefficients& TrajectoryIteratorImplementation::spline(
+    const Trajectory::const_iterator& it)
+{
+  return it._pimpl->parent->spline(it._pimpl->index());
+}
+
+//==============================================================================
+std::array<Time, 2> TrajectoryIteratorImplementation::spline_time_range(
+    const Trajectory::const_iterator& it)
+{
+  const Trajectory::Implementation& parent = *it._pimpl->parent;
+  const std::size_t index = it._pimpl->index();
+  assert(index > 0);
+  return {parent.time(index-1), parent.time(index)};
+}
+
+//==============================================================================
+const internal::SplineTree& TrajectoryIteratorImplementation::spline_tree(
+    const Trajectory& trajectory)
+{
+  return trajectory._pimpl->get_spline_tree();
+}
+
+//==============================================================================
+Trajectory::const_iterator TrajectoryIteratorImplementation::iterator_at(
+    const Trajectory& trajectory, const std::size_t index)
+{
+  return trajectory._pimpl->make_iterator_at<const Trajectory::Segment>(index);
+}
+
+} // namespace detail
+
+//==============================================================================
+namespace internal {
+
+//==============================================================================
+void SplineTree::build(
+    const std::vector<Node, Eigen::aligned_allocator<Node>>& leaves)
+{
+  _nodes.clear();
+  _num_leaves = leaves.size();
+  if (leaves.empty())
+    return;
+
+  _nodes.reserve(2*leaves.size() - 1);
+  _build(leaves, 0, leaves.size());
+}
+
+//==============================================================================
+std::size_t SplineTree::_build(
+    const std::vector<Node, Eigen::aligned_allocator<Node>>& leaves,
+    const std::size_t lower,
+    const std::size_t upper)
+{
+  const std::size_t index = _nodes.size();
+  if (upper - lower == 1)
+  {
+    _nodes.push_back(leaves[lower]);
+    return index;
+  }
+
+  _nodes.emplace_back();
+  const std::size_t middle = lower + (upper - lower)/2;
+  const std::size_t left = _build(leaves, lower, middle);
+  const std::size_t right = _build(leaves, middle, upper);
+
+  Node& node = _nodes[index];
+  const Node& left_node = _nodes[left];
+  const Node& right_node = _nodes[right];
+  node.start = std::min(left_node.start, right_node.start);
+  node.finish = std::max(left_node.finish, right_node.finish);
+  node.min = left_node.min.cwiseMin(right_node.min);
+  node.max = left_node.max.cwiseMax(right_node.max);
+
+  return index;
+}
+
+} // namespace internal
+
 //==============================================================================
 class Trajectory::Profile::Implementation
 {
@@ -377,116 +1052,101 @@ Trajectory::Profile::Profile(geometry::ConstFinalConvexShapePtr shape)
 //==============================================================================
 auto Trajectory::Segment::get_profile() const -> ConstProfilePtr
 {
-  return _pimpl->data().profile;
+  const Trajectory::Implementation& parent = *_pimpl->parent;
+  return parent.profiles.get()[parent.profile_indices.get()[_pimpl->index()]];
 }
 
 //==============================================================================
 Trajectory::Segment& Trajectory::Segment::set_profile(
     ConstProfilePtr new_profile)
 {
-  _pimpl->data().profile = std::move(new_profile);
+  Trajectory::Implementation& parent = *_pimpl->parent;
+  const std::size_t profile_index = parent.get_profile_index(new_profile);
+  parent.profile_indices.edit()[_pimpl->index()] = profile_index;
+
+  // The size of the new shape may be different, so the bounding volume
+  // hierarchy needs to be rebuilt.
+  parent.edit_splines().tree_ready.store(false, std::memory_order_relaxed);
   return *this;
 }
 
 //==============================================================================
 Eigen::Vector3d Trajectory::Segment::get_finish_position() const
 {
-  return _pimpl->data().position;
+  return _pimpl->parent->positions.get()[_pimpl->index()];
 }
 
 //==============================================================================
 Trajectory::Segment& Trajectory::Segment::set_finish_position(
     Eigen::Vector3d new_position)
 {
-  _pimpl->data().position = std::move(new_position);
+  const std::size_t index = _pimpl->index();
+  _pimpl->parent->positions.edit()[index] = std::move(new_position);
+  _pimpl->parent->invalidate_splines_around(index);
   return *this;
 }
 
 //==============================================================================
 Eigen::Vector3d Trajectory::Segment::get_finish_velocity() const
 {
-  return _pimpl->data().velocity;
+  return _pimpl->parent->velocities.get()[_pimpl->index()];
 }
 
 //==============================================================================
 Trajectory::Segment& Trajectory::Segment::set_finish_velocity(
     Eigen::Vector3d new_velocity)
 {
-  _pimpl->data().velocity = std::move(new_velocity);
+  const std::size_t index = _pimpl->index();
+  _pimpl->parent->velocities.edit()[index] = std::move(new_velocity);
+  _pimpl->parent->invalidate_splines_around(index);
   return *this;
 }
 
 //==============================================================================
 Time Trajectory::Segment::get_finish_time() const
 {
-  return _pimpl->time();
+  return _pimpl->parent->time(_pimpl->index());
 }
 
 //==============================================================================
 Trajectory::Segment& Trajectory::Segment::set_finish_time(const Time new_time)
 {
-  internal::SegmentList::iterator data_it = _pimpl->myself;
-  internal::SegmentElement::Data& current_data = data_it->data;
-  const Time current_time = current_data.finish_time;
+  Trajectory::Implementation& parent = *_pimpl->parent;
+  const std::size_t index = _pimpl->index();
 
-  if(current_time == new_time)
+  if(parent.time(index) == new_time)
   {
-    // Short-circuit, since nothing is changing. The erase and re-insertion
-    // would be a waste of time in this case.
+    // Short-circuit, since nothing is changing.
     return *this;
   }
 
-  internal::OrderMap& ordering = _pimpl->parent->ordering;
-  internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::OrderMap::const_iterator current_order_it =
-      ordering.find(current_time);
-  assert(current_order_it != ordering.end());
+  parent.apply_shifts();
+  const std::vector<Time>& times = parent.times.get();
 
-  const internal::OrderMap::const_iterator hint =
-      ordering.lower_bound(new_time);
-
-  if(current_order_it == hint)
+  const auto hint = std::lower_bound(times.begin(), times.end(), new_time);
+  if(hint != times.end() && *hint == new_time)
   {
-    // The Segment is already in the correct location within the list, so it
-    // does not need to be moved. We can just update its entry in the OrderMap.
-
-    // We need to create a new_hint iterator which points to the iterator after
-    // hint because the hint iterator will be invalidated when we erase
-    // current_order_it (because they are iterators to the same element).
-    const internal::OrderMap::const_iterator new_hint =
-        ++internal::OrderMap::const_iterator(hint);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(new_hint, new_time, std::move(data_it));
+    // The new time conflicts with an existing time, so we will throw an
+    // exception.
+    throw std::invalid_argument(
+          "[Trajectory::Segment::set_finish_time] Attempted to set time to "
+          + std::to_string(new_time.time_since_epoch().count())
+          + "ns, but a waypoint already exists at that timestamp.");
   }
-  else if(hint == ordering.end())
-  {
-    // This Segment must be moved to the end of the list.
-    segments.splice(segments.end(), segments, data_it);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(hint, new_time, std::move(data_it));
-  }
-  else
-  {
-    const internal::SegmentList::const_iterator destination = hint->second;
-    assert(destination != segments.end());
 
-    if(destination->data.finish_time == new_time)
-    {
-      // The new time conflicts with an existing time, so we will throw an
-      // exception.
-      throw std::invalid_argument(
-            "[Trajectory::Segment::set_finish_time] Attempted to set time to "
-            + std::to_string(new_time.time_since_epoch().count())
-            + "ns, but a waypoint already exists at that timestamp.");
-    }
+  // The hint is where the segment would go if it were inserted alongside its
+  // current self. If it is moving later in time, then removing it from its
+  // current position will shift its destination down by one.
+  std::size_t destination = static_cast<std::size_t>(hint - times.begin());
+  if(index < destination)
+    --destination;
 
-    segments.splice(destination, segments, data_it);
-    ordering.erase(current_order_it);
-    ordering.emplace_hint(hint, new_time, std::move(data_it));
-  }
+  if(destination != index)
+    parent.move_segment(index, destination);
 
-  // Update the finish_time value in the data field.
-  current_data.finish_time = new_time;
+  parent.times.edit()[destination] = new_time;
+  parent.update_bounds();
+  parent.invalidate_splines_around(destination);
 
   return *this;
 }
@@ -494,22 +1154,19 @@ Trajectory::Segment& Trajectory::Segment::set_finish_time(const Time new_time)
 //==============================================================================
 void Trajectory::Segment::adjust_finish_times(Duration delta_t)
 {
-  internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::SegmentList::iterator begin_it = _pimpl->myself;
-  const Time original_begin_time = begin_it->data.finish_time;
+  Trajectory::Implementation& parent = *_pimpl->parent;
+  const std::size_t index = _pimpl->index();
 
-  if(delta_t.count() < 0 && begin_it != segments.begin())
+  if(delta_t.count() < 0 && index > 0)
   {
     // If delta_t is negative and this is not the first Segment in the
     // Trajectory, make sure the change in time does not make it dip beneath its
     // predecessor Segment.
-    const internal::SegmentList::const_iterator predecessor_it =
-        --internal::SegmentList::iterator(begin_it);
-    const auto new_time = begin_it->data.finish_time + delta_t;
-    if(new_time <= predecessor_it->data.finish_time)
+    const Time predecessor_time = parent.time(index-1);
+    const auto new_time = parent.time(index) + delta_t;
+    if(new_time <= predecessor_time)
     {
-      const auto tp = predecessor_it->data.finish_time
-          .time_since_epoch().count();
+      const auto tp = predecessor_time.time_since_epoch().count();
       const auto tc = (new_time).time_since_epoch().count();
 
       const std::string error =
@@ -524,49 +1181,31 @@ void Trajectory::Segment::adjust_finish_times(Duration delta_t)
     }
   }
 
-  // Adjust the times for the segments and collect their iterators
-  std::vector<internal::SegmentList::iterator> list_iterators;
-  list_iterators.reserve(segments.size());
-  for(internal::SegmentList::iterator it = begin_it; it != segments.end(); ++it)
-  {
-    it->data.finish_time += delta_t;
-    list_iterators.push_back(it);
-  }
-
-  internal::OrderMap& ordering = _pimpl->parent->ordering;
-  const internal::OrderMap::iterator order_it =
-      ordering.find(original_begin_time);
-  assert(order_it != ordering.end());
-
-  // Erase the existing ordering entries for all the modified Trajectory
-  // Segments.
-  ordering.erase(order_it, ordering.end());
-
-  // Add new entries one at a time, supplying the emplacement operator with the
-  // hint that it can always append the entry to the end of the map.
-  for(internal::SegmentList::iterator& it : list_iterators)
-  {
-    const Time new_time = it->data.finish_time;
-    ordering.emplace_hint(ordering.end(), new_time, std::move(it));
-  }
+  // Shifting every time from here to the end by the same amount preserves the
+  // ordering, so nothing needs to be moved. The shift is recorded instead of
+  // being applied right away, so delays cost the same no matter how long the
+  // Trajectory is, and all of the segment data stays shared with any copies of
+  // this Trajectory.
+  parent.add_shift(index, delta_t);
 }
 
 //==============================================================================
 std::unique_ptr<Motion> Trajectory::Segment::compute_motion() const
 {
-  const internal::SegmentList& segments = _pimpl->parent->segments;
-  const internal::SegmentList::const_iterator& it = _pimpl->myself;
-  const internal::SegmentElement::Data& finish_data = it->data;
+  const Trajectory::Implementation& parent = *_pimpl->parent;
+  const std::size_t index = _pimpl->index();
 
-  if(it == segments.begin())
+  if(index == 0)
   {
+    const internal::SegmentData data = parent.data(index);
     return std::make_unique<SinglePointMotion>(
-          finish_data.finish_time,
-          finish_data.position,
-          finish_data.velocity);
+          data.finish_time,
+          data.position,
+          data.velocity);
   }
 
-  return std::make_unique<SplineMotion>(Spline(it));
+  return std::make_unique<SplineMotion>(
+        Spline(parent.make_iterator<const Segment>(_pimpl->id)));
 }
 
 //==============================================================================
@@ -618,17 +1257,26 @@ Trajectory::InsertionResult Trajectory::insert(
     Eigen::Vector3d velocity)
 {
   return _pimpl->insert(
-        internal::SegmentElement::Data{
-          std::move(finish_time),
-          std::move(profile),
-          std::move(position),
-          std::move(velocity)});
+        finish_time,
+        profile,
+        std::move(position),
+        std::move(velocity));
 }
 
 //==============================================================================
 Trajectory::InsertionResult Trajectory::insert(const Segment& other)
 {
-  return _pimpl->insert(internal::SegmentElement::Data{other._pimpl->data()});
+  const Implementation& parent = *other._pimpl->parent;
+  const std::size_t index = other._pimpl->index();
+  const internal::SegmentData data = parent.data(index);
+  const ConstProfilePtr profile =
+      parent.profiles.get()[parent.profile_indices.get()[index]];
+
+  return _pimpl->insert(
+        data.finish_time,
+        profile,
+        data.position,
+        data.velocity);
 }
 
 //==============================================================================
@@ -640,7 +1288,7 @@ Trajectory::iterator Trajectory::find(Time time)
 //==============================================================================
 Trajectory::const_iterator Trajectory::find(Time time) const
 {
-  return const_cast<Implementation&>(*_pimpl).find(time);
+  return _pimpl->find(time);
 }
 
 //==============================================================================
@@ -664,13 +1312,13 @@ Trajectory::iterator Trajectory::begin()
 //==============================================================================
 Trajectory::const_iterator Trajectory::begin() const
 {
-  return const_cast<Implementation&>(*_pimpl).begin();
+  return _pimpl->begin();
 }
 
 //==============================================================================
 Trajectory::const_iterator Trajectory::cbegin() const
 {
-  return const_cast<Implementation&>(*_pimpl).begin();
+  return _pimpl->begin();
 }
 
 //==============================================================================
@@ -682,87 +1330,83 @@ Trajectory::iterator Trajectory::end()
 //==============================================================================
 Trajectory::const_iterator Trajectory::end() const
 {
-  return const_cast<Implementation&>(*_pimpl).end();
+  return _pimpl->end();
 }
 
 //==============================================================================
 Trajectory::const_iterator Trajectory::cend() const
 {
-  return const_cast<Implementation&>(*_pimpl).end();
+  return _pimpl->end();
 }
 
 //==============================================================================
 auto Trajectory::front() -> Segment&
 {
-  return *_pimpl->segments.front().myself;
+  return _pimpl->get_segment(_pimpl->id_at(0));
 }
 
 //==============================================================================
 auto Trajectory::front() const -> const Segment&
 {
-  return *_pimpl->segments.front().myself;
+  return _pimpl->get_segment(_pimpl->id_at(0));
 }
 
 //==============================================================================
 auto Trajectory::back() -> Segment&
 {
-  return *_pimpl->segments.back().myself;
+  return _pimpl->get_segment(_pimpl->id_at(size() - 1));
 }
 
 //==============================================================================
 auto Trajectory::back() const -> const Segment&
 {
-  return *_pimpl->segments.back().myself;
+  return _pimpl->get_segment(_pimpl->id_at(size() - 1));
 }
 
 //==============================================================================
 const Time* Trajectory::start_time() const
 {
-  const auto& segments = _pimpl->segments;
-  return segments.size() == 0? nullptr : &segments.front().data.finish_time;
+  return size() == 0? nullptr : &_pimpl->cached_start_time;
 }
 
 //==============================================================================
 const Time* Trajectory::finish_time() const
 {
-  const auto& segments = _pimpl->segments;
-  return segments.size() == 0? nullptr : &segments.back().data.finish_time;
+  return size() == 0? nullptr : &_pimpl->cached_finish_time;
 }
 
 //==============================================================================
 Duration Trajectory::duration() const
 {
-  const auto& segments = _pimpl->segments;
-  return segments.size() < 2?
-        Duration(0) :
-        segments.back().data.finish_time - segments.front().data.finish_time;
+  return size() < 2?
+        Duration(0) : _pimpl->cached_finish_time - _pimpl->cached_start_time;
 }
 
 //==============================================================================
 std::size_t Trajectory::size() const
 {
-  return _pimpl->segments.size();
+  return _pimpl->times.get().size();
 }
 
 //==============================================================================
 template<typename SegT>
 SegT& Trajectory::base_iterator<SegT>::operator*() const
 {
-  return *_pimpl->raw_iterator->myself;
+  return _pimpl->parent->get_segment(_pimpl->id);
 }
 
 //==============================================================================
 template<typename SegT>
 SegT* Trajectory::base_iterator<SegT>::operator->() const
 {
-  return _pimpl->raw_iterator->myself.get();
+  return &_pimpl->parent->get_segment(_pimpl->id);
 }
 
 //==============================================================================
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator++() -> base_iterator&
 {
-  ++_pimpl->raw_iterator;
+  _pimpl->increment();
   return *this;
 }
 
@@ -770,7 +1414,7 @@ auto Trajectory::base_iterator<SegT>::operator++() -> base_iterator&
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator--() -> base_iterator&
 {
-  --_pimpl->raw_iterator;
+  _pimpl->decrement();
   return *this;
 }
 
@@ -778,95 +1422,54 @@ auto Trajectory::base_iterator<SegT>::operator--() -> base_iterator&
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator++(int) -> base_iterator
 {
-  return _pimpl->post_increment<SegT>();
+  return _pimpl->template post_increment<SegT>();
 }
 
 //==============================================================================
 template<typename SegT>
 auto Trajectory::base_iterator<SegT>::operator--(int) -> base_iterator
 {
-  return _pimpl->post_decrement<SegT>();
+  return _pimpl->template post_decrement<SegT>();
 }
 
 //==============================================================================
-#define DEFINE_BASIC_ITERATOR_OP(op) \
-  template<typename SegT> \
-  bool Trajectory::base_iterator<SegT>::operator op ( \
-      const base_iterator& other) const \
-  { \
-    return _pimpl->raw_iterator op other._pimpl->raw_iterator; \
-  }
-
-DEFINE_BASIC_ITERATOR_OP(==)
-DEFINE_BASIC_ITERATOR_OP(!=)
-
 template<typename SegT>
-bool Trajectory::base_iterator<SegT>::operator<(
+bool Trajectory::base_iterator<SegT>::operator==(
     const base_iterator& other) const
 {
-  const bool this_is_end =
-      this->_pimpl->raw_iterator == _pimpl->parent->segments.end();
-  const bool other_is_end =
-      other._pimpl->raw_iterator == _pimpl->parent->segments.end();
-
-  if(this_is_end || other_is_end)
-  {
-    // If the other is the end iterator but this iterator is not, then we return
-    // true, because the end iterator is "larger" than any valid iterator.
-    // If the other is not the end iterator but this iterator is, then we return
-    // false, because this iterator is definitely larger than anything the other
-    // can be.
-    return other_is_end && !this_is_end;
-  }
-
-  // If they are both valid iterators, then we can compare their times.
-  return this->_pimpl->raw_iterator->data.finish_time
-      < other._pimpl->raw_iterator->data.finish_time;
+  return _pimpl->id == other._pimpl->id
+      && _pimpl->parent == other._pimpl->parent;
 }
 
 //==============================================================================
 template<typename SegT>
-bool Trajectory::base_iterator<SegT>::operator>(
+bool Trajectory::base_iterator<SegT>::operator!=(
     const base_iterator& other) const
 {
-  const bool this_is_end =
-      this->_pimpl->raw_iterator == _pimpl->parent->segments.end();
-  const bool other_is_end =
-      other._pimpl->raw_iterator == _pimpl->parent->segments.end();
-
-  if(this_is_end || other_is_end)
-  {
-    // See the logic above for operator<, but in this case we want the opposite
-    // conclusion.
-    return this_is_end && !other_is_end;
-  }
-
-  // If they are both valid iterators, then we can compare their times.
-  return this->_pimpl->raw_iterator->data.finish_time
-      > other._pimpl->raw_iterator->data.finish_time;
+  return !(*this == other);
 }
 
 //==============================================================================
-template<typename SegT>
-bool Trajectory::base_iterator<SegT>::operator<=(
-    const base_iterator& other) const
-{
-  return (*this == other) || (*this < other);
-}
+// The end() iterator has an index equal to the size of the Trajectory, so it is
+// "larger" than any valid iterator.
+#define DEFINE_ORDERING_ITERATOR_OP(op) \
+  template<typename SegT> \
+  bool Trajectory::base_iterator<SegT>::operator op ( \
+      const base_iterator& other) const \
+  { \
+    return _pimpl->index() op other._pimpl->index(); \
+  }
 
-//==============================================================================
-template<typename SegT>
-bool Trajectory::base_iterator<SegT>::operator>=(
-    const base_iterator& other) const
-{
-  return (*this == other) || (*this > other);
-}
+DEFINE_ORDERING_ITERATOR_OP(<)
+DEFINE_ORDERING_ITERATOR_OP(>)
+DEFINE_ORDERING_ITERATOR_OP(<=)
+DEFINE_ORDERING_ITERATOR_OP(>=)
 
 //==============================================================================
 template<typename SegT>
 Trajectory::base_iterator<SegT>::operator const_iterator() const
 {
-  return _pimpl->make_iterator<const SegT>(_pimpl->raw_iterator);
+  return _pimpl->template make_iterator<const SegT>(_pimpl->id);
 }
 
 //==============================================================================
@@ -887,56 +1490,51 @@ bool Trajectory::Debug::check_iterator_time_consistency(
 {
   assert(trajectory._pimpl);
 
-  const internal::SegmentList& segments = trajectory._pimpl->segments;
-  const internal::OrderMap& ordering = trajectory._pimpl->ordering;
+  const Implementation& impl = *trajectory._pimpl;
+  const std::vector<Time>& times = impl.times.get();
+  const std::vector<std::size_t>& profile_indices = impl.profile_indices.get();
+  const Implementation::IdTable& table = impl.id_table.get();
+  const std::size_t N = times.size();
 
   bool consistent = true;
+  consistent &= impl.positions.get().size() == N;
+  consistent &= impl.velocities.get().size() == N;
+  consistent &= profile_indices.size() == N;
+  consistent &= table.ids.size() == N;
 
-  internal::SegmentList::const_iterator s_it = segments.begin();
-  internal::OrderMap::const_iterator o_it = ordering.begin();
-  for( ; s_it != segments.end() && o_it != ordering.end(); ++s_it, ++o_it)
+  for(std::size_t i=0; consistent && i < impl.shifts.size(); ++i)
   {
-    consistent &= s_it->data.finish_time == o_it->first;
+    consistent &= impl.shifts[i].first < N;
+    if(i > 0)
+      consistent &= impl.shifts[i-1].first < impl.shifts[i].first;
   }
 
-  consistent &= s_it == segments.end();
-  consistent &= o_it == ordering.end();
+  if(consistent && N > 0)
+  {
+    consistent &= impl.cached_start_time == impl.time(0);
+    consistent &= impl.cached_finish_time == impl.time(N-1);
+  }
+
+  for(std::size_t i=0; consistent && i < N; ++i)
+  {
+    consistent &= table.indices[table.ids[i]] == i;
+    consistent &= profile_indices[i] < impl.profiles.get().size();
+    if(i > 0)
+      consistent &= impl.time(i-1) < impl.time(i);
+  }
 
   if(print_inconsistency && !consistent)
   {
-    std::size_t index = 0;
-    s_it = segments.begin();
-    o_it = ordering.begin();
     std::cout << "Trajectory time inconsistency detected: "
-              << "( ordering | segments | difference )\n";
-    for( ; s_it != segments.end() && o_it != ordering.end();
-         ++s_it, ++o_it, ++index)
-    {
-      const auto difference = o_it->first - s_it->data.finish_time;
-      std::cout << " -- [" << index << "] "
-                << o_it->first.time_since_epoch().count()/1e9 << " | "
-                << s_it->data.finish_time.time_since_epoch().count()/1e9
-                << " | Difference: " << difference.count()/1e9 << "\n";
-    }
-
-    if(s_it != segments.end())
-    {
-      std::cout << " -- more elements in segments\n";
-      for( ; s_it != segments.end(); ++s_it, ++index)
-      {
-        std::cout << "      -- [" << index << "] "
-                  << s_it->data.finish_time.time_since_epoch().count()/1e9
-                  << "\n";
-      }
-    }
-    if(o_it != ordering.end())
+              << "( id | index | time )\n";
+    for(std::size_t i=0; i < table.ids.size(); ++i)
     {
-      std::cout << " -- more elements in ordering:\n";
-      for( ; o_it != ordering.end(); ++o_it, ++index)
-      {
-        std::cout << "     -- [" << index << "] "
-                  << o_it->first.time_since_epoch().count()/1e9 << "\n";
-      }
+      const std::size_t id = table.ids[i];
+      std::cout << " -- [" << i << "] " << id << " | "
+                << (id < table.indices.size()? table.indices[id] : id) << " | ";
+      if(i < times.size())
+        std::cout << impl.time(i).time_since_epoch().count()/1e9;
+      std::cout << "\n";
     }
     std::cout << std::endl;
   }
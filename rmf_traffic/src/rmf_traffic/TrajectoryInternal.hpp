@@ -20,58 +20,216 @@
 
 #include <rmf_traffic/Trajectory.hpp>
 
-#include <list>
-#include <map>
+#include <array>
+#include <limits>
+#include <vector>
 
 namespace rmf_traffic {
 namespace internal {
 
 //==============================================================================
-struct SegmentElement;
-using SegmentList = std::list<SegmentElement>;
-using OrderMap = std::map<Time, SegmentList::iterator>;
+/// The information that describes the end of a single Trajectory Segment
+struct SegmentData
+{
+  Time finish_time;
+  Eigen::Vector3d position;
+  Eigen::Vector3d velocity;
+};
+
+//==============================================================================
+/// The cubic spline that leads up to a single Trajectory Segment. These do not
+/// depend on when the spline starts, so they stay valid when the whole spline
+/// is shifted in time.
+struct SplineCoefficients
+{
+  /// The coefficients for each dimension over a scaled "time" range of [0, 1],
+  /// in increasing order of degree.
+  std::array<Eigen::Vector4d, 3> coeffs;
+
+  /// The duration of the spline in seconds.
+  double delta_t;
 
-struct SegmentElement
+  /// The lower and upper corners of the x-y positions that the spline passes
+  /// through.
+  std::array<Eigen::Vector2d, 2> bounds;
+};
+
+//==============================================================================
+/// Compute the spline that goes from the end of one segment to the end of the
+/// next segment. This is implemented in Spline.cpp.
+SplineCoefficients compute_spline_coefficients(
+    const SegmentData& start,
+    const SegmentData& finish);
+
+//==============================================================================
+/// A bounding volume hierarchy over the splines of a Trajectory. Each node
+/// covers a contiguous range of splines and holds the span of time and the x-y
+/// box that the Trajectory's shapes sweep through over that range. A query only
+/// descends into the nodes that overlap it in both time and space, so finding
+/// the splines near a short stretch of time costs O(log N) instead of O(N).
+class SplineTree
 {
-  struct Data
+public:
+
+  struct Node
   {
-    Time finish_time;
-    Trajectory::ConstProfilePtr profile;
-    Eigen::Vector3d position;
-    Eigen::Vector3d velocity;
+    Time start;
+    Time finish;
+    Eigen::Vector2d min;
+    Eigen::Vector2d max;
   };
 
-  Data data;
+  /// Build the tree. The leaf at index i describes the spline that leads up to
+  /// segment i+1 of the Trajectory. The leaves must be sorted by time.
+  void build(const std::vector<Node, Eigen::aligned_allocator<Node>>& leaves);
 
-  // We store a Trajectory::Segment in this struct so that we can always safely
-  // return a reference to a Trajectory::Segment object. As long as this
-  // SegmentData is alive, any Trajectory::Segment reference that refers to it
-  // will remain valid.
-  std::unique_ptr<Trajectory::Segment> myself;
+  /// Returns true if the tree has no leaves.
+  bool empty() const
+  {
+    return _nodes.empty();
+  }
 
-  SegmentElement(Data input_data)
-    : data(std::move(input_data))
+  /// Get the node that covers the whole Trajectory. The tree must not be
+  /// empty.
+  const Node& root() const
   {
-    // Do nothing
+    return _nodes.front();
   }
 
-  SegmentElement(const SegmentElement& other)
-    : data(other.data)
+  /// Pass the segment index of each spline that overlaps the given span of
+  /// time and box to the visitor, in order of time. The visitor returns false
+  /// to stop the search early.
+  ///
+  /// \return false if the visitor stopped the search, otherwise true.
+  template<typename Visitor>
+  bool visit(
+      const Time start,
+      const Time finish,
+      const Eigen::Vector2d& min,
+      const Eigen::Vector2d& max,
+      Visitor&& visitor) const
   {
-    // Do nothing
+    if (_nodes.empty())
+      return true;
+
+    const Node query{start, finish, min, max};
+    return _visit(query, 0, 0, _num_leaves, visitor);
   }
 
-  SegmentElement& operator=(const SegmentElement& other)
+private:
+
+  static bool _overlap(const Node& a, const Node& b)
   {
-    data = other.data;
-    return *this;
+    if (a.finish < b.start || b.finish < a.start)
+      return false;
+
+    for (int i=0; i < 2; ++i)
+    {
+      if (a.max[i] < b.min[i] || b.max[i] < a.min[i])
+        return false;
+    }
+
+    return true;
   }
 
-  SegmentElement(SegmentElement&&) = default;
-  SegmentElement& operator=(SegmentElement&&) = default;
+  // The nodes are stored in pre-order. A node that covers the leaves
+  // [lower, upper) has its left child right after it, and its right child
+  // after all 2*(middle - lower) - 1 nodes of the left subtree.
+  template<typename Visitor>
+  bool _visit(
+      const Node& query,
+      const std::size_t node,
+      const std::size_t lower,
+      const std::size_t upper,
+      Visitor& visitor) const
+  {
+    if (!_overlap(query, _nodes[node]))
+      return true;
+
+    if (upper - lower == 1)
+      return visitor(lower + 1);
+
+    const std::size_t middle = lower + (upper - lower)/2;
+    if (!_visit(query, node + 1, lower, middle, visitor))
+      return false;
+
+    return _visit(query, node + 2*(middle - lower), middle, upper, visitor);
+  }
+
+  std::size_t _build(
+      const std::vector<Node, Eigen::aligned_allocator<Node>>& leaves,
+      std::size_t lower,
+      std::size_t upper);
+
+  std::vector<Node, Eigen::aligned_allocator<Node>> _nodes;
+  std::size_t _num_leaves = 0;
 };
 
 } // namespace internal
+
+//==============================================================================
+namespace detail {
+class TrajectoryIteratorImplementation
+{
+public:
+
+  /// The ID that is given to the end() iterator of a Trajectory
+  static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+  // The ID of a segment never changes while the segment is in its Trajectory,
+  // even if other segments are inserted or erased around it.
+  std::size_t id = npos;
+  const Trajectory::Implementation* parent = nullptr;
+
+  template<typename SegT>
+  Trajectory::base_iterator<SegT> make_iterator(std::size_t id) const;
+
+  template<typename SegT>
+  Trajectory::base_iterator<SegT> post_increment();
+
+  template<typename SegT>
+  Trajectory::base_iterator<SegT> post_decrement();
+
+  /// Get the index of the segment within its Trajectory's storage. The end()
+  /// iterator has an index equal to the size of the Trajectory.
+  std::size_t index() const;
+
+  void increment();
+  void decrement();
+
+  /// Get the data of the segment that an iterator refers to
+  static internal::SegmentData data(const Trajectory::const_iterator& it);
+
+  /// Get the data of the segment that comes before the one that an iterator
+  /// refers to. The iterator must not refer to the first segment.
+  static internal::SegmentData preceding_data(
+      const Trajectory::const_iterator& it);
+
+  /// Get the spline that leads up to the segment that an iterator refers to.
+  /// The spline is computed the first time it is needed and then cached by the
+  /// Trajectory until the segment or the one before it is modified. The
+  /// iterator must not refer to the first segment.
+  static const internal::SplineCoefficients& spline(
+      const Trajectory::const_iterator& it);
+
+  /// Get the start and finish times of the spline that leads up to the segment
+  /// that an iterator refers to. The iterator must not refer to the first
+  /// segment.
+  static std::array<Time, 2> spline_time_range(
+      const Trajectory::const_iterator& it);
+
+  /// Get the bounding volume hierarchy over the splines of a Trajectory. The
+  /// tree is built the first time it is needed and then cached until the
+  /// Trajectory is modified. The boxes of the tree are inflated by the
+  /// characteristic length of each segment's shape.
+  static const internal::SplineTree& spline_tree(const Trajectory& trajectory);
+
+  /// Get an iterator to the segment at this index of a Trajectory.
+  static Trajectory::const_iterator iterator_at(
+      const Trajectory& trajectory, std::size_t index);
+
+};
+} // namespace detail
 } // namespace rmf_traffic
 
 #endif // SRC__RMF_TRAFFIC__TRAJECTORYINTERNAL_HPP
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+
+namespace rmf_traffic {
+namespace internal {
+
+//==============================================================================
+WorkerPool::WorkerPool(const std::size_t requested_workers)
+{
+  std::size_t num_workers = requested_workers;
+  if(num_workers == 0)
+    num_workers = std::max(1u, std::thread::hardware_concurrency());
+
+  _workers.reserve(num_workers);
+  for(std::size_t i=0; i < num_workers; ++i)
+    _workers.emplace_back([this]() { _work(); });
+}
+
+//==============================================================================
+std::size_t WorkerPool::num_workers() const
+{
+  return _workers.size();
+}
+
+//==============================================================================
+void WorkerPool::post(Job job)
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _jobs.push(std::move(job));
+  }
+  _cv.notify_one();
+}
+
+//==============================================================================
+WorkerPool& WorkerPool::shared()
+{
+  static WorkerPool pool;
+  return pool;
+}
+
+//==============================================================================
+WorkerPool::~WorkerPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+
+  for(auto& worker : _workers)
+    worker.join();
+}
+
+//==============================================================================
+void WorkerPool::_work()
+{
+  while(true)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cv.wait(lock, [&]() { return _stopping || !_jobs.empty(); });
+    if(_stopping)
+      return;
+
+    const Job job = std::move(_jobs.front());
+    _jobs.pop();
+    lock.unlock();
+
+    job();
+  }
+}
+
+} // namespace internal
+} // namespace rmf_traffic
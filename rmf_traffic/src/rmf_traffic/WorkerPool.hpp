@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__WORKERPOOL_HPP
+#define SRC__RMF_TRAFFIC__WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace rmf_traffic {
+namespace internal {
+
+//==============================================================================
+/// A fixed set of worker threads that run jobs from a shared queue. The
+/// threads are created once and reused for every job, so callers that need to
+/// split up work do not have to pay for creating threads each time.
+///
+/// When the pool is destroyed, it waits for the jobs that are currently running
+/// to finish. Jobs that have not started yet are dropped.
+class WorkerPool
+{
+public:
+
+  using Job = std::function<void()>;
+
+  /// Constructor
+  ///
+  /// \param[in] num_workers
+  ///   The number of worker threads. If this is zero, then the number of
+  ///   hardware threads will be used.
+  WorkerPool(std::size_t num_workers = 0);
+
+  /// Get the number of worker threads in this pool.
+  std::size_t num_workers() const;
+
+  /// Add a job to the queue. It will be run by the first worker that is free.
+  void post(Job job);
+
+  /// Get the pool that is shared by the whole process. It has one worker for
+  /// each hardware thread, and its workers are joined when the process exits.
+  static WorkerPool& shared();
+
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+private:
+
+  void _work();
+
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  std::queue<Job> _jobs;
+  bool _stopping = false;
+  std::vector<std::thread> _workers;
+
+};
+
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__WORKERPOOL_HPP
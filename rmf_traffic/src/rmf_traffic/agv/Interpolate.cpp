@@ -158,6 +158,20 @@ void interpolate_rotation(
     trajectory.insert(state.t, profile, p, v);
   }
 }
+
+//==============================================================================
+double compute_traversal_time(
+    const double distance,
+    const double v_nom,
+    const double a_nom)
+{
+  if(distance <= 0.0)
+    return 0.0;
+
+  const Time start_time = Time();
+  const States states = compute_traversal(start_time, distance, v_nom, a_nom);
+  return time::to_seconds(states.back().t - start_time);
+}
 } // namespace internal
 
 //==============================================================================
@@ -90,6 +90,15 @@ void interpolate_rotation(
     const Trajectory::ConstProfilePtr& profile,
     const double threshold);
 
+//==============================================================================
+/// Get the number of seconds it takes to travel a distance when starting and
+/// finishing at rest, using the same motion profile as interpolate_translation
+/// and interpolate_rotation.
+double compute_traversal_time(
+    const double distance,
+    const double v_nom,
+    const double a_nom);
+
 } // namespace internal
 } // namespace agv
 } // namespace rmf_traffic
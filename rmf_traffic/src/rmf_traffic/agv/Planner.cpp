@@ -117,6 +117,9 @@ public:
   Duration min_hold_time;
   const bool* interrupt_flag;
   std::unordered_set<schedule::Version> ignore_schedule_ids;
+  std::shared_ptr<const std::atomic_bool> cancel_flag = nullptr;
+  rmf_utils::optional<Time> deadline = rmf_utils::nullopt;
+  bool safe_interval_planning = false;
 
 };
 
@@ -178,6 +181,48 @@ const bool* Planner::Options::interrupt_flag() const
   return _pimpl->interrupt_flag;
 }
 
+//==============================================================================
+auto Planner::Options::cancel_flag(
+    std::shared_ptr<const std::atomic_bool> flag) -> Options&
+{
+  _pimpl->cancel_flag = std::move(flag);
+  return *this;
+}
+
+//==============================================================================
+const std::shared_ptr<const std::atomic_bool>&
+Planner::Options::cancel_flag() const
+{
+  return _pimpl->cancel_flag;
+}
+
+//==============================================================================
+auto Planner::Options::deadline(rmf_utils::optional<Time> deadline)
+-> Options&
+{
+  _pimpl->deadline = deadline;
+  return *this;
+}
+
+//==============================================================================
+const rmf_utils::optional<Time>& Planner::Options::deadline() const
+{
+  return _pimpl->deadline;
+}
+
+//==============================================================================
+auto Planner::Options::safe_interval_planning(const bool enable) -> Options&
+{
+  _pimpl->safe_interval_planning = enable;
+  return *this;
+}
+
+//==============================================================================
+bool Planner::Options::safe_interval_planning() const
+{
+  return _pimpl->safe_interval_planning;
+}
+
 //==============================================================================
 auto Planner::Options::ignore_schedule_ids(
     std::unordered_set<schedule::Version> ignore_ids) -> Options&
@@ -398,11 +443,63 @@ public:
     if (!result)
       return rmf_utils::nullopt;
 
+    return make(std::move(*result), std::move(cache_mgr));
+  }
+
+  static std::vector<rmf_utils::optional<Plan>> generate(
+      internal::planning::CacheManager cache_mgr,
+      const std::vector<Planner::Start>& starts,
+      std::vector<Planner::Goal> goals,
+      Planner::Options options,
+      const bool stop_at_first_goal)
+  {
+    auto results = cache_mgr.get().plan(
+          starts, std::move(goals), std::move(options), stop_at_first_goal);
+
+    std::vector<rmf_utils::optional<Plan>> plans;
+    plans.reserve(results.size());
+    for (auto& result : results)
+    {
+      if (!result)
+      {
+        plans.emplace_back(rmf_utils::nullopt);
+        continue;
+      }
+
+      plans.emplace_back(make(std::move(*result), cache_mgr));
+    }
+
+    return plans;
+  }
+
+  static rmf_utils::optional<Plan> generate_nearest(
+      internal::planning::CacheManager cache_mgr,
+      const std::vector<Planner::Start>& starts,
+      std::vector<Planner::Goal> goals,
+      Planner::Options options)
+  {
+    auto plans = generate(
+          std::move(cache_mgr), starts,
+          std::move(goals), std::move(options), true);
+
+    for (auto& plan : plans)
+    {
+      if (plan)
+        return std::move(plan);
+    }
+
+    return rmf_utils::nullopt;
+  }
+
+  static Plan make(
+      internal::planning::Result result,
+      internal::planning::CacheManager cache_mgr)
+  {
     Plan plan;
     plan._pimpl = rmf_utils::make_impl<Implementation>(
-          Implementation{std::move(*result), std::move(cache_mgr)});
+          Implementation{std::move(result), std::move(cache_mgr)});
 
-    return std::move(plan);
+    return plan;
   }
 
 };
@@ -492,6 +589,58 @@ rmf_utils::optional<Plan> Planner::plan(
         std::move(options));
 }
 
+//==============================================================================
+std::vector<rmf_utils::optional<Plan>> Planner::plan(
+    const StartSet& starts,
+    GoalSet goals) const
+{
+  return Plan::Implementation::generate(
+        _pimpl->cache_mgr,
+        starts,
+        std::move(goals),
+        _pimpl->default_options,
+        false);
+}
+
+//==============================================================================
+std::vector<rmf_utils::optional<Plan>> Planner::plan(
+    const StartSet& starts,
+    GoalSet goals,
+    Options options) const
+{
+  return Plan::Implementation::generate(
+        _pimpl->cache_mgr,
+        starts,
+        std::move(goals),
+        std::move(options),
+        false);
+}
+
+//==============================================================================
+rmf_utils::optional<Plan> Planner::plan_to_nearest(
+    const StartSet& starts,
+    GoalSet goals) const
+{
+  return Plan::Implementation::generate_nearest(
+        _pimpl->cache_mgr,
+        starts,
+        std::move(goals),
+        _pimpl->default_options);
+}
+
+//==============================================================================
+rmf_utils::optional<Plan> Planner::plan_to_nearest(
+    const StartSet& starts,
+    GoalSet goals,
+    Options options) const
+{
+  return Plan::Implementation::generate_nearest(
+        _pimpl->cache_mgr,
+        starts,
+        std::move(goals),
+        std::move(options));
+}
+
 //==============================================================================
 const Eigen::Vector3d& Plan::Waypoint::position() const
 {
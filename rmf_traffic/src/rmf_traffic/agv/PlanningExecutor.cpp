@@ -0,0 +1,306 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/agv/PlanningExecutor.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace rmf_traffic {
+namespace agv {
+
+//==============================================================================
+class PlanningExecutor::CancellationToken::Implementation
+{
+public:
+
+  // This is shared between every copy of the token
+  std::shared_ptr<std::atomic_bool> flag;
+
+  rmf_utils::optional<Time> deadline;
+
+  // This is counted from the moment that each job starts running
+  rmf_utils::optional<Duration> time_limit;
+
+};
+
+//==============================================================================
+PlanningExecutor::CancellationToken::CancellationToken(
+    rmf_utils::optional<Time> deadline,
+    rmf_utils::optional<Duration> time_limit)
+  : _pimpl(rmf_utils::make_impl<Implementation>(
+             Implementation{
+               std::make_shared<std::atomic_bool>(false),
+               deadline,
+               time_limit
+             }))
+{
+  // Do nothing
+}
+
+//==============================================================================
+void PlanningExecutor::CancellationToken::cancel() const
+{
+  _pimpl->flag->store(true);
+}
+
+//==============================================================================
+bool PlanningExecutor::CancellationToken::cancelled() const
+{
+  if (_pimpl->flag->load())
+    return true;
+
+  const auto& deadline = _pimpl->deadline;
+  return deadline && *deadline <= std::chrono::steady_clock::now();
+}
+
+//==============================================================================
+const rmf_utils::optional<Time>&
+PlanningExecutor::CancellationToken::deadline() const
+{
+  return _pimpl->deadline;
+}
+
+//==============================================================================
+const rmf_utils::optional<Duration>&
+PlanningExecutor::CancellationToken::time_limit() const
+{
+  return _pimpl->time_limit;
+}
+
+//==============================================================================
+Planner::Options& PlanningExecutor::CancellationToken::apply(
+    Planner::Options& options) const
+{
+  return options.cancel_flag(_pimpl->flag).deadline(_pimpl->deadline);
+}
+
+//==============================================================================
+class PlanningExecutor::Implementation
+{
+public:
+
+  struct Job
+  {
+    Priority priority;
+
+    // Jobs with the same priority are started in the order of this counter
+    uint64_t sequence;
+
+    CancellationToken token;
+
+    // Runs the planner and fulfills the promise of the job
+    std::function<void()> run;
+
+    // Fulfills the promise of the job without running the planner
+    std::function<void()> skip;
+  };
+
+  struct CompareJobs
+  {
+    // std::priority_queue puts the greatest element on top, so a job is "less"
+    // than another job if it should be started after it.
+    bool operator()(const Job& a, const Job& b) const
+    {
+      if (a.priority != b.priority)
+        return a.priority < b.priority;
+
+      return a.sequence > b.sequence;
+    }
+  };
+
+  using JobQueue = std::priority_queue<Job, std::vector<Job>, CompareJobs>;
+
+  Implementation(const std::size_t requested_workers)
+  {
+    std::size_t num_workers = requested_workers;
+    if (num_workers == 0)
+      num_workers = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(num_workers);
+    for (std::size_t i=0; i < num_workers; ++i)
+      workers.emplace_back([this]() { work(); });
+  }
+
+  ~Implementation()
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    cv.notify_all();
+
+    for (auto& worker : workers)
+      worker.join();
+
+    // Any jobs that never started get resolved with a nullopt so that nobody
+    // is left waiting on a broken promise.
+    while (!jobs.empty())
+    {
+      jobs.top().skip();
+      jobs.pop();
+    }
+  }
+
+  void work()
+  {
+    while (true)
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&]() { return stopping || !jobs.empty(); });
+      if (stopping)
+        return;
+
+      const Job job = jobs.top();
+      jobs.pop();
+      lock.unlock();
+
+      if (job.token.cancelled())
+        job.skip();
+      else
+        job.run();
+    }
+  }
+
+  template<typename Search>
+  PlanFuture submit(
+      Search search,
+      Planner::Options options,
+      CancellationToken token,
+      const Priority priority)
+  {
+    token.apply(options);
+
+    using Promise = std::promise<rmf_utils::optional<Plan>>;
+    const auto promise = std::make_shared<Promise>();
+    PlanFuture future = promise->get_future();
+
+    const auto time_limit = token.time_limit();
+
+    Job job{
+      priority,
+      0,
+      std::move(token),
+      [promise, search, options, time_limit]()
+      {
+        // Exceptions from the planner are passed along to whoever is waiting
+        // on the future instead of terminating the worker thread.
+        try
+        {
+          if (!time_limit)
+            return promise->set_value(search(options));
+
+          // The time limit only starts counting once the job begins to run
+          const Time limit_deadline =
+              std::chrono::steady_clock::now() + *time_limit;
+
+          Planner::Options limited_options = options;
+          const auto& deadline = options.deadline();
+          if (!deadline || limit_deadline < *deadline)
+            limited_options.deadline(limit_deadline);
+
+          promise->set_value(search(limited_options));
+        }
+        catch (...)
+        {
+          promise->set_exception(std::current_exception());
+        }
+      },
+      [promise]()
+      {
+        promise->set_value(rmf_utils::nullopt);
+      }
+    };
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      job.sequence = next_sequence++;
+      jobs.push(std::move(job));
+    }
+    cv.notify_one();
+
+    return future;
+  }
+
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  JobQueue jobs;
+  uint64_t next_sequence = 0;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+
+};
+
+//==============================================================================
+PlanningExecutor::PlanningExecutor(const std::size_t num_workers)
+  : _pimpl(rmf_utils::make_unique_impl<Implementation>(num_workers))
+{
+  // Do nothing
+}
+
+//==============================================================================
+std::size_t PlanningExecutor::num_workers() const
+{
+  return _pimpl->workers.size();
+}
+
+//==============================================================================
+std::size_t PlanningExecutor::num_pending() const
+{
+  std::unique_lock<std::mutex> lock(_pimpl->mutex);
+  return _pimpl->jobs.size();
+}
+
+//==============================================================================
+auto PlanningExecutor::plan(
+    const Planner& planner,
+    Planner::StartSet starts,
+    Planner::Goal goal,
+    Planner::Options options,
+    CancellationToken token,
+    const Priority priority) -> PlanFuture
+{
+  return _pimpl->submit(
+        [planner, starts, goal](const Planner::Options& options)
+  {
+    return planner.plan(starts, goal, options);
+  }, std::move(options), std::move(token), priority);
+}
+
+//==============================================================================
+auto PlanningExecutor::plan_to_nearest(
+    const Planner& planner,
+    Planner::StartSet starts,
+    Planner::GoalSet goals,
+    Planner::Options options,
+    CancellationToken token,
+    const Priority priority) -> PlanFuture
+{
+  return _pimpl->submit(
+        [planner, starts, goals](const Planner::Options& options)
+  {
+    return planner.plan_to_nearest(starts, goals, options);
+  }, std::move(options), std::move(token), priority);
+}
+
+} // namespace agv
+} // namespace rmf_traffic
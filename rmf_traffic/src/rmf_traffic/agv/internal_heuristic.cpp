@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "internal_heuristic.hpp"
+
+#include <rmf_utils/math.hpp>
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+namespace {
+//==============================================================================
+double event_cost(const agv::Graph::Lane& lane)
+{
+  double cost = 0.0;
+  if(const auto* event = lane.entry().event())
+    cost += time::to_seconds(event->duration());
+
+  if(const auto* event = lane.exit().event())
+    cost += time::to_seconds(event->duration());
+
+  return cost;
+}
+} // anonymous namespace
+
+//==============================================================================
+HeuristicTableBuilder::HeuristicTableBuilder(
+    const agv::Graph::Implementation& graph,
+    const agv::VehicleTraits& traits,
+    const agv::Interpolate::Options::Implementation& interpolate)
+: _lanes_from(graph.lanes_from),
+  _lanes_into(graph.waypoints.size()),
+  _continues_into(graph.lanes.size()),
+  _rotational_velocity(traits.rotational().get_nominal_velocity()),
+  _rotational_acceleration(traits.rotational().get_nominal_acceleration()),
+  _rotation_thresh(interpolate.rotation_thresh),
+  _reversible(
+    !traits.get_differential() || traits.get_differential()->is_reversible())
+{
+  const double v_nom = traits.linear().get_nominal_velocity();
+  const double a_nom = traits.linear().get_nominal_acceleration();
+
+  _lanes.reserve(graph.lanes.size());
+  for(std::size_t l=0; l < graph.lanes.size(); ++l)
+  {
+    const agv::Graph::Lane& lane = graph.lanes[l];
+    const std::size_t entry = lane.entry().waypoint_index();
+    const std::size_t exit = lane.exit().waypoint_index();
+    const Eigen::Vector2d course =
+        graph.waypoints[exit].get_location()
+        - graph.waypoints[entry].get_location();
+
+    const double distance = course.norm();
+    const double events = event_cost(lane);
+
+    LaneInfo info{entry, exit, events, events, rmf_utils::nullopt};
+    if(distance >= interpolate.translation_thresh)
+    {
+      info.stop_cost += agv::internal::compute_traversal_time(
+            distance, v_nom, a_nom);
+      info.move_cost += distance/v_nom;
+      info.heading = std::atan2(course[1], course[0]);
+    }
+
+    _lanes.emplace_back(std::move(info));
+    _lanes_into[exit].push_back(l);
+  }
+
+  for(std::size_t l=0; l < graph.lanes.size(); ++l)
+  {
+    const agv::Graph::Lane& lane = graph.lanes[l];
+    if(lane.exit().event())
+      continue;
+
+    const Eigen::Vector2d& p_entry =
+        graph.waypoints[lane.entry().waypoint_index()].get_location();
+    const Eigen::Vector2d& p_exit =
+        graph.waypoints[lane.exit().waypoint_index()].get_location();
+
+    for(const std::size_t next : graph.lanes_from[lane.exit().waypoint_index()])
+    {
+      const agv::Graph::Lane& next_lane = graph.lanes[next];
+      if(next_lane.entry().event())
+        continue;
+
+      const Eigen::Vector2d& p_next =
+          graph.waypoints[next_lane.exit().waypoint_index()].get_location();
+
+      // The planner only lets a robot pass through a waypoint without stopping
+      // when the interpolation for that waypoint can be skipped.
+      if(agv::internal::can_skip_interpolation(
+           {p_entry[0], p_entry[1], 0.0},
+           {p_exit[0], p_exit[1], 0.0},
+           {p_next[0], p_next[1], 0.0},
+           interpolate))
+      {
+        _continues_into[next].push_back(l);
+      }
+    }
+  }
+}
+
+//==============================================================================
+auto HeuristicTableBuilder::build(const std::size_t goal) const -> Table
+{
+  // We search over two kinds of states for each lane:
+  // * [l]: The robot is at rest at the entry of lane l and about to go down it
+  // * [N + l]: The robot is moving through the entry of lane l without stopping
+  //
+  // The state [2N] means the robot has come to rest on the goal.
+  //
+  // The cost of a state is the least amount of time that it could take to
+  // reach the goal from that state.
+  const std::size_t N = _lanes.size();
+  const std::size_t goal_state = 2*N;
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> costs(2*N + 1, inf);
+
+  using QueueElement = std::pair<double, std::size_t>;
+  std::priority_queue<
+      QueueElement,
+      std::vector<QueueElement>,
+      std::greater<QueueElement>> queue;
+
+  const auto relax = [&](const std::size_t state, const double cost)
+  {
+    if(cost < costs[state])
+    {
+      costs[state] = cost;
+      queue.push({cost, state});
+    }
+  };
+
+  // Relax the states that come right before the robot reaches the exit of lane
+  // l, given that the remaining cost after reaching the exit is known.
+  const auto relax_lane = [&](const std::size_t l, const double remaining)
+  {
+    const LaneInfo& lane = _lanes[l];
+    relax(l, lane.stop_cost + remaining);
+    relax(N + l, lane.move_cost + remaining);
+  };
+
+  costs[goal_state] = 0.0;
+  queue.push({0.0, goal_state});
+
+  while(!queue.empty())
+  {
+    const QueueElement top = queue.top();
+    queue.pop();
+
+    const double cost = top.first;
+    const std::size_t state = top.second;
+    if(costs[state] < cost)
+      continue;
+
+    if(state == goal_state)
+    {
+      for(const std::size_t l : _lanes_into[goal])
+        relax_lane(l, cost);
+    }
+    else if(state < N)
+    {
+      // The robot will come to rest at the entry of this lane, so the lane
+      // that leads into it may need to be followed by a rotation.
+      const LaneInfo& next = _lanes[state];
+      for(const std::size_t l : _lanes_into[next.entry])
+        relax_lane(l, rotation_cost(_lanes[l], next) + cost);
+    }
+    else
+    {
+      for(const std::size_t l : _continues_into[state - N])
+        relax_lane(l, cost);
+    }
+  }
+
+  Table table(_lanes_from.size(), inf);
+  for(std::size_t wp=0; wp < _lanes_from.size(); ++wp)
+  {
+    double& value = table[wp];
+    for(const std::size_t l : _lanes_from[wp])
+      value = std::min(value, costs[l]);
+  }
+
+  table[goal] = 0.0;
+
+  return table;
+}
+
+//==============================================================================
+std::size_t HeuristicTableBuilder::num_waypoints() const
+{
+  return _lanes_from.size();
+}
+
+//==============================================================================
+double HeuristicTableBuilder::rotation_cost(
+    const LaneInfo& from, const LaneInfo& to) const
+{
+  if(!from.heading || !to.heading)
+    return 0.0;
+
+  double angle = std::abs(rmf_utils::wrap_to_pi(*to.heading - *from.heading));
+  if(_reversible)
+    angle = std::min(angle, M_PI - angle);
+
+  if(angle < _rotation_thresh)
+    return 0.0;
+
+  return agv::internal::compute_traversal_time(
+        angle, _rotational_velocity, _rotational_acceleration);
+}
+
+//==============================================================================
+HeuristicTables::HeuristicTables(HeuristicTableBuilder builder)
+: _builder(std::move(builder)),
+  _tables(_builder.num_waypoints())
+{
+  for(auto& table : _tables)
+    table.store(nullptr, std::memory_order_relaxed);
+}
+
+//==============================================================================
+auto HeuristicTables::get(const std::size_t goal) -> const Table&
+{
+  std::atomic<const Table*>& slot = _tables.at(goal);
+  if(const Table* table = slot.load(std::memory_order_acquire))
+    return *table;
+
+  // If two threads race to build the same table, they will get identical
+  // results, so we keep whichever one gets published first.
+  std::unique_ptr<const Table> table(new Table(_builder.build(goal)));
+  const Table* expected = nullptr;
+  if(slot.compare_exchange_strong(
+       expected, table.get(), std::memory_order_acq_rel))
+    return *table.release();
+
+  return *expected;
+}
+
+//==============================================================================
+HeuristicTables::~HeuristicTables()
+{
+  for(auto& table : _tables)
+    delete table.load(std::memory_order_relaxed);
+}
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__AGV__INTERNAL_HEURISTIC_HPP
+#define SRC__RMF_TRAFFIC__AGV__INTERNAL_HEURISTIC_HPP
+
+#include "GraphInternal.hpp"
+#include "InterpolateInternal.hpp"
+
+#include <rmf_traffic/agv/VehicleTraits.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+/// Builds dense tables that give a lower bound on the time it takes to reach a
+/// goal waypoint from every other waypoint in a graph. Each table is built by
+/// running one Dijkstra search backwards from the goal along the lanes of the
+/// graph. The cost of each lane accounts for the time spent accelerating and
+/// decelerating, the time spent rotating between lanes, and the duration of
+/// any lane events.
+///
+/// The builder keeps its own copy of the graph information that it needs, so
+/// it can be used from a background thread even after the planner that created
+/// it is gone.
+class HeuristicTableBuilder
+{
+public:
+
+  using Table = std::vector<double>;
+
+  HeuristicTableBuilder(
+      const agv::Graph::Implementation& graph,
+      const agv::VehicleTraits& traits,
+      const agv::Interpolate::Options::Implementation& interpolate);
+
+  /// Build the table for a goal waypoint. The table is indexed by waypoint.
+  /// Waypoints that cannot reach the goal will have a value of infinity.
+  Table build(std::size_t goal) const;
+
+  /// The number of waypoints in the graph that this builder was made from
+  std::size_t num_waypoints() const;
+
+private:
+
+  struct LaneInfo
+  {
+    std::size_t entry;
+    std::size_t exit;
+
+    // Seconds to traverse the lane when starting and finishing at rest
+    double stop_cost;
+
+    // Seconds to traverse the lane when already moving at the nominal speed
+    double move_cost;
+
+    // Direction of travel along the lane, or nullopt if the lane has no length
+    rmf_utils::optional<double> heading;
+  };
+
+  double rotation_cost(const LaneInfo& from, const LaneInfo& to) const;
+
+  std::vector<LaneInfo> _lanes;
+
+  // The lanes that exit from and arrive at each waypoint
+  std::vector<std::vector<std::size_t>> _lanes_from;
+  std::vector<std::vector<std::size_t>> _lanes_into;
+
+  // For each lane, the lanes that can lead into it without the robot needing
+  // to stop in between them
+  std::vector<std::vector<std::size_t>> _continues_into;
+
+  double _rotational_velocity;
+  double _rotational_acceleration;
+  double _rotation_thresh;
+  bool _reversible;
+};
+
+//==============================================================================
+/// A collection of heuristic tables for every goal in a graph that can be
+/// shared by any number of planning threads without locking. Each table is
+/// only built the first time that a plan asks for its goal, so graphs with
+/// many waypoints do not pay for tables that never get used. A table is
+/// published with an atomic pointer once it is built, and it is never modified
+/// or removed after that, so a reference to a table stays valid for as long as
+/// the HeuristicTables object is alive.
+class HeuristicTables
+{
+public:
+
+  using Table = HeuristicTableBuilder::Table;
+
+  HeuristicTables(HeuristicTableBuilder builder);
+
+  /// Get the table for a goal waypoint. If the table has not been built yet,
+  /// it will be built by the calling thread.
+  const Table& get(std::size_t goal);
+
+  ~HeuristicTables();
+
+  // Copying or moving would invalidate the references that have been given out
+  HeuristicTables(const HeuristicTables&) = delete;
+  HeuristicTables& operator=(const HeuristicTables&) = delete;
+
+private:
+  HeuristicTableBuilder _builder;
+  std::vector<std::atomic<const Table*>> _tables;
+};
+
+using HeuristicTablesPtr = std::shared_ptr<HeuristicTables>;
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__AGV__INTERNAL_HEURISTIC_HPP
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "internal_obstacles.hpp"
+
+#include "../TrajectoryInternal.hpp"
+
+#include <rmf_traffic/schedule/Query.hpp>
+
+#include <algorithm>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+namespace {
+
+//==============================================================================
+BoundingBox get_trajectory_bounding_box(const Trajectory& trajectory)
+{
+  auto it = ++trajectory.begin();
+  BoundingBox box = get_bounding_box(it);
+  for (++it; it != trajectory.end(); ++it)
+  {
+    const BoundingBox segment_box = get_bounding_box(it);
+    box.min = box.min.cwiseMin(segment_box.min);
+    box.max = box.max.cwiseMax(segment_box.max);
+  }
+
+  return box;
+}
+
+//==============================================================================
+// The nodes are stored in pre-order. A node that covers the entries
+// [lower, upper) has its left child right after it, and its right child after
+// all 2*(middle - lower) - 1 nodes of the left subtree.
+Time build_latest_finish(
+    const Obstacles::Entries& entries,
+    std::vector<Time>& tree,
+    const std::size_t node,
+    const std::size_t lower,
+    const std::size_t upper)
+{
+  if (upper - lower == 1)
+    return tree[node] = entries[lower].finish;
+
+  const std::size_t middle = lower + (upper - lower)/2;
+  const Time left = build_latest_finish(entries, tree, node + 1, lower, middle);
+  const Time right = build_latest_finish(
+        entries, tree, node + 2*(middle - lower), middle, upper);
+
+  return tree[node] = std::max(left, right);
+}
+
+//==============================================================================
+/// Pass each entry whose timespan overlaps [start, finish] to the visitor.
+/// Since the entries are sorted by start time, a subtree can be skipped when
+/// its first entry starts after the finish, or when all of its entries finish
+/// before the start.
+template<typename Visitor>
+void visit_entries(
+    const Obstacles::Entries& entries,
+    const std::vector<Time>& latest_finish,
+    const Time start,
+    const Time finish,
+    const std::size_t node,
+    const std::size_t lower,
+    const std::size_t upper,
+    Visitor& visitor)
+{
+  if (latest_finish[node] < start || finish < entries[lower].start)
+    return;
+
+  if (upper - lower == 1)
+    return visitor(entries[lower]);
+
+  const std::size_t middle = lower + (upper - lower)/2;
+  visit_entries(
+        entries, latest_finish, start, finish,
+        node + 1, lower, middle, visitor);
+  visit_entries(
+        entries, latest_finish, start, finish,
+        node + 2*(middle - lower), middle, upper, visitor);
+}
+
+} // anonymous namespace
+
+//==============================================================================
+Obstacles::Obstacles(
+    const agv::Graph::Implementation& graph,
+    const schedule::Viewer& viewer,
+    const std::unordered_set<schedule::Version>& ignore_schedule_ids,
+    const Time start_time)
+{
+  std::vector<std::string> maps;
+  for (const auto& wp : graph.waypoints)
+  {
+    const std::string& map = wp.get_map_name();
+    if (std::find(maps.begin(), maps.end(), map) == maps.end())
+      maps.push_back(map);
+  }
+
+  const auto view = viewer.query(
+        schedule::make_query(std::move(maps), &start_time, nullptr));
+
+  for (const auto& element : view)
+  {
+    if (ignore_schedule_ids.count(element.id) > 0)
+      continue;
+
+    const Trajectory& trajectory = element.trajectory;
+    if (trajectory.size() < 2)
+      continue;
+
+    Entry entry{
+      trajectory,
+      *trajectory.start_time(),
+      *trajectory.finish_time(),
+      {}
+    };
+    entry.segments.reserve(trajectory.size() - 1);
+
+    auto previous = trajectory.begin();
+    for (auto it = ++trajectory.begin(); it != trajectory.end(); ++it)
+    {
+      entry.segments.push_back(
+            Segment{
+              previous->get_finish_time(),
+              it->get_finish_time(),
+              get_bounding_box(it)
+            });
+      previous = it;
+    }
+
+    _timelines[trajectory.get_map_name()].entries.emplace_back(
+          std::move(entry));
+  }
+
+  for (auto& map_timeline : _timelines)
+  {
+    Timeline& timeline = map_timeline.second;
+    Entries& entries = timeline.entries;
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b)
+    {
+      return a.start < b.start;
+    });
+
+    timeline.latest_finish.resize(2*entries.size() - 1);
+    build_latest_finish(
+          entries, timeline.latest_finish, 0, 0, entries.size());
+  }
+}
+
+//==============================================================================
+auto Obstacles::entries(const std::string& map) const -> const Entries&
+{
+  static const Entries empty_entries;
+  const auto it = _timelines.find(map);
+  if (it == _timelines.end())
+    return empty_entries;
+
+  return it->second.entries;
+}
+
+//==============================================================================
+bool Obstacles::is_free(const Trajectory& trajectory) const
+{
+  assert(trajectory.size() > 1);
+  const auto timeline_it = _timelines.find(trajectory.get_map_name());
+  if (timeline_it == _timelines.end())
+    return true;
+
+  const Timeline& timeline = timeline_it->second;
+  const Time start = *trajectory.start_time();
+  const Time finish = *trajectory.finish_time();
+  const BoundingBox box = get_trajectory_bounding_box(trajectory);
+
+  // Gather the splines of the obstacles that come close enough to need the
+  // exact check, so they can all be checked together against the trajectory.
+  std::vector<Trajectory::const_iterator> nearby;
+  auto gather = [&](const Entry& entry)
+  {
+    // The segments of an entry follow each other in time, so their finish
+    // times are sorted too.
+    const auto begin = entry.segments.begin();
+    auto segment = std::lower_bound(
+          begin, entry.segments.end(), start,
+          [](const Segment& s, const Time t)
+    {
+      return s.finish < t;
+    });
+
+    for (; segment != entry.segments.end(); ++segment)
+    {
+      if (finish < segment->start)
+        break;
+
+      if (!overlap(box, segment->box))
+        continue;
+
+      // Segment i of the entry is the spline that leads up to segment i+1 of
+      // its trajectory.
+      nearby.push_back(
+            detail::TrajectoryIteratorImplementation::iterator_at(
+              entry.trajectory, (segment - begin) + 1));
+    }
+  };
+
+  visit_entries(
+        timeline.entries, timeline.latest_finish, start, finish,
+        0, 0, timeline.entries.size(), gather);
+
+  if (nearby.empty())
+    return true;
+
+  return !detect_conflicts(trajectory, nearby);
+}
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__AGV__INTERNAL_OBSTACLES_HPP
+#define SRC__RMF_TRAFFIC__AGV__INTERNAL_OBSTACLES_HPP
+
+#include "GraphInternal.hpp"
+
+#include "../DetectConflictInternal.hpp"
+
+#include <rmf_traffic/schedule/Viewer.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+/// A snapshot of the schedule entries that a single planning attempt needs to
+/// avoid.
+///
+/// The schedule is queried once when this object is constructed. Each
+/// trajectory in the query result is stored with the timespan and bounding box
+/// of each of its segments, sorted by start time, so that candidate
+/// trajectories can be checked without querying the schedule again. The
+/// entries of each map are indexed by time, so only the entries that overlap a
+/// candidate trajectory in time get visited, and the exact conflict detection
+/// is only run against the segments whose timespan and bounding box overlap
+/// the candidate trajectory.
+class Obstacles
+{
+public:
+
+  struct Segment
+  {
+    Time start;
+    Time finish;
+    BoundingBox box;
+  };
+
+  struct Entry
+  {
+    Trajectory trajectory;
+    Time start;
+    Time finish;
+    std::vector<Segment> segments;
+  };
+
+  /// A list of entries sorted by their start times
+  using Entries = std::vector<Entry>;
+
+  /// Constructor
+  ///
+  /// \param[in] graph
+  ///   The graph that is being planned over. Only trajectories on the maps of
+  ///   this graph will be read from the schedule.
+  ///
+  /// \param[in] viewer
+  ///   The schedule to read obstacles from
+  ///
+  /// \param[in] ignore_schedule_ids
+  ///   Trajectories in the schedule with these IDs will not be obstacles
+  ///
+  /// \param[in] start_time
+  ///   Obstacles that finish before this time will be ignored
+  Obstacles(
+      const agv::Graph::Implementation& graph,
+      const schedule::Viewer& viewer,
+      const std::unordered_set<schedule::Version>& ignore_schedule_ids,
+      Time start_time);
+
+  /// Get the entries that are on a map
+  const Entries& entries(const std::string& map) const;
+
+  /// Returns true if the trajectory does not conflict with any of the
+  /// obstacles.
+  bool is_free(const Trajectory& trajectory) const;
+
+private:
+
+  /// The entries of a map along with their time index
+  struct Timeline
+  {
+    Entries entries;
+
+    /// A balanced binary tree over the entries, stored in pre-order in the
+    /// same layout as SplineTree. Each node holds the latest finish time of the
+    /// entries that it covers.
+    std::vector<Time> latest_finish;
+  };
+
+  std::unordered_map<std::string, Timeline> _timelines;
+};
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__AGV__INTERNAL_OBSTACLES_HPP
@@ -19,13 +19,19 @@
 #include "internal_Planner.hpp"
 #include "internal_planning.hpp"
 #include "GraphInternal.hpp"
+#include "internal_heuristic.hpp"
+#include "internal_obstacles.hpp"
+#include "internal_safe_intervals.hpp"
 
 #include <rmf_utils/math.hpp>
 
 #include <rmf_traffic/Conflict.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <queue>
 
@@ -49,37 +55,10 @@ struct Compare
 };
 
 //==============================================================================
-Cache::Cache(const Cache&)
-{
-  // Do nothing
-}
-
-//==============================================================================
-Cache::Cache(Cache&&)
-{
-  // Do nothing
-}
-
-//==============================================================================
-Cache& Cache::operator=(const Cache&)
-{
-  // Do nothing
-  return *this;
-}
-
-//==============================================================================
-Cache& Cache::operator=(Cache&&)
+CacheHandle::CacheHandle(CachePtr cache)
+  : _cache(std::move(cache))
 {
   // Do nothing
-  return *this;
-}
-
-//==============================================================================
-CacheHandle::CacheHandle(CachePtr original)
-  : _original(std::move(original))
-{
-  std::unique_lock<std::mutex> lock(_original->mutex);
-  _copy = _original->clone();
 }
 
 //==============================================================================
@@ -88,16 +67,21 @@ rmf_utils::optional<Result> CacheHandle::plan(
     agv::Planner::Goal goal,
     agv::Planner::Options options)
 {
-  return _copy->plan(starts, std::move(goal), std::move(options));
+  auto results = _cache->plan(
+        starts, {std::move(goal)}, std::move(options), true);
+
+  return std::move(results.front());
 }
 
 //==============================================================================
-CacheHandle::~CacheHandle()
+std::vector<rmf_utils::optional<Result>> CacheHandle::plan(
+    const std::vector<agv::Planner::Start>& starts,
+    std::vector<agv::Planner::Goal> goals,
+    agv::Planner::Options options,
+    const bool stop_at_first_goal)
 {
-  // We are now done with the copy, so we will update the original cache with
-  // whatever new searches have been accomplished by the copy.
-  std::unique_lock<std::mutex> lock(_original->mutex);
-  _original->update(*_copy);
+  return _cache->plan(
+        starts, std::move(goals), std::move(options), stop_at_first_goal);
 }
 
 //==============================================================================
@@ -119,6 +103,40 @@ const agv::Planner::Configuration& CacheManager::get_configuration() const
   return _cache->get_configuration();
 }
 
+//==============================================================================
+/// Checks every way that a planning attempt can be told to stop
+class Interrupter
+{
+public:
+
+  Interrupter(const agv::Planner::Options& options)
+  : _flag(options.interrupt_flag()),
+    _cancel_flag(options.cancel_flag()),
+    _deadline(options.deadline())
+  {
+    // Do nothing
+  }
+
+  bool operator()() const
+  {
+    if (_flag && *_flag)
+      return true;
+
+    if (_cancel_flag && _cancel_flag->load(std::memory_order_relaxed))
+      return true;
+
+    if (_deadline && *_deadline <= std::chrono::steady_clock::now())
+      return true;
+
+    return false;
+  }
+
+private:
+  const bool* _flag;
+  std::shared_ptr<const std::atomic_bool> _cancel_flag;
+  rmf_utils::optional<Time> _deadline;
+};
+
 //==============================================================================
 template<
     class Expander,
@@ -128,7 +146,8 @@ template<
 NodePtr search(
     Context&& context,
     InitialNodeArgs&& initial_node_args,
-    const bool* interrupt_flag)
+    const Interrupter& interrupted,
+    std::size_t& expanded_nodes)
 {
   using SearchQueue = typename Expander::SearchQueue;
 
@@ -137,7 +156,7 @@ NodePtr search(
   SearchQueue queue;
   expander.make_initial_nodes(initial_node_args, queue);
 
-  while(!queue.empty() && !(interrupt_flag && *interrupt_flag))
+  while(!queue.empty() && !interrupted())
   {
     NodePtr top = queue.top();
     queue.pop();
@@ -145,6 +164,7 @@ NodePtr search(
     if(expander.is_finished(top))
       return top;
 
+    ++expanded_nodes;
     expander.expand(top, queue);
   }
 
@@ -233,138 +253,6 @@ std::size_t find_start_index(const NodePtr& finish_node)
   return *node->start_set_index;
 }
 
-//==============================================================================
-struct EuclideanExpander
-{
-  // TODO(MXG): We should be able to improve the performance of this Euclidean
-  // search by making it two-sided (i.e. expanding from both the start and the
-  // goal at the same time).
-
-  // TODO(MXG): We can also make multi-floor planning more efficient by
-  // explicitly expanding to/from the LiftShaft bottlenecks.
-
-  struct Node;
-  using NodePtr = std::shared_ptr<Node>;
-
-  struct Node
-  {
-    std::size_t waypoint;
-    double remaining_cost_estimate;
-    double current_cost;
-    Eigen::Vector2d location;
-    NodePtr parent;
-  };
-
-  using SearchQueue =
-      std::priority_queue<NodePtr, std::vector<NodePtr>, Compare<NodePtr>>;
-
-  struct InitialNodeArgs
-  {
-    std::size_t waypoint;
-  };
-
-  struct Context
-  {
-    const agv::Graph::Implementation& graph;
-    const std::size_t final_waypoint;
-  };
-
-  double estimate_remaining_cost(const Eigen::Vector2d& p)
-  {
-    return (p_final - p).norm();
-  }
-
-  EuclideanExpander(const Context& context)
-  : context(context),
-    p_final(context.graph.waypoints[context.final_waypoint].get_location())
-  {
-    // Do nothing
-  }
-
-  void make_initial_nodes(const InitialNodeArgs& args, SearchQueue& queue)
-  {
-    const Eigen::Vector2d location =
-        context.graph.waypoints[args.waypoint].get_location();
-
-    queue.emplace(std::make_shared<Node>(
-          Node{
-            args.waypoint,
-            estimate_remaining_cost(location),
-            0.0,
-            location,
-            nullptr
-          }));
-  }
-
-  bool is_finished(const NodePtr& node)
-  {
-    return node->waypoint == context.final_waypoint;
-  }
-
-  static double lane_event_cost(const agv::Graph::Lane& lane)
-  {
-    double cost = 0.0;
-    if(const auto* event = lane.entry().event())
-      cost += time::to_seconds(event->duration());
-
-    if(const auto* event = lane.exit().event())
-      cost += time::to_seconds(event->duration());
-
-    return cost;
-  }
-
-  void expand_lane(
-      const NodePtr& parent_node,
-      const std::size_t lane_index,
-      SearchQueue& queue)
-  {
-    const agv::Graph::Lane& lane = context.graph.lanes[lane_index];
-    assert(lane.entry().waypoint_index() == parent_node->waypoint);
-    const std::size_t exit_waypoint_index = lane.exit().waypoint_index();
-    if(expanded.count(exit_waypoint_index) > 0)
-    {
-      // This waypoint has already been expanded from, so there's no point in
-      // expanding towards it again.
-      return;
-    }
-
-    const Eigen::Vector2d p_start = parent_node->location;
-    const Eigen::Vector2d p_exit =
-        context.graph.waypoints[exit_waypoint_index].get_location();
-
-    const double cost =
-        parent_node->current_cost
-        + lane_event_cost(lane)
-        + (p_exit - p_start).norm();
-
-    queue.push(std::make_shared<Node>(
-                 Node{
-                   exit_waypoint_index,
-                   estimate_remaining_cost(p_exit),
-                   cost,
-                   p_exit,
-                   parent_node
-                 }));
-  }
-
-  void expand(const NodePtr& parent_node, SearchQueue& queue)
-  {
-    const std::size_t parent_waypoint = parent_node->waypoint;
-    expanded.insert(parent_waypoint);
-
-    const std::vector<std::size_t>& lanes =
-        context.graph.lanes_from[parent_waypoint];
-
-    for(const std::size_t l : lanes)
-      expand_lane(parent_node, l, queue);
-  }
-
-private:
-  const Context& context;
-  Eigen::Vector2d p_final;
-  std::unordered_set<std::size_t> expanded;
-};
-
 //==============================================================================
 Eigen::Vector3d to_3d(const Eigen::Vector2d& p, const double w)
 {
@@ -541,65 +429,50 @@ struct DifferentialDriveExpander
   {
   public:
 
-    double estimate_remaining_cost(
-        const Context& context,
-        const std::size_t waypoint)
+    Heuristic(std::vector<const HeuristicTables::Table*> tables)
+    : _goal_tables(std::move(tables))
     {
-      auto estimate_it = known_costs.insert(
-          {waypoint, std::numeric_limits<double>::infinity()});
-
-      if(estimate_it.second)
+      assert(!_goal_tables.empty());
+      if(_goal_tables.size() == 1)
       {
-        // The pair was inserted, which implies that the cost estimate for this
-        // waypoint has never been found before, and we should compute it now.
-        const EuclideanExpander::NodePtr solution = search<EuclideanExpander>(
-              EuclideanExpander::Context{context.graph, context.final_waypoint},
-              EuclideanExpander::InitialNodeArgs{waypoint},
-              nullptr);
-
-        // TODO(MXG): Instead of asserting that the goal exists, we should
-        // probably take this opportunity to shortcircuit the planner and return
-        // that there is no solution.
-        assert(solution != nullptr);
-
-        std::vector<Eigen::Vector3d> positions;
-        EuclideanExpander::NodePtr euclidean_node = solution;
-        // Note: this constructs positions in reverse, but that's okay because
-        // the Interpolate::positions function will produce a trajectory with the
-        // same duration whether it is interpolating forward or backwards.
-        while(euclidean_node)
-        {
-          const Eigen::Vector2d p = euclidean_node->location;
-          positions.push_back({p[0], p[1], 0.0});
-          euclidean_node = euclidean_node->parent;
-        }
+        _table = _goal_tables.front();
+        return;
+      }
 
-        // We pass in context.initial_time here because we don't actually care
-        // about the Trajectory's start/end time being correct; we only care
-        // about the difference between the two.
-        const rmf_traffic::Trajectory estimate = agv::Interpolate::positions(
-              "", context.traits, context.initial_time, positions);
+      // When searching for several goals at once, the remaining cost from a
+      // waypoint is estimated by its distance to the nearest goal, which is
+      // still a lower bound on the distance to each individual goal.
+      _merged_table = *_goal_tables.front();
+      for(std::size_t i=1; i < _goal_tables.size(); ++i)
+      {
+        const HeuristicTables::Table& table = *_goal_tables[i];
+        for(std::size_t wp=0; wp < _merged_table.size(); ++wp)
+          _merged_table[wp] = std::min(_merged_table[wp], table[wp]);
+      }
 
-        const double cost_esimate = time::to_seconds(estimate.duration());
-        estimate_it.first->second = cost_esimate;
+      _table = &_merged_table;
+    }
 
-        // TODO(MXG): We could get significantly better performance if we
-        // accounted for the cost of rotating when making this estimate, but
-        // that would add considerable complexity to the caching, so we'll leave
-        // that for a future improvement.
-      }
+    // Copying would invalidate _table when it points to _merged_table
+    Heuristic(const Heuristic&) = delete;
+    Heuristic& operator=(const Heuristic&) = delete;
 
-      return estimate_it.first->second;
+    double estimate_remaining_cost(const std::size_t waypoint) const
+    {
+      return (*_table)[waypoint];
     }
 
-    void update(const Heuristic& other)
+    /// Returns true if there is any way to reach the goal with this index from
+    /// the waypoint.
+    bool can_reach(const std::size_t goal, const std::size_t waypoint) const
     {
-      for(const auto& wp_costs : other.known_costs)
-        known_costs.insert(wp_costs);
+      return std::isfinite((*_goal_tables[goal])[waypoint]);
     }
 
   private:
-    std::unordered_map<std::size_t, double> known_costs;
+    std::vector<const HeuristicTables::Table*> _goal_tables;
+    const HeuristicTables::Table* _table;
+    HeuristicTables::Table _merged_table;
   };
 
   struct Context
@@ -609,21 +482,27 @@ struct DifferentialDriveExpander
     const Trajectory::ConstProfilePtr& profile;
     const Duration holding_time;
     const agv::Interpolate::Options::Implementation& interpolate;
-    const schedule::Viewer& viewer;
-    const std::size_t final_waypoint;
-    const double* const final_orientation;
+    const Obstacles& obstacles;
+    const std::vector<agv::Planner::Goal>& goals;
+    const bool stop_at_first_goal;
     const rmf_traffic::Time initial_time;
-    const bool* const interrupt_flag;
-    const std::unordered_set<schedule::Version> ignore_schedule_ids;
-    Heuristic& heuristic;
+    const Heuristic& heuristic;
+
+    // The safe intervals of the schedule, or nullptr if Safe Interval Path
+    // Planning is turned off
+    SafeIntervals* const safe_intervals;
+
+    // The solution node for each goal, or nullptr for each goal that has not
+    // been reached yet
+    std::vector<NodePtr>& solutions;
   };
 
   DifferentialDriveExpander(Context& context)
   : _context(context),
-    _query(schedule::make_query({}, nullptr, nullptr)),
     _differential_constraint(
       _context.traits.get_differential()->get_forward(),
-      _context.traits.get_differential()->is_reversible())
+      _context.traits.get_differential()->is_reversible()),
+    _travel_durations(_context.graph.lanes.size())
   {
     // Do nothing
   }
@@ -638,15 +517,12 @@ struct DifferentialDriveExpander
       const std::size_t initial_waypoint = start.waypoint();
 
       const double cost_estimate =
-          _context.heuristic.estimate_remaining_cost(
-            _context, initial_waypoint);
+          _context.heuristic.estimate_remaining_cost(initial_waypoint);
 
       const double initial_orientation = start.orientation();
       const std::string& map_name =
           _context.graph.waypoints[initial_waypoint].get_map_name();
 
-      _query.spacetime().timespan()->add_map(map_name);
-
       const auto initial_time = start.time();
 
       const Eigen::Vector2d wp_location =
@@ -816,14 +692,14 @@ struct DifferentialDriveExpander
     }
   }
 
-  bool is_finished(const NodePtr& node) const
+  bool satisfies(const NodePtr& node, const agv::Planner::Goal& goal) const
   {
-    if(*node->waypoint != _context.final_waypoint)
+    if(*node->waypoint != goal.waypoint())
       return false;
 
-    if(_context.final_orientation)
+    if(const double* const goal_orientation = goal.orientation())
     {
-      if(std::abs(node->orientation - *_context.final_orientation)
+      if(std::abs(node->orientation - *goal_orientation)
          > _context.interpolate.rotation_thresh)
         return false;
     }
@@ -831,44 +707,84 @@ struct DifferentialDriveExpander
     return true;
   }
 
-  bool is_valid(const Trajectory& trajectory)
+  bool is_solution(const NodePtr& node) const
   {
-    assert(trajectory.size() > 1);
-    _query.spacetime().timespan()->set_lower_time_bound(
-          *trajectory.start_time());
-    _query.spacetime().timespan()->set_upper_time_bound(
-          *trajectory.finish_time());
+    for(std::size_t i=0; i < _context.goals.size(); ++i)
+    {
+      if(!_context.solutions[i] && satisfies(node, _context.goals[i]))
+        return true;
+    }
 
-    // TODO(MXG): When we start generating plans across multiple maps, we should
-    // account for the trajectory's map name(s) here.
-    const auto view = _context.viewer.query(_query);
+    return false;
+  }
 
-    const auto& ignore_schedule_ids = _context.ignore_schedule_ids;
-    if (ignore_schedule_ids.empty())
+  bool is_finished(const NodePtr& node)
+  {
+    bool found_solution = false;
+    for(std::size_t i=0; i < _context.goals.size(); ++i)
     {
-      for (const auto& check : view)
+      if(!_context.solutions[i] && satisfies(node, _context.goals[i]))
       {
-        assert(trajectory.size() > 1);
-        assert(check.trajectory.size() > 1);
-        if(!DetectConflict::between(trajectory, check.trajectory, true).empty())
-          return false;
+        _context.solutions[i] = node;
+        found_solution = true;
+        ++_num_solutions;
       }
     }
-    else
-    {
-      for (const auto& check : view)
-      {
-        assert(trajectory.size() > 1);
-        assert(check.trajectory.size() > 1);
-        if (ignore_schedule_ids.count(check.id) > 0)
-          continue;
 
-        if(!DetectConflict::between(trajectory, check.trajectory, true).empty())
-          return false;
-      }
+    if(!found_solution)
+      return false;
+
+    // Nodes get popped in order of cost, so the first solution found for each
+    // goal is the best one. We can stop once every goal has been reached.
+    return _context.stop_at_first_goal
+        || _num_solutions == _context.goals.size();
+  }
+
+  bool can_reach_unsolved_goal(const std::size_t waypoint) const
+  {
+    for(std::size_t i=0; i < _context.goals.size(); ++i)
+    {
+      if(!_context.solutions[i] && _context.heuristic.can_reach(i, waypoint))
+        return true;
     }
 
-    return true;
+    return false;
+  }
+
+  /// Get the safe intervals of a waypoint, or nullptr if Safe Interval Path
+  /// Planning is turned off.
+  const SafeIntervals::Intervals* safe_at_waypoint(const std::size_t waypoint)
+  {
+    if (!_context.safe_intervals)
+      return nullptr;
+
+    return &_context.safe_intervals->waypoint(waypoint);
+  }
+
+  /// Get the safe intervals of a lane, or nullptr if Safe Interval Path
+  /// Planning is turned off.
+  const SafeIntervals::Intervals* safe_along_lane(const std::size_t lane)
+  {
+    if (!_context.safe_intervals)
+      return nullptr;
+
+    return &_context.safe_intervals->lane(lane);
+  }
+
+  /// Check whether a trajectory is free of conflicts with the schedule. If the
+  /// trajectory fits inside one of the safe intervals, then we already know
+  /// that it is valid, and we can skip the conflict checks. Otherwise we check
+  /// it against the snapshot of the schedule that was taken for this plan.
+  bool is_valid(
+      const Trajectory& trajectory,
+      const SafeIntervals::Intervals* safe = nullptr)
+  {
+    assert(trajectory.size() > 1);
+    if (safe && SafeIntervals::covers(
+          *safe, *trajectory.start_time(), *trajectory.finish_time()))
+      return true;
+
+    return _context.obstacles.is_free(trajectory);
   }
 
   NodePtr expand_rotation(
@@ -896,11 +812,11 @@ struct DifferentialDriveExpander
           _context.profile,
           _context.interpolate.rotation_thresh);
 
-    if(is_valid(trajectory))
+    if(is_valid(trajectory, safe_at_waypoint(waypoint)))
     {
       return std::make_shared<Node>(
             Node{
-              _context.heuristic.estimate_remaining_cost(_context, waypoint),
+              _context.heuristic.estimate_remaining_cost(waypoint),
               compute_current_cost(parent_node, trajectory),
               waypoint,
               target_orientation,
@@ -986,14 +902,15 @@ struct DifferentialDriveExpander
       const double orientation,
       const NodePtr& parent_node,
       Trajectory trajectory,
-      agv::Graph::Lane::EventPtr event = nullptr)
+      agv::Graph::Lane::EventPtr event = nullptr,
+      const SafeIntervals::Intervals* safe = nullptr)
   {
     assert(trajectory.size() > 1);
-    if(is_valid(trajectory))
+    if(is_valid(trajectory, safe))
     {
       return std::make_shared<Node>(
             Node{
-              _context.heuristic.estimate_remaining_cost(_context, waypoint),
+              _context.heuristic.estimate_remaining_cost(waypoint),
               compute_current_cost(parent_node, trajectory),
               waypoint,
               orientation,
@@ -1012,21 +929,28 @@ struct DifferentialDriveExpander
       const NodePtr& parent_node,
       Trajectory trajectory,
       SearchQueue& queue,
-      agv::Graph::Lane::EventPtr event = nullptr)
+      agv::Graph::Lane::EventPtr event = nullptr,
+      const SafeIntervals::Intervals* safe = nullptr)
   {
     const auto node = make_if_valid(
           waypoint,
           orientation,
           parent_node,
           std::move(trajectory),
-          std::move(event));
+          std::move(event),
+          safe);
 
     if(node)
     {
       // TODO(MXG): Consider short-circuiting the rest of the search and
       // returning the solution if this Node solves the search problem. It could
       // be an optional behavior configurable from the Planner::Options.
-      queue.push(node);
+      if(!is_dominated(node))
+        queue.push(node);
+
+      // Note: We return true even if the node was dominated, because the
+      // trajectory was still valid, so it is okay to keep expanding further
+      // down the lane.
       return true;
     }
 
@@ -1102,15 +1026,20 @@ struct DifferentialDriveExpander
             _context.profile,
             _context.interpolate.translation_thresh);
 
+      // The safe intervals of a lane only describe that one lane, so we can
+      // only use them while the trajectory has not continued into other lanes.
+      const SafeIntervals::Intervals* const safe =
+          top.lane == initial_lane_index? safe_along_lane(top.lane) : nullptr;
+
       if (const auto* event = lane.exit().event())
       {
-        if(!is_valid(trajectory))
+        if(!is_valid(trajectory, safe))
           continue;
 
         auto parent_to_event = std::make_shared<Node>(
               Node{
                 _context.heuristic.estimate_remaining_cost(
-                    _context, exit_waypoint_index),
+                    exit_waypoint_index),
                 compute_current_cost(initial_parent, trajectory),
                 exit_waypoint_index,
                 orientation,
@@ -1128,7 +1057,7 @@ struct DifferentialDriveExpander
       // we may need to copy the trajectory later when we expand further down
       // other lanes.
       else if (!add_if_valid(exit_waypoint_index, orientation, initial_parent,
-                        trajectory, queue))
+                        trajectory, queue, nullptr, safe))
       {
         // This lane was not successfully added, so we should not try to expand
         // this any further.
@@ -1217,7 +1146,7 @@ struct DifferentialDriveExpander
 
     return make_if_valid(
           waypoint, initial_pos[2], parent_node,
-          std::move(trajectory), std::move(event));
+          std::move(trajectory), std::move(event), safe_at_waypoint(waypoint));
   }
 
   void expand_delay(
@@ -1230,7 +1159,7 @@ struct DifferentialDriveExpander
     const auto node = make_delay(
           waypoint, parent_node, delay, std::move(event));
 
-    if(node)
+    if(node && !is_dominated(node))
       queue.push(node);
   }
 
@@ -1242,12 +1171,159 @@ struct DifferentialDriveExpander
     expand_delay(waypoint, parent_node, _context.holding_time, queue);
   }
 
+  /// Get how long it takes to move down a lane, starting and finishing at rest
+  Duration get_travel_duration(const std::size_t lane_index)
+  {
+    rmf_utils::optional<Duration>& duration = _travel_durations[lane_index];
+    if (!duration)
+    {
+      const agv::Graph::Lane& lane = _context.graph.lanes[lane_index];
+      const Eigen::Vector2d& p0 = _context.graph.waypoints[
+          lane.entry().waypoint_index()].get_location();
+      const Eigen::Vector2d& p1 = _context.graph.waypoints[
+          lane.exit().waypoint_index()].get_location();
+
+      Trajectory trajectory{""};
+      trajectory.insert(
+            _context.initial_time, _context.profile,
+            to_3d(p0, 0.0), Eigen::Vector3d::Zero());
+
+      agv::internal::interpolate_translation(
+            trajectory,
+            _context.traits.linear().get_nominal_velocity(),
+            _context.traits.linear().get_nominal_acceleration(),
+            _context.initial_time,
+            to_3d(p0, 0.0),
+            to_3d(p1, 0.0),
+            _context.profile,
+            _context.interpolate.translation_thresh);
+
+      duration = trajectory.duration();
+    }
+
+    return *duration;
+  }
+
+  /// Instead of holding in increments of the minimum holding time, wait
+  /// exactly until a waypoint or lane that we can move into becomes safe. The
+  /// waits will never go past the end of the safe interval that the robot is
+  /// currently in, so they do not need to be checked against the schedule.
+  ///
+  /// The safe intervals are conservative, so the robot might really be able to
+  /// stay past the end of its current interval. To keep the search complete,
+  /// we also add one regular hold that reaches past the end of the interval.
+  /// From there the robot holds in increments of the minimum holding time
+  /// until it reaches another safe interval.
+  void expand_safe_waits(
+      const std::size_t waypoint,
+      const NodePtr& parent_node,
+      SearchQueue& queue)
+  {
+    SafeIntervals& safe_intervals = *_context.safe_intervals;
+    const Time arrival_time = get_arrival_time(parent_node);
+    const SafeIntervals::Interval* const current = SafeIntervals::find(
+          safe_intervals.waypoint(waypoint), arrival_time);
+
+    if (!current)
+    {
+      // The safe intervals are conservative, so they might not be able to
+      // confirm that this waypoint is safe even though the robot was able to
+      // reach it. We will fall back to the regular holding behavior.
+      expand_holding(waypoint, parent_node, queue);
+      return;
+    }
+
+    const Time latest_departure = current->finish;
+
+    std::vector<Time> departures;
+    const auto consider = [&](const Time departure)
+    {
+      if (arrival_time + ArrivalTolerance < departure
+          && departure <= latest_departure)
+        departures.push_back(departure);
+    };
+
+    for (const std::size_t l : _context.graph.lanes_from[waypoint])
+    {
+      const std::size_t exit_waypoint =
+          _context.graph.lanes[l].exit().waypoint_index();
+      const Duration travel_duration = get_travel_duration(l);
+
+      // Leave just in time to arrive as soon as the next waypoint is safe
+      for (const auto& interval : safe_intervals.waypoint(exit_waypoint))
+      {
+        if (interval.start <= arrival_time)
+          continue;
+
+        consider(interval.start - travel_duration);
+      }
+
+      // Leave as soon as the lane itself is safe
+      for (const auto& interval : safe_intervals.lane(l))
+      {
+        if (interval.start <= arrival_time)
+          continue;
+
+        consider(interval.start);
+      }
+    }
+
+    std::sort(departures.begin(), departures.end());
+    departures.erase(
+          std::unique(departures.begin(), departures.end(),
+                      [](const Time a, const Time b)
+    {
+      return b - a < ArrivalTolerance;
+    }), departures.end());
+
+    for (const Time departure : departures)
+      expand_delay(waypoint, parent_node, departure - arrival_time, queue);
+
+    if (latest_departure < Time::max())
+    {
+      // Hold until the first multiple of the holding time that comes after
+      // the end of the current interval. Holds that finish sooner would only
+      // reach states that this interval already covers.
+      const Duration holding_time = _context.holding_time;
+      const auto increments = (latest_departure - arrival_time)/holding_time;
+      expand_delay(
+            waypoint, parent_node, (increments + 1)*holding_time, queue);
+    }
+  }
+
   void expand(const NodePtr& parent_node, SearchQueue& queue)
   {
+    // The same state can get pushed into the queue through many different
+    // parents, so we check again before expanding, in case a node that reached
+    // this state more cheaply was expanded after this one was pushed.
+    if(is_dominated(parent_node))
+      return;
+
     const std::size_t parent_waypoint = *parent_node->waypoint;
-    if(parent_waypoint == _context.final_waypoint)
+
+    // When several goals are being searched for, a node might only lead to
+    // goals that have already been solved. Expanding it would only produce
+    // more nodes that can never finish the search, so we drop it. Once every
+    // node left in the queue is like this, the queue empties out and the
+    // search ends.
+    if(!can_reach_unsolved_goal(parent_waypoint))
+      return;
+
+    mark_visited(parent_node);
+
+    std::size_t remaining_goals = 0;
+    std::size_t final_nodes = 0;
+    for(std::size_t i=0; i < _context.goals.size(); ++i)
     {
-      if(!_context.final_orientation)
+      if(_context.solutions[i])
+        continue;
+
+      ++remaining_goals;
+      const agv::Planner::Goal& goal = _context.goals[i];
+      if(goal.waypoint() != parent_waypoint)
+        continue;
+
+      if(!goal.orientation())
       {
         // We have already arrived at the solution, because the user does not
         // care about the final orientation.
@@ -1258,24 +1334,29 @@ struct DifferentialDriveExpander
                   << "A bug has occurred. Please report this to the RMF "
                   << "developers." << std::endl;
         assert(false);
+        continue;
       }
 
       const double final_orientation =
-          rmf_utils::wrap_to_pi(*_context.final_orientation);
+          rmf_utils::wrap_to_pi(*goal.orientation());
       const auto final_node =
           expand_rotation(parent_node, final_orientation);
       if(final_node)
       {
         queue.push(final_node);
-        return;
+        ++final_nodes;
       }
+    }
 
-      // Note: If the rotation was not valid, then some other trajectory is
+    if(final_nodes > 0 && final_nodes == remaining_goals)
+    {
+      // Note: If a rotation was not valid, then some other trajectory is
       // blocking us from rotating, so we should keep expanding as usual.
-      // If the rotation was valid, then the node that was added is a solution
-      // node, so we should not expand anything else from this parent node.
-      // We should, however, continue to expand other nodes, because a more
-      // optimal solution could still exist.
+      // If the rotations for every remaining goal were valid, then the nodes
+      // that were added are solution nodes, so we should not expand anything
+      // else from this parent node. We should, however, continue to expand
+      // other nodes, because a more optimal solution could still exist.
+      return;
     }
 
     const std::vector<std::size_t>& lanes =
@@ -1285,18 +1366,179 @@ struct DifferentialDriveExpander
       expand_lane(parent_node, l, queue);
 
     if (_context.graph.waypoints[parent_waypoint].is_holding_point())
-      expand_holding(parent_waypoint, parent_node, queue);
+    {
+      if (_context.safe_intervals)
+        expand_safe_waits(parent_waypoint, parent_node, queue);
+      else
+        expand_holding(parent_waypoint, parent_node, queue);
+    }
   }
 
+  struct StateKey
+  {
+    std::size_t waypoint;
+    int64_t orientation_bin;
+
+    bool operator==(const StateKey& other) const
+    {
+      return waypoint == other.waypoint
+          && orientation_bin == other.orientation_bin;
+    }
+  };
+
+  struct StateKeyHash
+  {
+    std::size_t operator()(const StateKey& key) const
+    {
+      const std::size_t h = std::hash<std::size_t>()(key.waypoint);
+      return h ^ (std::hash<int64_t>()(key.orientation_bin)
+                  + 0x9e3779b9 + (h << 6) + (h >> 2));
+    }
+  };
+
+  StateKey get_key(const NodePtr& node) const
+  {
+    const double bin_size =
+        std::max(_context.interpolate.rotation_thresh, 1e-6);
+
+    return StateKey{
+      *node->waypoint,
+      static_cast<int64_t>(
+        std::floor(rmf_utils::wrap_to_pi(node->orientation)/bin_size))
+    };
+  }
+
+  static Time get_arrival_time(const NodePtr& node)
+  {
+    return node->trajectory_from_parent.back().get_finish_time();
+  }
+
+  /// A span of time that the robot is known to be able to occupy a state, and
+  /// the cost of occupying that state at the start of the span. The cost at any
+  /// later time in the span increases at a rate of one per second, just like
+  /// compute_current_cost().
+  struct Visit
+  {
+    Time start;
+    Time finish;
+    double start_cost;
+  };
+
+  /// Returns true if a node that has already been expanded reached the same
+  /// waypoint and orientation as this node, no later and at no higher cost.
+  ///
+  /// Because the schedule changes over time, arriving earlier does not
+  /// generally make a state better, since the robot might not be able to stay
+  /// at the waypoint until the later arrival time. So a node can only dominate
+  /// another node that arrives at the same time, unless a hold that has already
+  /// been validated against the schedule covers the later arrival time.
+  bool is_dominated(const NodePtr& node) const
+  {
+    // Never prune a solution node. Two orientations that fall into the same
+    // bin might not both satisfy the final orientation.
+    if(is_solution(node))
+      return false;
+
+    const auto it = _visits.find(get_key(node));
+    if(it == _visits.end())
+      return false;
+
+    // A node that waits in place is still inside of the safe interval that
+    // its parent claimed when it was visited. That parent is what produced the
+    // wait, so its visit must not be used to prune the wait.
+    const NodePtr& parent = node->parent;
+    const bool is_wait = _context.safe_intervals
+        && parent && parent->waypoint && get_key(parent) == get_key(node);
+
+    const Time arrival_time = get_arrival_time(node);
+    for(const Visit& visit : it->second)
+    {
+      if(is_wait && visit.start == get_arrival_time(parent)
+         && visit.start_cost == parent->current_cost)
+        continue;
+
+      if(arrival_time + ArrivalTolerance < visit.start
+         || visit.finish < arrival_time - ArrivalTolerance)
+        continue;
+
+      const double cost_at_arrival = visit.start_cost
+          + time::to_seconds(arrival_time - visit.start);
+
+      if(cost_at_arrival <= node->current_cost + CostTolerance)
+        return true;
+    }
+
+    return false;
+  }
+
+  void mark_visited(const NodePtr& node)
+  {
+    const StateKey key = get_key(node);
+    const Time arrival_time = get_arrival_time(node);
+    std::vector<Visit>& visits = _visits[key];
+    const NodePtr& parent = node->parent;
+
+    if (_context.safe_intervals
+        && _context.graph.waypoints[key.waypoint].is_holding_point())
+    {
+      // With Safe Interval Path Planning, the robot can wait here until the
+      // end of the safe interval that it arrived in, so this state covers that
+      // whole interval.
+      const SafeIntervals::Interval* const interval = SafeIntervals::find(
+            _context.safe_intervals->waypoint(key.waypoint), arrival_time);
+
+      // A node that waited here from earlier in the same interval is already
+      // covered by the visit of the node that it waited from. If it claimed
+      // the rest of the interval too, it would prune the other waits of that
+      // node, and those might be the only ones that lead to a solution.
+      const bool waited_in_interval = interval
+          && parent && parent->waypoint && get_key(parent) == key
+          && interval->start <= get_arrival_time(parent);
+
+      if (interval && !waited_in_interval)
+      {
+        visits.push_back(
+              Visit{arrival_time, interval->finish, node->current_cost});
+        return;
+      }
+    }
+
+    const Trajectory& trajectory = node->trajectory_from_parent;
+    const bool is_hold = parent && parent->waypoint && !node->event
+        && get_key(parent) == key
+        && trajectory.front().get_finish_position()
+           == trajectory.back().get_finish_position();
+
+    if(is_hold)
+    {
+      // The hold trajectory has already passed is_valid(), so the robot can
+      // occupy this state for the whole span between the parent's arrival and
+      // this node's arrival.
+      visits.push_back(
+            Visit{
+              get_arrival_time(parent), arrival_time, parent->current_cost});
+      return;
+    }
+
+    visits.push_back(Visit{arrival_time, arrival_time, node->current_cost});
+  }
 
 private:
 
+  static constexpr Duration ArrivalTolerance = std::chrono::milliseconds(1);
+  static constexpr double CostTolerance = 1e-6;
+
   Context& _context;
-  schedule::Query _query;
   DifferentialDriveConstraint _differential_constraint;
   LaneEventExecutor _executor;
+  std::unordered_map<StateKey, std::vector<Visit>, StateKeyHash> _visits;
+  std::size_t _num_solutions = 0;
+  std::vector<rmf_utils::optional<Duration>> _travel_durations;
 };
 
+constexpr Duration DifferentialDriveExpander::ArrivalTolerance;
+constexpr double DifferentialDriveExpander::CostTolerance;
+
 //==============================================================================
 namespace {
 class DifferentialDriveCache : public Cache
@@ -1312,75 +1554,115 @@ public:
     _traits(_config.vehicle_traits()),
     _profile(_traits.get_profile()),
     _interpolate(agv::Interpolate::Options::Implementation::get(
-                   _config.interpolation()))
+                   _config.interpolation())),
+    _heuristic_tables(std::make_shared<HeuristicTables>(
+                        HeuristicTableBuilder(_graph, _traits, _interpolate)))
   {
     // Do nothing
   }
 
-  CachePtr clone() const final
-  {
-    return std::make_shared<DifferentialDriveCache>(*this);
-  }
-
-  void update(const Cache& newer_cache) override final
+  std::vector<rmf_utils::optional<Result>> plan(
+      const std::vector<agv::Planner::Start>& starts,
+      std::vector<agv::Planner::Goal> goals,
+      agv::Planner::Options options,
+      const bool stop_at_first_goal) const final
   {
-    const auto& newer = static_cast<const DifferentialDriveCache&>(newer_cache);
-
-    for(const auto& h : newer._heuristics)
+    std::vector<rmf_utils::optional<Result>> results(goals.size());
+    if (starts.empty() || goals.empty())
+      return results;
+
+    // A goal that cannot be reached from any of the starts would keep the
+    // search from ever ending on its own. It would keep expanding nodes that
+    // wait in place until it gets interrupted. We leave those goals out of the
+    // search, and their results stay as nullopt.
+    std::vector<agv::Planner::Goal> reachable_goals;
+    std::vector<std::size_t> goal_indices;
+    std::vector<const HeuristicTables::Table*> tables;
+    for(std::size_t i=0; i < goals.size(); ++i)
     {
+      const HeuristicTables::Table& table =
+          _heuristic_tables->get(goals[i].waypoint());
+
+      const bool reachable = std::any_of(
+            starts.begin(), starts.end(),
+            [&](const agv::Planner::Start& start)
+      {
+        return std::isfinite(table[start.waypoint()]);
+      });
 
-      auto& heuristic = _heuristics.insert(
-            std::make_pair(h.first, Heuristic{})).first->second;
+      if (!reachable)
+        continue;
 
-      heuristic.update(h.second);
+      reachable_goals.push_back(goals[i]);
+      goal_indices.push_back(i);
+      tables.push_back(&table);
     }
-  }
 
-  rmf_utils::optional<Result> plan(
-      const std::vector<agv::Planner::Start>& starts,
-      agv::Planner::Goal goal,
-      agv::Planner::Options options) final
-  {
-    if (starts.empty())
-      return rmf_utils::nullopt;
+    if (reachable_goals.empty())
+      return results;
+
+    const Heuristic h{std::move(tables)};
 
-    const std::size_t goal_waypoint = goal.waypoint();
-    Heuristic& h = _heuristics.insert(
-          std::make_pair(goal_waypoint, Heuristic{})).first->second;
-    const bool* const interrupt_flag = options.interrupt_flag();
+    const Interrupter interrupter{options};
 
-    const NodePtr solution = search<DifferentialDriveExpander>(
+    Time earliest_start = starts.front().time();
+    for (const auto& start : starts)
+      earliest_start = std::min(earliest_start, start.time());
+
+    // Read the schedule once for this whole plan
+    const Obstacles obstacles{
+      _graph, options.schedule_viewer(),
+      options.ignore_schedule_ids(), earliest_start};
+
+    std::unique_ptr<SafeIntervals> safe_intervals;
+    if (options.safe_interval_planning())
+    {
+      safe_intervals =
+          std::make_unique<SafeIntervals>(_graph, *_profile, obstacles);
+    }
+
+    std::vector<NodePtr> solutions(reachable_goals.size(), nullptr);
+    std::size_t expanded_nodes = 0;
+    search<DifferentialDriveExpander>(
           DifferentialDriveExpander::Context{
             _graph,
             _traits,
             _profile,
             options.minimum_holding_time(),
             _interpolate,
-            options.schedule_viewer(),
-            goal_waypoint,
-            goal.orientation(),
+            obstacles,
+            reachable_goals,
+            stop_at_first_goal,
             starts.front().time(),
-            interrupt_flag,
-            options.ignore_schedule_ids(),
-            h
+            h,
+            safe_intervals.get(),
+            solutions
           },
           DifferentialDriveExpander::InitialNodeArgs{starts},
-          interrupt_flag);
+          interrupter,
+          expanded_nodes);
 
-    if (!solution)
-      return rmf_utils::nullopt;
+    for(std::size_t i=0; i < reachable_goals.size(); ++i)
+    {
+      const NodePtr& solution = solutions[i];
+      if (!solution)
+        continue;
 
-    auto trajectories = reconstruct_trajectories(solution);
-    auto waypoints = reconstruct_waypoints(solution, _graph);
-    auto start_index = find_start_index(solution);
+      auto trajectories = reconstruct_trajectories(solution);
+      auto waypoints = reconstruct_waypoints(solution, _graph);
+      auto start_index = find_start_index(solution);
+
+      results[goal_indices[i]] = Result{
+          std::move(trajectories),
+          std::move(waypoints),
+          starts[start_index],
+          reachable_goals[i],
+          options,
+          expanded_nodes
+      };
+    }
 
-    return Result{
-        std::move(trajectories),
-        std::move(waypoints),
-        starts[start_index],
-        std::move(goal),
-        std::move(options)
-    };
+    return results;
   }
 
   const agv::Planner::Configuration& get_configuration() const final
@@ -1397,10 +1679,8 @@ private:
   const Trajectory::ConstProfilePtr& _profile;
   const agv::Interpolate::Options::Implementation& _interpolate;
 
-  // This maps from a goal waypoint to the cached Heuristic object that tries to
-  // plan to that goal waypoint.
-  using HeuristicDatabase = std::unordered_map<std::size_t, Heuristic>;
-  HeuristicDatabase _heuristics;
+  // Every planning thread reads from and adds to these same heuristic tables
+  HeuristicTablesPtr _heuristic_tables;
 };
 } // anonymous namespace
 
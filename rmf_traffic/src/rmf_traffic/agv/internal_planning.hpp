@@ -21,7 +21,6 @@
 #include <rmf_traffic/agv/Planner.hpp>
 
 #include <memory>
-#include <mutex>
 
 namespace rmf_traffic {
 namespace internal {
@@ -39,32 +38,28 @@ struct Result
   agv::Planner::Start start;
   agv::Planner::Goal goal;
   agv::Planner::Options options;
+
+  // The number of nodes that the search expanded to produce this result
+  std::size_t expanded_nodes;
 };
 
 //==============================================================================
+/// A Cache holds onto the data that can be reused between planning attempts.
+/// Any number of threads may plan with the same Cache at the same time, so any
+/// data that the Cache reuses must be safe to share between threads.
 class Cache
 {
 public:
 
-  // TODO(MXG): Consider using libguarded instead of using mutexes manually
-  std::mutex mutex;
-
-  // We need to explicitly define these because the std::mutex does not have
-  // a copy constructor
-  Cache() = default;
-  Cache(const Cache&);
-  Cache(Cache&&);
-  Cache& operator=(const Cache&);
-  Cache& operator=(Cache&&);
-
-  virtual CachePtr clone() const = 0;
-
-  virtual void update(const Cache& other) = 0;
-
-  virtual rmf_utils::optional<Result> plan(
+  /// Search for plans to a set of goals. The results will be in the same
+  /// order as the goals, and each result will be a nullopt if its goal could
+  /// not be reached. If stop_at_first_goal is true, then the search will stop
+  /// as soon as any one of the goals is reached.
+  virtual std::vector<rmf_utils::optional<Result>> plan(
       const std::vector<agv::Planner::Start>& starts,
-      agv::Planner::Goal goal,
-      agv::Planner::Options options) = 0;
+      std::vector<agv::Planner::Goal> goals,
+      agv::Planner::Options options,
+      bool stop_at_first_goal) const = 0;
 
   virtual const agv::Planner::Configuration& get_configuration() const =0;
 
@@ -76,26 +71,22 @@ class CacheHandle
 {
 public:
 
-  CacheHandle(CachePtr original);
-
-  // Copying this class does not make sense
-  CacheHandle(const CacheHandle&) = delete;
-
-  // Moving it is okay
-  CacheHandle(CacheHandle&&) = default;
+  CacheHandle(CachePtr cache);
 
   rmf_utils::optional<Result> plan(
       const std::vector<agv::Planner::Start>& starts,
       agv::Planner::Goal goal,
       agv::Planner::Options options);
 
-  ~CacheHandle();
+  std::vector<rmf_utils::optional<Result>> plan(
+      const std::vector<agv::Planner::Start>& starts,
+      std::vector<agv::Planner::Goal> goals,
+      agv::Planner::Options options,
+      bool stop_at_first_goal);
 
 private:
 
-  CachePtr _copy;
-
-  CachePtr _original;
+  CachePtr _cache;
 
 };
 
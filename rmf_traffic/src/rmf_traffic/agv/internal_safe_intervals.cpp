@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "internal_safe_intervals.hpp"
+
+#include <algorithm>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+SafeIntervals::SafeIntervals(
+    const agv::Graph::Implementation& graph,
+    const Trajectory::Profile& profile,
+    const Obstacles& obstacles)
+  : _graph(graph),
+    _characteristic_length(profile.get_shape()->get_characteristic_length()),
+    _obstacles(obstacles),
+    _waypoint_intervals(graph.waypoints.size()),
+    _lane_intervals(graph.lanes.size())
+{
+  // Do nothing
+}
+
+//==============================================================================
+auto SafeIntervals::waypoint(const std::size_t index) -> const Intervals&
+{
+  rmf_utils::optional<Intervals>& intervals = _waypoint_intervals[index];
+  if (!intervals)
+  {
+    const agv::Graph::Waypoint& wp = _graph.waypoints[index];
+    const Eigen::Vector2d& p = wp.get_location();
+    intervals = compute(
+          wp.get_map_name(),
+          get_bounding_box({p, p}, _characteristic_length));
+  }
+
+  return *intervals;
+}
+
+//==============================================================================
+auto SafeIntervals::lane(const std::size_t index) -> const Intervals&
+{
+  rmf_utils::optional<Intervals>& intervals = _lane_intervals[index];
+  if (!intervals)
+  {
+    const agv::Graph::Lane& lane = _graph.lanes[index];
+    const agv::Graph::Waypoint& entry =
+        _graph.waypoints[lane.entry().waypoint_index()];
+    const agv::Graph::Waypoint& exit =
+        _graph.waypoints[lane.exit().waypoint_index()];
+
+    if (entry.get_map_name() != exit.get_map_name())
+    {
+      // We cannot say anything about lanes that travel between maps, so we
+      // will never consider them to be safe.
+      intervals = Intervals();
+    }
+    else
+    {
+      const Eigen::Vector2d& p0 = entry.get_location();
+      const Eigen::Vector2d& p1 = exit.get_location();
+      intervals = compute(
+            entry.get_map_name(),
+            get_bounding_box(
+              {p0.cwiseMin(p1), p0.cwiseMax(p1)}, _characteristic_length));
+    }
+  }
+
+  return *intervals;
+}
+
+//==============================================================================
+auto SafeIntervals::find(const Intervals& intervals, const Time time)
+-> const Interval*
+{
+  // Find the first interval that finishes at or after the time
+  const auto it = std::lower_bound(
+        intervals.begin(), intervals.end(), time,
+        [](const Interval& interval, const Time t)
+  {
+    return interval.finish < t;
+  });
+
+  if (it == intervals.end() || time < it->start)
+    return nullptr;
+
+  return &(*it);
+}
+
+//==============================================================================
+bool SafeIntervals::covers(
+    const Intervals& intervals,
+    const Time start,
+    const Time finish)
+{
+  const Interval* const interval = find(intervals, start);
+  return interval && finish <= interval->finish;
+}
+
+//==============================================================================
+auto SafeIntervals::compute(
+    const std::string& map,
+    const BoundingBox& box) const -> Intervals
+{
+  std::vector<Interval> blocked;
+  for (const Obstacles::Entry& entry : _obstacles.entries(map))
+  {
+    for (const Obstacles::Segment& segment : entry.segments)
+    {
+      if (overlap(box, segment.box))
+        blocked.push_back(Interval{segment.start, segment.finish});
+    }
+  }
+
+  std::sort(blocked.begin(), blocked.end(),
+            [](const Interval& a, const Interval& b)
+  {
+    return a.start < b.start;
+  });
+
+  // The safe intervals are the gaps between the blocked spans
+  Intervals safe;
+  Time gap_start = Time::min();
+  for (const Interval& b : blocked)
+  {
+    if (gap_start < b.start)
+      safe.push_back(Interval{gap_start, b.start});
+
+    gap_start = std::max(gap_start, b.finish);
+  }
+
+  if (gap_start < Time::max())
+    safe.push_back(Interval{gap_start, Time::max()});
+
+  return safe;
+}
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
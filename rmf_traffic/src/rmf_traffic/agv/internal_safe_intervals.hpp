@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__AGV__INTERNAL_SAFE_INTERVALS_HPP
+#define SRC__RMF_TRAFFIC__AGV__INTERNAL_SAFE_INTERVALS_HPP
+
+#include "GraphInternal.hpp"
+#include "internal_obstacles.hpp"
+
+#include <rmf_utils/optional.hpp>
+
+#include <vector>
+
+namespace rmf_traffic {
+namespace internal {
+namespace planning {
+
+//==============================================================================
+/// Finds the spans of time when a robot can stay on a waypoint or travel along
+/// a lane without any chance of running into a trajectory in the schedule.
+///
+/// The intervals of each waypoint and lane are computed from a snapshot of the
+/// schedule the first time they are asked for. The intervals are conservative:
+/// an obstacle blocks a waypoint or lane for the whole duration of any of its
+/// segments whose bounding box overlaps the bounding box of the waypoint or
+/// lane. So a trajectory that fits inside of a safe interval is guaranteed to
+/// be free of conflicts, but a trajectory that does not fit might still be
+/// free of conflicts.
+///
+/// This is not thread-safe. It is meant to be used by a single planning
+/// attempt.
+class SafeIntervals
+{
+public:
+
+  struct Interval
+  {
+    Time start;
+    Time finish;
+  };
+
+  /// A sorted list of disjoint intervals
+  using Intervals = std::vector<Interval>;
+
+  /// Constructor
+  ///
+  /// \param[in] graph
+  ///   The graph that is being planned over
+  ///
+  /// \param[in] profile
+  ///   The profile of the robot that is being planned for
+  ///
+  /// \param[in] obstacles
+  ///   The snapshot of the schedule. This must outlive the SafeIntervals.
+  SafeIntervals(
+      const agv::Graph::Implementation& graph,
+      const Trajectory::Profile& profile,
+      const Obstacles& obstacles);
+
+  /// Get the safe intervals for a robot that is sitting on a waypoint
+  const Intervals& waypoint(std::size_t index);
+
+  /// Get the safe intervals for a robot that is moving along a lane
+  const Intervals& lane(std::size_t index);
+
+  /// Find the interval that contains a time, or get a nullptr if the time is
+  /// not safe.
+  static const Interval* find(const Intervals& intervals, Time time);
+
+  /// Returns true if the whole span from start to finish fits inside one of
+  /// the intervals.
+  static bool covers(const Intervals& intervals, Time start, Time finish);
+
+private:
+
+  Intervals compute(const std::string& map, const BoundingBox& box) const;
+
+  const agv::Graph::Implementation& _graph;
+  double _characteristic_length;
+  const Obstacles& _obstacles;
+
+  std::vector<rmf_utils::optional<Intervals>> _waypoint_intervals;
+  std::vector<rmf_utils::optional<Intervals>> _lane_intervals;
+};
+
+} // namespace planning
+} // namespace internal
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__AGV__INTERNAL_SAFE_INTERVALS_HPP
@@ -21,6 +21,8 @@
 
 #include <fcl/shape/geometric_shapes.h>
 
+#include <cmath>
+
 namespace rmf_traffic {
 namespace geometry {
 
@@ -42,6 +44,11 @@ public:
     return {std::make_shared<fcl::Box>(_x, _y, 1.0)};
   }
 
+  double get_characteristic_length() const final
+  {
+    return std::sqrt(_x*_x + _y*_y)/2.0;
+  }
+
   double _x;
   double _y;
 
@@ -100,7 +107,8 @@ FinalShape Box::finalize() const
 {
   return FinalShape::Implementation::make_final_shape(
         rmf_utils::make_derived_impl<const Shape, const Box>(*this),
-        _get_internal()->make_fcl());
+        _get_internal()->make_fcl(),
+        _get_internal()->get_characteristic_length());
 }
 
 //==============================================================================
@@ -108,7 +116,8 @@ FinalConvexShape Box::finalize_convex() const
 {
   return FinalConvexShape::Implementation::make_final_shape(
         rmf_utils::make_derived_impl<const Shape, const Box>(*this),
-        _get_internal()->make_fcl());
+        _get_internal()->make_fcl(),
+        _get_internal()->get_characteristic_length());
 }
 
 } // namespace geometry
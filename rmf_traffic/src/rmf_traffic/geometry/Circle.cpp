@@ -40,6 +40,11 @@ public:
     return {std::make_shared<fcl::Sphere>(_radius)};
   }
 
+  double get_characteristic_length() const final
+  {
+    return _radius;
+  }
+
   double _radius;
 };
 
@@ -84,7 +89,8 @@ FinalShape Circle::finalize() const
 {
   return FinalShape::Implementation::make_final_shape(
         rmf_utils::make_derived_impl<const Shape, const Circle>(*this),
-        _get_internal()->make_fcl());
+        _get_internal()->make_fcl(),
+        _get_internal()->get_characteristic_length());
 }
 
 //==============================================================================
@@ -92,7 +98,8 @@ FinalConvexShape Circle::finalize_convex() const
 {
   return FinalConvexShape::Implementation::make_final_shape(
         rmf_utils::make_derived_impl<const Shape, const Circle>(*this),
-        _get_internal()->make_fcl());
+        _get_internal()->make_fcl(),
+        _get_internal()->get_characteristic_length());
 }
 
 } // namespace geometry
@@ -53,6 +53,12 @@ const Shape& FinalShape::source() const
   return *_pimpl->_shape;
 }
 
+//==============================================================================
+double FinalShape::get_characteristic_length() const
+{
+  return _pimpl->_characteristic_length;
+}
+
 //==============================================================================
 FinalShape::FinalShape()
 {
@@ -40,6 +40,11 @@ public:
 
   virtual CollisionGeometries make_fcl() const = 0;
 
+  /// The distance from the origin of the shape to the point of the shape that
+  /// is furthest from it. Any rotation of the shape about its origin will fit
+  /// inside of a circle with this radius.
+  virtual double get_characteristic_length() const = 0;
+
 };
 
 //==============================================================================
@@ -51,6 +56,8 @@ public:
 
   CollisionGeometries _collisions;
 
+  double _characteristic_length;
+
   static const CollisionGeometries& get_collisions(const FinalShape& shape)
   {
     return shape._pimpl->_collisions;
@@ -58,11 +65,15 @@ public:
 
   static FinalShape make_final_shape(
       rmf_utils::impl_ptr<const Shape> shape,
-      CollisionGeometries collisions)
+      CollisionGeometries collisions,
+      double characteristic_length)
   {
     FinalShape result;
     result._pimpl = rmf_utils::make_impl<Implementation>(
-          Implementation{std::move(shape), std::move(collisions)});
+          Implementation{
+            std::move(shape),
+            std::move(collisions),
+            characteristic_length});
     return result;
   }
 
@@ -80,11 +91,15 @@ public:
 
   static FinalConvexShape make_final_shape(
       rmf_utils::impl_ptr<const Shape> shape,
-      CollisionGeometries collisions)
+      CollisionGeometries collisions,
+      double characteristic_length)
   {
     FinalConvexShape result;
     result._pimpl = rmf_utils::make_impl<FinalShape::Implementation>(
-          FinalShape::Implementation{std::move(shape), std::move(collisions)});
+          FinalShape::Implementation{
+            std::move(shape),
+            std::move(collisions),
+            characteristic_length});
     return result;
   }
 };
@@ -559,6 +559,15 @@ public:
     return shapes;
   }
 
+  double get_characteristic_length() const final
+  {
+    double max_dist = 0.0;
+    for(const auto& p : _points)
+      max_dist = std::max(max_dist, p.norm());
+
+    return max_dist;
+  }
+
   std::vector<Eigen::Vector2d> _points;
 };
 
@@ -657,7 +666,8 @@ FinalShape SimplePolygon::finalize() const
 {
   return FinalShape::Implementation::make_final_shape(
         rmf_utils::make_derived_impl<const Shape, const SimplePolygon>(*this),
-        _get_internal()->make_fcl());
+        _get_internal()->make_fcl(),
+        _get_internal()->get_characteristic_length());
 }
 
 } // namespace geometry
@@ -626,6 +626,31 @@ Database::Patch::Patch()
 
 namespace internal {
 
+//==============================================================================
+EntryPtr make_entry_ref(
+    Trajectory trajectory,
+    const Version version,
+    ConstEntryPtr succeeds)
+{
+  EntryPtr entry = std::make_shared<Entry>(
+        std::move(trajectory), version, std::move(succeeds));
+
+  if(entry->succeeds)
+  {
+    entry->change = std::make_unique<Database::Change>(
+          Database::Change::Implementation::make_replace_ref(
+            entry->succeeds->version, &entry->trajectory, version));
+  }
+  else
+  {
+    entry->change = std::make_unique<Database::Change>(
+          Database::Change::Implementation::make_insert_ref(
+            &entry->trajectory, version));
+  }
+
+  return entry;
+}
+
 //==============================================================================
 void ChangeRelevanceInspector::version_range(VersionRange range)
 {
@@ -756,6 +781,80 @@ void ChangeRelevanceInspector::inspect(
   }
 }
 
+//==============================================================================
+namespace {
+
+bool is_relevant(const Trajectory& trajectory, const Query::Spacetime& spacetime)
+{
+  if(!trajectory.start_time())
+  {
+    // This is an erasure
+    return false;
+  }
+
+  switch(spacetime.get_mode())
+  {
+    case Query::Spacetime::Mode::Invalid:
+    {
+      throw std::runtime_error(
+          "[rmf_traffic::schedule::Database] Invalid Query::Spacetime::Mode "
+          "used. Please report this as a bug.");
+    }
+
+    case Query::Spacetime::Mode::All:
+    {
+      return true;
+    }
+
+    case Query::Spacetime::Mode::Regions:
+    {
+      assert(spacetime.regions() != nullptr);
+      for(const Region& region : *spacetime.regions())
+      {
+        if(region.get_map() != trajectory.get_map_name())
+          continue;
+
+        rmf_traffic::internal::Spacetime spacetime_data;
+        spacetime_data.lower_time_bound = region.get_lower_time_bound();
+        spacetime_data.upper_time_bound = region.get_upper_time_bound();
+        for(auto space_it=region.begin(); space_it != region.end(); ++space_it)
+        {
+          spacetime_data.pose = space_it->get_pose();
+          spacetime_data.shape = space_it->get_shape();
+
+          if(rmf_traffic::internal::detect_conflicts(
+               trajectory, spacetime_data, nullptr))
+            return true;
+        }
+      }
+
+      return false;
+    }
+
+    case Query::Spacetime::Mode::Timespan:
+    {
+      assert(spacetime.timespan() != nullptr);
+      const Query::Spacetime::Timespan& timespan = *spacetime.timespan();
+      if(timespan.get_maps().count(trajectory.get_map_name()) == 0)
+        return false;
+
+      const Time* const lower_time_bound = timespan.get_lower_time_bound();
+      if(lower_time_bound && *trajectory.finish_time() < *lower_time_bound)
+        return false;
+
+      const Time* const upper_time_bound = timespan.get_upper_time_bound();
+      if(upper_time_bound && *upper_time_bound < *trajectory.start_time())
+        return false;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+} // anonymous namespace
+
 //==============================================================================
 void ChangeRelevanceInspector::inspect(
     const ConstEntryPtr& entry,
@@ -807,18 +906,44 @@ void ChangeRelevanceInspector::inspect(
 //==============================================================================
 Database::Database()
 {
-  // Do nothing
+  _pimpl->keep_journal = true;
 }
 
 //==============================================================================
 auto Database::changes(const Query& parameters) const -> Patch
 {
-  auto relevant_changes = _pimpl->inspect<internal::ChangeRelevanceInspector>(
-        parameters).relevant_changes;
+  const auto* after = parameters.versions().after();
+
+  std::vector<Change> relevant_changes;
+  if(after)
+  {
+    // Only the entries that were created after the requested version can have
+    // changes that the remote mirror does not know about, so we use the
+    // journal to visit just those entries.
+    const Version after_version = after->get_version();
+    const Query::Spacetime& spacetime = parameters.spacetime();
+
+    internal::ChangeRelevanceInspector inspector;
+    inspector.after(&after_version);
+    _pimpl->for_each_entry_after(
+          after_version, [&](const internal::ConstEntryPtr& entry)
+    {
+      inspector.inspect(entry, [&](const internal::ConstEntryPtr& e)
+      {
+        return internal::is_relevant(e->trajectory, spacetime);
+      });
+    });
+
+    relevant_changes = std::move(inspector.relevant_changes);
+  }
+  else
+  {
+    relevant_changes = _pimpl->inspect<internal::ChangeRelevanceInspector>(
+          parameters).relevant_changes;
+  }
 
   if(_pimpl->cull_has_occurred)
   {
-    const auto* after = parameters.versions().after();
     const auto& last_cull = _pimpl->last_cull;
     if(after)
     {
@@ -842,18 +967,9 @@ auto Database::changes(const Query& parameters) const -> Patch
 //==============================================================================
 Version Database::insert(Trajectory trajectory)
 {
-  internal::EntryPtr new_entry =
-      std::make_shared<internal::Entry>(
-        std::move(trajectory),
-        ++_pimpl->latest_version);
-
-  new_entry->change = std::make_unique<Change>(
-        Change::Implementation::make_insert_ref(
-          &new_entry->trajectory, new_entry->version));
-
-  _pimpl->add_entry(new_entry);
-
-  return new_entry->version;
+  return _pimpl->add_entry(
+        internal::make_entry_ref(
+          std::move(trajectory), ++_pimpl->latest_version))->version;
 }
 
 //==============================================================================
@@ -894,6 +1010,9 @@ Version Database::delay(
   Trajectory new_trajectory = add_delay(
         old_entry->trajectory, from, delay);
 
+  const bool whole = is_delayed_as_whole(
+        old_entry->trajectory, new_trajectory, delay);
+
   const Version new_version = ++_pimpl->latest_version;
   Change change = Database::Change::make_delay(id, from, delay, new_version);
 
@@ -902,7 +1021,8 @@ Version Database::delay(
           std::move(new_trajectory),
           new_version,
           old_entry,
-          std::make_unique<Change>(std::move(change))));
+          std::make_unique<Change>(std::move(change))),
+        false, whole? &delay : nullptr);
 
   return new_version;
 }
@@ -916,17 +1036,9 @@ Version Database::replace(
       _pimpl->get_entry_iterator(previous_id, "replacement")->second;
 
   const Version new_version = ++_pimpl->latest_version;
-  internal::EntryPtr new_entry =
-      std::make_shared<internal::Entry>(
-        std::move(trajectory),
-        new_version,
-        old_entry);
-
-  new_entry->change = std::make_unique<Change>(
-        Change::Implementation::make_replace_ref(
-          previous_id, &new_entry->trajectory, new_version));
-
-  old_entry->succeeded_by = _pimpl->add_entry(new_entry);
+  old_entry->succeeded_by = _pimpl->add_entry(
+        internal::make_entry_ref(
+          std::move(trajectory), new_version, old_entry));
 
   return new_version;
 }
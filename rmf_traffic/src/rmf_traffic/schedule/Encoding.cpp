@@ -0,0 +1,1109 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "EncodingInternal.hpp"
+
+#include <rmf_traffic/schedule/Encoding.hpp>
+
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include <memory>
+#include <stdexcept>
+
+namespace rmf_traffic {
+namespace schedule {
+
+namespace {
+
+//==============================================================================
+const char TrajectoryMagic[4] = {'R', 'M', 'F', 'T'};
+const char PatchMagic[4] = {'R', 'M', 'F', 'P'};
+const uint8_t EncodingFormat = 1;
+
+// Every segment needs at least one byte for its time, one byte for its profile
+// index, and six doubles for its position and velocity.
+const std::size_t VectorBytes = 6*sizeof(double);
+const std::size_t MinimumSegmentBytes = 2 + VectorBytes;
+
+//==============================================================================
+enum class ShapeType : uint8_t
+{
+  Box = 1,
+  Circle
+};
+
+//==============================================================================
+void write_shape(
+    internal::BinaryWriter& writer,
+    const geometry::ConstFinalConvexShapePtr& shape)
+{
+  const geometry::Shape& source = shape->source();
+  if(const auto* box = dynamic_cast<const geometry::Box*>(&source))
+  {
+    writer.put<ShapeType>(ShapeType::Box);
+    writer.put<double>(box->get_x_length());
+    writer.put<double>(box->get_y_length());
+    return;
+  }
+
+  if(const auto* circle = dynamic_cast<const geometry::Circle*>(&source))
+  {
+    writer.put<ShapeType>(ShapeType::Circle);
+    writer.put<double>(circle->get_radius());
+    return;
+  }
+
+  internal::throw_encoding_error("Unsupported shape type in trajectory profile");
+}
+
+//==============================================================================
+geometry::FinalConvexShapePtr read_shape(internal::BinaryReader& reader)
+{
+  const ShapeType type = reader.get<ShapeType>();
+  switch(type)
+  {
+    case ShapeType::Box:
+    {
+      const double x = reader.get<double>();
+      const double y = reader.get<double>();
+      return geometry::make_final_convex<geometry::Box>(x, y);
+    }
+    case ShapeType::Circle:
+      return geometry::make_final_convex<geometry::Circle>(
+            reader.get<double>());
+  }
+
+  internal::throw_encoding_error(
+        "Invalid shape type [" + std::to_string(static_cast<int>(type)) + "]");
+}
+
+//==============================================================================
+std::string as_key(const internal::BinaryWriter& writer)
+{
+  const auto& data = writer.data();
+  return std::string(reinterpret_cast<const char*>(data.data()), data.size());
+}
+
+//==============================================================================
+void check_header(
+    internal::BinaryReader& reader,
+    const char (&magic)[4],
+    const std::string& name)
+{
+  if(reader.remaining() < sizeof(magic)
+     || std::memcmp(reader.position(), magic, sizeof(magic)) != 0)
+  {
+    internal::throw_encoding_error("The data is not an encoded " + name);
+  }
+  reader.skip(sizeof(magic));
+
+  const uint8_t format = reader.get<uint8_t>();
+  if(format != EncodingFormat)
+  {
+    internal::throw_encoding_error(
+          "Unsupported format [" + std::to_string(format) + "] for an encoded "
+          + name);
+  }
+}
+
+} // anonymous namespace
+
+namespace internal {
+
+//==============================================================================
+void throw_encoding_error(const std::string& message)
+{
+  throw std::runtime_error("[rmf_traffic::schedule::encoding] " + message);
+}
+
+//==============================================================================
+uint64_t EncodingTableBuilder::map(const std::string& name)
+{
+  const auto insertion =
+      _map_indices.insert(std::make_pair(name, _map_indices.size()));
+
+  if(insertion.second)
+    _maps.put_string(name);
+
+  return insertion.first->second;
+}
+
+//==============================================================================
+uint64_t EncodingTableBuilder::profile(
+    const Trajectory::ConstProfilePtr& profile)
+{
+  const auto known = _known_profiles.find(profile.get());
+  if(known != _known_profiles.end())
+    return known->second;
+
+  using Autonomy = Trajectory::Profile::Autonomy;
+  const Autonomy autonomy = profile->get_autonomy();
+  if(autonomy != Autonomy::Guided
+     && autonomy != Autonomy::Queued
+     && autonomy != Autonomy::Autonomous)
+  {
+    throw_encoding_error(
+          "Invalid profile autonomy ["
+          + std::to_string(static_cast<int>(autonomy)) + "]");
+  }
+
+  BinaryWriter record;
+  record.put<uint8_t>(static_cast<uint8_t>(autonomy));
+
+  // Zero is reserved for profiles that have no shape
+  const auto& shape = profile->get_shape();
+  record.put_varint(shape? this->shape(shape) + 1 : 0);
+
+  if(autonomy == Autonomy::Queued)
+    record.put_string(profile->get_queue_info()->get_queue_id());
+
+  const auto insertion = _profile_indices.insert(
+        std::make_pair(as_key(record), _profile_indices.size()));
+
+  if(insertion.second)
+    _profiles.put_bytes(record.data().data(), record.size());
+
+  _known_profiles[profile.get()] = insertion.first->second;
+  _keep_alive.push_back(profile);
+
+  return insertion.first->second;
+}
+
+//==============================================================================
+uint64_t EncodingTableBuilder::shape(
+    const geometry::ConstFinalConvexShapePtr& shape)
+{
+  BinaryWriter record;
+  write_shape(record, shape);
+
+  const auto insertion = _shape_indices.insert(
+        std::make_pair(as_key(record), _shape_indices.size()));
+
+  if(insertion.second)
+    _shapes.put_bytes(record.data().data(), record.size());
+
+  return insertion.first->second;
+}
+
+//==============================================================================
+void EncodingTableBuilder::write(BinaryWriter& writer) const
+{
+  writer.put_varint(_map_indices.size());
+  writer.put_bytes(_maps.data().data(), _maps.size());
+
+  writer.put_varint(_shape_indices.size());
+  writer.put_bytes(_shapes.data().data(), _shapes.size());
+
+  writer.put_varint(_profile_indices.size());
+  writer.put_bytes(_profiles.data().data(), _profiles.size());
+}
+
+//==============================================================================
+void EncodingTables::read(BinaryReader& reader)
+{
+  const uint64_t num_maps = reader.get_varint();
+  if(num_maps > reader.remaining())
+    throw_encoding_error("Invalid number of maps");
+
+  _maps.clear();
+  _maps.reserve(num_maps);
+  for(uint64_t i=0; i < num_maps; ++i)
+  {
+    const std::size_t size = reader.get_size();
+    _maps.push_back(std::make_pair(reader.position(), size));
+    reader.skip(size);
+  }
+
+  const uint64_t num_shapes = reader.get_varint();
+  if(num_shapes > reader.remaining())
+    throw_encoding_error("Invalid number of shapes");
+
+  _shapes.clear();
+  _shapes.reserve(num_shapes);
+  for(uint64_t i=0; i < num_shapes; ++i)
+  {
+    _shapes.push_back(reader.position());
+    const ShapeType type = reader.get<ShapeType>();
+    if(type == ShapeType::Box)
+      reader.skip(2*sizeof(double));
+    else if(type == ShapeType::Circle)
+      reader.skip(sizeof(double));
+    else
+      throw_encoding_error("Invalid shape type in table");
+  }
+
+  const uint64_t num_profiles = reader.get_varint();
+  if(num_profiles > reader.remaining())
+    throw_encoding_error("Invalid number of profiles");
+
+  _profiles.clear();
+  _profiles.reserve(num_profiles);
+  for(uint64_t i=0; i < num_profiles; ++i)
+  {
+    using Autonomy = Trajectory::Profile::Autonomy;
+
+    _profiles.push_back(reader.position());
+    const Autonomy autonomy = static_cast<Autonomy>(reader.get<uint8_t>());
+    if(reader.get_varint() > _shapes.size())
+      throw_encoding_error("Invalid shape index in profile table");
+
+    if(autonomy == Autonomy::Queued)
+      reader.skip(reader.get_size());
+    else if(autonomy != Autonomy::Guided && autonomy != Autonomy::Autonomous)
+      throw_encoding_error("Invalid profile autonomy in table");
+  }
+
+  _end = reader.position();
+}
+
+//==============================================================================
+std::string EncodingTables::map_name(const uint64_t index) const
+{
+  const auto& map = _maps.at(index);
+  return std::string(reinterpret_cast<const char*>(map.first), map.second);
+}
+
+//==============================================================================
+std::size_t EncodingTables::num_maps() const
+{
+  return _maps.size();
+}
+
+//==============================================================================
+std::size_t EncodingTables::num_profiles() const
+{
+  return _profiles.size();
+}
+
+//==============================================================================
+std::vector<Trajectory::ProfilePtr> EncodingTables::decode_profiles() const
+{
+  using Autonomy = Trajectory::Profile::Autonomy;
+
+  std::vector<geometry::FinalConvexShapePtr> shapes;
+  shapes.reserve(_shapes.size());
+  for(const uint8_t* const shape : _shapes)
+  {
+    BinaryReader reader(shape, _end);
+    shapes.push_back(read_shape(reader));
+  }
+
+  std::vector<Trajectory::ProfilePtr> profiles;
+  profiles.reserve(_profiles.size());
+  for(const uint8_t* const profile : _profiles)
+  {
+    BinaryReader reader(profile, _end);
+    const Autonomy autonomy = static_cast<Autonomy>(reader.get<uint8_t>());
+    const uint64_t shape_index = reader.get_varint();
+    geometry::ConstFinalConvexShapePtr shape =
+        shape_index == 0? nullptr : shapes[shape_index - 1];
+
+    if(autonomy == Autonomy::Guided)
+      profiles.push_back(Trajectory::Profile::make_guided(std::move(shape)));
+    else if(autonomy == Autonomy::Autonomous)
+      profiles.push_back(Trajectory::Profile::make_autonomous(std::move(shape)));
+    else
+      profiles.push_back(
+            Trajectory::Profile::make_queued(
+              std::move(shape), reader.get_string()));
+  }
+
+  return profiles;
+}
+
+//==============================================================================
+void write_trajectory_body(
+    BinaryWriter& writer,
+    const Trajectory& trajectory,
+    EncodingTableBuilder& tables)
+{
+  BinaryWriter body;
+  body.put_varint(tables.map(trajectory.get_map_name()));
+  body.put_varint(trajectory.size());
+
+  if(trajectory.size() > 0)
+  {
+    const Time start_time = *trajectory.start_time();
+    body.put_time(start_time);
+    body.put_time(*trajectory.finish_time());
+
+    Time previous_time = start_time;
+    for(const auto& segment : trajectory)
+    {
+      const Time finish_time = segment.get_finish_time();
+      body.put_duration(finish_time - previous_time);
+      body.put_varint(tables.profile(segment.get_profile()));
+      body.put_vector(segment.get_finish_position());
+      body.put_vector(segment.get_finish_velocity());
+      previous_time = finish_time;
+    }
+  }
+
+  // The size of the body is written first so that readers can skip past it
+  // without decoding the segments.
+  writer.put_varint(body.size());
+  writer.put_bytes(body.data().data(), body.size());
+}
+
+//==============================================================================
+TrajectoryBody read_trajectory_body(
+    BinaryReader& reader,
+    const EncodingTables& tables)
+{
+  const std::size_t size = reader.get_size();
+  BinaryReader body_reader(reader.position(), reader.position() + size);
+  reader.skip(size);
+
+  TrajectoryBody body;
+  body.map = body_reader.get_varint();
+  if(body.map >= tables.num_maps())
+    throw_encoding_error("Invalid map index in trajectory");
+
+  body.size = body_reader.get_varint();
+  if(body.size > 0)
+  {
+    body.start_time = body_reader.get_time();
+    body.finish_time = body_reader.get_time();
+  }
+
+  if(body.size > body_reader.remaining()/MinimumSegmentBytes)
+    throw_encoding_error("Invalid number of segments in trajectory");
+
+  body.segments = body_reader.position();
+  body.end = body_reader.end();
+  return body;
+}
+
+//==============================================================================
+SegmentRecord read_segment(
+    BinaryReader& reader,
+    const Time previous_finish_time,
+    const std::size_t num_profiles)
+{
+  SegmentRecord segment;
+  segment.finish_time = previous_finish_time + reader.get_duration();
+  segment.profile = reader.get_varint();
+  if(segment.profile >= num_profiles)
+    throw_encoding_error("Invalid profile index in trajectory");
+
+  segment.vectors = reader.position();
+  reader.skip(VectorBytes);
+  return segment;
+}
+
+//==============================================================================
+Eigen::Vector3d read_position(const SegmentRecord& segment)
+{
+  return BinaryReader(segment.vectors, segment.vectors + VectorBytes)
+      .get_vector();
+}
+
+//==============================================================================
+Eigen::Vector3d read_velocity(const SegmentRecord& segment)
+{
+  return BinaryReader(
+        segment.vectors + VectorBytes/2, segment.vectors + VectorBytes)
+      .get_vector();
+}
+
+//==============================================================================
+Trajectory decode_trajectory(
+    const TrajectoryBody& body,
+    const EncodingTables& tables,
+    const std::vector<Trajectory::ProfilePtr>& profiles)
+{
+  Trajectory trajectory(tables.map_name(body.map));
+
+  BinaryReader reader(body.segments, body.end);
+  Time previous_time = body.start_time;
+  for(uint64_t i=0; i < body.size; ++i)
+  {
+    const SegmentRecord segment =
+        read_segment(reader, previous_time, profiles.size());
+
+    trajectory.insert(
+          segment.finish_time,
+          profiles[segment.profile],
+          read_position(segment),
+          read_velocity(segment));
+
+    previous_time = segment.finish_time;
+  }
+
+  return trajectory;
+}
+
+//==============================================================================
+void write_trajectory(BinaryWriter& writer, const Trajectory& trajectory)
+{
+  EncodingTableBuilder tables;
+  BinaryWriter body;
+  write_trajectory_body(body, trajectory, tables);
+
+  tables.write(writer);
+  writer.put_bytes(body.data().data(), body.size());
+}
+
+//==============================================================================
+Trajectory read_trajectory(BinaryReader& reader)
+{
+  EncodingTables tables;
+  tables.read(reader);
+  const TrajectoryBody body = read_trajectory_body(reader, tables);
+  return decode_trajectory(body, tables, tables.decode_profiles());
+}
+
+} // namespace internal
+
+//==============================================================================
+std::vector<uint8_t> encode(const Trajectory& trajectory)
+{
+  internal::BinaryWriter writer;
+  writer.put_bytes(TrajectoryMagic, sizeof(TrajectoryMagic));
+  writer.put<uint8_t>(EncodingFormat);
+  internal::write_trajectory(writer, trajectory);
+  return std::move(writer.data());
+}
+
+//==============================================================================
+std::vector<uint8_t> encode(const Database::Patch& patch)
+{
+  using Mode = Database::Change::Mode;
+
+  internal::EncodingTableBuilder tables;
+  internal::BinaryWriter changes;
+
+  const auto write_trajectory = [&](
+      const Trajectory* trajectory,
+      const Version id)
+  {
+    if(!trajectory)
+    {
+      internal::throw_encoding_error(
+            "Change [" + std::to_string(id) + "] is missing its trajectory");
+    }
+
+    internal::write_trajectory_body(changes, *trajectory, tables);
+  };
+
+  // The original IDs are written as differences from the ID of the change,
+  // which are usually small.
+  const auto write_original_id = [&](
+      const Version original_id,
+      const Version id)
+  {
+    changes.put_varint(id - original_id);
+  };
+
+  for(const auto& change : patch)
+  {
+    const Mode mode = change.get_mode();
+    const Version id = change.id();
+    changes.put<uint8_t>(static_cast<uint8_t>(mode));
+    changes.put_varint(id);
+
+    switch(mode)
+    {
+      case Mode::Insert:
+        write_trajectory(change.insert()->trajectory(), id);
+        break;
+      case Mode::Interrupt:
+      {
+        const auto* interrupt = change.interrupt();
+        write_original_id(interrupt->original_id(), id);
+        changes.put_duration(interrupt->delay());
+        write_trajectory(interrupt->interruption(), id);
+        break;
+      }
+      case Mode::Delay:
+      {
+        const auto* delay = change.delay();
+        write_original_id(delay->original_id(), id);
+        changes.put_time(delay->from());
+        changes.put_duration(delay->duration());
+        break;
+      }
+      case Mode::Replace:
+      {
+        const auto* replace = change.replace();
+        write_original_id(replace->original_id(), id);
+        write_trajectory(replace->trajectory(), id);
+        break;
+      }
+      case Mode::Erase:
+        write_original_id(change.erase()->original_id(), id);
+        break;
+      case Mode::Cull:
+        changes.put_time(change.cull()->time());
+        break;
+      default:
+        internal::throw_encoding_error(
+              "Invalid change mode [" + std::to_string(static_cast<int>(mode))
+              + "]");
+    }
+  }
+
+  internal::BinaryWriter writer;
+  writer.put_bytes(PatchMagic, sizeof(PatchMagic));
+  writer.put<uint8_t>(EncodingFormat);
+  writer.put<Version>(patch.latest_version());
+  tables.write(writer);
+  writer.put_varint(patch.size());
+  writer.put_bytes(changes.data().data(), changes.size());
+  return std::move(writer.data());
+}
+
+//==============================================================================
+class TrajectoryView::Implementation
+{
+public:
+
+  std::shared_ptr<const internal::EncodingTables> tables;
+  internal::TrajectoryBody body;
+
+};
+
+//==============================================================================
+Time TrajectoryView::Segment::get_finish_time() const
+{
+  return _finish_time;
+}
+
+//==============================================================================
+Eigen::Vector3d TrajectoryView::Segment::get_finish_position() const
+{
+  return internal::read_position({_finish_time, _profile_index, _vectors});
+}
+
+//==============================================================================
+Eigen::Vector3d TrajectoryView::Segment::get_finish_velocity() const
+{
+  return internal::read_velocity({_finish_time, _profile_index, _vectors});
+}
+
+//==============================================================================
+std::size_t TrajectoryView::Segment::get_profile_index() const
+{
+  return _profile_index;
+}
+
+//==============================================================================
+auto TrajectoryView::const_iterator::operator*() const -> const Segment&
+{
+  return _segment;
+}
+
+//==============================================================================
+auto TrajectoryView::const_iterator::operator->() const -> const Segment*
+{
+  return &_segment;
+}
+
+//==============================================================================
+auto TrajectoryView::const_iterator::operator++() -> const_iterator&
+{
+  ++_index;
+  _load();
+  return *this;
+}
+
+//==============================================================================
+auto TrajectoryView::const_iterator::operator++(int) -> const_iterator
+{
+  const_iterator original = *this;
+  ++(*this);
+  return original;
+}
+
+//==============================================================================
+bool TrajectoryView::const_iterator::operator==(
+    const const_iterator& other) const
+{
+  return _end == other._end && _index == other._index;
+}
+
+//==============================================================================
+bool TrajectoryView::const_iterator::operator!=(
+    const const_iterator& other) const
+{
+  return !(*this == other);
+}
+
+//==============================================================================
+TrajectoryView::const_iterator::const_iterator()
+  : _next(nullptr),
+    _end(nullptr),
+    _index(0),
+    _size(0),
+    _num_profiles(0),
+    _segment()
+{
+  // Do nothing
+}
+
+//==============================================================================
+void TrajectoryView::const_iterator::_load()
+{
+  if(_index >= _size)
+    return;
+
+  internal::BinaryReader reader(_next, _end);
+  const internal::SegmentRecord record =
+      internal::read_segment(reader, _segment._finish_time, _num_profiles);
+
+  _segment._finish_time = record.finish_time;
+  _segment._profile_index = record.profile;
+  _segment._vectors = record.vectors;
+  _next = reader.position();
+}
+
+//==============================================================================
+TrajectoryView::TrajectoryView(const uint8_t* const data, const std::size_t size)
+{
+  internal::BinaryReader reader(data, data + size);
+  check_header(reader, TrajectoryMagic, "trajectory");
+
+  auto tables = std::make_shared<internal::EncodingTables>();
+  tables->read(reader);
+  const internal::TrajectoryBody body =
+      internal::read_trajectory_body(reader, *tables);
+
+  if(reader.remaining() > 0)
+    internal::throw_encoding_error("Unexpected data after trajectory");
+
+  _pimpl = rmf_utils::make_impl<Implementation>(
+        Implementation{std::move(tables), body});
+}
+
+//==============================================================================
+TrajectoryView::TrajectoryView(const std::vector<uint8_t>& data)
+  : TrajectoryView(data.data(), data.size())
+{
+  // Do nothing
+}
+
+//==============================================================================
+std::string TrajectoryView::get_map_name() const
+{
+  return _pimpl->tables->map_name(_pimpl->body.map);
+}
+
+//==============================================================================
+std::size_t TrajectoryView::size() const
+{
+  return _pimpl->body.size;
+}
+
+//==============================================================================
+bool TrajectoryView::empty() const
+{
+  return _pimpl->body.size == 0;
+}
+
+//==============================================================================
+const Time* TrajectoryView::start_time() const
+{
+  if(empty())
+    return nullptr;
+
+  return &_pimpl->body.start_time;
+}
+
+//==============================================================================
+const Time* TrajectoryView::finish_time() const
+{
+  if(empty())
+    return nullptr;
+
+  return &_pimpl->body.finish_time;
+}
+
+//==============================================================================
+Duration TrajectoryView::duration() const
+{
+  if(empty())
+    return Duration(0);
+
+  return _pimpl->body.finish_time - _pimpl->body.start_time;
+}
+
+//==============================================================================
+std::size_t TrajectoryView::num_profiles() const
+{
+  return _pimpl->tables->num_profiles();
+}
+
+//==============================================================================
+auto TrajectoryView::begin() const -> const_iterator
+{
+  const internal::TrajectoryBody& body = _pimpl->body;
+
+  const_iterator it;
+  it._next = body.segments;
+  it._end = body.end;
+  it._size = body.size;
+  it._num_profiles = _pimpl->tables->num_profiles();
+
+  // The first segment is encoded relative to the start time
+  it._segment._finish_time = body.start_time;
+  it._load();
+  return it;
+}
+
+//==============================================================================
+auto TrajectoryView::end() const -> const_iterator
+{
+  const_iterator it;
+  it._end = _pimpl->body.end;
+  it._index = _pimpl->body.size;
+  it._size = _pimpl->body.size;
+  return it;
+}
+
+//==============================================================================
+Trajectory TrajectoryView::decode() const
+{
+  return internal::decode_trajectory(
+        _pimpl->body, *_pimpl->tables, _pimpl->tables->decode_profiles());
+}
+
+//==============================================================================
+TrajectoryView::TrajectoryView()
+{
+  // Do nothing
+}
+
+//==============================================================================
+class PatchView::Implementation
+{
+public:
+
+  std::shared_ptr<const internal::EncodingTables> tables;
+  Version latest_version;
+  std::size_t size;
+  const uint8_t* changes;
+  const uint8_t* end;
+
+  /// Read the next change. If output is a nullptr, the change will only be
+  /// checked for errors.
+  static void read_change(
+      internal::BinaryReader& reader,
+      const std::shared_ptr<const internal::EncodingTables>& tables,
+      Change* const output)
+  {
+    using Mode = Database::Change::Mode;
+
+    const Mode mode = static_cast<Mode>(reader.get<uint8_t>());
+    const Version id = reader.get_varint();
+
+    Change change;
+    change._mode = mode;
+    change._id = id;
+    change._original_id = 0;
+    change._time = Time(Duration(0));
+    change._duration = Duration(0);
+
+    const auto read_original_id = [&]()
+    {
+      change._original_id = id - reader.get_varint();
+    };
+
+    const auto read_trajectory = [&]()
+    {
+      const internal::TrajectoryBody body =
+          internal::read_trajectory_body(reader, *tables);
+
+      if(output)
+      {
+        TrajectoryView view;
+        view._pimpl = rmf_utils::make_impl<TrajectoryView::Implementation>(
+              TrajectoryView::Implementation{tables, body});
+        change._trajectory = std::move(view);
+      }
+    };
+
+    switch(mode)
+    {
+      case Mode::Insert:
+        read_trajectory();
+        break;
+      case Mode::Interrupt:
+        read_original_id();
+        change._duration = reader.get_duration();
+        read_trajectory();
+        break;
+      case Mode::Delay:
+        read_original_id();
+        change._time = reader.get_time();
+        change._duration = reader.get_duration();
+        break;
+      case Mode::Replace:
+        read_original_id();
+        read_trajectory();
+        break;
+      case Mode::Erase:
+        read_original_id();
+        break;
+      case Mode::Cull:
+        change._time = reader.get_time();
+        break;
+      default:
+        internal::throw_encoding_error(
+              "Invalid change mode [" + std::to_string(static_cast<int>(mode))
+              + "]");
+    }
+
+    if(output)
+      *output = std::move(change);
+  }
+};
+
+//==============================================================================
+Database::Change::Mode PatchView::Change::get_mode() const
+{
+  return _mode;
+}
+
+//==============================================================================
+Version PatchView::Change::id() const
+{
+  return _id;
+}
+
+//==============================================================================
+Version PatchView::Change::original_id() const
+{
+  return _original_id;
+}
+
+//==============================================================================
+const TrajectoryView* PatchView::Change::trajectory() const
+{
+  if(_trajectory)
+    return &(*_trajectory);
+
+  return nullptr;
+}
+
+//==============================================================================
+Time PatchView::Change::time() const
+{
+  return _time;
+}
+
+//==============================================================================
+Duration PatchView::Change::duration() const
+{
+  return _duration;
+}
+
+//==============================================================================
+auto PatchView::const_iterator::operator*() const -> const Change&
+{
+  return _change;
+}
+
+//==============================================================================
+auto PatchView::const_iterator::operator->() const -> const Change*
+{
+  return &_change;
+}
+
+//==============================================================================
+auto PatchView::const_iterator::operator++() -> const_iterator&
+{
+  ++_index;
+  _load();
+  return *this;
+}
+
+//==============================================================================
+auto PatchView::const_iterator::operator++(int) -> const_iterator
+{
+  const_iterator original = *this;
+  ++(*this);
+  return original;
+}
+
+//==============================================================================
+bool PatchView::const_iterator::operator==(const const_iterator& other) const
+{
+  return _view == other._view && _index == other._index;
+}
+
+//==============================================================================
+bool PatchView::const_iterator::operator!=(const const_iterator& other) const
+{
+  return !(*this == other);
+}
+
+//==============================================================================
+PatchView::const_iterator::const_iterator()
+  : _view(nullptr),
+    _next(nullptr),
+    _index(0),
+    _change()
+{
+  // Do nothing
+}
+
+//==============================================================================
+void PatchView::const_iterator::_load()
+{
+  const Implementation& impl = *_view->_pimpl;
+  if(_index >= impl.size)
+    return;
+
+  internal::BinaryReader reader(_next, impl.end);
+  Implementation::read_change(reader, impl.tables, &_change);
+  _next = reader.position();
+}
+
+//==============================================================================
+PatchView::PatchView(const uint8_t* const data, const std::size_t size)
+{
+  internal::BinaryReader reader(data, data + size);
+  check_header(reader, PatchMagic, "patch");
+
+  const Version latest_version = reader.get<Version>();
+
+  auto tables = std::make_shared<internal::EncodingTables>();
+  tables->read(reader);
+
+  const uint64_t num_changes = reader.get_varint();
+  if(num_changes > reader.remaining())
+    internal::throw_encoding_error("Invalid number of changes");
+
+  const uint8_t* const changes = reader.position();
+
+  // Check the whole patch now so that iterating through it later can only
+  // fail if the data has been modified.
+  for(uint64_t i=0; i < num_changes; ++i)
+    Implementation::read_change(reader, tables, nullptr);
+
+  if(reader.remaining() > 0)
+    internal::throw_encoding_error("Unexpected data after patch");
+
+  _pimpl = rmf_utils::make_impl<Implementation>(
+        Implementation{
+          std::move(tables),
+          latest_version,
+          static_cast<std::size_t>(num_changes),
+          changes,
+          reader.end()
+        });
+}
+
+//==============================================================================
+PatchView::PatchView(const std::vector<uint8_t>& data)
+  : PatchView(data.data(), data.size())
+{
+  // Do nothing
+}
+
+//==============================================================================
+Version PatchView::latest_version() const
+{
+  return _pimpl->latest_version;
+}
+
+//==============================================================================
+std::size_t PatchView::size() const
+{
+  return _pimpl->size;
+}
+
+//==============================================================================
+auto PatchView::begin() const -> const_iterator
+{
+  const_iterator it;
+  it._view = this;
+  it._next = _pimpl->changes;
+  it._load();
+  return it;
+}
+
+//==============================================================================
+auto PatchView::end() const -> const_iterator
+{
+  const_iterator it;
+  it._view = this;
+  it._index = _pimpl->size;
+  return it;
+}
+
+//==============================================================================
+Database::Patch PatchView::decode() const
+{
+  using Mode = Database::Change::Mode;
+
+  const internal::EncodingTables& tables = *_pimpl->tables;
+  const std::vector<Trajectory::ProfilePtr> profiles = tables.decode_profiles();
+
+  const auto decode_trajectory = [&](const Change& change)
+  {
+    return internal::decode_trajectory(
+          change._trajectory->_pimpl->body, tables, profiles);
+  };
+
+  std::vector<Database::Change> changes;
+  changes.reserve(_pimpl->size);
+  for(const Change& change : *this)
+  {
+    switch(change.get_mode())
+    {
+      case Mode::Insert:
+        changes.emplace_back(
+              Database::Change::make_insert(
+                decode_trajectory(change), change.id()));
+        break;
+      case Mode::Interrupt:
+        changes.emplace_back(
+              Database::Change::make_interrupt(
+                change.original_id(), decode_trajectory(change),
+                change.duration(), change.id()));
+        break;
+      case Mode::Delay:
+        changes.emplace_back(
+              Database::Change::make_delay(
+                change.original_id(), change.time(), change.duration(),
+                change.id()));
+        break;
+      case Mode::Replace:
+        changes.emplace_back(
+              Database::Change::make_replace(
+                change.original_id(), decode_trajectory(change), change.id()));
+        break;
+      case Mode::Erase:
+        changes.emplace_back(
+              Database::Change::make_erase(change.original_id(), change.id()));
+        break;
+      case Mode::Cull:
+        changes.emplace_back(
+              Database::Change::make_cull(change.time(), change.id()));
+        break;
+      default:
+        break;
+    }
+  }
+
+  return Database::Patch(std::move(changes), _pimpl->latest_version);
+}
+
+} // namespace schedule
+} // namespace rmf_traffic
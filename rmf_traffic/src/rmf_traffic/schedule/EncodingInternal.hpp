@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC__SCHEDULE__ENCODINGINTERNAL_HPP
+#define SRC__RMF_TRAFFIC__SCHEDULE__ENCODINGINTERNAL_HPP
+
+#include <rmf_traffic/Trajectory.hpp>
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace rmf_traffic {
+namespace schedule {
+namespace internal {
+
+//==============================================================================
+[[noreturn]] void throw_encoding_error(const std::string& message);
+
+//==============================================================================
+/// Appends values to a buffer of bytes. Fixed-size values are written in the
+/// byte order of the machine.
+class BinaryWriter
+{
+public:
+
+  template<typename T>
+  void put(const T& value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable types can be written directly");
+    put_bytes(&value, sizeof(T));
+  }
+
+  void put_bytes(const void* data, const std::size_t size)
+  {
+    const uint8_t* const bytes = static_cast<const uint8_t*>(data);
+    _data.insert(_data.end(), bytes, bytes + size);
+  }
+
+  /// Write an unsigned integer using as few bytes as its value needs.
+  void put_varint(uint64_t value)
+  {
+    while(value >= 0x80)
+    {
+      _data.push_back(static_cast<uint8_t>(value | 0x80));
+      value >>= 7;
+    }
+    _data.push_back(static_cast<uint8_t>(value));
+  }
+
+  /// Write a signed integer using as few bytes as its magnitude needs.
+  void put_signed_varint(const int64_t value)
+  {
+    put_varint((static_cast<uint64_t>(value) << 1)
+               ^ static_cast<uint64_t>(value >> 63));
+  }
+
+  void put_string(const std::string& value)
+  {
+    put_varint(value.size());
+    put_bytes(value.data(), value.size());
+  }
+
+  void put_time(const Time time)
+  {
+    put<int64_t>(time.time_since_epoch().count());
+  }
+
+  void put_duration(const Duration duration)
+  {
+    put_signed_varint(duration.count());
+  }
+
+  void put_vector(const Eigen::Vector3d& v)
+  {
+    put<double>(v[0]);
+    put<double>(v[1]);
+    put<double>(v[2]);
+  }
+
+  std::size_t size() const
+  {
+    return _data.size();
+  }
+
+  std::vector<uint8_t>& data()
+  {
+    return _data;
+  }
+
+  const std::vector<uint8_t>& data() const
+  {
+    return _data;
+  }
+
+private:
+  std::vector<uint8_t> _data;
+};
+
+//==============================================================================
+/// Reads values out of a range of bytes without copying the range. Every read
+/// is checked against the end of the range, and an exception is thrown if the
+/// data ends too early.
+class BinaryReader
+{
+public:
+
+  BinaryReader(const uint8_t* begin, const uint8_t* end)
+    : _it(begin),
+      _end(end)
+  {
+    // Do nothing
+  }
+
+  template<typename T>
+  T get()
+  {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "Only trivially copyable types can be read directly");
+    require(sizeof(T));
+    T value;
+    std::memcpy(&value, _it, sizeof(T));
+    _it += sizeof(T);
+    return value;
+  }
+
+  uint64_t get_varint()
+  {
+    uint64_t value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7)
+    {
+      require(1);
+      const uint8_t byte = *_it++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if(!(byte & 0x80))
+        return value;
+    }
+
+    throw_encoding_error("Invalid variable-length integer");
+  }
+
+  int64_t get_signed_varint()
+  {
+    const uint64_t value = get_varint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  std::string get_string()
+  {
+    const std::size_t size = get_size();
+    std::string value(reinterpret_cast<const char*>(_it), size);
+    _it += size;
+    return value;
+  }
+
+  Time get_time()
+  {
+    return Time(Duration(get<int64_t>()));
+  }
+
+  Duration get_duration()
+  {
+    return Duration(get_signed_varint());
+  }
+
+  Eigen::Vector3d get_vector()
+  {
+    const double x = get<double>();
+    const double y = get<double>();
+    const double z = get<double>();
+    return Eigen::Vector3d(x, y, z);
+  }
+
+  /// Read a varint that describes the size of something that follows it, and
+  /// make sure that there is enough data left for it.
+  std::size_t get_size()
+  {
+    const uint64_t size = get_varint();
+    require(size);
+    return static_cast<std::size_t>(size);
+  }
+
+  std::size_t remaining() const
+  {
+    return static_cast<std::size_t>(_end - _it);
+  }
+
+  const uint8_t* position() const
+  {
+    return _it;
+  }
+
+  const uint8_t* end() const
+  {
+    return _end;
+  }
+
+  void skip(const std::size_t size)
+  {
+    require(size);
+    _it += size;
+  }
+
+private:
+
+  void require(const uint64_t size) const
+  {
+    if(remaining() < size)
+      throw_encoding_error("Unexpected end of data");
+  }
+
+  const uint8_t* _it;
+  const uint8_t* _end;
+};
+
+//==============================================================================
+/// Collects the map names, shapes, and profiles that are used by a set of
+/// trajectories so that each one only gets written once. Profiles and shapes
+/// are deduplicated by their contents, so trajectories that were decoded
+/// separately will still share their entries.
+class EncodingTableBuilder
+{
+public:
+
+  uint64_t map(const std::string& name);
+
+  uint64_t profile(const Trajectory::ConstProfilePtr& profile);
+
+  void write(BinaryWriter& writer) const;
+
+private:
+
+  uint64_t shape(const geometry::ConstFinalConvexShapePtr& shape);
+
+  std::unordered_map<std::string, uint64_t> _map_indices;
+  std::unordered_map<std::string, uint64_t> _shape_indices;
+  std::unordered_map<std::string, uint64_t> _profile_indices;
+
+  // Most segments share their profile object with the segment before them, so
+  // this lets us skip encoding the same profile over and over.
+  std::unordered_map<const Trajectory::Profile*, uint64_t> _known_profiles;
+  std::vector<Trajectory::ConstProfilePtr> _keep_alive;
+
+  BinaryWriter _maps;
+  BinaryWriter _shapes;
+  BinaryWriter _profiles;
+};
+
+//==============================================================================
+/// The tables that were written by an EncodingTableBuilder. This only keeps
+/// pointers into the encoded data, which must outlive it.
+class EncodingTables
+{
+public:
+
+  /// Read the tables and advance the reader past them.
+  void read(BinaryReader& reader);
+
+  std::string map_name(uint64_t index) const;
+
+  std::size_t num_maps() const;
+
+  std::size_t num_profiles() const;
+
+  /// Construct all of the profiles in the table. Each shape is only
+  /// constructed once, no matter how many profiles use it.
+  std::vector<Trajectory::ProfilePtr> decode_profiles() const;
+
+private:
+  std::vector<std::pair<const uint8_t*, std::size_t>> _maps;
+  std::vector<const uint8_t*> _shapes;
+  std::vector<const uint8_t*> _profiles;
+  const uint8_t* _end = nullptr;
+};
+
+//==============================================================================
+/// The location of a trajectory within encoded data. The segments are decoded
+/// lazily with read_segment().
+struct TrajectoryBody
+{
+  uint64_t map;
+  uint64_t size;
+  Time start_time;
+  Time finish_time;
+  const uint8_t* segments;
+  const uint8_t* end;
+};
+
+//==============================================================================
+struct SegmentRecord
+{
+  Time finish_time;
+  uint64_t profile;
+
+  // Points to the finish position followed by the finish velocity, each as
+  // three doubles.
+  const uint8_t* vectors;
+};
+
+//==============================================================================
+/// Write the body of a trajectory whose map name and profiles get put into
+/// the given tables.
+void write_trajectory_body(
+    BinaryWriter& writer,
+    const Trajectory& trajectory,
+    EncodingTableBuilder& tables);
+
+//==============================================================================
+/// Read the location of a trajectory body and advance the reader past it.
+TrajectoryBody read_trajectory_body(
+    BinaryReader& reader,
+    const EncodingTables& tables);
+
+//==============================================================================
+/// Read the next segment of a trajectory body, starting from the position of
+/// the reader. The finish time of the previous segment is needed because the
+/// times are delta-encoded.
+SegmentRecord read_segment(
+    BinaryReader& reader,
+    Time previous_finish_time,
+    std::size_t num_profiles);
+
+//==============================================================================
+Eigen::Vector3d read_position(const SegmentRecord& segment);
+
+//==============================================================================
+Eigen::Vector3d read_velocity(const SegmentRecord& segment);
+
+//==============================================================================
+Trajectory decode_trajectory(
+    const TrajectoryBody& body,
+    const EncodingTables& tables,
+    const std::vector<Trajectory::ProfilePtr>& profiles);
+
+//==============================================================================
+/// Write a trajectory along with its own tables.
+void write_trajectory(BinaryWriter& writer, const Trajectory& trajectory);
+
+//==============================================================================
+/// Read a trajectory that was written by write_trajectory().
+Trajectory read_trajectory(BinaryReader& reader);
+
+} // namespace internal
+} // namespace schedule
+} // namespace rmf_traffic
+
+#endif // SRC__RMF_TRAFFIC__SCHEDULE__ENCODINGINTERNAL_HPP
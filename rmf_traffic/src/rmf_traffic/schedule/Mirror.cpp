@@ -76,7 +76,13 @@ Mirror::Mirror()
           delay.from(),
           delay.duration());
 
-    _pimpl->modify_entry(entry, std::move(new_trajectory), change.id());
+    const Duration duration = delay.duration();
+    const bool whole = is_delayed_as_whole(
+          entry->trajectory, new_trajectory, duration);
+
+    _pimpl->modify_entry(
+          entry, std::move(new_trajectory), change.id(),
+          whole? &duration : nullptr);
   };
 
   _pimpl->changers[static_cast<std::size_t>(Database::Change::Mode::Replace)]
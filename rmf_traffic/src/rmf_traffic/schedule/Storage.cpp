@@ -0,0 +1,765 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "EncodingInternal.hpp"
+#include "ViewerInternal.hpp"
+
+#include <rmf_traffic/schedule/Storage.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rmf_traffic {
+namespace schedule {
+
+namespace {
+
+//==============================================================================
+const char SnapshotMagic[8] = {'R', 'M', 'F', 'S', 'N', 'A', 'P', '\0'};
+const char LogMagic[8] = {'R', 'M', 'F', 'L', 'O', 'G', '\0', '\0'};
+const uint32_t FormatVersion = 2;
+
+//==============================================================================
+[[noreturn]] void throw_storage_error(const std::string& message)
+{
+  throw std::runtime_error("[rmf_traffic::schedule::Storage] " + message);
+}
+
+//==============================================================================
+using Writer = internal::BinaryWriter;
+using Reader = internal::BinaryReader;
+
+//==============================================================================
+/// A read-only memory mapping of a whole file. If the file does not exist or
+/// is empty, the mapping will be empty.
+class MappedFile
+{
+public:
+
+  MappedFile(const std::string& path)
+  {
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if(_fd < 0)
+      return;
+
+    struct stat info;
+    if(::fstat(_fd, &info) != 0 || info.st_size == 0)
+      return;
+
+    void* const data = ::mmap(
+          nullptr, static_cast<std::size_t>(info.st_size),
+          PROT_READ, MAP_PRIVATE, _fd, 0);
+
+    if(data == MAP_FAILED)
+      throw_storage_error("Failed to map file [" + path + "] into memory");
+
+    _data = static_cast<const uint8_t*>(data);
+    _size = static_cast<std::size_t>(info.st_size);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* begin() const
+  {
+    return _data;
+  }
+
+  const uint8_t* end() const
+  {
+    return _data + _size;
+  }
+
+  bool empty() const
+  {
+    return _size == 0;
+  }
+
+  ~MappedFile()
+  {
+    if(_data)
+      ::munmap(const_cast<uint8_t*>(_data), _size);
+
+    if(_fd >= 0)
+      ::close(_fd);
+  }
+
+private:
+  int _fd = -1;
+  const uint8_t* _data = nullptr;
+  std::size_t _size = 0;
+};
+
+//==============================================================================
+// Flags for entry records
+const uint8_t EntryIsIndexed = 1 << 0;
+const uint8_t EntryHasPredecessor = 1 << 1;
+
+//==============================================================================
+/// Write the record of an entry. Indexed entries are the ones that belong in
+/// the all_entries map of the Database. Entries that are not indexed have been
+/// culled, but are still needed as part of the lineage of an indexed entry.
+///
+/// The trajectories of delays and interruptions are not written, because they
+/// can be rebuilt from the trajectory of the entry that they succeed.
+void write_entry(
+    Writer& writer,
+    const internal::Entry& entry,
+    const bool indexed)
+{
+  using Mode = Database::Change::Mode;
+
+  writer.put<Version>(entry.version);
+
+  uint8_t flags = 0;
+  if(indexed)
+    flags |= EntryIsIndexed;
+  if(entry.succeeds)
+    flags |= EntryHasPredecessor;
+  writer.put<uint8_t>(flags);
+
+  if(entry.succeeds)
+    writer.put<Version>(entry.succeeds->version);
+
+  assert(entry.change);
+  const Database::Change& change = *entry.change;
+  const Mode mode = change.get_mode();
+  writer.put<Mode>(mode);
+  switch(mode)
+  {
+    case Mode::Insert:
+    case Mode::Replace:
+      // These changes refer to the trajectory of the entry itself
+      break;
+    case Mode::Interrupt:
+    {
+      const auto* interrupt = change.interrupt();
+      assert(interrupt->interruption());
+      internal::write_trajectory(writer, *interrupt->interruption());
+      writer.put_duration(interrupt->delay());
+      return;
+    }
+    case Mode::Delay:
+    {
+      const auto* delay = change.delay();
+      writer.put_time(delay->from());
+      writer.put_duration(delay->duration());
+      return;
+    }
+    case Mode::Erase:
+      break;
+    default:
+      throw_storage_error("Invalid change mode for an entry ["
+                          + std::to_string(static_cast<int>(mode)) + "]");
+  }
+
+  internal::write_trajectory(writer, entry.trajectory);
+}
+
+//==============================================================================
+/// Restores the records of a Database from snapshot and log files.
+class Restorer
+{
+public:
+
+  Restorer(Viewer::Implementation& database)
+    : _database(database)
+  {
+    // Entries are added to the journal all at once in finish(), because the
+    // journal needs placeholders for versions that do not have an entry.
+    _database.keep_journal = false;
+  }
+
+  void read_entry(Reader& reader)
+  {
+    using Mode = Database::Change::Mode;
+
+    const Version version = reader.get<Version>();
+    const uint8_t flags = reader.get<uint8_t>();
+
+    internal::EntryPtr predecessor;
+    if(flags & EntryHasPredecessor)
+    {
+      const Version predecessor_version = reader.get<Version>();
+      const auto it = _entries.find(predecessor_version);
+      if(it == _entries.end())
+      {
+        throw_storage_error(
+              "Missing entry [" + std::to_string(predecessor_version)
+              + "] which precedes entry [" + std::to_string(version) + "]");
+      }
+
+      predecessor = it->second;
+    }
+
+    const Version original_id = predecessor? predecessor->version : 0;
+    const Mode mode = reader.get<Mode>();
+    if(!predecessor && (mode == Mode::Interrupt || mode == Mode::Delay))
+    {
+      throw_storage_error(
+            "Entry [" + std::to_string(version) + "] changes an entry, but "
+            "does not have a predecessor");
+    }
+
+    internal::ChangePtr change;
+    rmf_utils::optional<Trajectory> trajectory;
+    rmf_utils::optional<Duration> whole_delay;
+    switch(mode)
+    {
+      case Mode::Insert:
+      case Mode::Replace:
+        break;
+      case Mode::Interrupt:
+      {
+        Trajectory interruption = internal::read_trajectory(reader);
+        const Duration delay = reader.get_duration();
+        trajectory = add_interruption(
+              predecessor->trajectory, interruption, delay);
+        change = std::make_unique<Database::Change>(
+              Database::Change::make_interrupt(
+                original_id, std::move(interruption), delay, version));
+        break;
+      }
+      case Mode::Delay:
+      {
+        const Time from = reader.get_time();
+        const Duration duration = reader.get_duration();
+        trajectory = add_delay(predecessor->trajectory, from, duration);
+        if(is_delayed_as_whole(predecessor->trajectory, *trajectory, duration))
+          whole_delay = duration;
+
+        change = std::make_unique<Database::Change>(
+              Database::Change::make_delay(
+                original_id, from, duration, version));
+        break;
+      }
+      case Mode::Erase:
+        change = std::make_unique<Database::Change>(
+              Database::Change::make_erase(original_id, version));
+        break;
+      default:
+        throw_storage_error("Invalid change mode for entry ["
+                            + std::to_string(version) + "]");
+    }
+
+    if(!trajectory)
+      trajectory = internal::read_trajectory(reader);
+
+    internal::EntryPtr entry;
+    if(change)
+    {
+      entry = std::make_shared<internal::Entry>(
+            std::move(*trajectory), version, predecessor, std::move(change));
+    }
+    else
+    {
+      entry = internal::make_entry_ref(
+            std::move(*trajectory), version, predecessor);
+    }
+
+    if(predecessor)
+      predecessor->succeeded_by = entry;
+
+    _entries[version] = entry;
+
+    if(flags & EntryIsIndexed)
+    {
+      _database.add_entry(
+            entry, mode == Mode::Erase, whole_delay? &*whole_delay : nullptr);
+    }
+  }
+
+  void finish(const Version latest_version)
+  {
+    _database.latest_version = latest_version;
+    _database.keep_journal = true;
+    _database.journal.clear();
+
+    const auto& all_entries = _database.all_entries;
+    if(all_entries.empty())
+      return;
+
+    Version v = all_entries.begin()->first;
+    while(true)
+    {
+      const auto it = all_entries.find(v);
+      _database.journal.push_back(
+            it == all_entries.end()? nullptr : it->second);
+
+      if(v == latest_version)
+        break;
+
+      ++v;
+    }
+  }
+
+private:
+  Viewer::Implementation& _database;
+  std::unordered_map<Version, internal::EntryPtr> _entries;
+};
+
+//==============================================================================
+/// FNV-1a hash, used to detect log records that were only partially written.
+uint32_t checksum(const uint8_t* data, const std::size_t size)
+{
+  uint32_t hash = 2166136261u;
+  for(std::size_t i=0; i < size; ++i)
+  {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+//==============================================================================
+void write_file(
+    std::FILE* file,
+    const std::vector<uint8_t>& data,
+    const std::string& path)
+{
+  if(std::fwrite(data.data(), 1, data.size(), file) != data.size()
+     || std::fflush(file) != 0
+     || ::fsync(::fileno(file)) != 0)
+  {
+    throw_storage_error("Failed to write to file [" + path + "]");
+  }
+}
+
+//==============================================================================
+/// Make sure that the entries of a directory, e.g. files that were created or
+/// renamed inside of it, will survive a crash.
+void sync_directory(const std::string& directory)
+{
+  const int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if(fd < 0)
+    throw_storage_error("Failed to open directory [" + directory + "]");
+
+  const bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+
+  if(!synced)
+    throw_storage_error("Failed to sync directory [" + directory + "]");
+}
+
+} // anonymous namespace
+
+//==============================================================================
+class Storage::Pending::Implementation
+{
+public:
+
+  // True if the data is a whole snapshot, false if it should be appended to
+  // the log.
+  bool snapshot;
+
+  // The latest version of the Database when this was prepared
+  Version latest_version;
+
+  std::vector<uint8_t> data;
+
+  static Pending make(
+      const bool snapshot,
+      const Version latest_version,
+      std::vector<uint8_t> data)
+  {
+    Pending pending;
+    pending._pimpl = rmf_utils::make_unique_impl<Implementation>(
+          Implementation{snapshot, latest_version, std::move(data)});
+    return pending;
+  }
+
+  static const Implementation& get(const Pending& pending)
+  {
+    return *pending._pimpl;
+  }
+};
+
+//==============================================================================
+Storage::Pending::Pending()
+{
+  // Do nothing
+}
+
+//==============================================================================
+class Storage::Implementation
+{
+public:
+
+  std::string directory;
+  std::string snapshot_path;
+  std::string log_path;
+
+  // This is only used by load() and write()
+  std::FILE* log_file = nullptr;
+
+  // The latest version that has been serialized by prepare(). This is nullopt
+  // if the files do not match any Database that we know of, in which case the
+  // next call to prepare() will produce a snapshot.
+  rmf_utils::optional<Version> prepared_version;
+
+  // write() sets this if it fails, so that the next call to prepare() will
+  // produce a snapshot that repairs the files.
+  std::atomic_bool write_failed;
+
+  Implementation(std::string _directory)
+    : directory(std::move(_directory)),
+      snapshot_path(directory + "/snapshot"),
+      log_path(directory + "/log"),
+      write_failed(false)
+  {
+    if(::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+      throw_storage_error("Failed to create directory [" + directory + "]");
+  }
+
+  void close_log()
+  {
+    if(log_file)
+      std::fclose(log_file);
+
+    log_file = nullptr;
+  }
+
+  Database load()
+  {
+    close_log();
+    prepared_version = rmf_utils::nullopt;
+    write_failed = false;
+
+    Database database;
+    Viewer::Implementation& impl = *database._pimpl;
+    Restorer restorer(impl);
+
+    const MappedFile snapshot(snapshot_path);
+    if(!snapshot.empty())
+    {
+      Reader reader(snapshot.begin(), snapshot.end());
+      if(reader.remaining() < sizeof(SnapshotMagic)
+         || std::memcmp(reader.position(), SnapshotMagic,
+                        sizeof(SnapshotMagic)) != 0)
+      {
+        throw_storage_error("[" + snapshot_path + "] is not a snapshot file");
+      }
+      reader.skip(sizeof(SnapshotMagic));
+
+      if(reader.get<uint32_t>() != FormatVersion)
+        throw_storage_error("Unsupported format for [" + snapshot_path + "]");
+
+      impl.latest_version = reader.get<Version>();
+      impl.oldest_version = reader.get<Version>();
+      impl.cull_has_occurred = reader.get<uint8_t>() != 0;
+      const Version cull_version = reader.get<Version>();
+      const Time cull_time = reader.get_time();
+      impl.last_cull = std::make_pair(cull_version, cull_time);
+
+      const uint64_t num_entries = reader.get<uint64_t>();
+      for(uint64_t i=0; i < num_entries; ++i)
+        restorer.read_entry(reader);
+    }
+
+    Version latest_version = impl.latest_version;
+
+    // If the log does not continue from the snapshot, then the process must
+    // have stopped after writing the snapshot but before clearing the log. In
+    // that case, everything in the log is already in the snapshot. If the end
+    // of the log is damaged, then we recover as much of it as we can. Either
+    // way, we will write a fresh snapshot the next time we save.
+    bool log_is_usable = false;
+    const MappedFile log(log_path);
+    if(!log.empty())
+    {
+      Reader reader(log.begin(), log.end());
+      if(reader.remaining() >= sizeof(LogMagic)
+         && std::memcmp(reader.position(), LogMagic, sizeof(LogMagic)) == 0)
+      {
+        reader.skip(sizeof(LogMagic));
+        if(reader.remaining() >= sizeof(uint32_t) + sizeof(Version)
+           && reader.get<uint32_t>() == FormatVersion
+           && reader.get<Version>() == latest_version)
+        {
+          log_is_usable = true;
+        }
+      }
+
+      while(log_is_usable && reader.remaining() > 0)
+      {
+        if(reader.remaining() < 2*sizeof(uint32_t))
+        {
+          log_is_usable = false;
+          break;
+        }
+
+        const uint32_t size = reader.get<uint32_t>();
+        const uint32_t expected_checksum = reader.get<uint32_t>();
+        if(reader.remaining() < size
+           || checksum(reader.position(), size) != expected_checksum)
+        {
+          log_is_usable = false;
+          break;
+        }
+
+        Reader record(reader.position(), reader.position() + size);
+        reader.skip(size);
+
+        // The versions in the log are contiguous, because culls always cause
+        // the log to be compacted.
+        Reader peek = record;
+        if(peek.get<Version>() != latest_version + 1)
+        {
+          log_is_usable = false;
+          break;
+        }
+
+        restorer.read_entry(record);
+        ++latest_version;
+      }
+    }
+
+    restorer.finish(latest_version);
+
+    if(log_is_usable || (log.empty() && !snapshot.empty()))
+    {
+      log_file = std::fopen(log_path.c_str(), "ab");
+      if(!log_file)
+        throw_storage_error("Failed to open [" + log_path + "]");
+
+      if(log.empty())
+        write_log_header(latest_version);
+
+      prepared_version = latest_version;
+    }
+
+    return database;
+  }
+
+  void write_log_header(const Version base_version)
+  {
+    Writer writer;
+    writer.put_bytes(LogMagic, sizeof(LogMagic));
+    writer.put<uint32_t>(FormatVersion);
+    writer.put<Version>(base_version);
+    write_file(log_file, writer.data(), log_path);
+  }
+
+  Pending prepare(const Database& database)
+  {
+    const Viewer::Implementation& impl = *database._pimpl;
+    if(write_failed.exchange(false))
+      prepared_version = rmf_utils::nullopt;
+
+    if(!prepared_version)
+      return prepare_snapshot(database);
+
+    if(*prepared_version == impl.latest_version)
+      return Pending::Implementation::make(false, impl.latest_version, {});
+
+    const internal::VersionRange versions(impl.oldest_version);
+    if(impl.cull_has_occurred
+       && versions.less(*prepared_version, impl.last_cull.first))
+    {
+      // A cull has happened, so we compact the log to forget the culled
+      // entries.
+      return prepare_snapshot(database);
+    }
+
+    Writer writer;
+    impl.for_each_entry_after(
+          *prepared_version, [&](const internal::ConstEntryPtr& entry)
+    {
+      Writer record;
+      write_entry(record, *entry, true);
+
+      const std::vector<uint8_t>& data = record.data();
+      writer.put<uint32_t>(static_cast<uint32_t>(data.size()));
+      writer.put<uint32_t>(checksum(data.data(), data.size()));
+      writer.put_bytes(data.data(), data.size());
+    });
+
+    prepared_version = impl.latest_version;
+    return Pending::Implementation::make(
+          false, impl.latest_version, std::move(writer.data()));
+  }
+
+  Pending prepare_snapshot(const Database& database)
+  {
+    const Viewer::Implementation& impl = *database._pimpl;
+
+    // Entries that have been culled may still be part of the lineage of
+    // entries that have not been culled, so we need to save them too.
+    std::map<Version, internal::ConstEntryPtr> entries;
+    std::vector<internal::ConstEntryPtr> queue;
+    for(const auto& element : impl.all_entries)
+      queue.push_back(element.second);
+
+    while(!queue.empty())
+    {
+      const internal::ConstEntryPtr entry = queue.back();
+      queue.pop_back();
+      if(!entries.insert(std::make_pair(entry->version, entry)).second)
+        continue;
+
+      if(entry->succeeds)
+        queue.push_back(entry->succeeds);
+
+      if(entry->succeeded_by)
+        queue.push_back(entry->succeeded_by);
+    }
+
+    Writer writer;
+    writer.put_bytes(SnapshotMagic, sizeof(SnapshotMagic));
+    writer.put<uint32_t>(FormatVersion);
+    writer.put<Version>(impl.latest_version);
+    writer.put<Version>(impl.oldest_version);
+    writer.put<uint8_t>(impl.cull_has_occurred? 1 : 0);
+    writer.put<Version>(impl.last_cull.first);
+    writer.put_time(impl.last_cull.second);
+    writer.put<uint64_t>(entries.size());
+    for(const auto& element : entries)
+    {
+      const bool indexed =
+          impl.all_entries.find(element.first) != impl.all_entries.end();
+      write_entry(writer, *element.second, indexed);
+    }
+
+    prepared_version = impl.latest_version;
+    return Pending::Implementation::make(
+          true, impl.latest_version, std::move(writer.data()));
+  }
+
+  void write(const Pending::Implementation& pending)
+  {
+    try
+    {
+      if(pending.snapshot)
+        return write_snapshot(pending);
+
+      // If there is no log file, then an earlier write failed, and the next
+      // snapshot will include these changes.
+      if(pending.data.empty() || !log_file)
+        return;
+
+      write_file(log_file, pending.data, log_path);
+    }
+    catch(const std::exception&)
+    {
+      close_log();
+      write_failed = true;
+      throw;
+    }
+  }
+
+  void write_snapshot(const Pending::Implementation& pending)
+  {
+    // The snapshot is written to a temporary file first so that a complete
+    // snapshot is always available, even if we are interrupted.
+    const std::string temp_path = snapshot_path + ".tmp";
+    std::FILE* temp_file = std::fopen(temp_path.c_str(), "wb");
+    if(!temp_file)
+      throw_storage_error("Failed to open [" + temp_path + "]");
+
+    try
+    {
+      write_file(temp_file, pending.data, temp_path);
+    }
+    catch(const std::exception&)
+    {
+      std::fclose(temp_file);
+      throw;
+    }
+    std::fclose(temp_file);
+    sync_directory(directory);
+
+    if(std::rename(temp_path.c_str(), snapshot_path.c_str()) != 0)
+      throw_storage_error("Failed to replace [" + snapshot_path + "]");
+
+    // The new snapshot must be in place before the log gets cleared. Otherwise
+    // a crash could leave us with the old snapshot and an empty log, and every
+    // version since the old snapshot would be lost.
+    sync_directory(directory);
+
+    close_log();
+    log_file = std::fopen(log_path.c_str(), "wb");
+    if(!log_file)
+      throw_storage_error("Failed to open [" + log_path + "]");
+
+    write_log_header(pending.latest_version);
+  }
+
+  ~Implementation()
+  {
+    close_log();
+  }
+};
+
+//==============================================================================
+Storage::Storage(std::string directory)
+  : _pimpl(rmf_utils::make_unique_impl<Implementation>(std::move(directory)))
+{
+  // Do nothing
+}
+
+//==============================================================================
+const std::string& Storage::directory() const
+{
+  return _pimpl->directory;
+}
+
+//==============================================================================
+Database Storage::load()
+{
+  return _pimpl->load();
+}
+
+//==============================================================================
+auto Storage::prepare(const Database& database) -> Pending
+{
+  return _pimpl->prepare(database);
+}
+
+//==============================================================================
+void Storage::write(Pending pending)
+{
+  _pimpl->write(Pending::Implementation::get(pending));
+}
+
+//==============================================================================
+void Storage::save(const Database& database)
+{
+  write(prepare(database));
+}
+
+//==============================================================================
+void Storage::compact(const Database& database)
+{
+  write(_pimpl->prepare_snapshot(database));
+}
+
+} // namespace schedule
+} // namespace rmf_traffic
@@ -24,6 +24,9 @@
 #include <rmf_traffic/schedule/Database.hpp>
 #include "debug_Viewer.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 namespace rmf_traffic {
 namespace schedule {
 
@@ -37,6 +40,9 @@ const Duration BucketDuration = std::chrono::minutes(1);
 // potentially not be very useful.
 const Duration PartialBucketDuration = std::chrono::seconds(50);
 
+// Each cell of a spatial index is a square with sides of 5 meters.
+const double SpatialCellSize = 5.0;
+
 } // anonymous namespace
 
 namespace internal {
@@ -54,6 +60,162 @@ Entry::Entry(Trajectory _trajectory,
   // Do nothing
 }
 
+//==============================================================================
+SpatialIndex::SpatialIndex(const double cell_size)
+  : _cell_size(cell_size)
+{
+  // Do nothing
+}
+
+//==============================================================================
+void SpatialIndex::insert(const ConstEntryPtr& entry)
+{
+  const Trajectory& trajectory = entry->trajectory;
+  if(trajectory.size() == 0)
+    return;
+
+  // The span of time that the entry spends in each cell that it touches
+  using Span = std::pair<Time, Time>;
+  std::unordered_map<CellKey, Span, CellKeyHash> spans;
+
+  const auto occupy = [&](
+      const rmf_traffic::internal::BoundingBox& box,
+      const Time start,
+      const Time finish)
+  {
+    const CellKey min = get_key(box.min);
+    const CellKey max = get_key(box.max);
+    for(int64_t x = min.x; x <= max.x; ++x)
+    {
+      for(int64_t y = min.y; y <= max.y; ++y)
+      {
+        const auto insertion =
+            spans.insert(std::make_pair(CellKey{x, y}, Span(start, finish)));
+
+        if(!insertion.second)
+        {
+          Span& span = insertion.first->second;
+          span.first = std::min(span.first, start);
+          span.second = std::max(span.second, finish);
+        }
+      }
+    }
+  };
+
+  Trajectory::const_iterator it = trajectory.begin();
+  const Eigen::Vector2d p = it->get_finish_position().block<2,1>(0,0);
+  Time previous_time = it->get_finish_time();
+  occupy(rmf_traffic::internal::get_bounding_box(
+           {p, p}, it->get_profile()->get_shape()->get_characteristic_length()),
+         previous_time, previous_time);
+
+  for(++it; it != trajectory.end(); ++it)
+  {
+    const Time finish_time = it->get_finish_time();
+    occupy(rmf_traffic::internal::get_bounding_box(it),
+           previous_time, finish_time);
+    previous_time = finish_time;
+  }
+
+  std::vector<CellKey>& occupied = _occupied_cells[entry.get()];
+  occupied.reserve(occupied.size() + spans.size());
+  for(const auto& span : spans)
+  {
+    _cells[span.first].push_back(
+          Occupant{entry, span.second.first, span.second.second});
+    occupied.push_back(span.first);
+  }
+}
+
+//==============================================================================
+void SpatialIndex::insert_shifted(
+    const ConstEntryPtr& entry,
+    const Entry* const original,
+    const Duration delta)
+{
+  const auto original_it = _occupied_cells.find(original);
+  if(original_it == _occupied_cells.end())
+    return insert(entry);
+
+  // Copy the keys because inserting into _occupied_cells may invalidate
+  // original_it.
+  const std::vector<CellKey> keys = original_it->second;
+  for(const CellKey& key : keys)
+  {
+    Cell& cell = _cells.at(key);
+    const std::size_t N = cell.size();
+    for(std::size_t i=0; i < N; ++i)
+    {
+      const Occupant& occupant = cell[i];
+      if(occupant.entry.get() != original)
+        continue;
+
+      cell.push_back(
+            Occupant{entry, occupant.start + delta, occupant.finish + delta});
+      break;
+    }
+  }
+
+  std::vector<CellKey>& occupied = _occupied_cells[entry.get()];
+  occupied.insert(occupied.end(), keys.begin(), keys.end());
+}
+
+//==============================================================================
+void SpatialIndex::shift(const Entry* const entry, const Duration delta)
+{
+  const auto occupied_it = _occupied_cells.find(entry);
+  if(occupied_it == _occupied_cells.end())
+    return;
+
+  for(const CellKey& key : occupied_it->second)
+  {
+    for(Occupant& occupant : _cells.at(key))
+    {
+      if(occupant.entry.get() != entry)
+        continue;
+
+      occupant.start += delta;
+      occupant.finish += delta;
+    }
+  }
+}
+
+//==============================================================================
+void SpatialIndex::erase(const Entry* entry)
+{
+  const auto occupied_it = _occupied_cells.find(entry);
+  if(occupied_it == _occupied_cells.end())
+    return;
+
+  for(const CellKey& key : occupied_it->second)
+  {
+    const auto cell_it = _cells.find(key);
+    if(cell_it == _cells.end())
+      continue;
+
+    Cell& cell = cell_it->second;
+    cell.erase(std::remove_if(cell.begin(), cell.end(),
+                              [&](const Occupant& occupant)
+    {
+      return occupant.entry.get() == entry;
+    }), cell.end());
+
+    if(cell.empty())
+      _cells.erase(cell_it);
+  }
+
+  _occupied_cells.erase(occupied_it);
+}
+
+//==============================================================================
+auto SpatialIndex::get_key(const Eigen::Vector2d& p) const -> CellKey
+{
+  return CellKey{
+    static_cast<int64_t>(std::floor(p[0]/_cell_size)),
+    static_cast<int64_t>(std::floor(p[1]/_cell_size))
+  };
+}
+
 //==============================================================================
 VersionRange::VersionRange(const Version oldest)
   : _oldest(oldest)
@@ -144,10 +306,17 @@ void ViewRelevanceInspector::inspect(
 //==============================================================================
 internal::EntryPtr Viewer::Implementation::add_entry(
     internal::EntryPtr entry,
-    const bool erasure)
+    const bool erasure,
+    const Duration* const shift)
 {
   all_entries.insert(std::make_pair(entry->version, entry));
 
+  if(keep_journal)
+  {
+    assert(entry->version == latest_version);
+    journal.push_back(entry);
+  }
+
   if(!erasure)
   {
     const Trajectory& trajectory = entry->trajectory;
@@ -171,6 +340,16 @@ internal::EntryPtr Viewer::Implementation::add_entry(
     {
       it->second.push_back(entry);
     }
+
+    internal::SpatialIndex& index = spatial_indices.insert(
+          std::make_pair(trajectory.get_map_name(),
+                         internal::SpatialIndex(SpatialCellSize)))
+        .first->second;
+
+    if(shift && entry->succeeds)
+      index.insert_shifted(entry, entry->succeeds.get(), *shift);
+    else
+      index.insert(entry);
   }
 
   return entry;
@@ -178,9 +357,12 @@ internal::EntryPtr Viewer::Implementation::add_entry(
 
 //==============================================================================
 void Viewer::Implementation::modify_entry(
-    const internal::EntryPtr& entry,
+    // Note: This is taken by value because the caller's reference usually
+    // points into all_entries, which we modify below.
+    const internal::EntryPtr entry,
     Trajectory new_trajectory,
-    const Version new_id)
+    const Version new_id,
+    const Duration* const shift)
 {
   const Version old_version = entry->version;
   all_entries.erase(old_version);
@@ -208,7 +390,27 @@ void Viewer::Implementation::modify_entry(
   const Timeline::iterator new_end_it =
       get_timeline_iterator(timeline, new_end);
 
-  entry->trajectory = std::move(new_trajectory);
+  internal::SpatialIndex& old_index =
+      spatial_indices.at(entry->trajectory.get_map_name());
+
+  if(shift)
+  {
+    // The trajectory was delayed as a whole, so it still passes through the
+    // same cells.
+    old_index.shift(entry.get(), *shift);
+    entry->trajectory = std::move(new_trajectory);
+  }
+  else
+  {
+    old_index.erase(entry.get());
+
+    entry->trajectory = std::move(new_trajectory);
+
+    spatial_indices.insert(
+          std::make_pair(entry->trajectory.get_map_name(),
+                         internal::SpatialIndex(SpatialCellSize)))
+        .first->second.insert(entry);
+  }
 
   // Fix the bucketing for this entry
   if(old_end_it->first < new_start_it->first
@@ -291,6 +493,8 @@ void Viewer::Implementation::erase_entry(Version id)
                  bucket.end());
   }
 
+  spatial_indices.at(entry->trajectory.get_map_name()).erase(entry.get());
+
   all_entries.erase(id);
 }
 
@@ -379,18 +583,25 @@ void Viewer::Implementation::cull(Version id, Time time)
     const Timeline::iterator end_it = last_it == timeline.end()?
           timeline.end() : ++Timeline::iterator(last_it);
 
+    internal::SpatialIndex& index = spatial_indices.at(pair.first);
+
     for(Timeline::iterator it = timeline.begin(); it != end_it; ++it)
     {
       Bucket& bucket = it->second;
+      // Note: We use stable_partition instead of remove_if because we need the
+      // removed entries to remain valid after they have been moved.
       const Bucket::iterator removed =
-          std::remove_if(bucket.begin(), bucket.end(),
+          std::stable_partition(bucket.begin(), bucket.end(),
                      [&](const internal::ConstEntryPtr& entry) -> bool
       {
-        return *entry->trajectory.finish_time() < time;
+        return !(*entry->trajectory.finish_time() < time);
       });
 
       for(Bucket::iterator bit = removed; bit != bucket.end(); ++bit)
-        culled.insert((*bit)->version);
+      {
+        if(culled.insert((*bit)->version).second)
+          index.erase(bit->get());
+      }
 
       bucket.erase(removed, bucket.end());
     }
@@ -412,6 +623,23 @@ void Viewer::Implementation::cull(Version id, Time time)
     timeline.erase(timeline.begin(), stop_erasing);
   }
 
+  if(keep_journal)
+  {
+    // The cull itself does not have an entry
+    assert(id == latest_version);
+    journal.push_back(nullptr);
+
+    for(const Version v : culled)
+    {
+      const Version age = latest_version - v;
+      if(age < journal.size())
+        journal[journal.size() - 1 - age] = nullptr;
+    }
+
+    while(!journal.empty() && !journal.front())
+      journal.pop_front();
+  }
+
   for(const Version v : culled)
     all_entries.erase(v);
 
@@ -499,6 +727,17 @@ Trajectory add_delay(
   return new_trajectory;
 }
 
+//==============================================================================
+bool is_delayed_as_whole(
+    const Trajectory& old_trajectory,
+    const Trajectory& new_trajectory,
+    const Duration delay)
+{
+  // add_delay() only changes the start time of a trajectory when it delays
+  // the whole thing.
+  return *new_trajectory.start_time() - *old_trajectory.start_time() == delay;
+}
+
 //==============================================================================
 class Viewer::View::Implementation
 {
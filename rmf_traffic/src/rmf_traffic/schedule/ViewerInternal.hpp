@@ -23,9 +23,12 @@
 #include <rmf_traffic/schedule/Viewer.hpp>
 #include <rmf_traffic/schedule/Database.hpp>
 
+#include <cstdint>
+#include <deque>
 #include <map>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace rmf_traffic {
 namespace schedule {
@@ -64,6 +67,150 @@ struct Entry
       ChangePtr _change = nullptr);
 };
 
+//==============================================================================
+/// Make an entry whose change refers to its own trajectory. If succeeds is a
+/// nullptr, the change will be an Insert. Otherwise it will be a Replace of the
+/// entry that it succeeds.
+EntryPtr make_entry_ref(
+    Trajectory trajectory,
+    Version version,
+    ConstEntryPtr succeeds = nullptr);
+
+//==============================================================================
+/// A uniform grid over the x-y plane of one map. Each cell keeps track of the
+/// entries whose swept bounding boxes pass through it, along with the span of
+/// time during which they pass through it. This allows spacetime region
+/// queries to skip the narrow-phase collision checks for entries that are not
+/// nearby in both space and time.
+class SpatialIndex
+{
+public:
+
+  struct Occupant
+  {
+    ConstEntryPtr entry;
+    Time start;
+    Time finish;
+  };
+
+  using Cell = std::vector<Occupant>;
+
+  struct CellKey
+  {
+    int64_t x;
+    int64_t y;
+
+    bool operator==(const CellKey& other) const
+    {
+      return x == other.x && y == other.y;
+    }
+  };
+
+  struct CellKeyHash
+  {
+    std::size_t operator()(const CellKey& key) const
+    {
+      return std::hash<int64_t>()(key.x) ^ (std::hash<int64_t>()(key.y) << 1);
+    }
+  };
+
+  /// Constructor
+  ///
+  /// \param[in] cell_size
+  ///   The length (in meters) of each side of each square cell in the grid.
+  SpatialIndex(double cell_size);
+
+  /// Add an entry to the cells that its trajectory passes through.
+  void insert(const ConstEntryPtr& entry);
+
+  /// Add an entry whose trajectory is the trajectory of another entry in this
+  /// index, shifted in time by delta. The entry reuses the cells of the
+  /// original entry, so none of its segments need to be inspected. If the
+  /// original entry is not in this index, this is the same as insert(entry).
+  void insert_shifted(
+      const ConstEntryPtr& entry,
+      const Entry* original,
+      Duration delta);
+
+  /// Shift the time spans of an entry that is already in the index. This
+  /// should be used when the trajectory of the entry has been delayed as a
+  /// whole.
+  void shift(const Entry* entry, Duration delta);
+
+  /// Remove an entry from all the cells that it was inserted into.
+  void erase(const Entry* entry);
+
+  /// Call f(entry) for each entry that occupies a cell that overlaps with the
+  /// box during a time span that overlaps with the time bounds. An entry might
+  /// be passed to f multiple times if it occupies multiple cells.
+  template<typename F>
+  void for_each_candidate(
+      const rmf_traffic::internal::BoundingBox& box,
+      const Time* lower_time_bound,
+      const Time* upper_time_bound,
+      const F& f) const
+  {
+    const auto inspect_cell = [&](const Cell& cell)
+    {
+      for(const Occupant& occupant : cell)
+      {
+        if(lower_time_bound && occupant.finish < *lower_time_bound)
+          continue;
+
+        if(upper_time_bound && *upper_time_bound < occupant.start)
+          continue;
+
+        f(occupant.entry);
+      }
+    };
+
+    const CellKey min = get_key(box.min);
+    const CellKey max = get_key(box.max);
+    const double num_cells_in_box =
+        static_cast<double>(max.x - min.x + 1)
+        * static_cast<double>(max.y - min.y + 1);
+
+    if(num_cells_in_box <= static_cast<double>(_cells.size()))
+    {
+      for(int64_t x = min.x; x <= max.x; ++x)
+      {
+        for(int64_t y = min.y; y <= max.y; ++y)
+        {
+          const auto cell_it = _cells.find(CellKey{x, y});
+          if(cell_it != _cells.end())
+            inspect_cell(cell_it->second);
+        }
+      }
+    }
+    else
+    {
+      // The box covers more cells than are occupied, so it is cheaper to
+      // iterate through the occupied cells.
+      for(const auto& cell : _cells)
+      {
+        const CellKey& key = cell.first;
+        if(key.x < min.x || max.x < key.x || key.y < min.y || max.y < key.y)
+          continue;
+
+        inspect_cell(cell.second);
+      }
+    }
+  }
+
+private:
+
+  CellKey get_key(const Eigen::Vector2d& p) const;
+
+  double _cell_size;
+
+  std::unordered_map<CellKey, Cell, CellKeyHash> _cells;
+
+  // Keeps track of which cells each entry was inserted into so that it can be
+  // removed efficiently.
+  std::unordered_map<const Entry*, std::vector<CellKey>> _occupied_cells;
+
+};
+
 //==============================================================================
 struct DeepIterator
 {
@@ -245,10 +392,6 @@ public:
 
   using Bucket = std::vector<internal::ConstEntryPtr>;
 
-  // TODO(MXG): A possible performance improvement could be to introduce spatial
-  // buckets that are orthogonal to the time buckets. This could be added later
-  // without negatively impacting the API or ABI.
-
   // Each bucket stores trajectories whose time span intersects with the range
   // ( key(timeline_it - 1), key(timeline_it) ].
   using Timeline = std::map<Time, Bucket>;
@@ -257,6 +400,14 @@ public:
 
   MapToTimeline timelines;
 
+  // The spatial indices are orthogonal to the time buckets. Timespan queries
+  // and culling use the timelines while spacetime region queries use the
+  // spatial indices.
+  using MapToSpatialIndex =
+      std::unordered_map<std::string, internal::SpatialIndex>;
+
+  MapToSpatialIndex spatial_indices;
+
   // TODO(MXG): Consider using a sorted vector here instead of a std::map.
   using EntryMap = std::map<Version, internal::EntryPtr>;
   EntryMap all_entries;
@@ -264,6 +415,19 @@ public:
   Version oldest_version = 0;
   Version latest_version = 0;
 
+  /// The Database keeps a journal of its entries in the order of their
+  /// versions so that it can find the entries that have changed after a
+  /// certain version without looking at any of the other entries. The last
+  /// element of the journal always belongs to latest_version, and each element
+  /// before it belongs to the version before that. Versions that do not have
+  /// an entry (like culls) and entries that have been culled are left as
+  /// nullptr.
+  ///
+  /// The Mirror class does not keep a journal, because its versions are not
+  /// contiguous.
+  bool keep_journal = false;
+  std::deque<internal::ConstEntryPtr> journal;
+
   /// Remembers the version number and time value of the last culling that took
   /// place.
   bool cull_has_occurred = false;
@@ -278,11 +442,24 @@ public:
   /// This field does not get used by the Database class
   Changers changers;
 
-  internal::EntryPtr add_entry(internal::EntryPtr entry, bool erasure = false);
+  /// Add an entry to the record.
+  ///
+  /// If shift is not nullptr, then the trajectory of the entry must be the
+  /// trajectory of the entry that it succeeds, delayed as a whole by *shift.
+  /// The spatial index will then reuse the cells of the entry that it
+  /// succeeds.
+  internal::EntryPtr add_entry(
+      internal::EntryPtr entry,
+      bool erasure = false,
+      const Duration* shift = nullptr);
 
   /// Used by the Mirror class to make efficient changes to entries
-  void modify_entry(const internal::EntryPtr& entry,
-      Trajectory new_trajectory, const Version new_id);
+  ///
+  /// If shift is not nullptr, then new_trajectory must be the current
+  /// trajectory of the entry, delayed as a whole by *shift.
+  void modify_entry(internal::EntryPtr entry,
+      Trajectory new_trajectory, const Version new_id,
+      const Duration* shift = nullptr);
 
   /// Used by the Mirror class to erase entries that are no longer needed
   void erase_entry(Version id);
@@ -296,6 +473,27 @@ public:
 
   void cull(Version id, Time time);
 
+  /// Call f on each entry in the journal whose version comes after the given
+  /// version.
+  template<typename F>
+  void for_each_entry_after(const Version after, const F& f) const
+  {
+    assert(keep_journal);
+    if(!internal::VersionRange().less(after, latest_version))
+      return;
+
+    const Version behind = latest_version - after;
+    const std::size_t first =
+        behind < journal.size() ? journal.size() - behind : 0;
+
+    for(std::size_t i = first; i < journal.size(); ++i)
+    {
+      const internal::ConstEntryPtr& entry = journal[i];
+      if(entry)
+        f(entry);
+    }
+  }
+
   static Timeline::const_iterator get_timeline_end(
       const Timeline& timeline, const Time* upper_time_bound)
   {
@@ -319,21 +517,14 @@ public:
 
     for(const Region& region : regions)
     {
-      const std::string& map = region.get_map();
-      const auto map_it = timelines.find(map);
-      if(map_it == timelines.end())
+      const auto map_it = spatial_indices.find(region.get_map());
+      if(map_it == spatial_indices.end())
         continue;
 
-      const Timeline& timeline = map_it->second;
+      const internal::SpatialIndex& index = map_it->second;
       const Time* const lower_time_bound = region.get_lower_time_bound();
       const Time* const upper_time_bound = region.get_upper_time_bound();
 
-      const auto timeline_begin =
-          (lower_time_bound == nullptr)?
-            timeline.begin() : timeline.lower_bound(*lower_time_bound);
-
-      const auto timeline_end = get_timeline_end(timeline, upper_time_bound);
-
       rmf_traffic::internal::Spacetime spacetime_data;
       spacetime_data.lower_time_bound = lower_time_bound;
       spacetime_data.upper_time_bound = upper_time_bound;
@@ -342,22 +533,20 @@ public:
         spacetime_data.pose = space_it->get_pose();
         spacetime_data.shape = space_it->get_shape();
 
-        auto timeline_it = timeline_begin;
-        for(; timeline_it != timeline_end; ++timeline_it)
+        const rmf_traffic::internal::BoundingBox space_box =
+            rmf_traffic::internal::get_bounding_box(
+              spacetime_data.pose, *spacetime_data.shape);
+
+        index.for_each_candidate(
+              space_box, lower_time_bound, upper_time_bound,
+              [&](const internal::ConstEntryPtr& entry_ptr)
         {
-          const Bucket& bucket = timeline_it->second;
-
-          auto entry_it = bucket.begin();
-          for(; entry_it != bucket.end(); ++entry_it)
-          {
-            const internal::ConstEntryPtr& entry_ptr = *entry_it;
-            // Test if we have already checked this entry
-            if(!checked.insert(entry_ptr->version).second)
-              continue;
-
-            inspector.inspect(entry_ptr, spacetime_data);
-          }
-        }
+          // Test if we have already checked this entry
+          if(!checked.insert(entry_ptr->version).second)
+            return;
+
+          inspector.inspect(entry_ptr, spacetime_data);
+        });
       }
     }
   }
@@ -507,6 +696,14 @@ Trajectory add_delay(
     const Time time,
     const Duration delay);
 
+//==============================================================================
+/// Returns true if add_delay() delayed every segment of old_trajectory by
+/// delay to produce new_trajectory.
+bool is_delayed_as_whole(
+    const Trajectory& old_trajectory,
+    const Trajectory& new_trajectory,
+    const Duration delay);
+
 } // namespace schedule
 } // namespace rmf_traffic
 
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/agv/Planner.hpp>
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include "src/rmf_traffic/agv/internal_heuristic.hpp"
+
+#include "../utils_Trajectory.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <thread>
+
+SCENARIO("Heuristic tables give a lower bound on travel time")
+{
+  using namespace std::chrono_literals;
+  using rmf_traffic::internal::planning::HeuristicTableBuilder;
+
+  const std::string test_map_name = "test_map";
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint(test_map_name, { 0, 0}); // 0
+  graph.add_waypoint(test_map_name, { 5, 0}); // 1
+  graph.add_waypoint(test_map_name, {10, 0}); // 2
+  graph.add_waypoint(test_map_name, {10, 5}); // 3
+  graph.add_waypoint(test_map_name, {10, 10}); // 4
+  graph.add_waypoint(test_map_name, {20, 20}); // 5 (unreachable)
+
+  auto add_bidir_lane = [&](const std::size_t w0, const std::size_t w1)
+  {
+    graph.add_lane(w0, w1);
+    graph.add_lane(w1, w0);
+  };
+
+  add_bidir_lane(0, 1);
+  add_bidir_lane(1, 2);
+  add_bidir_lane(2, 3);
+  add_bidir_lane(3, 4);
+
+  const rmf_traffic::agv::VehicleTraits traits(
+      {0.7, 0.3}, {1.0, 0.45}, make_test_profile(UnitCircle));
+
+  const rmf_traffic::agv::Interpolate::Options interpolation;
+
+  const HeuristicTableBuilder builder(
+        rmf_traffic::agv::Graph::Implementation::get(graph),
+        traits,
+        rmf_traffic::agv::Interpolate::Options::Implementation::get(
+          interpolation));
+
+  using rmf_traffic::agv::internal::compute_traversal_time;
+  const double v = traits.linear().get_nominal_velocity();
+  const double a = traits.linear().get_nominal_acceleration();
+  const double w = traits.rotational().get_nominal_velocity();
+  const double alpha = traits.rotational().get_nominal_acceleration();
+
+  const auto table = builder.build(4);
+  REQUIRE(table.size() == graph.num_waypoints());
+
+  CHECK(table[4] == 0.0);
+
+  // Waypoints 2->3->4 are colinear, so the robot does not need to stop at 3
+  CHECK(table[3] == Approx(compute_traversal_time(5.0, v, a)));
+  CHECK(table[2] == Approx(compute_traversal_time(10.0, v, a)));
+
+  // The robot must stop and turn at waypoint 2
+  const double turn = compute_traversal_time(M_PI/2.0, w, alpha);
+  CHECK(table[1] == Approx(
+          compute_traversal_time(5.0, v, a) + turn
+          + compute_traversal_time(10.0, v, a)));
+  CHECK(table[0] == Approx(
+          compute_traversal_time(10.0, v, a) + turn
+          + compute_traversal_time(10.0, v, a)));
+
+  CHECK(std::isinf(table[5]));
+
+  WHEN("Plans are made to the goal")
+  {
+    rmf_traffic::schedule::Database database;
+    rmf_traffic::agv::Planner planner{
+      rmf_traffic::agv::Planner::Configuration{graph, traits, interpolation},
+      rmf_traffic::agv::Planner::Options{database}
+    };
+
+    const rmf_traffic::Time start_time = std::chrono::steady_clock::now();
+    for(std::size_t start=0; start < 4; ++start)
+    {
+      for(const double orientation : {0.0, M_PI/2.0, M_PI})
+      {
+        const auto plan = planner.plan(
+              rmf_traffic::agv::Planner::Start{start_time, start, orientation},
+              rmf_traffic::agv::Planner::Goal{4});
+
+        REQUIRE(plan);
+        const double duration = rmf_traffic::time::to_seconds(
+              plan->get_trajectories().front().duration());
+
+        CHECK(table[start] <= duration + 1e-6);
+      }
+    }
+  }
+}
+
+SCENARIO("Heuristic tables can be shared between planning threads")
+{
+  using rmf_traffic::internal::planning::HeuristicTableBuilder;
+  using rmf_traffic::internal::planning::HeuristicTables;
+
+  const std::string test_map_name = "test_map";
+  rmf_traffic::agv::Graph graph;
+  const std::size_t grid_size = 8;
+  for(std::size_t i=0; i < grid_size; ++i)
+  {
+    for(std::size_t j=0; j < grid_size; ++j)
+    {
+      graph.add_waypoint(
+            test_map_name, {2.0*static_cast<double>(j), 3.0*i});
+
+      const std::size_t w = i*grid_size + j;
+      if(j > 0)
+      {
+        graph.add_lane(w, w-1);
+        graph.add_lane(w-1, w);
+      }
+
+      if(i > 0)
+        graph.add_lane(w, w-grid_size);
+    }
+  }
+
+  const rmf_traffic::agv::VehicleTraits traits(
+      {0.7, 0.3}, {1.0, 0.45}, make_test_profile(UnitCircle));
+
+  const rmf_traffic::agv::Interpolate::Options interpolation;
+
+  const HeuristicTableBuilder builder(
+        rmf_traffic::agv::Graph::Implementation::get(graph),
+        traits,
+        rmf_traffic::agv::Interpolate::Options::Implementation::get(
+          interpolation));
+
+  const auto tables = std::make_shared<HeuristicTables>(builder);
+
+  std::vector<const HeuristicTables::Table*> results[4];
+  std::vector<std::thread> threads;
+  for(auto& result : results)
+  {
+    threads.emplace_back([&tables, &result, &graph]()
+    {
+      for(std::size_t goal=0; goal < graph.num_waypoints(); ++goal)
+        result.push_back(&tables->get(goal));
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  for(std::size_t goal=0; goal < graph.num_waypoints(); ++goal)
+  {
+    // Every thread must see the same published table
+    for(const auto& result : results)
+      CHECK(result[goal] == results[0][goal]);
+
+    CHECK(*results[0][goal] == builder.build(goal));
+  }
+}
@@ -522,15 +522,17 @@ SCENARIO("Test planning")
     default_options
   };
 
-  //TODO abort planning that is impossible as lane does not exit in the graph
+  WHEN("goal waypoint cannot be reached from the start")
+  {
+    // There is no sequence of lanes from 3 to 9, so the planner should give up
+    // right away instead of searching until it gets interrupted.
+    const rmf_traffic::Time start_time = std::chrono::steady_clock::now();
+    auto plan = planner.plan(
+        rmf_traffic::agv::Planner::Start(start_time, 3, 0.0),
+        rmf_traffic::agv::Planner::Goal(9));
 
-  // WHEN("goal waypoint does not have a lane in the graph")
-  // {
-  //   const rmf_traffic::Time start_time = std::chrono::steady_clock::now();
-  //   auto plan = planner.plan(
-  //       rmf_traffic::agv::Planner::Start(start_time, 3, 0.0),
-  //       rmf_traffic::agv::Planner::Goal(9));
-  // } 
+    CHECK_FALSE(plan);
+  }
 
   WHEN("initial conditions satisfy the goals")
   {
@@ -622,6 +624,76 @@ SCENARIO("Test planning")
     CHECK(t.back().get_finish_time() > start_time);
   }
 
+  WHEN("planning to several goals at once")
+  {
+    const rmf_traffic::Time start_time = std::chrono::steady_clock::now();
+    const rmf_traffic::agv::Planner::StartSet starts =
+      {rmf_traffic::agv::Planner::Start{start_time, 3, M_PI}};
+
+    const rmf_traffic::agv::Planner::GoalSet goals = {
+      rmf_traffic::agv::Planner::Goal{0},
+      rmf_traffic::agv::Planner::Goal{2, M_PI}
+    };
+
+    const auto plans = planner.plan(starts, goals);
+    REQUIRE(plans.size() == goals.size());
+
+    for (std::size_t i=0; i < goals.size(); ++i)
+    {
+      REQUIRE(plans[i]);
+      CHECK(plans[i]->get_goal().waypoint() == goals[i].waypoint());
+      CHECK(*plans[i]->get_waypoints().back().graph_index()
+            == goals[i].waypoint());
+
+      // Each plan should be as good as a plan that was searched for on its own
+      const auto single_plan = planner.plan(starts, goals[i]);
+      REQUIRE(single_plan);
+      CHECK(rmf_traffic::time::to_seconds(
+              *plans[i]->get_trajectories().back().finish_time()
+              - *single_plan->get_trajectories().back().finish_time())
+            == Approx(0.0).margin(1e-6));
+    }
+
+    const auto nearest = planner.plan_to_nearest(starts, goals);
+    REQUIRE(nearest);
+    CHECK(nearest->get_goal().waypoint() == 2);
+    CHECK(*nearest->get_waypoints().back().graph_index() == 2);
+  }
+
+  WHEN("planning to several goals at once where one cannot be reached")
+  {
+    const rmf_traffic::Time start_time = std::chrono::steady_clock::now();
+    const rmf_traffic::agv::Planner::StartSet starts =
+      {rmf_traffic::agv::Planner::Start{start_time, 3, M_PI}};
+
+    // There is no sequence of lanes from 3 to 9, so the search needs to finish
+    // without ever reaching it.
+    const rmf_traffic::agv::Planner::GoalSet goals = {
+      rmf_traffic::agv::Planner::Goal{0},
+      rmf_traffic::agv::Planner::Goal{9},
+      rmf_traffic::agv::Planner::Goal{2, M_PI}
+    };
+
+    const auto plans = planner.plan(starts, goals);
+    REQUIRE(plans.size() == goals.size());
+    CHECK_FALSE(plans[1]);
+
+    REQUIRE(plans[0]);
+    CHECK(*plans[0]->get_waypoints().back().graph_index() == 0);
+
+    REQUIRE(plans[2]);
+    CHECK(*plans[2]->get_waypoints().back().graph_index() == 2);
+
+    const auto nearest = planner.plan_to_nearest(starts, goals);
+    REQUIRE(nearest);
+    CHECK(nearest->get_goal().waypoint() == 2);
+
+    const auto only_unreachable = planner.plan(
+          starts, rmf_traffic::agv::Planner::GoalSet{goals[1]});
+    REQUIRE(only_unreachable.size() == 1);
+    CHECK_FALSE(only_unreachable.front());
+  }
+
   GIVEN("Goal from 12->5 and obstacle from 5->12")
   {
     const rmf_traffic::Time time = std::chrono::steady_clock::now();
@@ -694,6 +766,23 @@ SCENARIO("Test planning")
 
         test_ignore_obstacle(*plan, database.latest_version());
       }
+
+      WHEN("An obstacle is introduced with Safe Interval Path Planning")
+      {
+        auto options = default_options;
+        options.safe_interval_planning(true);
+        const auto sipp_plan = planner.plan(start, goal, options);
+        REQUIRE(sipp_plan);
+        CHECK(sipp_plan->get_options().safe_interval_planning());
+
+        const auto& t_sipp = sipp_plan->get_trajectories().front();
+        CHECK(rmf_traffic::time::to_seconds(t_sipp.duration() - t.duration())
+              == Approx(0.0).margin(1e-8));
+
+        test_with_obstacle(
+              "Unconstrained 12->5 SIPP", *sipp_plan, database, obstacles, 6,
+              time);
+      }
     }
 
     WHEN("Docking must be at 90-degrees")
@@ -1637,13 +1726,15 @@ SCENARIO("DP1 Graph")
       const std::size_t goal_index = 32;
       const auto goal = rmf_traffic::agv::Plan::Goal{goal_index};
 
+      // The flag is raised before the planning thread starts, because the
+      // planner may otherwise find a solution before the flag gets raised.
       rmf_utils::optional<rmf_traffic::agv::Plan> plan;
+      interrupt_flag = true;
       auto plan_thread = std::thread(
           [&]()
       {
         plan = planner.plan(start, goal);
       });
-      interrupt_flag = true;
       plan_thread.join();
       CHECK_FALSE(plan);
     }
@@ -2342,3 +2433,97 @@ SCENARIO("Test starts using graph with non-colinear waypoints")
     // start2 has the shortest duration
   }
 }
+
+SCENARIO("Planner waits out a blocked corridor")
+{
+  using namespace std::chrono_literals;
+  using rmf_traffic::agv::Graph;
+  using Planner = rmf_traffic::agv::Planner;
+
+  const std::string test_map_name = "test_map";
+  Graph graph;
+
+  // A 5x5 grid of holding points where every state can be reached through
+  // many different parents
+  const std::size_t grid_size = 5;
+  for(std::size_t i=0; i < grid_size; ++i)
+  {
+    for(std::size_t j=0; j < grid_size; ++j)
+    {
+      graph.add_waypoint(
+            test_map_name, {5.0*static_cast<double>(j), 5.0*i}, true);
+    }
+  }
+
+  auto add_bidir_lane = [&](const std::size_t w0, const std::size_t w1)
+  {
+    graph.add_lane(w0, w1);
+    graph.add_lane(w1, w0);
+  };
+
+  for(std::size_t i=0; i < grid_size; ++i)
+  {
+    for(std::size_t j=0; j < grid_size; ++j)
+    {
+      const std::size_t w = i*grid_size + j;
+      if(j+1 < grid_size)
+        add_bidir_lane(w, w+1);
+      if(i+1 < grid_size)
+        add_bidir_lane(w, w+grid_size);
+    }
+  }
+
+  // The only way to the goal is a corridor that leaves the corner of the grid
+  const std::size_t corridor_entry = grid_size*grid_size - 1;
+  const std::size_t corridor = graph.num_waypoints();
+  graph.add_waypoint(test_map_name, {25.0, 20.0}); // corridor
+  const std::size_t goal_waypoint = graph.num_waypoints();
+  graph.add_waypoint(test_map_name, {30.0, 20.0}); // goal
+  add_bidir_lane(corridor_entry, corridor);
+  add_bidir_lane(corridor, goal_waypoint);
+
+  const rmf_traffic::agv::VehicleTraits traits(
+      {0.7, 0.3}, {1.0, 0.45}, make_test_profile(UnitCircle));
+
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+
+  // Another robot is parked at the entrance of the corridor for a full minute
+  rmf_traffic::Trajectory obstacle{test_map_name};
+  obstacle.insert(
+        time,
+        make_test_profile(UnitCircle),
+        {20.0, 20.0, 0.0},
+        {0.0, 0.0, 0.0});
+  obstacle.insert(
+        time + 60s,
+        make_test_profile(UnitCircle),
+        {20.0, 20.0, 0.0},
+        {0.0, 0.0, 0.0});
+  obstacle.insert(
+        time + 70s,
+        make_test_profile(UnitCircle),
+        {20.0, 30.0, 0.0},
+        {0.0, 0.0, 0.0});
+
+  rmf_traffic::schedule::Database database;
+  database.insert(obstacle);
+
+  Planner planner{
+    Planner::Configuration{graph, traits},
+    Planner::Options{database}
+  };
+
+  const auto plan = planner.plan(
+        Planner::Start{time, 0, 0.0},
+        Planner::Goal{goal_waypoint});
+
+  REQUIRE(plan);
+  REQUIRE(plan->get_trajectories().size() == 1);
+  const auto& t = plan->get_trajectories().front();
+  CHECK(rmf_traffic::DetectConflict::between(t, obstacle).empty());
+  CHECK(*t.finish_time() > time + 60s);
+
+  const Eigen::Vector2d final_p =
+      t.back().get_finish_position().block<2,1>(0,0);
+  CHECK((final_p - Eigen::Vector2d(30.0, 20.0)).norm() == Approx(0.0));
+}
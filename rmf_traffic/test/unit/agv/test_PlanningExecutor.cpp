@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/agv/PlanningExecutor.hpp>
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include "../utils_Trajectory.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+SCENARIO("Planning jobs run on a shared worker pool")
+{
+  using namespace std::chrono_literals;
+  using rmf_traffic::agv::Planner;
+  using rmf_traffic::agv::PlanningExecutor;
+
+  const std::string test_map_name = "test_map";
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint(test_map_name, { 0, 0}); // 0
+  graph.add_waypoint(test_map_name, { 5, 0}); // 1
+  graph.add_waypoint(test_map_name, {10, 0}); // 2
+  graph.add_waypoint(test_map_name, {10, 5}); // 3
+  graph.add_waypoint(test_map_name, {10, 10}); // 4
+
+  auto add_bidir_lane = [&](const std::size_t w0, const std::size_t w1)
+  {
+    graph.add_lane(w0, w1);
+    graph.add_lane(w1, w0);
+  };
+
+  add_bidir_lane(0, 1);
+  add_bidir_lane(1, 2);
+  add_bidir_lane(2, 3);
+  add_bidir_lane(3, 4);
+
+  const rmf_traffic::agv::VehicleTraits traits(
+      {0.7, 0.3}, {1.0, 0.45}, make_test_profile(UnitCircle));
+
+  rmf_traffic::schedule::Database database;
+  const Planner planner{
+    Planner::Configuration{graph, traits},
+    Planner::Options{database}
+  };
+
+  const auto time = std::chrono::steady_clock::now();
+  const Planner::StartSet starts = {Planner::Start{time, 0, 0.0}};
+  const Planner::Goal goal{4};
+  const auto options = planner.get_default_options();
+
+  PlanningExecutor executor(2);
+  CHECK(executor.num_workers() == 2);
+
+  WHEN("A plan is requested")
+  {
+    const auto expected = planner.plan(starts, goal);
+    REQUIRE(expected);
+
+    auto future = executor.plan(planner, starts, goal, options);
+    const auto plan = future.get();
+    REQUIRE(plan);
+    CHECK(*plan->get_trajectories().back().finish_time()
+          == *expected->get_trajectories().back().finish_time());
+  }
+
+  WHEN("A plan to the nearest goal is requested")
+  {
+    auto future = executor.plan_to_nearest(
+          planner, starts, {Planner::Goal{4}, Planner::Goal{2}}, options);
+
+    const auto plan = future.get();
+    REQUIRE(plan);
+    CHECK(plan->get_goal().waypoint() == 2);
+  }
+
+  WHEN("The token is cancelled before the job starts")
+  {
+    const PlanningExecutor::CancellationToken token;
+    CHECK_FALSE(token.cancelled());
+    token.cancel();
+    CHECK(token.cancelled());
+
+    auto future = executor.plan(planner, starts, goal, options, token);
+    CHECK_FALSE(future.get());
+  }
+
+  WHEN("The deadline of the token has already passed")
+  {
+    const PlanningExecutor::CancellationToken token{time - 1s};
+    CHECK(token.cancelled());
+
+    auto future = executor.plan(
+          planner, starts, goal, options, token,
+          PlanningExecutor::Priority::Emergency);
+    CHECK_FALSE(future.get());
+  }
+
+  WHEN("The token has a time limit")
+  {
+    const PlanningExecutor::CancellationToken no_time{
+      rmf_utils::nullopt, rmf_traffic::Duration(0s)};
+    CHECK_FALSE(no_time.cancelled());
+    REQUIRE(no_time.time_limit());
+    CHECK(*no_time.time_limit() == rmf_traffic::Duration(0s));
+
+    // A job with no time to search will give up as soon as it starts
+    auto future = executor.plan(planner, starts, goal, options, no_time);
+    CHECK_FALSE(future.get());
+
+    // Time spent waiting in the queue does not count against the time limit,
+    // so jobs that wait behind many others will still get to run.
+    const PlanningExecutor::CancellationToken limited{
+      rmf_utils::nullopt, rmf_traffic::Duration(10s)};
+    std::vector<PlanningExecutor::PlanFuture> futures;
+    PlanningExecutor small_executor(1);
+    for (std::size_t i=0; i < 20; ++i)
+    {
+      futures.emplace_back(
+            small_executor.plan(planner, starts, goal, options, limited));
+    }
+
+    for (auto& future : futures)
+      CHECK(future.get());
+  }
+
+  WHEN("Many jobs are submitted at once")
+  {
+    std::vector<PlanningExecutor::PlanFuture> futures;
+    for (std::size_t i=0; i < 20; ++i)
+      futures.emplace_back(executor.plan(planner, starts, goal, options));
+
+    for (auto& future : futures)
+      CHECK(future.get());
+
+    CHECK(executor.num_pending() == 0);
+  }
+
+  WHEN("The planner throws an exception")
+  {
+    // Lane 0 goes from waypoint 0 to waypoint 1, so it disagrees with a start
+    // on waypoint 0.
+    const Planner::StartSet bad_starts = {
+      Planner::Start{time, 0, 0.0, Eigen::Vector2d{2.0, 0.0}, 0}
+    };
+    CHECK_THROWS_AS(planner.plan(bad_starts, goal), std::invalid_argument);
+
+    auto future = executor.plan(planner, bad_starts, goal, options);
+    CHECK_THROWS_AS(future.get(), std::invalid_argument);
+
+    // The workers keep running after the exception
+    CHECK(executor.plan(planner, starts, goal, options).get());
+  }
+
+  WHEN("An Emergency job is submitted behind Routine jobs")
+  {
+    // An obstacle that sits on the goal for a very long time, so that plans
+    // to the goal will keep searching until they are cancelled
+    rmf_traffic::schedule::Database blocked_database;
+    rmf_traffic::Trajectory obstacle{test_map_name};
+    obstacle.insert(
+          time, make_test_profile(UnitCircle), {10, 10, 0}, {0, 0, 0});
+    obstacle.insert(
+          time + 1000000s, make_test_profile(UnitCircle),
+          {10, 10, 0}, {0, 0, 0});
+    blocked_database.insert(obstacle);
+    const Planner::Options blocked_options{blocked_database};
+
+    PlanningExecutor small_executor(1);
+
+    // Keep the only worker busy while the other jobs get queued
+    const PlanningExecutor::CancellationToken busy_token;
+    auto busy = small_executor.plan(
+          planner, starts, goal, blocked_options, busy_token);
+
+    const PlanningExecutor::CancellationToken routine_token;
+    std::vector<PlanningExecutor::PlanFuture> routine;
+    for (std::size_t i=0; i < 3; ++i)
+    {
+      routine.emplace_back(
+            small_executor.plan(
+              planner, starts, goal, blocked_options, routine_token));
+    }
+
+    auto emergency = small_executor.plan(
+          planner, starts, goal, options, PlanningExecutor::CancellationToken(),
+          PlanningExecutor::Priority::Emergency);
+
+    busy_token.cancel();
+    CHECK_FALSE(busy.get());
+
+    // The Routine jobs can only finish once they are cancelled, so the
+    // Emergency job can only finish if it was started before them.
+    REQUIRE(emergency.wait_for(10s) == std::future_status::ready);
+    CHECK(emergency.get());
+    CHECK(routine.front().wait_for(100ms) == std::future_status::timeout);
+
+    routine_token.cancel();
+    for (auto& future : routine)
+      CHECK_FALSE(future.get());
+  }
+
+  WHEN("The executor is destroyed while jobs are waiting")
+  {
+    std::vector<PlanningExecutor::PlanFuture> futures;
+    {
+      PlanningExecutor small_executor(1);
+      for (std::size_t i=0; i < 20; ++i)
+      {
+        futures.emplace_back(
+              small_executor.plan(planner, starts, goal, options));
+      }
+    }
+
+    // Every future should be resolved, whether or not its job got to run
+    for (auto& future : futures)
+      CHECK_NOTHROW(future.get());
+  }
+}
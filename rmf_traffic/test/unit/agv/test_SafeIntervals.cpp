@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/agv/Planner.hpp>
+#include <rmf_traffic/schedule/Database.hpp>
+
+#include "src/rmf_traffic/agv/internal_planning.hpp"
+
+#include "../utils_Trajectory.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <algorithm>
+
+SCENARIO("Safe Interval Path Planning waits for obstacles to pass")
+{
+  using namespace std::chrono_literals;
+  using rmf_traffic::agv::Planner;
+  using rmf_traffic::time::to_seconds;
+
+  const std::string test_map_name = "test_map";
+  rmf_traffic::agv::Graph graph;
+  graph.add_waypoint(test_map_name, { 0, 0}, true); // 0
+  graph.add_waypoint(test_map_name, { 5, 0}, true); // 1
+  graph.add_waypoint(test_map_name, {10, 0}, true); // 2
+
+  auto add_bidir_lane = [&](const std::size_t w0, const std::size_t w1)
+  {
+    graph.add_lane(w0, w1);
+    graph.add_lane(w1, w0);
+  };
+
+  add_bidir_lane(0, 1);
+  add_bidir_lane(1, 2);
+
+  // The robot is not reversible, so it cannot turn around in place to pass
+  // time instead of waiting.
+  const rmf_traffic::agv::VehicleTraits traits(
+      {0.7, 0.3}, {1.0, 0.45}, make_test_profile(UnitCircle),
+      rmf_traffic::agv::VehicleTraits::Differential(
+        Eigen::Vector2d::UnitX(), false));
+
+  const auto cache = rmf_traffic::internal::planning::make_cache(
+        Planner::Configuration{graph, traits});
+
+  rmf_traffic::schedule::Database database;
+  const auto time = std::chrono::steady_clock::now();
+  const std::vector<Planner::Start> starts = {Planner::Start{time, 0, 0.0}};
+
+  GIVEN("An obstacle that sits on waypoint 1 for a long time")
+  {
+    rmf_traffic::Trajectory obstacle{test_map_name};
+    obstacle.insert(
+          time, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    obstacle.insert(
+          time + 100s, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    database.insert(obstacle);
+
+    Planner::Options options{database};
+    const auto regular = cache.get().plan(starts, Planner::Goal{2}, options);
+    REQUIRE(regular);
+
+    options.safe_interval_planning(true);
+    const auto sipp = cache.get().plan(starts, Planner::Goal{2}, options);
+    REQUIRE(sipp);
+
+    THEN("Waiting for the safe interval expands fewer nodes than holding")
+    {
+      // The regular search needs to expand a hold for every increment of the
+      // minimum holding time, while the safe interval search can jump
+      // straight to the end of the obstacle.
+      CHECK(sipp->expanded_nodes < regular->expanded_nodes);
+      CHECK(sipp->expanded_nodes <= 5);
+      CHECK(time + 100s < *sipp->trajectories.back().finish_time());
+    }
+  }
+
+  GIVEN("A gap between two obstacles that is too short for the holding time")
+  {
+    // The first obstacle leaves waypoint 1 at time + 27s, and the second one
+    // arrives at time + 36.7s. It takes the robot less than 9.5s to move from
+    // waypoint 0 to waypoint 1, so it can only pass through the gap if it
+    // leaves waypoint 0 between about time + 21.5s and time + 27.2s. Holding
+    // in increments of 10s will leave either at time + 20s or time + 30s, so
+    // it can only leave after the second obstacle is gone.
+    rmf_traffic::Trajectory first{test_map_name};
+    first.insert(
+          time, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    first.insert(
+          time + 27s, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    database.insert(first);
+
+    rmf_traffic::Trajectory second{test_map_name};
+    second.insert(
+          time + 36700ms, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    second.insert(
+          time + 200s, make_test_profile(UnitCircle), {5, 0, 0}, {0, 0, 0});
+    database.insert(second);
+
+    Planner::Options options{database, 10s};
+    const auto regular = cache.get().plan(starts, Planner::Goal{1}, options);
+    REQUIRE(regular);
+    CHECK(time + 200s < *regular->trajectories.back().finish_time());
+
+    options.safe_interval_planning(true);
+    const auto sipp = cache.get().plan(starts, Planner::Goal{1}, options);
+    REQUIRE(sipp);
+
+    THEN("The robot waits exactly until the gap opens")
+    {
+      CHECK(*sipp->trajectories.back().finish_time() < time + 36700ms);
+
+      // The robot leaves waypoint 0 as soon as the lane becomes safe
+      const auto departure = std::find_if(
+            sipp->waypoints.begin(), sipp->waypoints.end(),
+            [&](const rmf_traffic::agv::Plan::Waypoint& wp)
+      {
+        return wp.graph_index() && *wp.graph_index() == 0
+            && wp.time() != time;
+      });
+
+      REQUIRE(departure != sipp->waypoints.end());
+      CHECK(to_seconds(departure->time() - time) == Approx(27.0));
+    }
+  }
+}
@@ -168,7 +168,24 @@ SCENARIO("Test Database Conflicts")
           auto erase=erase_change->erase();
           CHECK(erase->original_id()==1);
           CHECK_TRAJECTORY_COUNT(db,0);
-    
+
+        }
+
+        WHEN("Trajectory is erased and changes for a timespan are requested")
+        {
+          rmf_traffic::schedule::Version version2= db.erase(1);
+          CHECK(version2==2);
+          std::vector<std::string> maps = {"test_map"};
+          auto timespan_query=
+              rmf_traffic::schedule::make_query(maps, &time, nullptr);
+          timespan_query.versions().query_after(1);
+          changes=db.changes(timespan_query);
+          REQUIRE(changes.size()==1);
+          REQUIRE(static_cast<int>(changes.begin()->get_mode())==5);
+          CHECK(changes.begin()->erase()->original_id()==1);
+
+          changes=db.changes(rmf_traffic::schedule::make_query(2));
+          CHECK(changes.size()==0);
         }
         
         
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/Encoding.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include <rmf_utils/catch.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+//==============================================================================
+void CHECK_SAME_TRAJECTORY(
+    const rmf_traffic::Trajectory& a,
+    const rmf_traffic::Trajectory& b)
+{
+  CHECK(a.get_map_name() == b.get_map_name());
+  REQUIRE(a.size() == b.size());
+  for(auto it_a = a.begin(), it_b = b.begin(); it_a != a.end(); ++it_a, ++it_b)
+  {
+    CHECK(it_a->get_finish_time() == it_b->get_finish_time());
+    CHECK((it_a->get_finish_position() - it_b->get_finish_position()).norm()
+          == Approx(0.0));
+    CHECK((it_a->get_finish_velocity() - it_b->get_finish_velocity()).norm()
+          == Approx(0.0));
+    CHECK(it_a->get_profile()->get_autonomy()
+          == it_b->get_profile()->get_autonomy());
+    CHECK(it_a->get_profile()->get_shape()->get_characteristic_length()
+          == Approx(it_b->get_profile()->get_shape()
+                    ->get_characteristic_length()));
+  }
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Encode trajectories")
+{
+  using namespace rmf_traffic;
+
+  const Time time = std::chrono::steady_clock::now();
+  const auto box = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Box>(1.0, 2.0));
+  const auto circle = Trajectory::Profile::make_queued(
+        geometry::make_final_convex<geometry::Circle>(0.5), "queue");
+
+  GIVEN("A trajectory with several segments")
+  {
+    Trajectory trajectory("test_map");
+    trajectory.insert(
+          time, box, Eigen::Vector3d{-5, 0, 0}, Eigen::Vector3d{0, 0, 0});
+    trajectory.insert(
+          time + 10s, box, Eigen::Vector3d{5, 0, 0}, Eigen::Vector3d{1, 0, 0});
+    trajectory.insert(
+          time + 20s, circle, Eigen::Vector3d{5, 5, 1}, Eigen::Vector3d{0, 0, 0});
+    trajectory.insert(
+          time + 25s, box, Eigen::Vector3d{0, 5, 0}, Eigen::Vector3d{0, 0, 0});
+
+    const std::vector<uint8_t> data = schedule::encode(trajectory);
+
+    WHEN("It is viewed")
+    {
+      const schedule::TrajectoryView view(data);
+      CHECK(view.get_map_name() == "test_map");
+      CHECK(view.size() == trajectory.size());
+      CHECK_FALSE(view.empty());
+      REQUIRE(view.start_time());
+      CHECK(*view.start_time() == *trajectory.start_time());
+      REQUIRE(view.finish_time());
+      CHECK(*view.finish_time() == *trajectory.finish_time());
+      CHECK(view.duration() == trajectory.duration());
+
+      // The box profile is shared by three segments but only stored once
+      CHECK(view.num_profiles() == 2);
+
+      auto original = trajectory.begin();
+      std::size_t count = 0;
+      for(const auto& segment : view)
+      {
+        CHECK(segment.get_finish_time() == original->get_finish_time());
+        CHECK((segment.get_finish_position()
+               - original->get_finish_position()).norm() == Approx(0.0));
+        CHECK((segment.get_finish_velocity()
+               - original->get_finish_velocity()).norm() == Approx(0.0));
+        CHECK(segment.get_profile_index() < view.num_profiles());
+        ++original;
+        ++count;
+      }
+      CHECK(count == trajectory.size());
+    }
+
+    WHEN("It is decoded")
+    {
+      const Trajectory decoded = schedule::TrajectoryView(data).decode();
+      CHECK_SAME_TRAJECTORY(trajectory, decoded);
+
+      // Segments that shared a profile still share one after decoding
+      CHECK(decoded.begin()->get_profile()
+            == (++decoded.begin())->get_profile());
+    }
+
+    WHEN("The data is damaged")
+    {
+      std::vector<uint8_t> truncated = data;
+      truncated.pop_back();
+      CHECK_THROWS_AS(schedule::TrajectoryView(truncated), std::runtime_error);
+
+      std::vector<uint8_t> wrong_magic = data;
+      wrong_magic[0] = 'X';
+      CHECK_THROWS_AS(schedule::TrajectoryView(wrong_magic), std::runtime_error);
+
+      CHECK_THROWS_AS(schedule::PatchView(data), std::runtime_error);
+    }
+  }
+
+  GIVEN("An empty trajectory")
+  {
+    const Trajectory trajectory("empty_map");
+    const std::vector<uint8_t> data = schedule::encode(trajectory);
+    const schedule::TrajectoryView view(data);
+    CHECK(view.get_map_name() == "empty_map");
+    CHECK(view.empty());
+    CHECK(view.start_time() == nullptr);
+    CHECK(view.finish_time() == nullptr);
+    CHECK(view.begin() == view.end());
+  }
+}
+
+//==============================================================================
+SCENARIO("Encode patches")
+{
+  using namespace rmf_traffic;
+  using Mode = schedule::Database::Change::Mode;
+
+  const Time time = std::chrono::steady_clock::now();
+
+  const auto make_box = [&]()
+  {
+    return Trajectory::Profile::make_guided(
+          geometry::make_final_convex<geometry::Box>(1.0, 1.0));
+  };
+
+  const auto make_trajectory = [&](const double offset)
+  {
+    // Each trajectory gets its own profile objects, like the trajectories
+    // that come out of a message conversion
+    const auto box = make_box();
+    Trajectory trajectory("test_map");
+    trajectory.insert(
+          time, box, Eigen::Vector3d{offset, 0, 0}, Eigen::Vector3d{0, 0, 0});
+    trajectory.insert(
+          time + 10s, box, Eigen::Vector3d{offset, 10, 0},
+          Eigen::Vector3d{0, 0, 0});
+    return trajectory;
+  };
+
+  GIVEN("A patch with every kind of change")
+  {
+    Trajectory pause("test_map");
+    pause.insert(time + 2s, make_box(), Eigen::Vector3d{0, 2, 0},
+                 Eigen::Vector3d{0, 0, 0});
+    pause.insert(time + 4s, make_box(), Eigen::Vector3d{0, 2, 0},
+                 Eigen::Vector3d{0, 0, 0});
+
+    std::vector<schedule::Database::Change> changes;
+    changes.push_back(schedule::Database::Change::make_insert(
+                        make_trajectory(0.0), 1));
+    changes.push_back(schedule::Database::Change::make_interrupt(
+                        1, pause, 1s, 2));
+    changes.push_back(schedule::Database::Change::make_delay(
+                        2, time + 5s, 3s, 3));
+    changes.push_back(schedule::Database::Change::make_replace(
+                        3, make_trajectory(1.0), 4));
+    changes.push_back(schedule::Database::Change::make_erase(4, 5));
+    changes.push_back(schedule::Database::Change::make_cull(time - 10s, 6));
+    const schedule::Database::Patch patch(changes, 6);
+
+    const std::vector<uint8_t> data = schedule::encode(patch);
+
+    WHEN("It is viewed")
+    {
+      const schedule::PatchView view(data);
+      CHECK(view.latest_version() == 6);
+      REQUIRE(view.size() == patch.size());
+
+      auto original = patch.begin();
+      for(const auto& change : view)
+      {
+        CHECK(change.get_mode() == original->get_mode());
+        CHECK(change.id() == original->id());
+        ++original;
+      }
+
+      auto it = view.begin();
+      REQUIRE(it->trajectory());
+      CHECK(it->trajectory()->size() == 2);
+
+      ++it;
+      CHECK(it->original_id() == 1);
+      CHECK(it->duration() == 1s);
+      REQUIRE(it->trajectory());
+      CHECK(*it->trajectory()->start_time() == time + 2s);
+
+      ++it;
+      CHECK(it->original_id() == 2);
+      CHECK(it->time() == time + 5s);
+      CHECK(it->duration() == 3s);
+      CHECK(it->trajectory() == nullptr);
+
+      ++it;
+      CHECK(it->original_id() == 3);
+      REQUIRE(it->trajectory());
+
+      ++it;
+      CHECK(it->get_mode() == Mode::Erase);
+      CHECK(it->original_id() == 4);
+
+      ++it;
+      CHECK(it->get_mode() == Mode::Cull);
+      CHECK(it->time() == time - 10s);
+
+      ++it;
+      CHECK(it == view.end());
+    }
+
+    WHEN("It is decoded")
+    {
+      const schedule::Database::Patch decoded = schedule::PatchView(data).decode();
+      CHECK(decoded.latest_version() == patch.latest_version());
+      REQUIRE(decoded.size() == patch.size());
+
+      auto original = patch.begin();
+      for(const auto& change : decoded)
+      {
+        CHECK(change.get_mode() == original->get_mode());
+        CHECK(change.id() == original->id());
+        if(change.insert())
+        {
+          CHECK_SAME_TRAJECTORY(
+                *original->insert()->trajectory(), *change.insert()->trajectory());
+        }
+        else if(change.interrupt())
+        {
+          CHECK(change.interrupt()->original_id()
+                == original->interrupt()->original_id());
+          CHECK(change.interrupt()->delay() == original->interrupt()->delay());
+          CHECK_SAME_TRAJECTORY(
+                *original->interrupt()->interruption(),
+                *change.interrupt()->interruption());
+        }
+        else if(change.delay())
+        {
+          CHECK(change.delay()->original_id()
+                == original->delay()->original_id());
+          CHECK(change.delay()->from() == original->delay()->from());
+          CHECK(change.delay()->duration() == original->delay()->duration());
+        }
+        else if(change.replace())
+        {
+          CHECK(change.replace()->original_id()
+                == original->replace()->original_id());
+          CHECK_SAME_TRAJECTORY(
+                *original->replace()->trajectory(),
+                *change.replace()->trajectory());
+        }
+        else if(change.erase())
+        {
+          CHECK(change.erase()->original_id()
+                == original->erase()->original_id());
+        }
+        else if(change.cull())
+        {
+          CHECK(change.cull()->time() == original->cull()->time());
+        }
+        ++original;
+      }
+
+      // All of the trajectories use equivalent profiles, so they share a
+      // single profile after decoding.
+      auto it = decoded.begin();
+      const auto profile = it->insert()->trajectory()->begin()->get_profile();
+      ++it;
+      CHECK(it->interrupt()->interruption()->begin()->get_profile() == profile);
+    }
+
+    WHEN("The data is damaged")
+    {
+      std::vector<uint8_t> truncated = data;
+      truncated.resize(truncated.size() - 5);
+      CHECK_THROWS_AS(schedule::PatchView(truncated), std::runtime_error);
+    }
+  }
+
+  GIVEN("A patch with many trajectories that use equivalent profiles")
+  {
+    const std::size_t N = 100;
+    std::vector<schedule::Database::Change> changes;
+    for(std::size_t i=0; i < N; ++i)
+    {
+      changes.push_back(
+            schedule::Database::Change::make_insert(
+              make_trajectory(static_cast<double>(i)), i+1));
+    }
+    const schedule::Database::Patch patch(changes, N);
+
+    std::size_t separate_size = 0;
+    for(const auto& change : patch)
+      separate_size += schedule::encode(*change.insert()->trajectory()).size();
+
+    const std::vector<uint8_t> data = schedule::encode(patch);
+
+    // The map name and profile are only written once for the whole patch
+    CHECK(data.size() < separate_size);
+    CHECK(data.size() < N*(2*(2 + 6*sizeof(double)) + 30));
+
+    const schedule::PatchView view(data);
+    CHECK(view.size() == N);
+    for(const auto& change : view)
+      CHECK(change.trajectory()->num_profiles() == 1);
+  }
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+#include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/Mirror.hpp>
+
+#include "src/rmf_traffic/DetectConflictInternal.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <set>
+
+namespace {
+
+//==============================================================================
+rmf_traffic::Trajectory make_random_trajectory(
+    std::mt19937& rng,
+    const rmf_traffic::Time start_time,
+    const double site_size,
+    const rmf_traffic::Trajectory::ProfilePtr& profile)
+{
+  using namespace std::chrono_literals;
+  std::uniform_real_distribution<double> position(0.0, site_size);
+  std::uniform_int_distribution<int> waypoints(2, 6);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  Eigen::Vector3d p{position(rng), position(rng), 0.0};
+  rmf_traffic::Time t = start_time;
+  trajectory.insert(t, profile, p, Eigen::Vector3d::Zero());
+
+  const int num_waypoints = waypoints(rng);
+  for(int i=0; i < num_waypoints; ++i)
+  {
+    // Move up to 10 meters along one axis at a speed of 1 m/s
+    const int axis = i%2;
+    const double step =
+        std::uniform_real_distribution<double>(-10.0, 10.0)(rng);
+    p[axis] = std::max(0.0, std::min(site_size, p[axis] + step));
+    t += std::chrono::milliseconds(
+          static_cast<int>(std::abs(step)*1000.0) + 1000);
+    trajectory.insert(t, profile, p, Eigen::Vector3d::Zero());
+  }
+
+  return trajectory;
+}
+
+//==============================================================================
+/// This reproduces the behavior of a region query without a spatial index:
+/// every entry that overlaps with the region in time gets a narrow-phase check.
+std::set<rmf_traffic::schedule::Version> brute_force_query(
+    const rmf_traffic::schedule::Viewer& viewer,
+    const rmf_traffic::Region& region)
+{
+  const auto view = viewer.query(
+        rmf_traffic::schedule::make_query(
+          {region.get_map()},
+          region.get_lower_time_bound(),
+          region.get_upper_time_bound()));
+
+  std::set<rmf_traffic::schedule::Version> result;
+  for(const auto& element : view)
+  {
+    for(const auto& space : region)
+    {
+      const rmf_traffic::internal::Spacetime spacetime{
+        region.get_lower_time_bound(),
+        region.get_upper_time_bound(),
+        space.get_pose(),
+        space.get_shape()
+      };
+
+      if(rmf_traffic::internal::detect_conflicts(
+           element.trajectory, spacetime, nullptr))
+      {
+        result.insert(element.id);
+        break;
+      }
+    }
+  }
+
+  return result;
+}
+
+//==============================================================================
+std::set<rmf_traffic::schedule::Version> indexed_query(
+    const rmf_traffic::schedule::Viewer& viewer,
+    const rmf_traffic::Region& region)
+{
+  std::set<rmf_traffic::schedule::Version> result;
+  for(const auto& element : viewer.query(
+        rmf_traffic::schedule::make_query({region})))
+    result.insert(element.id);
+
+  return result;
+}
+
+//==============================================================================
+rmf_traffic::Region make_region(
+    const rmf_traffic::Time start_time,
+    const Eigen::Vector2d& p,
+    const rmf_traffic::geometry::ConstFinalShapePtr& shape)
+{
+  using namespace std::chrono_literals;
+  Eigen::Isometry2d tf = Eigen::Isometry2d::Identity();
+  tf.translate(p);
+  return rmf_traffic::Region{
+    "test_map", start_time, start_time + 20s,
+    {rmf_traffic::geometry::Space{shape, tf}}};
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Spacetime region queries use the spatial index")
+{
+  using namespace std::chrono_literals;
+  const auto start_time = std::chrono::steady_clock::now();
+  std::mt19937 rng(42);
+
+  const auto profile = rmf_traffic::Trajectory::Profile::make_guided(
+        rmf_traffic::geometry::make_final_convex<
+          rmf_traffic::geometry::Circle>(0.5));
+
+  const auto region_shape =
+      rmf_traffic::geometry::make_final<rmf_traffic::geometry::Box>(6.0, 6.0);
+
+  rmf_traffic::schedule::Database db;
+  std::vector<rmf_traffic::schedule::Version> ids;
+  for(int i=0; i < 100; ++i)
+  {
+    const auto t = start_time + std::chrono::seconds(i%30);
+    ids.push_back(db.insert(make_random_trajectory(rng, t, 60.0, profile)));
+  }
+
+  const auto check_regions = [&](const rmf_traffic::schedule::Viewer& viewer)
+  {
+    std::size_t total_hits = 0;
+    for(int x=0; x <= 60; x += 10)
+    {
+      for(int y=0; y <= 60; y += 10)
+      {
+        for(const auto t : {start_time, start_time + 20s, start_time + 40s})
+        {
+          const auto region =
+              make_region(t, Eigen::Vector2d(x, y), region_shape);
+          const auto expected = brute_force_query(viewer, region);
+          CHECK(indexed_query(viewer, region) == expected);
+          total_hits += expected.size();
+        }
+      }
+    }
+
+    // Make sure that the test is meaningful
+    CHECK(total_hits > 0);
+  };
+
+  WHEN("The database is freshly populated")
+  {
+    check_regions(db);
+  }
+
+  WHEN("Entries are delayed, replaced, and erased")
+  {
+    for(std::size_t i=0; i < ids.size(); i += 3)
+      ids[i] = db.delay(ids[i], start_time, 7s);
+
+    for(std::size_t i=1; i < ids.size(); i += 5)
+    {
+      ids[i] = db.replace(
+            ids[i], make_random_trajectory(rng, start_time, 60.0, profile));
+    }
+
+    for(std::size_t i=2; i < ids.size(); i += 7)
+      db.erase(ids[i]);
+
+    check_regions(db);
+
+    THEN("A mirror of the database agrees with the database")
+    {
+      rmf_traffic::schedule::Mirror mirror;
+      mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+      check_regions(mirror);
+    }
+  }
+
+  WHEN("The database is culled")
+  {
+    rmf_traffic::schedule::Mirror mirror;
+    mirror.update(db.changes(rmf_traffic::schedule::query_everything()));
+
+    db.cull(start_time + 40s);
+    check_regions(db);
+
+    const auto query =
+        rmf_traffic::schedule::make_query(mirror.latest_version());
+    mirror.update(db.changes(query));
+    check_regions(mirror);
+  }
+}
+
+//==============================================================================
+TEST_CASE("Benchmark spacetime region queries", "[.][benchmark]")
+{
+  using namespace std::chrono_literals;
+  using Clock = std::chrono::steady_clock;
+  const auto start_time = Clock::now();
+  std::mt19937 rng(7);
+
+  const auto profile = rmf_traffic::Trajectory::Profile::make_guided(
+        rmf_traffic::geometry::make_final_convex<
+          rmf_traffic::geometry::Circle>(0.5));
+
+  const auto region_shape =
+      rmf_traffic::geometry::make_final<rmf_traffic::geometry::Box>(4.0, 4.0);
+
+  // Simulate a 300 robot site where each robot has a queue of trajectories
+  // lined up over the next few minutes
+  const double site_size = 200.0;
+  rmf_traffic::schedule::Database db;
+  for(int robot=0; robot < 300; ++robot)
+  {
+    for(int k=0; k < 5; ++k)
+    {
+      const auto t = start_time + std::chrono::seconds(30*k + robot%30);
+      db.insert(make_random_trajectory(rng, t, site_size, profile));
+    }
+  }
+
+  std::uniform_real_distribution<double> position(0.0, site_size);
+  std::vector<rmf_traffic::Region> regions;
+  for(int i=0; i < 200; ++i)
+  {
+    regions.push_back(make_region(
+      start_time + std::chrono::seconds(i%120),
+      Eigen::Vector2d(position(rng), position(rng)), region_shape));
+  }
+
+  std::size_t brute_force_hits = 0;
+  const auto brute_force_start = Clock::now();
+  for(const auto& region : regions)
+    brute_force_hits += brute_force_query(db, region).size();
+  const auto brute_force_duration = Clock::now() - brute_force_start;
+
+  std::size_t indexed_hits = 0;
+  const auto indexed_start = Clock::now();
+  for(const auto& region : regions)
+    indexed_hits += indexed_query(db, region).size();
+  const auto indexed_duration = Clock::now() - indexed_start;
+
+  CHECK(indexed_hits == brute_force_hits);
+
+  using Ms = std::chrono::duration<double, std::milli>;
+  const double num_queries = static_cast<double>(regions.size());
+  std::cout << "Average region query latency over " << regions.size()
+            << " queries:"
+            << "\n -- time buckets only: "
+            << Ms(brute_force_duration).count()/num_queries << "ms"
+            << "\n -- spatial index: "
+            << Ms(indexed_duration).count()/num_queries << "ms" << std::endl;
+}
@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/Storage.hpp>
+#include <rmf_traffic/geometry/Box.hpp>
+#include <rmf_traffic/geometry/Circle.hpp>
+
+#include "src/rmf_traffic/schedule/debug_Viewer.hpp"
+
+#include <rmf_utils/catch.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+//==============================================================================
+std::string make_temp_directory()
+{
+  char path[] = "/tmp/rmf_traffic_test_storage_XXXXXX";
+  REQUIRE(mkdtemp(path) != nullptr);
+  return path;
+}
+
+//==============================================================================
+void remove_directory(const std::string& directory)
+{
+  std::remove((directory + "/snapshot").c_str());
+  std::remove((directory + "/snapshot.tmp").c_str());
+  std::remove((directory + "/log").c_str());
+  rmdir(directory.c_str());
+}
+
+//==============================================================================
+void CHECK_SAME_TRAJECTORY(
+    const rmf_traffic::Trajectory& a,
+    const rmf_traffic::Trajectory& b)
+{
+  CHECK(a.get_map_name() == b.get_map_name());
+  REQUIRE(a.size() == b.size());
+  for(auto it_a = a.begin(), it_b = b.begin(); it_a != a.end(); ++it_a, ++it_b)
+  {
+    CHECK(it_a->get_finish_time() == it_b->get_finish_time());
+    CHECK((it_a->get_finish_position() - it_b->get_finish_position()).norm()
+          == Approx(0.0));
+    CHECK((it_a->get_finish_velocity() - it_b->get_finish_velocity()).norm()
+          == Approx(0.0));
+    CHECK(it_a->get_profile()->get_autonomy()
+          == it_b->get_profile()->get_autonomy());
+    CHECK(it_a->get_profile()->get_shape()->get_characteristic_length()
+          == Approx(it_b->get_profile()->get_shape()
+                    ->get_characteristic_length()));
+  }
+}
+
+//==============================================================================
+void CHECK_SAME_CHANGES(
+    const rmf_traffic::schedule::Database& original,
+    const rmf_traffic::schedule::Database& restored,
+    const rmf_traffic::schedule::Version after)
+{
+  const auto query = rmf_traffic::schedule::make_query(after);
+  const auto original_changes = original.changes(query);
+  const auto restored_changes = restored.changes(query);
+
+  CHECK(original_changes.latest_version() == restored_changes.latest_version());
+  REQUIRE(original_changes.size() == restored_changes.size());
+
+  auto restored_it = restored_changes.begin();
+  for(const auto& change : original_changes)
+  {
+    const auto& other = *restored_it++;
+    CHECK(change.get_mode() == other.get_mode());
+    CHECK(change.id() == other.id());
+    if(change.insert())
+    {
+      REQUIRE(other.insert());
+      CHECK_SAME_TRAJECTORY(
+            *change.insert()->trajectory(), *other.insert()->trajectory());
+    }
+    else if(change.delay())
+    {
+      REQUIRE(other.delay());
+      CHECK(change.delay()->original_id() == other.delay()->original_id());
+      CHECK(change.delay()->from() == other.delay()->from());
+      CHECK(change.delay()->duration() == other.delay()->duration());
+    }
+    else if(change.interrupt())
+    {
+      REQUIRE(other.interrupt());
+      CHECK(change.interrupt()->original_id()
+            == other.interrupt()->original_id());
+      CHECK_SAME_TRAJECTORY(
+            *change.interrupt()->interruption(),
+            *other.interrupt()->interruption());
+    }
+    else if(change.replace())
+    {
+      REQUIRE(other.replace());
+      CHECK(change.replace()->original_id() == other.replace()->original_id());
+      CHECK_SAME_TRAJECTORY(
+            *change.replace()->trajectory(), *other.replace()->trajectory());
+    }
+    else if(change.erase())
+    {
+      REQUIRE(other.erase());
+      CHECK(change.erase()->original_id() == other.erase()->original_id());
+    }
+    else if(change.cull())
+    {
+      REQUIRE(other.cull());
+      CHECK(change.cull()->time() == other.cull()->time());
+    }
+  }
+}
+
+//==============================================================================
+void CHECK_SAME_VIEW(
+    const rmf_traffic::schedule::Database& original,
+    const rmf_traffic::schedule::Database& restored)
+{
+  using Version = rmf_traffic::schedule::Version;
+
+  // Erased entries have empty trajectories, so we only look at the timelines
+  // of the maps instead of querying for everything.
+  const auto query = rmf_traffic::schedule::make_query(
+        {"test_map", "other_map"}, nullptr, nullptr);
+  const auto original_view = original.query(query);
+  const auto restored_view = restored.query(query);
+
+  std::map<Version, const rmf_traffic::Trajectory*> original_trajectories;
+  for(const auto& element : original_view)
+    original_trajectories[element.id] = &element.trajectory;
+
+  std::map<Version, const rmf_traffic::Trajectory*> restored_trajectories;
+  for(const auto& element : restored_view)
+    restored_trajectories[element.id] = &element.trajectory;
+
+  REQUIRE(original_trajectories.size() == restored_trajectories.size());
+  for(const auto& element : original_trajectories)
+  {
+    const auto it = restored_trajectories.find(element.first);
+    REQUIRE(it != restored_trajectories.end());
+    CHECK_SAME_TRAJECTORY(*element.second, *it->second);
+  }
+}
+
+//==============================================================================
+long file_size(const std::string& path)
+{
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  REQUIRE(file);
+  std::fseek(file, 0, SEEK_END);
+  const long size = std::ftell(file);
+  std::fclose(file);
+  return size;
+}
+
+} // anonymous namespace
+
+//==============================================================================
+SCENARIO("Test Database Storage")
+{
+  using namespace rmf_traffic;
+  using Database = schedule::Database;
+  using Storage = schedule::Storage;
+
+  const std::string directory = make_temp_directory();
+
+  const Time time = std::chrono::steady_clock::now();
+  const auto box = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Box>(1.0, 1.0));
+  const auto circle = Trajectory::Profile::make_queued(
+        geometry::make_final_convex<geometry::Circle>(0.5), "queue");
+
+  Trajectory t1("test_map");
+  t1.insert(time, box, Eigen::Vector3d{-5, 0, 0}, Eigen::Vector3d{0, 0, 0});
+  t1.insert(time + 10s, box, Eigen::Vector3d{5, 0, 0}, Eigen::Vector3d{1, 0, 0});
+  t1.insert(time + 20s, circle, Eigen::Vector3d{5, 5, 0}, Eigen::Vector3d{0, 0, 0});
+
+  Trajectory t2("other_map");
+  t2.insert(time, circle, Eigen::Vector3d{0, -5, 0}, Eigen::Vector3d{0, 0, 0});
+  t2.insert(time + 5s, circle, Eigen::Vector3d{0, 5, 0}, Eigen::Vector3d{0, 0, 0});
+
+  Trajectory t3("test_map");
+  t3.insert(time + 30s, box, Eigen::Vector3d{1, 1, 0}, Eigen::Vector3d{0, 0, 0});
+  t3.insert(time + 35s, box, Eigen::Vector3d{1, 1, 0}, Eigen::Vector3d{0, 0, 0});
+
+  Trajectory pause("test_map");
+  pause.insert(time + 12s, box, Eigen::Vector3d{5, 0, 0}, Eigen::Vector3d{0, 0, 0});
+  pause.insert(time + 14s, box, Eigen::Vector3d{5, 0, 0}, Eigen::Vector3d{0, 0, 0});
+
+  GIVEN("A Database that is saved after each change")
+  {
+    Storage storage(directory);
+    Database db = storage.load();
+    CHECK(db.latest_version() == 0);
+
+    const auto v1 = db.insert(t1);
+    storage.save(db);
+    const auto v2 = db.insert(t2);
+    storage.save(db);
+    const auto v3 = db.delay(v1, time + 5s, 2s);
+    storage.save(db);
+    const auto v4 = db.interrupt(v3, pause, 1s);
+    storage.save(db);
+    const auto v5 = db.replace(v2, t3);
+    db.insert(t2);
+    storage.save(db);
+    db.erase(v5);
+    storage.save(db);
+
+    WHEN("The Database is loaded from storage")
+    {
+      Storage other_storage(directory);
+      Database restored = other_storage.load();
+
+      CHECK(restored.latest_version() == db.latest_version());
+      CHECK(restored.oldest_version() == db.oldest_version());
+      CHECK(schedule::Viewer::Debug::get_num_entries(restored)
+            == schedule::Viewer::Debug::get_num_entries(db));
+
+      for(schedule::Version v = 0; v <= db.latest_version(); ++v)
+        CHECK_SAME_CHANGES(db, restored, v);
+
+      CHECK_SAME_VIEW(db, restored);
+
+      THEN("The restored Database continues with the same versions")
+      {
+        CHECK(restored.delay(v4, time, 1s) == db.delay(v4, time, 1s));
+        other_storage.save(restored);
+        CHECK_SAME_CHANGES(db, restored, v4);
+
+        Database reloaded = Storage(directory).load();
+        CHECK(reloaded.latest_version() == db.latest_version());
+        CHECK_SAME_CHANGES(db, reloaded, v4);
+        CHECK_SAME_VIEW(restored, reloaded);
+      }
+    }
+
+    WHEN("A trajectory is delayed")
+    {
+      const long size_before = file_size(directory + "/log");
+      db.delay(v4, time + 13s, 3s);
+      storage.save(db);
+
+      // Only the parameters of the delay are written to the log, not the
+      // trajectory that it produces
+      CHECK(file_size(directory + "/log") - size_before < 64);
+
+      Database restored = Storage(directory).load();
+      CHECK(restored.latest_version() == db.latest_version());
+      CHECK_SAME_CHANGES(db, restored, v4);
+      CHECK_SAME_VIEW(db, restored);
+    }
+
+    WHEN("Changes are prepared before they get written")
+    {
+      db.delay(v4, time + 13s, 3s);
+      auto first = storage.prepare(db);
+      db.insert(t3);
+      auto second = storage.prepare(db);
+
+      // Nothing is on disk until the changes are written
+      CHECK(Storage(directory).load().latest_version()
+            == db.latest_version() - 2);
+
+      storage.write(std::move(first));
+      storage.write(std::move(second));
+
+      Database restored = Storage(directory).load();
+      CHECK(restored.latest_version() == db.latest_version());
+      CHECK_SAME_CHANGES(db, restored, v4);
+      CHECK_SAME_VIEW(db, restored);
+    }
+
+    WHEN("The Database is culled")
+    {
+      const auto cull_version = db.cull(time + 16s);
+      storage.save(db);
+
+      Database restored = Storage(directory).load();
+      CHECK(restored.latest_version() == cull_version);
+      CHECK(restored.oldest_version() == db.oldest_version());
+      CHECK(schedule::Viewer::Debug::get_num_entries(restored)
+            == schedule::Viewer::Debug::get_num_entries(db));
+
+      for(schedule::Version v = 0; v <= db.latest_version(); ++v)
+        CHECK_SAME_CHANGES(db, restored, v);
+
+      // The cull should have compacted the log into the snapshot
+      std::FILE* log = std::fopen((directory + "/log").c_str(), "rb");
+      REQUIRE(log);
+      std::fseek(log, 0, SEEK_END);
+      CHECK(std::ftell(log) == 20);
+      std::fclose(log);
+    }
+
+    WHEN("The end of the log is damaged")
+    {
+      const std::string log_path = directory + "/log";
+      std::FILE* log = std::fopen(log_path.c_str(), "rb");
+      REQUIRE(log);
+      std::fseek(log, 0, SEEK_END);
+      const long size = std::ftell(log);
+      std::fclose(log);
+      REQUIRE(truncate(log_path.c_str(), size - 3) == 0);
+
+      Storage damaged_storage(directory);
+      Database restored = damaged_storage.load();
+
+      // Only the erasure was lost
+      CHECK(restored.latest_version() == db.latest_version() - 1);
+      CHECK(schedule::Viewer::Debug::get_num_entries(restored)
+            == schedule::Viewer::Debug::get_num_entries(db) - 1);
+
+      THEN("Saving again repairs the storage")
+      {
+        restored.erase(v5);
+        damaged_storage.save(restored);
+
+        Database reloaded = Storage(directory).load();
+        CHECK(reloaded.latest_version() == db.latest_version());
+        for(schedule::Version v = 0; v <= db.latest_version(); ++v)
+          CHECK_SAME_CHANGES(db, reloaded, v);
+      }
+    }
+
+    WHEN("The snapshot was written in an older format")
+    {
+      // The format version comes right after the magic string
+      const std::string snapshot_path = directory + "/snapshot";
+      std::FILE* snapshot = std::fopen(snapshot_path.c_str(), "r+b");
+      REQUIRE(snapshot);
+      const uint32_t old_version = 1;
+      std::fseek(snapshot, 8, SEEK_SET);
+      REQUIRE(std::fwrite(&old_version, sizeof(old_version), 1, snapshot) == 1);
+      std::fclose(snapshot);
+
+      CHECK_THROWS_AS(Storage(directory).load(), std::runtime_error);
+    }
+  }
+
+  remove_directory(directory);
+}
@@ -18,9 +18,12 @@
 #include "utils_Conflict.hpp"
 #include "utils_Trajectory.hpp"
 #include "src/rmf_traffic/DetectConflictInternal.hpp"
+#include "src/rmf_traffic/Spline.hpp"
 
 #include <rmf_utils/catch.hpp>
 #include <iostream>
+#include <limits>
+#include <random>
 
 using namespace std::chrono_literals;
 
@@ -656,6 +659,549 @@ SCENARIO("DetectConflict unit tests")
 }
 
 
+SCENARIO("DetectConflict::all_pairs matches pairwise checks")
+{
+  using namespace rmf_traffic;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  // Robots move along a grid of crossing lanes with staggered start times, so
+  // some of them will conflict and others will not.
+  std::vector<Trajectory> trajectories;
+  for(int i=0; i < 12; ++i)
+  {
+    const double lane = 2.0*(i/2);
+    const auto t0 = start_time + std::chrono::seconds(i%3);
+    Trajectory trajectory(i < 10? "test_map" : "other_map");
+    if(i%2 == 0)
+    {
+      trajectory.insert(t0, profile, {lane, -1.0, 0.0}, {0.0, 1.0, 0.0});
+      trajectory.insert(t0 + 12s, profile, {lane, 11.0, 0.0}, {0.0, 1.0, 0.0});
+    }
+    else
+    {
+      trajectory.insert(t0, profile, {-1.0, lane, 0.0}, {1.0, 0.0, 0.0});
+      trajectory.insert(t0 + 12s, profile, {11.0, lane, 0.0}, {1.0, 0.0, 0.0});
+    }
+
+    trajectories.emplace_back(std::move(trajectory));
+  }
+
+  std::vector<const Trajectory*> pointers;
+  for(const auto& trajectory : trajectories)
+    pointers.push_back(&trajectory);
+
+  std::vector<DetectConflict::IndexPair> expected;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    for(std::size_t j=i+1; j < trajectories.size(); ++j)
+    {
+      if(!DetectConflict::between(
+           trajectories[i], trajectories[j], true).empty())
+        expected.emplace_back(i, j);
+    }
+  }
+
+  REQUIRE_FALSE(expected.empty());
+  REQUIRE(expected.size() < trajectories.size()*(trajectories.size()-1)/2);
+
+  WHEN("Checking all pairs within one set")
+  {
+    CHECK(DetectConflict::all_pairs(pointers, 1) == expected);
+    CHECK(DetectConflict::all_pairs(pointers, 4) == expected);
+    CHECK(DetectConflict::all_pairs(pointers) == expected);
+  }
+
+  WHEN("Checking all pairs between two sets")
+  {
+    const std::size_t split = 5;
+    const std::vector<const Trajectory*> set_a(
+          pointers.begin(), pointers.begin() + split);
+    const std::vector<const Trajectory*> set_b(
+          pointers.begin() + split, pointers.end());
+
+    std::vector<DetectConflict::IndexPair> expected_between;
+    for(const auto& pair : expected)
+    {
+      if(pair.first < split && split <= pair.second)
+        expected_between.emplace_back(pair.first, pair.second - split);
+    }
+
+    CHECK(DetectConflict::all_pairs(set_a, set_b, 3) == expected_between);
+    CHECK(DetectConflict::all_pairs(set_a, set_b) == expected_between);
+
+    std::vector<DetectConflict::IndexPair> expected_swapped;
+    for(const auto& pair : expected_between)
+      expected_swapped.emplace_back(pair.second, pair.first);
+    std::sort(expected_swapped.begin(), expected_swapped.end());
+
+    CHECK(DetectConflict::all_pairs(set_b, set_a) == expected_swapped);
+  }
+
+  WHEN("Checking many times in a row")
+  {
+    // The workers are shared between calls, so this should not leave any
+    // threads or work behind.
+    for(std::size_t i=0; i < 50; ++i)
+      CHECK(DetectConflict::all_pairs(pointers, 2 + i%4) == expected);
+  }
+
+  WHEN("The set is empty")
+  {
+    CHECK(DetectConflict::all_pairs({}).empty());
+  }
+}
+
+
+SCENARIO("Circle contacts are solved analytically")
+{
+  using namespace rmf_traffic;
+
+  const auto start_time = std::chrono::steady_clock::now();
+
+  GIVEN("A circle that drives past a parked circle")
+  {
+    const auto profile = Trajectory::Profile::make_guided(
+          geometry::make_final_convex<geometry::Circle>(0.5));
+
+    Trajectory moving("test_map");
+    moving.insert(start_time, profile, {-5.0, 0.0, 0.0}, {1.0, 0.0, 0.0});
+    moving.insert(start_time + 10s, profile, {5.0, 0.0, 0.0}, {1.0, 0.0, 0.0});
+
+    Trajectory parked("test_map");
+    parked.insert(start_time, profile, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0});
+    parked.insert(start_time + 10s, profile, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0});
+
+    // The centers are 1m apart after the moving circle has traveled 4m
+    const auto conflicts = DetectConflict::between(moving, parked);
+    REQUIRE(conflicts.size() == 1);
+    const double error = std::chrono::duration_cast<
+        std::chrono::duration<double>>(
+          conflicts.front().get_time() - (start_time + 4s)).count();
+    CHECK(std::abs(error) < 1e-5);
+
+    WHEN("The parked circle is moved out of the way")
+    {
+      Trajectory out_of_the_way("test_map");
+      out_of_the_way.insert(
+            start_time, profile, {0.0, 1.01, 0.0}, {0.0, 0.0, 0.0});
+      out_of_the_way.insert(
+            start_time + 10s, profile, {0.0, 1.01, 0.0}, {0.0, 0.0, 0.0});
+
+      CHECK(DetectConflict::between(moving, out_of_the_way).empty());
+    }
+  }
+
+  GIVEN("Random pairs of splines")
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> position(-3.0, 3.0);
+    std::uniform_real_distribution<double> velocity(-2.0, 2.0);
+    std::uniform_real_distribution<double> radius(0.1, 1.0);
+
+    const auto random_data = [&](const Time time)
+    {
+      return internal::SegmentData{
+        time,
+        Eigen::Vector3d(position(rng), position(rng), position(rng)),
+        Eigen::Vector3d(velocity(rng), velocity(rng), velocity(rng))
+      };
+    };
+
+    const std::size_t samples = 20000;
+    for(std::size_t n=0; n < 200; ++n)
+    {
+      const Spline spline_a(
+            random_data(start_time), random_data(start_time + 10s));
+      const Spline spline_b(
+            random_data(start_time), random_data(start_time + 10s));
+      const double contact_distance = radius(rng) + radius(rng);
+
+      const auto coeffs_a =
+          spline_a.compute_coefficients(start_time, start_time + 10s);
+      const auto coeffs_b =
+          spline_b.compute_coefficients(start_time, start_time + 10s);
+
+      // Find the first contact by brute force
+      rmf_utils::optional<double> expected;
+      double closest = std::numeric_limits<double>::infinity();
+      for(std::size_t i=0; i <= samples; ++i)
+      {
+        const double s = static_cast<double>(i)/samples;
+        const Time t = start_time + std::chrono::duration_cast<Duration>(
+              std::chrono::duration<double>(10.0*s));
+        const double distance =
+            (spline_a.compute_position(t) - spline_b.compute_position(t))
+            .block<2,1>(0,0).norm();
+
+        closest = std::min(closest, distance);
+        if(!expected && distance <= contact_distance)
+          expected = s;
+      }
+
+      const auto contact = internal::detect_circle_contact(
+            coeffs_a, coeffs_b, contact_distance);
+
+      if(expected)
+      {
+        REQUIRE(contact);
+        CHECK(*contact <= *expected + 1e-6);
+        CHECK(*expected - 1.0/samples - 1e-6 <= *contact);
+      }
+      else if(contact)
+      {
+        // The contact must have happened between two samples
+        CHECK(closest < contact_distance + 1e-2);
+      }
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Segments are culled by their swept bounding boxes")
+{
+  using namespace rmf_traffic;
+
+  const auto start_time = std::chrono::steady_clock::now();
+
+  GIVEN("A spline that curves between two points")
+  {
+    const internal::SegmentData start{
+      start_time,
+      Eigen::Vector3d(0.0, 0.0, 0.0),
+      Eigen::Vector3d(2.0, 1.0, 0.0)
+    };
+
+    const internal::SegmentData finish{
+      start_time + 10s,
+      Eigen::Vector3d(10.0, 0.0, 0.0),
+      Eigen::Vector3d(-1.0, 2.0, 0.0)
+    };
+
+    const Spline spline(start, finish);
+    const auto full_bounds = spline.compute_bounds();
+
+    WHEN("Bounds are computed for part of the spline")
+    {
+      const Time window_start = start_time + 2s;
+      const Time window_finish = start_time + 5s;
+      const auto bounds = spline.compute_bounds(window_start, window_finish);
+
+      THEN("The bounds contain every position within the window")
+      {
+        const std::size_t samples = 100;
+        for(std::size_t i=0; i <= samples; ++i)
+        {
+          const Time t = window_start
+              + (window_finish - window_start)*i/samples;
+          const Eigen::Vector3d p = spline.compute_position(t);
+          for(int k=0; k < 2; ++k)
+          {
+            CHECK(bounds[0][k] <= p[k] + 1e-8);
+            CHECK(p[k] <= bounds[1][k] + 1e-8);
+          }
+        }
+      }
+
+      THEN("The bounds are no larger than the bounds of the whole spline")
+      {
+        for(int k=0; k < 2; ++k)
+        {
+          CHECK(full_bounds[0][k] <= bounds[0][k] + 1e-8);
+          CHECK(bounds[1][k] <= full_bounds[1][k] + 1e-8);
+        }
+
+        CHECK(bounds[1][0] - bounds[0][0]
+              < full_bounds[1][0] - full_bounds[0][0]);
+      }
+    }
+
+    WHEN("Bounds are computed for the whole time range")
+    {
+      const auto bounds = spline.compute_bounds(
+            spline.start_time(), spline.finish_time());
+
+      for(int k=0; k < 2; ++k)
+      {
+        CHECK(bounds[0][k] == Approx(full_bounds[0][k]));
+        CHECK(bounds[1][k] == Approx(full_bounds[1][k]));
+      }
+    }
+  }
+
+  GIVEN("Two robots whose paths only come close at different times")
+  {
+    const auto profile = Trajectory::Profile::make_guided(
+          geometry::make_final_convex<geometry::Circle>(0.5));
+
+    // The first robot passes through the origin at 5s and is far away by the
+    // time the second robot arrives there at 15s.
+    Trajectory first("test_map");
+    first.insert(start_time, profile, {-5.0, 0.0, 0.0}, {1.0, 0.0, 0.0});
+    first.insert(start_time + 10s, profile, {5.0, 0.0, 0.0}, {1.0, 0.0, 0.0});
+    first.insert(start_time + 20s, profile, {15.0, 0.0, 0.0}, {1.0, 0.0, 0.0});
+
+    Trajectory second("test_map");
+    second.insert(start_time, profile, {0.0, -15.0, 0.0}, {0.0, 1.0, 0.0});
+    second.insert(start_time + 10s, profile, {0.0, -5.0, 0.0}, {0.0, 1.0, 0.0});
+    second.insert(start_time + 20s, profile, {0.0, 5.0, 0.0}, {0.0, 1.0, 0.0});
+
+    CHECK(DetectConflict::between(first, second).empty());
+
+    WHEN("The second robot arrives at the same time as the first")
+    {
+      Trajectory early("test_map");
+      early.insert(start_time, profile, {0.0, -5.0, 0.0}, {0.0, 1.0, 0.0});
+      early.insert(start_time + 10s, profile, {0.0, 5.0, 0.0}, {0.0, 1.0, 0.0});
+      early.insert(start_time + 20s, profile, {0.0, 15.0, 0.0}, {0.0, 1.0, 0.0});
+
+      const auto conflicts = DetectConflict::between(first, early);
+      REQUIRE(conflicts.size() == 1);
+      CHECK(conflicts.front().get_time() < start_time + 5s);
+    }
+  }
+}
+
+//==============================================================================
+SCENARIO("Long trajectories are searched through their bounding volume hierarchy")
+{
+  using namespace rmf_traffic;
+  using TrajectoryIteratorImplementation =
+      detail::TrajectoryIteratorImplementation;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  // A robot that drives around a 10m square 100 times, taking 10s per side
+  const std::array<Eigen::Vector3d, 4> corners = {
+    Eigen::Vector3d{0.0, 0.0, 0.0},
+    Eigen::Vector3d{10.0, 0.0, 0.0},
+    Eigen::Vector3d{10.0, 10.0, 0.0},
+    Eigen::Vector3d{0.0, 10.0, 0.0}
+  };
+
+  Trajectory loop("test_map");
+  const std::size_t num_sides = 400;
+  for(std::size_t i=0; i <= num_sides; ++i)
+  {
+    loop.insert(start_time + std::chrono::seconds(10*i), profile,
+                corners[i%4], Eigen::Vector3d::Zero());
+  }
+  REQUIRE(loop.size() == num_sides + 1);
+
+  GIVEN("Queries on the tree of the long trajectory")
+  {
+    const internal::SplineTree& tree =
+        TrajectoryIteratorImplementation::spline_tree(loop);
+    REQUIRE_FALSE(tree.empty());
+    CHECK(tree.root().start == *loop.start_time());
+    CHECK(tree.root().finish == *loop.finish_time());
+    CHECK(tree.root().min[0] == Approx(-0.5));
+    CHECK(tree.root().max[1] == Approx(10.5));
+
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> time(0, 10*num_sides);
+    std::uniform_real_distribution<double> position(-2.0, 12.0);
+
+    for(std::size_t q=0; q < 100; ++q)
+    {
+      const int t0 = time(rng);
+      const int t1 = t0 + time(rng)/20;
+      const Time query_start = start_time + std::chrono::seconds(t0);
+      const Time query_finish = start_time + std::chrono::seconds(t1);
+      const Eigen::Vector2d p(position(rng), position(rng));
+      const Eigen::Vector2d min = p - Eigen::Vector2d::Constant(1.0);
+      const Eigen::Vector2d max = p + Eigen::Vector2d::Constant(1.0);
+
+      std::vector<std::size_t> expected;
+      std::size_t index = 0;
+      for(auto it = ++loop.begin(); it != loop.end(); ++it)
+      {
+        ++index;
+        const Spline spline(it);
+        if(spline.finish_time() < query_start
+           || query_finish < spline.start_time())
+          continue;
+
+        const internal::BoundingBox box = internal::get_bounding_box(it);
+        if(!internal::overlap(box, internal::BoundingBox{min, max}))
+          continue;
+
+        expected.push_back(index);
+      }
+
+      std::vector<std::size_t> visited;
+      tree.visit(query_start, query_finish, min, max,
+                 [&](const std::size_t index)
+      {
+        visited.push_back(index);
+        return true;
+      });
+
+      CHECK(visited == expected);
+    }
+  }
+
+  GIVEN("A short trajectory that crosses the path of the loop")
+  {
+    // The loop robot drives along the bottom edge from t=2000s to t=2010s and
+    // passes x=5 at t=2005s
+    Trajectory crossing("test_map");
+    crossing.insert(start_time + 2000s, profile,
+                    {5.0, -5.0, 0.0}, {0.0, 1.0, 0.0});
+    crossing.insert(start_time + 2010s, profile,
+                    {5.0, 5.0, 0.0}, {0.0, 1.0, 0.0});
+
+    const auto conflicts = DetectConflict::between(loop, crossing);
+    REQUIRE(conflicts.size() == 1);
+    CHECK(conflicts.front().get_time() < start_time + 2005s);
+    CHECK(start_time + 2003s < conflicts.front().get_time());
+    CHECK(conflicts.front().get_segments().first->get_finish_time()
+          == start_time + 2010s);
+    CHECK(conflicts.front().get_segments().second->get_finish_time()
+          == start_time + 2010s);
+
+    const auto swapped = DetectConflict::between(crossing, loop);
+    REQUIRE(swapped.size() == 1);
+    CHECK(swapped.front().get_time() == conflicts.front().get_time());
+    CHECK(swapped.front().get_segments().first->get_finish_time()
+          == start_time + 2010s);
+
+    WHEN("The crossing happens while the loop robot is on the far side")
+    {
+      Trajectory late("test_map");
+      late.insert(start_time + 2020s, profile,
+                  {5.0, -5.0, 0.0}, {0.0, 1.0, 0.0});
+      late.insert(start_time + 2025s, profile,
+                  {5.0, 0.0, 0.0}, {0.0, 0.0, 0.0});
+      late.insert(start_time + 2030s, profile,
+                  {5.0, -5.0, 0.0}, {0.0, 0.0, 0.0});
+
+      CHECK(DetectConflict::between(loop, late).empty());
+      CHECK(DetectConflict::between(late, loop).empty());
+    }
+
+    WHEN("The loop is delayed")
+    {
+      (++loop.begin())->adjust_finish_times(20s);
+      CHECK(DetectConflict::between(loop, crossing).empty());
+
+      (++loop.begin())->adjust_finish_times(-20s);
+      CHECK(DetectConflict::between(loop, crossing).size() == 1);
+    }
+
+    WHEN("A copy of the loop is delayed")
+    {
+      // The copy shares the splines that were cached for the original until
+      // one of them is modified.
+      Trajectory copy = loop;
+      CHECK(DetectConflict::between(copy, crossing).size() == 1);
+
+      (++copy.begin())->adjust_finish_times(20s);
+      CHECK(DetectConflict::between(copy, crossing).empty());
+      CHECK(DetectConflict::between(loop, crossing).size() == 1);
+
+      loop = copy;
+      CHECK(DetectConflict::between(loop, crossing).empty());
+    }
+  }
+}
+
+
+//==============================================================================
+SCENARIO("DetectConflict::any_between and all_between match pairwise checks")
+{
+  using namespace rmf_traffic;
+
+  const auto start_time = std::chrono::steady_clock::now();
+  const auto profile = Trajectory::Profile::make_guided(
+        geometry::make_final_convex<geometry::Circle>(0.5));
+
+  // A candidate robot drives up one lane and then across the grid
+  Trajectory candidate("test_map");
+  candidate.insert(start_time, profile, {4.0, -1.0, 0.0}, {0.0, 0.0, 0.0});
+  candidate.insert(start_time + 6s, profile, {4.0, 5.0, 0.0}, {0.0, 0.0, 0.0});
+  candidate.insert(start_time + 8s, profile, {4.0, 5.0, 0.0}, {0.0, 0.0, 0.0});
+  candidate.insert(start_time + 14s, profile, {10.0, 5.0, 0.0}, {0.0, 0.0, 0.0});
+
+  // The other robots cross the path of the candidate at staggered times, so
+  // some of them will conflict with it and others will not.
+  std::vector<Trajectory> trajectories;
+  for(int i=0; i < 12; ++i)
+  {
+    const double lane = 2.0*(i/2);
+    const auto t0 = start_time + std::chrono::seconds(3*(i%4));
+    Trajectory trajectory(i < 10? "test_map" : "other_map");
+    if(i%2 == 0)
+    {
+      trajectory.insert(t0, profile, {lane, -1.0, 0.0}, {0.0, 1.0, 0.0});
+      trajectory.insert(t0 + 12s, profile, {lane, 11.0, 0.0}, {0.0, 1.0, 0.0});
+    }
+    else
+    {
+      trajectory.insert(t0, profile, {-1.0, lane, 0.0}, {1.0, 0.0, 0.0});
+      trajectory.insert(t0 + 12s, profile, {11.0, lane, 0.0}, {1.0, 0.0, 0.0});
+    }
+
+    trajectories.emplace_back(std::move(trajectory));
+  }
+
+  std::vector<const Trajectory*> pointers;
+  for(const auto& trajectory : trajectories)
+    pointers.push_back(&trajectory);
+
+  std::vector<std::size_t> expected;
+  for(std::size_t i=0; i < trajectories.size(); ++i)
+  {
+    if(!DetectConflict::between(candidate, trajectories[i], true).empty())
+      expected.push_back(i);
+  }
+
+  REQUIRE_FALSE(expected.empty());
+  REQUIRE(expected.size() < trajectories.size());
+
+  WHEN("Checking the candidate against every trajectory")
+  {
+    CHECK(DetectConflict::all_between(candidate, pointers) == expected);
+    CHECK(DetectConflict::any_between(candidate, pointers));
+  }
+
+  WHEN("Checking the candidate against trajectories that it does not meet")
+  {
+    std::vector<const Trajectory*> clear;
+    for(std::size_t i=0; i < pointers.size(); ++i)
+    {
+      if(std::find(expected.begin(), expected.end(), i) == expected.end())
+        clear.push_back(pointers[i]);
+    }
+
+    CHECK(DetectConflict::all_between(candidate, clear).empty());
+    CHECK_FALSE(DetectConflict::any_between(candidate, clear));
+  }
+
+  WHEN("The set is empty")
+  {
+    CHECK(DetectConflict::all_between(candidate, {}).empty());
+    CHECK_FALSE(DetectConflict::any_between(candidate, {}));
+  }
+
+  WHEN("A trajectory is too short")
+  {
+    Trajectory short_trajectory("test_map");
+    short_trajectory.insert(
+          start_time, profile, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0});
+
+    pointers.push_back(&short_trajectory);
+    CHECK_THROWS_AS(DetectConflict::all_between(candidate, pointers),
+                    invalid_trajectory_error);
+
+    CHECK_THROWS_AS(DetectConflict::any_between(short_trajectory, {}),
+                    invalid_trajectory_error);
+  }
+}
 
 /// Remaining test suggestions:
 // A useful website for playing with 2D cubic splines: https://www.desmos.com/calculator/
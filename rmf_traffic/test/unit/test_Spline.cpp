@@ -22,6 +22,52 @@
 
 #include <iostream>
 
+namespace {
+
+//==============================================================================
+/// Check that the spline that a Trajectory gives for each of its segments
+/// matches a spline that is computed from scratch.
+void CHECK_CACHED_SPLINES(const rmf_traffic::Trajectory& trajectory)
+{
+  REQUIRE(trajectory.size() > 1);
+  auto previous = trajectory.begin();
+  for(auto it = ++trajectory.begin(); it != trajectory.end(); ++it, ++previous)
+  {
+    const rmf_traffic::Spline cached(it);
+    const rmf_traffic::Spline fresh(
+          rmf_traffic::internal::SegmentData{
+            previous->get_finish_time(),
+            previous->get_finish_position(),
+            previous->get_finish_velocity()
+          },
+          rmf_traffic::internal::SegmentData{
+            it->get_finish_time(),
+            it->get_finish_position(),
+            it->get_finish_velocity()
+          });
+
+    CHECK(cached.start_time() == fresh.start_time());
+    CHECK(cached.finish_time() == fresh.finish_time());
+    for(int i=0; i < 2; ++i)
+    {
+      CHECK(cached.compute_bounds()[i].isApprox(fresh.compute_bounds()[i]));
+    }
+
+    const rmf_traffic::Duration step = (it->get_finish_time()
+        - previous->get_finish_time())/10;
+    for(int i=0; i <= 10; ++i)
+    {
+      const rmf_traffic::Time t = previous->get_finish_time() + i*step;
+      CHECK((cached.compute_position(t) - fresh.compute_position(t)).norm()
+            == Approx(0.0).margin(1e-8));
+      CHECK((cached.compute_velocity(t) - fresh.compute_velocity(t)).norm()
+            == Approx(0.0).margin(1e-8));
+    }
+  }
+}
+
+} // anonymous namespace
+
 SCENARIO("Test spline")
 {
   using namespace std::chrono_literals;
@@ -70,3 +116,73 @@ SCENARIO("Test spline")
     CHECK(p[1] == Approx(delta_t.count() - 5.0));
   }
 }
+
+SCENARIO("Splines are cached by their Trajectory")
+{
+  using namespace std::chrono_literals;
+
+  const rmf_traffic::Time begin_time = std::chrono::steady_clock::now();
+  const auto profile = make_test_profile(UnitBox);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  trajectory.insert(begin_time, profile,
+                    Eigen::Vector3d{0.0, 0.0, 0.0}, Eigen::Vector3d{1.0, 0.0, 0.0});
+  trajectory.insert(begin_time + 10s, profile,
+                    Eigen::Vector3d{10.0, 0.0, 0.0}, Eigen::Vector3d{0.0, 1.0, 0.0});
+  trajectory.insert(begin_time + 20s, profile,
+                    Eigen::Vector3d{10.0, 10.0, 0.0}, Eigen::Vector3d{0.0, 0.0, 0.0});
+  trajectory.insert(begin_time + 30s, profile,
+                    Eigen::Vector3d{0.0, 10.0, 1.0}, Eigen::Vector3d{0.0, 0.0, 0.0});
+
+  CHECK_CACHED_SPLINES(trajectory);
+
+  WHEN("A segment's position and velocity are changed")
+  {
+    auto it = ++trajectory.begin();
+    it->set_finish_position({5.0, -3.0, 0.0});
+    it->set_finish_velocity({-1.0, 1.0, 0.0});
+    CHECK_CACHED_SPLINES(trajectory);
+  }
+
+  WHEN("A segment's finish time is moved past another segment")
+  {
+    (++trajectory.begin())->set_finish_time(begin_time + 25s);
+    CHECK_CACHED_SPLINES(trajectory);
+  }
+
+  WHEN("Segments are delayed")
+  {
+    (++trajectory.begin())->adjust_finish_times(5s);
+    CHECK_CACHED_SPLINES(trajectory);
+
+    (++(++trajectory.begin()))->adjust_finish_times(-2s);
+    CHECK_CACHED_SPLINES(trajectory);
+  }
+
+  WHEN("Segments are inserted and erased")
+  {
+    trajectory.insert(begin_time + 15s, profile,
+                      Eigen::Vector3d{12.0, 5.0, 0.0},
+                      Eigen::Vector3d{0.0, 0.5, 0.0});
+    CHECK_CACHED_SPLINES(trajectory);
+
+    trajectory.erase(++trajectory.begin());
+    CHECK_CACHED_SPLINES(trajectory);
+
+    trajectory.erase(trajectory.begin());
+    CHECK_CACHED_SPLINES(trajectory);
+  }
+
+  WHEN("A copy of the trajectory is modified")
+  {
+    rmf_traffic::Trajectory copy = trajectory;
+    (++copy.begin())->set_finish_position({3.0, 3.0, 0.0});
+    CHECK_CACHED_SPLINES(copy);
+    CHECK_CACHED_SPLINES(trajectory);
+
+    const auto original = rmf_traffic::Spline(++trajectory.begin());
+    const auto modified = rmf_traffic::Spline(++copy.begin());
+    CHECK((original.compute_position(begin_time + 10s)
+           - modified.compute_position(begin_time + 10s)).norm() > 1.0);
+  }
+}
@@ -19,6 +19,7 @@
 #include <src/rmf_traffic/debug_Trajectory.hpp>
 #include <rmf_utils/catch.hpp>
 #include <iostream>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -730,6 +731,30 @@ SCENARIO("Trajectory and base_iterator unit tests")
         CHECK(++third_it == trajectory.end());
       }
     }
+
+    WHEN("Inserting and erasing segments around a segment reference")
+    {
+      rmf_traffic::Trajectory trajectory = create_test_trajectory(param_inputs);
+      rmf_traffic::Trajectory::Segment& second = *trajectory.find(time + 10s);
+      const auto profile = second.get_profile();
+
+      trajectory.insert(time + 5s, profile, Eigen::Vector3d(6, 6, 6),
+                        Eigen::Vector3d(7, 7, 7));
+      trajectory.erase(trajectory.begin());
+      trajectory.insert(time + 30s, profile, Eigen::Vector3d(8, 8, 8),
+                        Eigen::Vector3d(9, 9, 9));
+
+      THEN("The reference still refers to the same segment")
+      {
+        CHECK(second.get_finish_time() == time + 10s);
+        CHECK(second.get_finish_position() == Eigen::Vector3d(2, 2, 2));
+        CHECK(&second == &(*trajectory.find(time + 10s)));
+        CHECK(second.get_profile() == profile);
+        CHECK(trajectory.size() == 4);
+        CHECK(rmf_traffic::Trajectory::Debug::check_iterator_time_consistency(
+                trajectory, true));
+      }
+    }
   }
   // Trajectory functions
   GIVEN("Sample Trajectories")
@@ -783,6 +808,66 @@ SCENARIO("Trajectory and base_iterator unit tests")
       }
     }
 
+    WHEN("Modifying a copy of a trajectory")
+    {
+      rmf_traffic::Trajectory trajectory_copy = trajectory;
+      trajectory_copy.begin()->adjust_finish_times(5s);
+      trajectory_copy.back().set_finish_position(Eigen::Vector3d(9, 9, 9));
+
+      THEN("Only the copy is changed, source is unaffected")
+      {
+        CHECK(*trajectory.start_time() == time);
+        CHECK(*trajectory.finish_time() == time + 20s);
+        CHECK(trajectory.back().get_finish_position() == Eigen::Vector3d(4, 4, 4));
+
+        CHECK(*trajectory_copy.start_time() == time + 5s);
+        CHECK(*trajectory_copy.finish_time() == time + 25s);
+        CHECK(trajectory_copy.back().get_finish_position() == Eigen::Vector3d(9, 9, 9));
+        CHECK(trajectory_copy.front().get_finish_position() == Eigen::Vector3d(0, 0, 0));
+      }
+    }
+
+    WHEN("Repeatedly delaying the segments of a trajectory")
+    {
+      for(std::size_t i=0; i < 20; ++i)
+      {
+        rmf_traffic::Trajectory::iterator it = trajectory.begin();
+        for(std::size_t j=0; j < i%3; ++j)
+          ++it;
+
+        it->adjust_finish_times(1s);
+      }
+
+      THEN("Every delay is applied to the segments that follow it")
+      {
+        auto it = trajectory.begin();
+        CHECK(it->get_finish_time() == time + 7s);
+        CHECK((++it)->get_finish_time() == time + 10s + 14s);
+        CHECK((++it)->get_finish_time() == time + 20s + 20s);
+
+        CHECK(*trajectory.start_time() == time + 7s);
+        CHECK(*trajectory.finish_time() == time + 40s);
+        CHECK(trajectory.duration() == 33s);
+        CHECK(trajectory.find(time + 20s)->get_finish_time() == time + 24s);
+        CHECK(trajectory.find(time) == trajectory.end());
+        CHECK(rmf_traffic::Trajectory::Debug::check_iterator_time_consistency(
+                trajectory, true));
+      }
+
+      THEN("Inserting a segment keeps the delays")
+      {
+        trajectory.insert(time + 30s, trajectory.front().get_profile(),
+                          Eigen::Vector3d(5, 5, 5),
+                          Eigen::Vector3d(0, 0, 0));
+        CHECK(trajectory.size() == 4);
+        CHECK(*trajectory.start_time() == time + 7s);
+        CHECK(*trajectory.finish_time() == time + 40s);
+        CHECK(trajectory.find(time + 25s)->get_finish_time() == time + 30s);
+        CHECK(rmf_traffic::Trajectory::Debug::check_iterator_time_consistency(
+                trajectory, true));
+      }
+    }
+
     WHEN("Erasing a first segment")
     {
       THEN("Segment is erased and trajectory is rearranged")
@@ -1039,3 +1124,55 @@ SCENARIO("Trajectory and base_iterator unit tests")
     }
   }
 }
+
+SCENARIO("Segments of a const Trajectory are dereferenced from many threads")
+{
+  const rmf_traffic::Time time = std::chrono::steady_clock::now();
+  const auto profile = create_test_profile(
+        UnitBox, rmf_traffic::Trajectory::Profile::Autonomy::Guided);
+
+  rmf_traffic::Trajectory trajectory("test_map");
+  const std::size_t N = 200;
+  for (std::size_t i=0; i < N; ++i)
+  {
+    trajectory.insert(
+          time + i*1s, profile,
+          Eigen::Vector3d(i, 0, 0), Eigen::Vector3d(1, 0, 0));
+  }
+
+  const rmf_traffic::Trajectory& const_trajectory = trajectory;
+
+  // Every thread should get the same Segment object for each iterator, even
+  // though the Segment objects are created while the threads are running.
+  const std::size_t num_threads = 4;
+  std::vector<std::vector<const rmf_traffic::Trajectory::Segment*>> results(
+        num_threads);
+  std::vector<std::thread> threads;
+  for (std::size_t t=0; t < num_threads; ++t)
+  {
+    threads.emplace_back([&, t]()
+    {
+      for (auto it = const_trajectory.begin();
+           it != const_trajectory.end(); ++it)
+      {
+        results[t].push_back(&(*it));
+      }
+    });
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  for (std::size_t t=0; t < num_threads; ++t)
+  {
+    REQUIRE(results[t].size() == N);
+    CHECK(results[t] == results.front());
+  }
+
+  std::size_t i = 0;
+  for (const auto* segment : results.front())
+  {
+    CHECK(segment->get_finish_time() == time + (i++)*1s);
+    CHECK(&(*const_trajectory.find(segment->get_finish_time())) == segment);
+  }
+}
@@ -32,6 +32,7 @@ const std::string RegisterQueryServiceName = Prefix + "register_query";
 const std::string UnregisterQueryServiceName = Prefix + "unregister_query";
 const std::string MirrorUpdateServiceName = Prefix + "mirror_update";
 const std::string MirrorWakeupTopicName = Prefix + "mirror_wakeup";
+const std::string MirrorPatchTopicName = Prefix + "mirror_patch";
 const std::string ScheduleConflictTopicName = Prefix + "schedule_conflict";
 
 const std::string EmergencyTopicName = "fire_alarm_trigger";
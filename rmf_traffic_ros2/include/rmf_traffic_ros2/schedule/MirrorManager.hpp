@@ -44,9 +44,20 @@ public:
     /// \brief update_on_wakeup
     ///   Specify if the mirror should perform an update whenever it gets woken
     ///   up by the schedule.
+    ///
+    /// \brief stream_patches
+    ///   Specify if the mirror should be updated by the patches that the
+    ///   schedule publishes instead of requesting its own updates.
+    ///
+    /// \brief minimum_update_interval
+    ///   The minimum amount of time to wait between the update requests that
+    ///   get sent in response to changes in the schedule.
     Options(
         std::mutex* update_mutex = nullptr,
-        bool update_on_wakeup = true);
+        bool update_on_wakeup = true,
+        bool stream_patches = false,
+        rmf_traffic::Duration minimum_update_interval =
+            rmf_traffic::Duration(0));
 
     /// Get a reference to the mutex that will be used when performing an
     /// update.
@@ -63,6 +74,26 @@ public:
     /// Toggle the choice to wakeup on an update.
     Options& update_on_wakeup(bool choice);
 
+    /// True if the mirror should be updated by the patches that the schedule
+    /// publishes each time it changes. This saves a round trip to the schedule
+    /// for every change. If a patch is missed, the mirror will request an
+    /// update from the schedule to get back in sync.
+    ///
+    /// While this is true, MirrorWakeup messages will not trigger updates.
+    bool stream_patches() const;
+
+    /// Toggle the choice to stream patches.
+    Options& stream_patches(bool choice);
+
+    /// The minimum amount of time to wait between the update requests that
+    /// get sent in response to changes in the schedule. Any changes that
+    /// arrive during this interval get folded into the next request. There is
+    /// never more than one update request waiting for a reply at a time.
+    rmf_traffic::Duration minimum_update_interval() const;
+
+    /// Set the minimum amount of time to wait between update requests.
+    Options& minimum_update_interval(rmf_traffic::Duration interval);
+
     class Implementation;
   private:
     rmf_utils::impl_ptr<Implementation> _pimpl;
@@ -82,6 +113,15 @@ public:
   // get triggered when the update is complete.
   void update(rmf_traffic::Duration wait = rmf_traffic::Duration(0));
 
+  /// Get the number of update requests that this mirror manager has sent to
+  /// the schedule.
+  std::size_t update_requests_sent() const;
+
+  /// Get the number of updates that did not need a request of their own,
+  /// either because the mirror was already up to date or because they were
+  /// folded into another request.
+  std::size_t update_requests_saved() const;
+
   /// Get the options for this mirror manager
   const Options& get_options() const;
 
@@ -20,6 +20,7 @@
 #include <rmf_traffic_ros2/schedule/Patch.hpp>
 #include <rmf_traffic_ros2/schedule/Query.hpp>
 
+#include <rmf_traffic_msgs/msg/mirror_patch.hpp>
 #include <rmf_traffic_msgs/msg/mirror_wakeup.hpp>
 
 #include <rmf_traffic_msgs/srv/mirror_update.hpp>
@@ -28,6 +29,10 @@
 
 #include <rclcpp/logging.hpp>
 
+#include <rmf_utils/optional.hpp>
+
+#include <algorithm>
+
 namespace rmf_traffic_ros2 {
 namespace schedule {
 
@@ -35,12 +40,19 @@ using MirrorUpdate = rmf_traffic_msgs::srv::MirrorUpdate;
 using MirrorUpdateClient = rclcpp::Client<MirrorUpdate>::SharedPtr;
 using MirrorUpdateFuture = rclcpp::Client<MirrorUpdate>::SharedFuture;
 
+using RegisterQuery = rmf_traffic_msgs::srv::RegisterQuery;
+using RegisterQueryClient = rclcpp::Client<RegisterQuery>::SharedPtr;
+using RegisterQueryFuture = rclcpp::Client<RegisterQuery>::SharedFuture;
+
 using UnregisterQuery = rmf_traffic_msgs::srv::UnregisterQuery;
 using UnregisterQueryClient = rclcpp::Client<UnregisterQuery>::SharedPtr;
 
 using MirrorWakeup = rmf_traffic_msgs::msg::MirrorWakeup;
 using MirrorWakeupSub = rclcpp::Subscription<MirrorWakeup>::SharedPtr;
 
+using MirrorPatch = rmf_traffic_msgs::msg::MirrorPatch;
+using MirrorPatchSub = rclcpp::Subscription<MirrorPatch>::SharedPtr;
+
 //==============================================================================
 class MirrorManager::Implementation
 {
@@ -48,9 +60,12 @@ public:
 
   rclcpp::Node& node;
   Options options;
+  rmf_traffic::schedule::Query::Spacetime spacetime;
+  RegisterQueryClient register_query_client;
   MirrorUpdateClient mirror_update_client;
   UnregisterQueryClient unregister_query_client;
   MirrorWakeupSub mirror_wakeup_sub;
+  MirrorPatchSub mirror_patch_sub;
 
   MirrorUpdate::Request::SharedPtr request_msg;
 
@@ -60,14 +75,28 @@ public:
 
   rmf_traffic::schedule::Version next_minimum_version = 0;
 
+  // Used to space out the update requests that we send in response to changes
+  rmf_traffic::Time last_request_time;
+  rclcpp::TimerBase::SharedPtr update_timer;
+
+  std::size_t requests_sent = 0;
+  std::size_t requests_saved = 0;
+
+  // The sequence number of the last streamed patch that was received
+  rmf_utils::optional<uint64_t> last_patch_sequence;
+
   Implementation(
       rclcpp::Node& _node,
       Options _options,
+      rmf_traffic::schedule::Query::Spacetime _spacetime,
       uint64_t _query_id,
+      RegisterQueryClient _register_query_client,
       MirrorUpdateClient _mirror_update_client,
       UnregisterQueryClient _unregister_query_client)
     : node(_node),
       options(std::move(_options)),
+      spacetime(std::move(_spacetime)),
+      register_query_client(std::move(_register_query_client)),
       mirror_update_client(std::move(_mirror_update_client)),
       unregister_query_client(std::move(_unregister_query_client)),
       request_msg(std::make_shared<MirrorUpdate::Request>())
@@ -80,12 +109,135 @@ public:
     });
 
     request_msg->query_id = _query_id;
+
+    configure_streaming();
+  }
+
+  void configure_streaming()
+  {
+    if(!options.stream_patches())
+    {
+      mirror_patch_sub = nullptr;
+      last_patch_sequence = rmf_utils::nullopt;
+      return;
+    }
+
+    if(mirror_patch_sub)
+      return;
+
+    mirror_patch_sub = node.create_subscription<MirrorPatch>(
+          MirrorPatchTopicName, rclcpp::SystemDefaultsQoS(),
+          [&](const MirrorPatch::SharedPtr msg)
+    {
+      receive_patch(*msg);
+    });
+
+    // Streamed patches only cover changes that happen from now on, so we ask
+    // the schedule for everything that came before.
+    update(mirror.latest_version());
   }
 
   void trigger_wakeup(uint64_t minimum_version)
   {
-    if(options.update_on_wakeup())
-      update(minimum_version);
+    if(!options.update_on_wakeup() || options.stream_patches())
+      return;
+
+    if(minimum_version <= mirror.latest_version())
+    {
+      // We have already caught up to this wakeup
+      ++requests_saved;
+      return;
+    }
+
+    request_update(minimum_version);
+  }
+
+  void receive_patch(const MirrorPatch& msg)
+  {
+    const auto& ids = msg.query_ids;
+    if(std::find(ids.begin(), ids.end(), request_msg->query_id) == ids.end())
+      return;
+
+    const bool missed_patch = last_patch_sequence
+        && msg.sequence != *last_patch_sequence + 1;
+    last_patch_sequence = msg.sequence;
+
+    if(msg.patch.latest_version <= mirror.latest_version())
+    {
+      // We already caught up to this patch with the MirrorUpdate service
+      return;
+    }
+
+    if(missed_patch || waiting_for_reply
+       || msg.after_version != mirror.latest_version())
+    {
+      // This patch does not pick up where our mirror left off, so we need to
+      // ask the schedule for the changes that we missed.
+      request_update(msg.patch.latest_version);
+      return;
+    }
+
+    try
+    {
+      apply(convert(msg.patch));
+    }
+    catch(const std::exception& e)
+    {
+      RCLCPP_ERROR(
+            node.get_logger(),
+            "[rmf_traffic_ros2::MirrorManager] Failed to deserialize streamed "
+            "Patch message: " + std::string(e.what()));
+    }
+  }
+
+  void apply(const rmf_traffic::schedule::Database::Patch& patch)
+  {
+    RCLCPP_DEBUG(
+          node.get_logger(),
+          "Updating mirror ["
+          + std::to_string(patch.latest_version())
+          + "]: " + std::to_string(patch.size()) + " changes");
+
+    std::mutex* update_mutex = options.update_mutex();
+    if (update_mutex)
+    {
+      std::lock_guard<std::mutex> lock(*update_mutex);
+      mirror.update(patch);
+    }
+    else
+    {
+      mirror.update(patch);
+    }
+  }
+
+  /// Request an update in response to a change in the schedule. When many
+  /// changes arrive in a burst, they get folded into a single request, and
+  /// requests are kept at least the minimum update interval apart.
+  void request_update(uint64_t minimum_version)
+  {
+    if (waiting_for_reply || update_timer)
+    {
+      next_minimum_version = std::max(next_minimum_version, minimum_version);
+      ++requests_saved;
+      return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto ready_time =
+        last_request_time + options.minimum_update_interval();
+    if (now < ready_time)
+    {
+      next_minimum_version = std::max(next_minimum_version, minimum_version);
+      update_timer = node.create_wall_timer(ready_time - now, [&]()
+      {
+        const auto timer = std::move(update_timer);
+        timer->cancel();
+        update(next_minimum_version);
+      });
+      return;
+    }
+
+    update(minimum_version);
   }
 
   void update(
@@ -94,11 +246,14 @@ public:
   {
     if (waiting_for_reply)
     {
-      next_minimum_version = minimum_version;
+      next_minimum_version = std::max(next_minimum_version, minimum_version);
+      ++requests_saved;
       return;
     }
 
     waiting_for_reply = true;
+    last_request_time = std::chrono::steady_clock::now();
+    ++requests_sent;
     // TODO(MXG): What if the latest version has wrapped around the integer
     // overflow, but this is a fresh mirror starting up? We should have a ROS2
     // service to ask the schedule database what its oldest version is, and
@@ -113,32 +268,23 @@ public:
           [&](const MirrorUpdateFuture response_future)
     {
       const auto response = response_future.get();
+      waiting_for_reply = false;
+
+      if (response->query_unrecognized)
+      {
+        reregister_query();
+        return;
+      }
 
       try
       {
         const rmf_traffic::schedule::Database::Patch patch =
             convert(response->patch);
 
-        RCLCPP_DEBUG(
-              node.get_logger(),
-              "Updating mirror ["
-              + std::to_string(response->patch.latest_version)
-              + "]: " + std::to_string(patch.size()) + " changes");
-
-        std::mutex* update_mutex = options.update_mutex();
-        if (update_mutex)
-        {
-          std::lock_guard<std::mutex> lock(*update_mutex);
-          mirror.update(patch);
-        }
-        else
-        {
-          mirror.update(patch);
-        }
+        apply(patch);
 
-        waiting_for_reply = false;
         if (patch.latest_version() < next_minimum_version)
-          update(next_minimum_version);
+          request_update(next_minimum_version);
       }
       catch(const std::exception& e)
       {
@@ -153,6 +299,43 @@ public:
       future.wait_for(wait);
   }
 
+  /// Register our query again. The schedule node forgets its registered
+  /// queries when it restarts, after which it will not recognize our query_id.
+  void reregister_query()
+  {
+    RCLCPP_WARN(
+          node.get_logger(),
+          "[rmf_traffic_ros2::MirrorManager] The schedule does not recognize "
+          "query_id [" + std::to_string(request_msg->query_id) + "], so the "
+          "query will be registered again");
+
+    // Updates will be held back until the new query_id arrives
+    waiting_for_reply = true;
+
+    RegisterQuery::Request register_query_request;
+    register_query_request.query = convert(spacetime);
+    register_query_client->async_send_request(
+          std::make_shared<RegisterQuery::Request>(register_query_request),
+          [&](const RegisterQueryFuture response_future)
+    {
+      const auto response = response_future.get();
+      waiting_for_reply = false;
+
+      if (!response->error.empty())
+      {
+        RCLCPP_ERROR(
+              node.get_logger(),
+              "[rmf_traffic_ros2::MirrorManager] Failed to register the query "
+              "again: " + response->error);
+        return;
+      }
+
+      request_msg->query_id = response->query_id;
+      last_patch_sequence = rmf_utils::nullopt;
+      update(std::max(next_minimum_version, mirror.latest_version()));
+    });
+  }
+
   ~Implementation()
   {
     UnregisterQuery::Request msg;
@@ -181,16 +364,24 @@ public:
 
   bool update_on_wakeup;
 
+  bool stream_patches;
+
+  rmf_traffic::Duration minimum_update_interval;
+
 };
 
 //==============================================================================
 MirrorManager::Options::Options(
     std::mutex* update_mutex,
-    bool update_on_wakeup)
+    bool update_on_wakeup,
+    bool stream_patches,
+    rmf_traffic::Duration minimum_update_interval)
   : _pimpl(rmf_utils::make_impl<Implementation>(
              Implementation{
                update_mutex,
-               update_on_wakeup
+               update_on_wakeup,
+               stream_patches,
+               minimum_update_interval
              }))
 {
   // Do nothing
@@ -222,6 +413,33 @@ auto MirrorManager::Options::update_on_wakeup(bool choice) -> Options&
   return *this;
 }
 
+//==============================================================================
+bool MirrorManager::Options::stream_patches() const
+{
+  return _pimpl->stream_patches;
+}
+
+//==============================================================================
+auto MirrorManager::Options::stream_patches(bool choice) -> Options&
+{
+  _pimpl->stream_patches = choice;
+  return *this;
+}
+
+//==============================================================================
+rmf_traffic::Duration MirrorManager::Options::minimum_update_interval() const
+{
+  return _pimpl->minimum_update_interval;
+}
+
+//==============================================================================
+auto MirrorManager::Options::minimum_update_interval(
+    rmf_traffic::Duration interval) -> Options&
+{
+  _pimpl->minimum_update_interval = interval;
+  return *this;
+}
+
 //==============================================================================
 const rmf_traffic::schedule::Viewer& MirrorManager::viewer() const
 {
@@ -234,6 +452,18 @@ void MirrorManager::update(const rmf_traffic::Duration wait)
   _pimpl->update(_pimpl->mirror.latest_version(), wait);
 }
 
+//==============================================================================
+std::size_t MirrorManager::update_requests_sent() const
+{
+  return _pimpl->requests_sent;
+}
+
+//==============================================================================
+std::size_t MirrorManager::update_requests_saved() const
+{
+  return _pimpl->requests_saved;
+}
+
 //==============================================================================
 auto MirrorManager::get_options() const -> const Options&
 {
@@ -244,6 +474,7 @@ auto MirrorManager::get_options() const -> const Options&
 MirrorManager& MirrorManager::set_options(Options options)
 {
   _pimpl->options = std::move(options);
+  _pimpl->configure_streaming();
   return *this;
 }
 
@@ -262,9 +493,6 @@ public:
   rmf_traffic::schedule::Query::Spacetime spacetime;
   MirrorManager::Options options;
 
-  using RegisterQuery = rmf_traffic_msgs::srv::RegisterQuery;
-  using RegisterQueryClient = rclcpp::Client<RegisterQuery>::SharedPtr;
-  using RegisterQueryFuture = rclcpp::Client<RegisterQuery>::SharedFuture;
   using UnregisterQueryFuture = rclcpp::Client<UnregisterQuery>::SharedFuture;
   RegisterQueryClient register_query_client;
   MirrorUpdateClient mirror_update_client;
@@ -363,7 +591,9 @@ public:
     return MirrorManager::Implementation::make(
           node,
           std::move(options),
+          std::move(spacetime),
           registration.query_id,
+          std::move(register_query_client),
           std::move(mirror_update_client),
           std::move(unregister_query_client));
   }
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#include "ConflictTracker.hpp"
+
+#include <rmf_traffic/Conflict.hpp>
+
+#include <rmf_utils/optional.hpp>
+
+#include <algorithm>
+
+namespace rmf_traffic_schedule {
+
+//==============================================================================
+auto ConflictTracker::update(const Patch& patch) -> Version
+{
+  using Mode = rmf_traffic::schedule::Database::Change::Mode;
+
+  // Collect the entries that this patch makes obsolete before we apply it, so
+  // that nothing changes if the mirror rejects the patch.
+  std::vector<Version> obsolete;
+  rmf_utils::optional<rmf_traffic::Time> cull_time;
+  for(const auto& change : patch)
+  {
+    switch(change.get_mode())
+    {
+      case Mode::Interrupt:
+        obsolete.push_back(change.interrupt()->original_id());
+        break;
+      case Mode::Delay:
+        obsolete.push_back(change.delay()->original_id());
+        break;
+      case Mode::Replace:
+        obsolete.push_back(change.replace()->original_id());
+        break;
+      case Mode::Erase:
+        obsolete.push_back(change.erase()->original_id());
+        break;
+      case Mode::Cull:
+        if(!cull_time || *cull_time < change.cull()->time())
+          cull_time = change.cull()->time();
+        break;
+      default:
+        break;
+    }
+  }
+
+  const Version latest_version = _mirror.update(patch);
+
+  for(const Version id : obsolete)
+    erase(id);
+
+  if(cull_time)
+    cull(*cull_time);
+
+  return latest_version;
+}
+
+//==============================================================================
+void ConflictTracker::check()
+{
+  const auto new_entries = _mirror.query(
+        rmf_traffic::schedule::make_query(_last_checked_version));
+
+  // The time span that the new entries cover on each map
+  using TimeSpan = std::pair<rmf_traffic::Time, rmf_traffic::Time>;
+  std::unordered_map<std::string, TimeSpan> spans;
+
+  std::unordered_set<Version> new_ids;
+  std::vector<Version> new_versions;
+  std::vector<const rmf_traffic::Trajectory*> new_trajectories;
+  for(const auto& entry : new_entries)
+  {
+    new_ids.insert(entry.id);
+    new_versions.push_back(entry.id);
+    new_trajectories.push_back(&entry.trajectory);
+
+    const rmf_traffic::Trajectory& trajectory = entry.trajectory;
+    const TimeSpan span{*trajectory.start_time(), *trajectory.finish_time()};
+    const auto insertion = spans.insert(
+          std::make_pair(trajectory.get_map_name(), span));
+    if(!insertion.second)
+    {
+      TimeSpan& known = insertion.first->second;
+      known.first = std::min(known.first, span.first);
+      known.second = std::max(known.second, span.second);
+    }
+  }
+
+  if(!new_trajectories.empty())
+  {
+    // Only the old entries that share a map with the new entries and overlap
+    // them in time can be in conflict with them, so those are the only ones
+    // that get gathered for the sweep.
+    std::vector<rmf_traffic::schedule::Viewer::View> old_views;
+    old_views.reserve(spans.size());
+    for(const auto& span : spans)
+    {
+      old_views.emplace_back(
+            _mirror.query(rmf_traffic::schedule::make_query(
+                            {span.first},
+                            &span.second.first,
+                            &span.second.second)));
+    }
+
+    std::vector<Version> old_versions;
+    std::vector<const rmf_traffic::Trajectory*> old_trajectories;
+    for(const auto& view : old_views)
+    {
+      for(const auto& entry : view)
+      {
+        if(new_ids.count(entry.id) != 0)
+          continue;
+
+        old_versions.push_back(entry.id);
+        old_trajectories.push_back(&entry.trajectory);
+      }
+    }
+
+    using rmf_traffic::DetectConflict;
+    for(const auto& conflict : DetectConflict::all_pairs(new_trajectories))
+    {
+      add_conflict(
+            new_versions[conflict.first],
+            *new_trajectories[conflict.first]->finish_time(),
+            new_versions[conflict.second],
+            *new_trajectories[conflict.second]->finish_time());
+    }
+
+    const auto conflicts_with_old =
+        DetectConflict::all_pairs(new_trajectories, old_trajectories);
+    for(const auto& conflict : conflicts_with_old)
+    {
+      add_conflict(
+            new_versions[conflict.first],
+            *new_trajectories[conflict.first]->finish_time(),
+            old_versions[conflict.second],
+            *old_trajectories[conflict.second]->finish_time());
+    }
+  }
+
+  _last_checked_version = _mirror.latest_version();
+}
+
+//==============================================================================
+auto ConflictTracker::conflicts() const -> std::unordered_set<Version>
+{
+  std::unordered_set<Version> result;
+  result.reserve(_nodes.size());
+  for(const auto& node : _nodes)
+    result.insert(node.first);
+
+  return result;
+}
+
+//==============================================================================
+void ConflictTracker::erase(const Version id)
+{
+  const auto it = _nodes.find(id);
+  if(it == _nodes.end())
+    return;
+
+  for(const Version other : it->second.conflicts_with)
+  {
+    const auto other_it = _nodes.find(other);
+    if(other_it == _nodes.end())
+      continue;
+
+    other_it->second.conflicts_with.erase(id);
+    if(other_it->second.conflicts_with.empty())
+      _nodes.erase(other_it);
+  }
+
+  _nodes.erase(it);
+}
+
+//==============================================================================
+void ConflictTracker::cull(const rmf_traffic::Time time)
+{
+  // This matches the criteria that the schedule uses to cull its entries
+  std::vector<Version> culled;
+  for(const auto& node : _nodes)
+  {
+    if(node.second.finish_time < time)
+      culled.push_back(node.first);
+  }
+
+  for(const Version id : culled)
+    erase(id);
+}
+
+//==============================================================================
+void ConflictTracker::add_conflict(
+    const Version id_a, const rmf_traffic::Time finish_a,
+    const Version id_b, const rmf_traffic::Time finish_b)
+{
+  Node& node_a = _nodes.insert(
+        std::make_pair(id_a, Node{finish_a, {}})).first->second;
+  node_a.conflicts_with.insert(id_b);
+
+  Node& node_b = _nodes.insert(
+        std::make_pair(id_b, Node{finish_b, {}})).first->second;
+  node_b.conflicts_with.insert(id_a);
+}
+
+} // namespace rmf_traffic_schedule
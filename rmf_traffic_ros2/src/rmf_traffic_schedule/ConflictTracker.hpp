@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2019 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+#ifndef SRC__RMF_TRAFFIC_SCHEDULE__CONFLICTTRACKER_HPP
+#define SRC__RMF_TRAFFIC_SCHEDULE__CONFLICTTRACKER_HPP
+
+#include <rmf_traffic/schedule/Mirror.hpp>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rmf_traffic_schedule {
+
+//==============================================================================
+/// Keeps a mirror of the schedule along with the set of schedule entries that
+/// are in conflict with each other. Only the entries that were inserted or
+/// modified since the previous check get tested for conflicts, so the cost of
+/// each check is proportional to the size of the change instead of the size of
+/// the whole schedule.
+class ConflictTracker
+{
+public:
+
+  using Version = rmf_traffic::schedule::Version;
+  using Patch = rmf_traffic::schedule::Database::Patch;
+
+  /// Apply a patch to the mirror of the schedule. Entries that get erased,
+  /// replaced, or culled by the patch are removed from the known conflicts.
+  ///
+  /// A patch that comes directly from a Database may refer to trajectories
+  /// that belong to that Database, so the Database must not be modified while
+  /// this function is running.
+  ///
+  /// \return the latest version of the mirror after the patch is applied.
+  Version update(const Patch& patch);
+
+  /// Check the entries that have been inserted or modified since the last call
+  /// to this function against the rest of the schedule, and record any
+  /// conflicts that are found.
+  void check();
+
+  /// Get the entries that are currently in conflict with at least one other
+  /// entry.
+  std::unordered_set<Version> conflicts() const;
+
+private:
+
+  void erase(Version id);
+
+  void cull(rmf_traffic::Time time);
+
+  void add_conflict(
+      Version id_a, rmf_traffic::Time finish_a,
+      Version id_b, rmf_traffic::Time finish_b);
+
+  struct Node
+  {
+    rmf_traffic::Time finish_time;
+    std::unordered_set<Version> conflicts_with;
+  };
+
+  rmf_traffic::schedule::Mirror _mirror;
+
+  // Only entries that are in conflict have a node
+  std::unordered_map<Version, Node> _nodes;
+
+  Version _last_checked_version = 0;
+
+};
+
+} // namespace rmf_traffic_schedule
+
+#endif // SRC__RMF_TRAFFIC_SCHEDULE__CONFLICTTRACKER_HPP
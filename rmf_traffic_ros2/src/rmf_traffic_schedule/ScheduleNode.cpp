@@ -16,6 +16,7 @@
 */
 
 #include "ScheduleNode.hpp"
+#include "ConflictTracker.hpp"
 
 #include <rmf_traffic_ros2/StandardNames.hpp>
 #include <rmf_traffic_ros2/Trajectory.hpp>
@@ -27,40 +28,31 @@
 
 #include <rmf_utils/optional.hpp>
 
+#include <algorithm>
+#include <random>
+
 namespace rmf_traffic_schedule {
 
 //==============================================================================
-std::unordered_set<rmf_traffic::schedule::Version> get_conflicts(
-    const rmf_traffic::schedule::Viewer::View& view)
+ScheduleNode::ScheduleNode()
+  : Node("rmf_traffic_schedule_node")
 {
-  // TODO(MXG): Make this function more efficient by only checking the latest
-  // unchecked changes against the ones that came before them, and then
-  // appending that list onto the conflicts of the previous version.
-
-  std::unordered_set<rmf_traffic::schedule::Version> conflicts;
-  for (auto v0 = view.begin(); v0 != view.end(); ++v0)
+  const std::string storage_directory =
+      declare_parameter<std::string>("storage_directory", "");
+  if (!storage_directory.empty())
   {
-    auto v1 = ++rmf_traffic::schedule::Viewer::View::const_iterator{v0};
-    for (; v1 != view.end(); ++v1)
-    {
-      if (!rmf_traffic::DetectConflict::between(
-            v0->trajectory, v1->trajectory, true).empty())
-      {
-        conflicts.insert(v0->id);
-        conflicts.insert(v1->id);
-      }
-    }
-  }
+    storage = std::make_unique<rmf_traffic::schedule::Storage>(
+          storage_directory);
+    database = storage->load();
 
-  return conflicts;
-}
+    RCLCPP_INFO(
+          get_logger(),
+          "Loaded schedule version [" + std::to_string(database.latest_version())
+          + "] from " + storage_directory);
+  }
 
-//==============================================================================
-ScheduleNode::ScheduleNode()
-  : Node("rmf_traffic_schedule_node")
-{
-  // TODO(MXG): As soon as possible, all of these services should be made
-  // multi-threaded so they can be parallel processed.
+  services_callback_group = create_callback_group(
+        rclcpp::callback_group::CallbackGroupType::Reentrant);
 
   submit_trajectories_service =
       create_service<rmf_traffic_msgs::srv::SubmitTrajectories>(
@@ -68,7 +60,8 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const SubmitTrajectories::Request::SharedPtr request,
             const SubmitTrajectories::Response::SharedPtr response)
-        { this->submit_trajectories(request_header, request, response); });
+        { this->submit_trajectories(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   replace_trajectories_service =
       create_service<ReplaceTrajectories>(
@@ -76,7 +69,8 @@ ScheduleNode::ScheduleNode()
         [=](const request_id_ptr request_header,
             const ReplaceTrajectories::Request::SharedPtr request,
             const ReplaceTrajectories::Response::SharedPtr response)
-        { this->replace_trajectories(request_header, request, response); });
+        { this->replace_trajectories(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   delay_trajectories_service =
       create_service<DelayTrajectories>(
@@ -84,7 +78,8 @@ ScheduleNode::ScheduleNode()
         [=](const request_id_ptr request_header,
             const DelayTrajectories::Request::SharedPtr request,
             const DelayTrajectories::Response::SharedPtr response)
-        { this->delay_trajectories(request_header, request, response); });
+        { this->delay_trajectories(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   erase_trajectories_service =
       create_service<EraseTrajectories>(
@@ -92,7 +87,8 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const EraseTrajectories::Request::SharedPtr request,
             const EraseTrajectories::Response::SharedPtr response)
-        { this->erase_trajectories(request_header, request, response); });
+        { this->erase_trajectories(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   resolve_conflicts_service =
       create_service<ResolveConflicts>(
@@ -100,7 +96,8 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const ResolveConflicts::Request::SharedPtr request,
             const ResolveConflicts::Response::SharedPtr response)
-        { this->resolve_conflicts(request_header, request, response); });
+        { this->resolve_conflicts(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   register_query_service =
       create_service<RegisterQuery>(
@@ -108,7 +105,8 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const RegisterQuery::Request::SharedPtr request,
             const RegisterQuery::Response::SharedPtr response)
-        { this->register_query(request_header, request, response); });
+        { this->register_query(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   unregister_query_service =
       create_service<UnregisterQuery>(
@@ -116,7 +114,8 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const UnregisterQuery::Request::SharedPtr request,
             const UnregisterQuery::Response::SharedPtr response)
-        { this->unregister_query(request_header, request, response); });
+        { this->unregister_query(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   mirror_update_service =
       create_service<MirrorUpdate>(
@@ -124,23 +123,48 @@ ScheduleNode::ScheduleNode()
         [=](const std::shared_ptr<rmw_request_id_t> request_header,
             const MirrorUpdate::Request::SharedPtr request,
             const MirrorUpdate::Response::SharedPtr response)
-        { this->mirror_update(request_header, request, response); });
+        { this->mirror_update(request_header, request, response); },
+        rmw_qos_profile_services_default, services_callback_group);
 
   mirror_wakeup_publisher =
       create_publisher<MirrorWakeup>(
         rmf_traffic_ros2::MirrorWakeupTopicName,
         rclcpp::SystemDefaultsQoS());
 
+  mirror_patch_publisher =
+      create_publisher<MirrorPatch>(
+        rmf_traffic_ros2::MirrorPatchTopicName,
+        rclcpp::SystemDefaultsQoS());
+
   conflict_publisher =
       create_publisher<ScheduleConflict>(
         rmf_traffic_ros2::ScheduleConflictTopicName,
         rclcpp::SystemDefaultsQoS());
 
+  // Trajectories that finished more than one cull period ago get culled from
+  // the database once per cull period. A period of zero disables culling.
+  const double cull_period_sec =
+      declare_parameter<double>("cull_period", 600.0);
+  if (cull_period_sec > 0.0)
+  {
+    cull_period = std::chrono::duration_cast<rmf_traffic::Duration>(
+          std::chrono::duration<double, std::ratio<1>>(cull_period_sec));
+    cull_timer = create_wall_timer(cull_period, [=]() { this->cull(); });
+  }
+
+  // Query IDs start from a random value, so the mirrors that registered with
+  // an earlier run of this node are unlikely to share an ID with the mirrors
+  // that register with this one. Those mirrors will be told that their IDs
+  // are unrecognized, and they will register their queries again.
+  std::random_device random_device;
+  last_query_id = (static_cast<uint64_t>(random_device()) << 32)
+      | random_device();
+
   conflict_check_quit = false;
   conflict_check_thread = std::thread(
         [&]()
   {
-    rmf_traffic::schedule::Mirror mirror;
+    ConflictTracker conflict_tracker;
 
     Version last_checked_version = 0;
 
@@ -152,7 +176,7 @@ ScheduleNode::ScheduleNode()
 
       // Use this scope to minimize how long we lock the database for
       {
-        std::unique_lock<std::mutex> lock(database_mutex);
+        ReadLock lock(database_mutex);
         conflict_check_cv.wait_for(lock, std::chrono::milliseconds(100), [&]()
         {
           return (database.latest_version() > last_checked_version)
@@ -168,12 +192,11 @@ ScheduleNode::ScheduleNode()
 
         next_patch = database.changes(next_query);
 
-        // TODO(MXG): Check whether the database really needs to remain locked
-        // during this update.
+        // The patch refers to trajectories that are owned by the database, so
+        // the database needs to remain locked while the tracker copies them.
         try
         {
-          mirror.update(*next_patch);
-          last_checked_version = next_patch->latest_version();
+          last_checked_version = conflict_tracker.update(*next_patch);
         }
         catch(const std::exception& e)
         {
@@ -182,10 +205,10 @@ ScheduleNode::ScheduleNode()
         }
       }
 
-      const auto view = mirror.query(
-            rmf_traffic::schedule::query_everything());
-
-      const auto conflicts = get_conflicts(view);
+      // Only the entries that changed since the last check get tested against
+      // the rest of the schedule.
+      conflict_tracker.check();
+      const auto conflicts = conflict_tracker.conflicts();
       if (!conflicts.empty())
       {
         {
@@ -282,6 +305,12 @@ std::unordered_set<uint64_t> ScheduleNode::process_trajectories(
               requested_trajectory.start_time(),
               requested_trajectory.finish_time()));
 
+    // Sort the schedule entries into the ones that were already in conflict
+    // and the rest, so that each group can be checked against the requested
+    // trajectory in a single batch.
+    std::vector<uint64_t> initial_ids;
+    std::vector<const rmf_traffic::Trajectory*> initial_trajectories;
+    std::vector<const rmf_traffic::Trajectory*> other_trajectories;
     for(const auto& v : view)
     {
       if (initial_conflicts.count(v.id) != 0)
@@ -291,26 +320,21 @@ std::unordered_set<uint64_t> ScheduleNode::process_trajectories(
         if (replace_ids.count(v.id) != 0)
           continue;
 
-        if (!rmf_traffic::DetectConflict::between(
-              requested_trajectory, v.trajectory, true).empty())
-          unresolved_conflicts.insert(v.id);
-
+        initial_ids.push_back(v.id);
+        initial_trajectories.push_back(&v.trajectory);
         continue;
       }
 
-      // TODO(MXG) Since we already put these time limits in the query, do we
-      // really need to check them again here?
-      if(*requested_trajectory.finish_time() < *v.trajectory.start_time())
-        continue;
+      other_trajectories.push_back(&v.trajectory);
+    }
 
-      if(*v.trajectory.finish_time() < *requested_trajectory.start_time())
-        continue;
+    for(const std::size_t index : rmf_traffic::DetectConflict::all_between(
+          requested_trajectory, initial_trajectories))
+      unresolved_conflicts.insert(initial_ids[index]);
 
-      const auto conflicts = rmf_traffic::DetectConflict::narrow_phase(
-            requested_trajectory, v.trajectory, true);
-      if (!conflicts.empty())
-        output_conflicts.push_back(i);
-    }
+    if (rmf_traffic::DetectConflict::any_between(
+          requested_trajectory, other_trajectories))
+      output_conflicts.push_back(i);
 
     output_trajectories.emplace_back(std::move(requested_trajectory));
   }
@@ -326,19 +350,18 @@ std::vector<uint64_t> check_self_conflicts(
   // this kind of check? Like each submission can only refer to one vehicle at
   // a time, and therefore we should never need to test these trajectories for
   // conflicts with each other?
+  std::vector<const rmf_traffic::Trajectory*> trajectories;
+  trajectories.reserve(requested_trajectories.size());
+  for(const auto& trajectory : requested_trajectories)
+    trajectories.push_back(&trajectory);
+
+  const auto conflicts =
+      rmf_traffic::DetectConflict::all_pairs(trajectories);
+
   std::vector<uint64_t> conflicting_indices;
-  conflicting_indices.reserve(requested_trajectories.size());
-  for(std::size_t i=0; i < requested_trajectories.size()-1; ++i)
-  {
-    for(std::size_t j=i+1; j < requested_trajectories.size(); ++j)
-    {
-      const auto conflicts = rmf_traffic::DetectConflict::between(
-            requested_trajectories[i],
-            requested_trajectories[j], true);
-      if (!conflicts.empty())
-        conflicting_indices.push_back(i);
-    }
-  }
+  conflicting_indices.reserve(conflicts.size());
+  for(const auto& conflict : conflicts)
+    conflicting_indices.push_back(conflict.first);
 
   return conflicting_indices;
 }
@@ -350,14 +373,15 @@ void ScheduleNode::submit_trajectories(
     const SubmitTrajectories::Response::SharedPtr& response)
 {
   response->accepted = true;
-  response->current_version = database.latest_version();
-  response->original_version = response->current_version;
   response->error.clear();
 
   std::vector<rmf_traffic::Trajectory> requested_trajectories;
   std::vector<uint64_t> conflicting_indices;
   try
   {
+    ReadLock lock(database_mutex);
+    response->current_version = database.latest_version();
+    response->original_version = response->current_version;
     process_trajectories(
           requested_trajectories, conflicting_indices, request->trajectories);
   }
@@ -377,12 +401,15 @@ void ScheduleNode::submit_trajectories(
 //    return;
 
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    WriteLock lock(database_mutex);
     for(auto&& request : requested_trajectories)
       database.insert(std::move(request));
+
+    prepare_save();
+    response->current_version = database.latest_version();
   }
 
-  response->current_version = database.latest_version();
+  save_database();
   wakeup_mirrors();
 
   RCLCPP_INFO(
@@ -398,24 +425,41 @@ void ScheduleNode::perform_replacement(
     uint64_t& latest_trajectory_version,
     uint64_t& current_version)
 {
-  std::size_t index=0;
-  std::unique_lock<std::mutex> lock(database_mutex);
-  while (index < replace_ids.size() &&
-         index < trajectories.size())
   {
-    database.replace(replace_ids[index], std::move(trajectories[index]));
-    ++index;
-  }
+    std::size_t index=0;
+    WriteLock lock(database_mutex);
+    try
+    {
+      while (index < replace_ids.size() &&
+             index < trajectories.size())
+      {
+        database.replace(replace_ids[index], std::move(trajectories[index]));
+        ++index;
+      }
+
+      for (; index < trajectories.size(); ++index)
+        database.insert(std::move(trajectories[index]));
 
-  for (; index < trajectories.size(); ++index)
-    database.insert(std::move(trajectories[index]));
+      latest_trajectory_version = database.latest_version();
 
-  latest_trajectory_version = database.latest_version();
+      for (; index < replace_ids.size(); ++index)
+        database.erase(replace_ids[index]);
+    }
+    catch (const std::exception&)
+    {
+      // The changes that were made before the exception will be seen by the
+      // mirrors, so they need to be saved too.
+      prepare_save();
+      lock.unlock();
+      save_database();
+      throw;
+    }
 
-  for (; index < replace_ids.size(); ++index)
-    database.erase(replace_ids[index]);
+    prepare_save();
+    current_version = database.latest_version();
+  }
 
-  current_version = database.latest_version();
+  save_database();
 }
 
 //==============================================================================
@@ -424,7 +468,10 @@ void ScheduleNode::replace_trajectories(
     const ReplaceTrajectories::Request::SharedPtr& request,
     const ReplaceTrajectories::Response::SharedPtr& response)
 {
-  response->original_version = database.latest_version();
+  {
+    ReadLock lock(database_mutex);
+    response->original_version = database.latest_version();
+  }
   response->current_version = response->original_version;
   if (request->replace_ids.size() == 0)
   {
@@ -472,7 +519,10 @@ void ScheduleNode::delay_trajectories(
     const DelayTrajectories::Request::SharedPtr& request,
     const DelayTrajectories::Response::SharedPtr& response)
 {
-  response->original_version = database.latest_version();
+  {
+    ReadLock lock(database_mutex);
+    response->original_version = database.latest_version();
+  }
   response->current_version = response->original_version;
 
   const auto from_time = std::chrono::steady_clock::time_point(
@@ -488,13 +538,15 @@ void ScheduleNode::delay_trajectories(
   const auto delay = std::chrono::nanoseconds(request->delay);
 
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    WriteLock lock(database_mutex);
     for (const rmf_traffic::schedule::Version id : request->delay_ids)
       database.delay(id, from_time, delay);
-  }
 
-  response->current_version = database.latest_version();
+    prepare_save();
+    response->current_version = database.latest_version();
+  }
 
+  save_database();
   wakeup_mirrors();
 }
 
@@ -505,12 +557,15 @@ void ScheduleNode::erase_trajectories(
     const EraseTrajectories::Response::SharedPtr& response)
 {
   {
-    std::unique_lock<std::mutex> lock(database_mutex);
+    WriteLock lock(database_mutex);
     for(const uint64_t id : request->erase_ids)
       database.erase(id);
+
+    prepare_save();
+    response->version = database.latest_version();
   }
 
-  response->version = database.latest_version();
+  save_database();
   wakeup_mirrors();
 }
 
@@ -520,7 +575,10 @@ void ScheduleNode::resolve_conflicts(
     const ResolveConflicts::Request::SharedPtr& request,
     const ResolveConflicts::Response::SharedPtr& response)
 {
-  response->current_version = database.latest_version();
+  {
+    ReadLock lock(database_mutex);
+    response->current_version = database.latest_version();
+  }
   response->original_version = response->current_version;
   response->accepted = false;
 
@@ -588,6 +646,7 @@ void ScheduleNode::resolve_conflicts(
   std::unordered_set<uint64_t> unresolved_conflicts;
   try
   {
+    ReadLock lock(database_mutex);
     unresolved_conflicts = process_trajectories(
           resolution_trajectories,
           conflict_indices,
@@ -628,23 +687,46 @@ void ScheduleNode::resolve_conflicts(
     return;
   }
 
-  response->accepted = true;
-
   {
+    // Services run in parallel, so the conflict may have been resolved, or
+    // cleared by the conflict checking thread, while we were evaluating this
+    // request. We hold onto the lock until the replacement is finished so that
+    // only one resolution of the same conflict can be accepted.
     std::unique_lock<std::mutex> lock(active_conflicts_mutex);
-    active_conflicts.at(request->conflict_version)
-        .unresolved_ids = unresolved_conflicts;
-  }
+    const auto conflict_it = active_conflicts.find(request->conflict_version);
+    if (conflict_it == active_conflicts.end()
+        || conflict_it->second.unresolved_ids.empty())
+    {
+      response->reason =
+          ResolveConflicts::Response::REASON_ALREADY_RESOLVED;
+      return;
+    }
 
-  try
-  {
-    perform_replacement(request->resolve_ids, std::move(resolution_trajectories),
-                        response->latest_trajectory_version,
-                        response->current_version);
-  }
-  catch (const std::exception& e)
-  {
-    response->error = e.what();
+    if (conflict_it->second.unresolved_ids != remaining_conflict_set)
+    {
+      response->reason =
+          ResolveConflicts::Response::REASON_ALREADY_PARTIALLY_RESOLVED;
+      return;
+    }
+
+    try
+    {
+      perform_replacement(
+            request->resolve_ids, std::move(resolution_trajectories),
+            response->latest_trajectory_version,
+            response->current_version);
+    }
+    catch (const std::exception& e)
+    {
+      response->error = e.what();
+      response->reason = ResolveConflicts::Response::REASON_EXCEPTION;
+      lock.unlock();
+      wakeup_mirrors();
+      return;
+    }
+
+    conflict_it->second.unresolved_ids = std::move(unresolved_conflicts);
+    response->accepted = true;
   }
 
   wakeup_mirrors();
@@ -656,6 +738,8 @@ void ScheduleNode::register_query(
     const RegisterQuery::Request::SharedPtr& request,
     const RegisterQuery::Response::SharedPtr& response)
 {
+  std::unique_lock<std::mutex> lock(queries_mutex);
+
   uint64_t query_id = last_query_id;
   uint64_t attempts = 0;
   do
@@ -674,9 +758,47 @@ void ScheduleNode::register_query(
     }
   } while(registered_queries.find(query_id) != registered_queries.end());
 
+  // If another mirror has already registered the same query, then this
+  // registration will share its patches.
+  QueryInfoPtr info;
+  for (const auto& existing : distinct_queries)
+  {
+    if (existing->msg == request->query)
+    {
+      info = existing;
+      break;
+    }
+  }
+
+  if (!info)
+  {
+    try
+    {
+      info = std::make_shared<QueryInfo>(request->query);
+    }
+    catch(const std::exception& e)
+    {
+      response->error = std::string("Invalid query: ") + e.what();
+      RCLCPP_ERROR(
+            get_logger(),
+            "[ScheduleNode::register_query] " + response->error);
+      return;
+    }
+
+    // Patches will only be streamed for changes that happen after the query
+    // was registered. Mirrors will use the MirrorUpdate service to catch up
+    // to this point.
+    {
+      ReadLock database_lock(database_mutex);
+      info->streamed_version = database.latest_version();
+    }
+
+    distinct_queries.push_back(info);
+  }
+
+  info->query_ids.push_back(query_id);
   last_query_id = query_id;
-  registered_queries.insert(
-        std::make_pair(query_id, rmf_traffic_ros2::convert(request->query)));
+  registered_queries.insert(std::make_pair(query_id, std::move(info)));
 
   response->query_id = query_id;
   RCLCPP_INFO(
@@ -690,6 +812,8 @@ void ScheduleNode::unregister_query(
     const UnregisterQuery::Request::SharedPtr& request,
     const UnregisterQuery::Response::SharedPtr& response)
 {
+  std::unique_lock<std::mutex> lock(queries_mutex);
+
   const auto it = registered_queries.find(request->query_id);
   if(it == registered_queries.end())
   {
@@ -703,7 +827,20 @@ void ScheduleNode::unregister_query(
     return;
   }
 
+  const QueryInfoPtr info = it->second;
   registered_queries.erase(it);
+  info->query_ids.erase(
+        std::remove(
+          info->query_ids.begin(), info->query_ids.end(), request->query_id),
+        info->query_ids.end());
+
+  if (info->query_ids.empty())
+  {
+    distinct_queries.erase(
+          std::remove(distinct_queries.begin(), distinct_queries.end(), info),
+          distinct_queries.end());
+  }
+
   response->confirmation = true;
 
   RCLCPP_INFO(
@@ -717,32 +854,188 @@ void ScheduleNode::mirror_update(
     const MirrorUpdate::Request::SharedPtr& request,
     const MirrorUpdate::Response::SharedPtr& response)
 {
-  const auto query_it = registered_queries.find(request->query_id);
-  if(query_it == registered_queries.end())
+  QueryInfoPtr info;
+  {
+    std::unique_lock<std::mutex> lock(queries_mutex);
+    const auto query_it = registered_queries.find(request->query_id);
+    if(query_it != registered_queries.end())
+      info = query_it->second;
+  }
+
+  if(!info)
   {
     response->error = "Unrecognized query_id: "
         + std::to_string(request->query_id);
+    response->query_unrecognized = true;
     RCLCPP_WARN(
           get_logger(),
           "[ScheduleNode::mirror_update] " + response->error);
     return;
   }
 
-  auto query = rmf_traffic::schedule::make_query(
-        request->latest_mirror_version);
-  query.spacetime() = query_it->second;
+  // Mirrors that share a query usually get woken up together and ask for the
+  // same patch, so we hold onto the cache lock while computing a patch. Any
+  // requests for the same patch that arrive in the meantime will wait for it
+  // instead of computing it again.
+  std::unique_lock<std::mutex> cache_lock(info->cache_mutex);
+  const ConstSchedulePatchPtr patch =
+      get_patch(*info, request->latest_mirror_version);
+  cache_lock.unlock();
 
-  response->patch = rmf_traffic_ros2::convert(database.changes(query));
+  response->patch = *patch;
+}
+
+//==============================================================================
+auto ScheduleNode::get_patch(QueryInfo& info, const Version after)
+-> ConstSchedulePatchPtr
+{
+  ReadLock database_lock(database_mutex);
+
+  const Version latest_version = database.latest_version();
+  if(info.cached_latest_version != latest_version)
+  {
+    info.cached_patches.clear();
+    info.cached_latest_version = latest_version;
+  }
+
+  ConstSchedulePatchPtr& cached_patch = info.cached_patches[after];
+  if(!cached_patch)
+  {
+    auto query = rmf_traffic::schedule::make_query(after);
+    query.spacetime() = info.spacetime;
+
+    cached_patch = std::make_shared<SchedulePatch>(
+          rmf_traffic_ros2::convert(database.changes(query)));
+  }
+
+  return cached_patch;
+}
+
+//==============================================================================
+void ScheduleNode::cull()
+{
+  Version version;
+  {
+    WriteLock lock(database_mutex);
+    database.cull(std::chrono::steady_clock::now() - cull_period);
+    prepare_save();
+    version = database.latest_version();
+  }
+
+  save_database();
+  wakeup_mirrors();
+
+  RCLCPP_DEBUG(
+        get_logger(),
+        "Culled the schedule [" + std::to_string(version) + "]");
+}
+
+//==============================================================================
+void ScheduleNode::prepare_save()
+{
+  if (!storage)
+    return;
+
+  try
+  {
+    auto pending = storage->prepare(database);
+    std::unique_lock<std::mutex> lock(pending_saves_mutex);
+    pending_saves.emplace_back(std::move(pending));
+  }
+  catch (const std::exception& e)
+  {
+    RCLCPP_ERROR(
+          get_logger(),
+          std::string("Failed to prepare the schedule for saving: ")
+          + e.what());
+  }
+}
+
+//==============================================================================
+void ScheduleNode::save_database()
+{
+  if (!storage)
+    return;
+
+  // Whichever thread gets the storage first writes everything that has been
+  // prepared so far, so the saves reach the disk in the order they were
+  // prepared.
+  std::unique_lock<std::mutex> storage_lock(storage_mutex);
+  while (true)
+  {
+    std::unique_lock<std::mutex> lock(pending_saves_mutex);
+    if (pending_saves.empty())
+      return;
+
+    auto pending = std::move(pending_saves.front());
+    pending_saves.pop_front();
+    lock.unlock();
+
+    try
+    {
+      storage->write(std::move(pending));
+    }
+    catch (const std::exception& e)
+    {
+      RCLCPP_ERROR(
+            get_logger(),
+            std::string("Failed to save the schedule: ") + e.what());
+    }
+  }
 }
 
 //==============================================================================
 void ScheduleNode::wakeup_mirrors()
 {
   rmf_traffic_msgs::msg::MirrorWakeup msg;
-  msg.latest_version = database.latest_version();
+  {
+    ReadLock lock(database_mutex);
+    msg.latest_version = database.latest_version();
+  }
   mirror_wakeup_publisher->publish(msg);
 
+  // Nobody has asked for patches to be streamed, so we can skip computing them
+  if(mirror_patch_publisher->get_subscription_count() > 0)
+    publish_mirror_patches();
+
   conflict_check_cv.notify_all();
 }
 
+//==============================================================================
+void ScheduleNode::publish_mirror_patches()
+{
+  std::vector<std::pair<QueryInfoPtr, std::vector<uint64_t>>> queries;
+  {
+    std::unique_lock<std::mutex> lock(queries_mutex);
+    queries.reserve(distinct_queries.size());
+    for(const auto& info : distinct_queries)
+      queries.emplace_back(info, info->query_ids);
+  }
+
+  for(auto& query : queries)
+  {
+    QueryInfo& info = *query.first;
+
+    // The cache lock is held until the patch is published so that the patches
+    // of each query go out in the same order as their sequence numbers, even
+    // when several changes finish at the same time.
+    std::unique_lock<std::mutex> cache_lock(info.cache_mutex);
+    const ConstSchedulePatchPtr patch = get_patch(info, info.streamed_version);
+    if(patch->latest_version <= info.streamed_version)
+    {
+      // Another thread has already streamed this version of the schedule
+      continue;
+    }
+
+    MirrorPatch msg;
+    msg.query_ids = std::move(query.second);
+    msg.sequence = ++info.stream_sequence;
+    msg.after_version = info.streamed_version;
+    msg.patch = *patch;
+
+    info.streamed_version = patch->latest_version;
+    mirror_patch_publisher->publish(msg);
+  }
+}
+
 } // namespace rmf_traffic_schedule
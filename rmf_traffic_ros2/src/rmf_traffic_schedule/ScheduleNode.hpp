@@ -19,11 +19,17 @@
 #define SRC__RMF_TRAFFIC_SCHEDULE__SCHEDULENODE_HPP
 
 #include <rmf_traffic/schedule/Database.hpp>
+#include <rmf_traffic/schedule/Storage.hpp>
+
+#include <rmf_traffic_ros2/schedule/Query.hpp>
 
 #include <rclcpp/node.hpp>
 
+#include <rmf_traffic_msgs/msg/mirror_patch.hpp>
 #include <rmf_traffic_msgs/msg/mirror_wakeup.hpp>
 #include <rmf_traffic_msgs/msg/schedule_conflict.hpp>
+#include <rmf_traffic_msgs/msg/schedule_patch.hpp>
+#include <rmf_traffic_msgs/msg/schedule_query_spacetime.hpp>
 
 #include <rmf_traffic_msgs/srv/submit_trajectories.hpp>
 #include <rmf_traffic_msgs/srv/replace_trajectories.hpp>
@@ -36,7 +42,13 @@
 #include <rmf_traffic_msgs/srv/mirror_update.h>
 #include <rmf_traffic_msgs/srv/unregister_query.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace rmf_traffic_schedule {
 
@@ -159,6 +171,11 @@ private:
   MirrorWakeupPublisher::SharedPtr mirror_wakeup_publisher;
 
 
+  using MirrorPatch = rmf_traffic_msgs::msg::MirrorPatch;
+  using MirrorPatchPublisher = rclcpp::Publisher<MirrorPatch>;
+  MirrorPatchPublisher::SharedPtr mirror_patch_publisher;
+
+
   using ScheduleConflict = rmf_traffic_msgs::msg::ScheduleConflict;
   using ScheduleConflictPublisher = rclcpp::Publisher<ScheduleConflict>;
   ScheduleConflictPublisher::SharedPtr conflict_publisher;
@@ -166,23 +183,108 @@ private:
 
   void wakeup_mirrors();
 
-  // TODO(MXG): Consider using libguarded instead of a database_mutex
-  std::mutex database_mutex;
+  void publish_mirror_patches();
+
+  // All of the services share this callback group so that they can be run in
+  // parallel by a multi-threaded executor.
+  rclcpp::callback_group::CallbackGroup::SharedPtr services_callback_group;
+
+  // Requests that only read from the database (like mirror updates and
+  // conflict checks) hold a shared lock on this mutex, so they can run at the
+  // same time as each other. Requests that modify the database hold a unique
+  // lock.
+  using DatabaseMutex = std::shared_timed_mutex;
+  using ReadLock = std::shared_lock<DatabaseMutex>;
+  using WriteLock = std::unique_lock<DatabaseMutex>;
+  DatabaseMutex database_mutex;
   rmf_traffic::schedule::Database database;
 
-  using QueryMap =
-      std::unordered_map<uint64_t, rmf_traffic::schedule::Query::Spacetime>;
+  // If the storage_directory parameter is set, the database gets loaded from
+  // this storage on startup and saved to it after each change. Each change is
+  // serialized by prepare_save() while the WriteLock is still held, and then
+  // save_database() writes it to disk after the WriteLock is released, so
+  // requests that read the database do not have to wait for the disk.
+  std::unique_ptr<rmf_traffic::schedule::Storage> storage;
+  void prepare_save();
+  void save_database();
+
+  // Saves that have been prepared but not written yet, in the order that they
+  // were prepared. This is protected by pending_saves_mutex.
+  std::deque<rmf_traffic::schedule::Storage::Pending> pending_saves;
+  std::mutex pending_saves_mutex;
+
+  // Makes sure that only one thread writes to the storage at a time
+  std::mutex storage_mutex;
+
+  // Old trajectories are culled from the database periodically. Culling is
+  // also what lets the storage compact its log into a new snapshot.
+  void cull();
+  rmf_traffic::Duration cull_period;
+  rclcpp::TimerBase::SharedPtr cull_timer;
+
+  using Version = rmf_traffic::schedule::Version;
+  using SchedulePatch = rmf_traffic_msgs::msg::SchedulePatch;
+  using ConstSchedulePatchPtr = std::shared_ptr<const SchedulePatch>;
+
+  /// A query that has been registered by one or more mirrors. Mirrors that
+  /// register identical queries share the same QueryInfo, so each patch only
+  /// needs to be computed and converted once no matter how many of those
+  /// mirrors ask for it.
+  struct QueryInfo
+  {
+    QueryInfo(rmf_traffic_msgs::msg::ScheduleQuerySpacetime _msg)
+    : msg(std::move(_msg)),
+      spacetime(rmf_traffic_ros2::convert(msg))
+    {
+      // Do nothing
+    }
+
+    const rmf_traffic_msgs::msg::ScheduleQuerySpacetime msg;
+    const rmf_traffic::schedule::Query::Spacetime spacetime;
+
+    // The query IDs that refer to this QueryInfo
+    std::vector<uint64_t> query_ids;
+
+    // The patches that have been computed for this query, organized by the
+    // mirror version that they were computed for. All of these patches lead
+    // up to cached_latest_version, and they get cleared when the database
+    // moves past that version.
+    std::mutex cache_mutex;
+    Version cached_latest_version = 0;
+    std::unordered_map<Version, ConstSchedulePatchPtr> cached_patches;
+
+    // The version that the last streamed patch for this query led up to, and
+    // the sequence number that it was published with. These are also
+    // protected by cache_mutex.
+    Version streamed_version = 0;
+    uint64_t stream_sequence = 0;
+  };
+
+  using QueryInfoPtr = std::shared_ptr<QueryInfo>;
+
+  /// Get the patch that brings a mirror of this query from the given version
+  /// up to the latest version of the database. The caller must be holding
+  /// the cache_mutex of the QueryInfo.
+  ConstSchedulePatchPtr get_patch(QueryInfo& info, Version after);
+
+  using QueryMap = std::unordered_map<uint64_t, QueryInfoPtr>;
   // TODO(MXG): Have a way to make query registrations expire after they have
   // not been used for some set amount of time (e.g. 24 hours? 48 hours?).
-  std::size_t last_query_id = 0;
+  uint64_t last_query_id = 0;
   QueryMap registered_queries;
 
+  // Each distinct query that is currently registered
+  std::vector<QueryInfoPtr> distinct_queries;
+
+  // Protects registered_queries and distinct_queries. Each QueryInfo has its
+  // own mutex for its cache.
+  std::mutex queries_mutex;
+
   // TODO(MXG): Make this a separate node
   std::thread conflict_check_thread;
-  std::condition_variable conflict_check_cv;
+  std::condition_variable_any conflict_check_cv;
   std::atomic_bool conflict_check_quit;
 
-  using Version = rmf_traffic::schedule::Version;
   struct ConflictInfo
   {
     ConflictInfo(std::unordered_set<Version> ids)
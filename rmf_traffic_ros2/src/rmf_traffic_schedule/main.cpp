@@ -29,7 +29,12 @@ int main(int argc, char* argv[])
         node->get_logger(),
         "Beginning traffic schedule node");
 
-  rclcpp::spin(node);
+  // The schedule services share a reentrant callback group, so a
+  // multi-threaded executor lets mirror updates and queries be answered in
+  // parallel while the database is not being modified.
+  rclcpp::executors::MultiThreadedExecutor executor;
+  executor.add_node(node);
+  executor.spin();
 
   RCLCPP_INFO(
         node->get_logger(),